@@ -37,7 +37,7 @@
 
 /*
 ** these libs are loaded by lua.c and are readily available to any Lua
-** program
+** program; the order is the one of the LUA_*LIBK bits in lualib.h
 */
 static const luaL_Reg loadedlibs[] = {
   {LUA_GNAME, luaopen_base},
@@ -54,12 +54,31 @@ static const luaL_Reg loadedlibs[] = {
 };
 
 
-LUALIB_API void luaL_openlibs (lua_State *L) {
+/*
+** Open the libraries whose bits are set in 'load'; the ones set only in
+** 'preload' go to the preload table, so that 'require' opens them the
+** first time they are needed.
+*/
+LUALIB_API void luaL_openselectedlibs (lua_State *L, int load, int preload) {
   const luaL_Reg *lib;
+  int mask;
+  luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
   /* "require" functions from 'loadedlibs' and set results to global table */
-  for (lib = loadedlibs; lib->func; lib++) {
-    luaL_requiref(L, lib->name, lib->func, 1);
-    lua_pop(L, 1);  /* remove lib */
+  for (lib = loadedlibs, mask = 1; lib->func; lib++, mask <<= 1) {
+    if (load & mask) {
+      luaL_requiref(L, lib->name, lib->func, 1);
+      lua_pop(L, 1);  /* remove lib */
+    }
+    else if (preload & mask) {
+      lua_pushcfunction(L, lib->func);
+      lua_setfield(L, -2, lib->name);  /* PRELOAD[name] = luaopen_name */
+    }
   }
+  lua_pop(L, 1);  /* remove PRELOAD table */
+}
+
+
+LUALIB_API void luaL_openlibs (lua_State *L) {
+  luaL_openselectedlibs(L, ~0, 0);
 }
 
@@ -45,6 +45,21 @@ LUAMOD_API int (luaopen_debug) (lua_State *L);
 LUAMOD_API int (luaopen_package) (lua_State *L);
 
 
+/* bits of luaL_openselectedlibs, one for each library above */
+#define LUA_GLIBK		1
+#define LUA_LOADLIBK	(LUA_GLIBK << 1)
+#define LUA_COLIBK		(LUA_LOADLIBK << 1)
+#define LUA_TABLIBK		(LUA_COLIBK << 1)
+#define LUA_IOLIBK		(LUA_TABLIBK << 1)
+#define LUA_OSLIBK		(LUA_IOLIBK << 1)
+#define LUA_STRLIBK		(LUA_OSLIBK << 1)
+#define LUA_MATHLIBK	(LUA_STRLIBK << 1)
+#define LUA_UTF8LIBK	(LUA_MATHLIBK << 1)
+#define LUA_DBLIBK		(LUA_UTF8LIBK << 1)
+
+/* open the libraries in 'load', preload the ones in 'preload' */
+LUALIB_API void (luaL_openselectedlibs) (lua_State *L, int load, int preload);
+
 /* open all previous libraries */
 LUALIB_API void (luaL_openlibs) (lua_State *L);
 
@@ -0,0 +1,62 @@
+-- ansi_bench.lua : cost of ansi() on the strings of a progress bar
+--
+--   xLua ansi_bench.lua [repeat] > /dev/null
+--
+-- The bars of progress2 (the Lua renderer) for the positions 0 to 1000 are
+-- printed `repeat` times each (default 200).  ansi() writes to stdout, so
+-- send it to /dev/null; the results are printed to stderr.
+--   cached      the templates are compiled once and found in the cache
+--   compiled    every call gets a new template (a different trailing
+--               space count), so each one runs the brace parser
+--   render      progress2:render() and ansi() of the result
+-- Run it with an xLua built before the template cache to get the figures
+-- of the old parser.
+------------------------------------------------------------------------------
+local sep  = package.config:sub(1,1) -- extract the separator
+package.path = ("..{SEP}modules{SEP}?.lua;.{SEP}modules{SEP}?.lua;"):gsub("{SEP}",sep) .. package.path
+------------------------------------------------------------------------------
+if ansi == nil then
+    io.stderr:write("ansi() is not available, run this script with xLua\n")
+    os.exit(1)
+end
+-- the Lua renderer, as before the native progress bar
+local native = cprogress
+cprogress = nil
+local progress = require "progress2"
+cprogress = native
+------------------------------------------------------------------------------
+local rep = tonumber(arg[1]) or 200
+local bar = progress.new(50, 1000)
+local bars = {}
+for i = 0, 1000 do
+    bar:pos(i)
+    bars[#bars + 1] = "\r" .. bar:render()
+end
+
+local function report( name, calls, t )
+    io.stderr:write(string.format("  %-10s %8.2f us/call  (%d calls)\n", name, t / calls * 1e6, calls))
+end
+
+io.stderr:write(string.format("%d bars of %d bytes, %d times\n", #bars, #bars[1], rep))
+local t0 = os.clock()
+for _ = 1, rep do
+    for i = 1, #bars do ansi(bars[i]) end
+end
+report("cached", rep * #bars, os.clock() - t0)
+
+local pad = {}
+for i = 1, 300 do pad[i] = string.rep(" ", i) end
+t0 = os.clock()
+for r = 1, rep do
+    for i = 1, #bars do ansi(bars[i] .. pad[(r * #bars + i) % 300 + 1]) end
+end
+report("compiled", rep * #bars, os.clock() - t0)
+
+t0 = os.clock()
+for _ = 1, rep do
+    for i = 0, 1000 do
+        bar:pos(i)
+        ansi("\r" .. bar:render())
+    end
+end
+report("render", rep * #bars, os.clock() - t0)
@@ -0,0 +1,90 @@
+-- json_bench.lua : json.lua (Lua code) against the native cjson library
+--
+--   xLua json_bench.lua [file.json] [repeat]
+--
+-- Without a file a corpus of records is generated (about 2.5 MB, the same
+-- text for every run).  Times are the best of `repeat` runs (default 3).
+------------------------------------------------------------------------------
+local sep  = package.config:sub(1,1) -- extract the separator
+package.path = ("..{SEP}modules{SEP}?.lua;.{SEP}modules{SEP}?.lua;"):gsub("{SEP}",sep) .. package.path
+------------------------------------------------------------------------------
+if cjson == nil then
+    print("cjson is not available, run this script with xLua")
+    os.exit(1)
+end
+-- json.lua takes cjson when it is loaded, load it once without it
+local native = cjson
+cjson = nil
+local JSONlua = require "json"
+package.loaded.json = nil
+cjson = native
+local JSON = require "json"
+------------------------------------------------------------------------------
+local function corpus( records )
+    local words = { "alpha", "beta", "gamma", "delta", "tab\there", "quote\"d", "back\\slash",
+                    "caf\u{e9}", "\u{2603} snow", "line\nbreak" }
+    local seed = 12345
+    local function rnd( n )
+        seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF
+        return seed % n
+    end
+    local t = {}
+    for i = 1, records do
+        local tags = {}
+        for j = 1, rnd(6) do tags[j] = words[rnd(#words) + 1] end
+        t[i] = {
+            id = i,
+            name = words[rnd(#words) + 1] .. " " .. i,
+            value = rnd(1000000) / 1000,
+            count = rnd(100000),
+            enabled = (rnd(2) == 1),
+            tags = tags,
+            position = { x = rnd(4096) - 2048, y = rnd(4096) - 2048, z = rnd(100) / 7 },
+            history = { rnd(255), rnd(255), rnd(255), rnd(255), rnd(255), rnd(255), rnd(255), rnd(255) },
+        }
+    end
+    return JSON:encode(t)
+end
+------------------------------------------------------------------------------
+local function best( rep, fn )
+    local t = math.huge
+    local r
+    for _ = 1, rep do
+        local t0 = os.clock()
+        r = fn()
+        t = math.min(t, os.clock() - t0)
+    end
+    return t, r
+end
+------------------------------------------------------------------------------
+local text
+if arg[1] and not tonumber(arg[1]) then
+    local f = assert(io.open(arg[1], "rb"))
+    text = f:read("a")
+    f:close()
+end
+local rep = tonumber(arg[2] or arg[1]) or 3
+text = text or corpus(13500)
+print(string.format("document: %.2f MB, best of %d", #text / 1048576, rep))
+
+local tl, vl = best(rep, function() return JSONlua:decode(text) end)
+local tc, vc = best(rep, function() return JSON:decode(text) end)
+print(string.format("  decode  json.lua %8.3f s   cjson %8.3f s   x%.1f", tl, tc, tl / tc))
+
+local el, sl = best(rep, function() return JSONlua:encode(vl) end)
+local ec, sc = best(rep, function() return JSON:encode(vc) end)
+print(string.format("  encode  json.lua %8.3f s   cjson %8.3f s   x%.1f", el, ec, el / ec))
+if sl ~= sc then print("  ** the encoded texts differ") end
+
+local events = 0
+local handler = setmetatable({}, { __index = function() return function() events = events + 1 end end })
+local ts = best(rep, function() events = 0; native.stream(text, handler) end)
+print(string.format("  stream  cjson %8.3f s (%d events)", ts, events))
+
+local tz, lazy = best(rep, function() return JSON:decode_lazy(text) end)
+local n = #lazy
+local tf = best(rep, function()
+    local doc = JSON:decode_lazy(text)
+    return doc[1].name, doc[n // 2].position.x, doc[n].tags[1]
+end)
+print(string.format("  lazy    open %8.3f s   open and read 3 fields %8.3f s", tz, tf))
@@ -0,0 +1,92 @@
+-- screen_bench.lua : bytes per frame of a status screen
+--
+--   xLua screen_bench.lua [frames] > frames.out
+--
+-- A 24x80 register dashboard is drawn for `frames` frames (default 500),
+-- in each frame two register values and the progress bar change.
+--   ansi()       the whole screen with {csr} and {mv} every frame
+--   full         screen, redrawn completely (invalidate() every frame)
+--   diff         screen, only the changed cells (flush() as it is used)
+-- The ansi() output goes to stdout, which must be a file so its size can
+-- be read; the screen output is taken with render().  The results are
+-- printed to stderr.
+------------------------------------------------------------------------------
+if screen == nil then
+    io.stderr:write("screen is not available, run this script with xLua\n")
+    os.exit(1)
+end
+local frames = tonumber(arg[1]) or 500
+local rows, cols = 24, 80
+local regs = {}
+for i = 1, 16 do
+    regs[i] = { name = string.format("REG%02d", i), value = (i * 40503) & 0xFFFF,
+                text = "configuration register " .. i }
+end
+------------------------------------------------------------------------------
+local function update( frame )
+    local a, b = frame % 16 + 1, (frame * 7) % 16 + 1
+    regs[a].value = (regs[a].value * 75 + 74) % 65537 & 0xFFFF
+    regs[b].value = (regs[b].value + frame) & 0xFFFF
+end
+
+local function bar( frame )
+    local n = (frame * 60) // frames
+    return string.rep("#", n) .. string.rep("-", 60 - n)
+end
+------------------------------------------------------------------------------
+-- the template the scripts used: clear, then every line at its place
+local function ansi_frame( frame )
+    local t = { "{csr}{mv1,1}{c15}Register monitor{c7}" }
+    for i, r in ipairs(regs) do
+        t[#t + 1] = string.format("{mv%d,3}{c11}%-8s{c10}0x%04X  {c7}%-40s", i + 2, r.name, r.value, r.text)
+    end
+    t[#t + 1] = string.format("{mv%d,3}{c4}[{c10}%s{c4}]{c7} %3d%%", rows - 2, bar(frame), frame * 100 // frames)
+    return table.concat(t)
+end
+
+local function screen_frame( s, frame )
+    s:put(1, 1, "Register monitor", 15)
+    for i, r in ipairs(regs) do
+        s:put(i + 2, 3, r.name, 11)
+        s:put(i + 2, 11, string.format("0x%04X", r.value), 10)
+        s:put(i + 2, 19, r.text, 7)
+    end
+    s:put(rows - 2, 3, "{c4}[{c10}" .. bar(frame) .. "{c4}]{c7} " .. string.format("%3d%%", frame * 100 // frames))
+end
+------------------------------------------------------------------------------
+local function report( name, bytes, t )
+    io.stderr:write(string.format("  %-8s %8.0f bytes/frame  %8.1f us/frame\n", name, bytes / frames, t / frames * 1e6))
+end
+io.stderr:write(string.format("%dx%d dashboard, %d frames\n", rows, cols, frames))
+
+local start = io.stdout:seek("cur") or 0
+local t0 = os.clock()
+for f = 1, frames do
+    update(f)
+    ansi(ansi_frame(f))
+end
+local t = os.clock() - t0
+local size = (io.stdout:seek("cur") or 0) - start
+if size > 0 then report("ansi()", size, t)
+else io.stderr:write("  ansi()   stdout is not a file, the size is not known\n") end
+
+local s = screen.new(rows, cols)
+local bytes = 0
+t0 = os.clock()
+for f = 1, frames do
+    update(f)
+    s:invalidate()
+    screen_frame(s, f)
+    bytes = bytes + #s:render()
+end
+report("full", bytes, os.clock() - t0)
+
+s = screen.new(rows, cols)
+bytes = 0
+t0 = os.clock()
+for f = 1, frames do
+    update(f)
+    screen_frame(s, f)
+    bytes = bytes + #s:render()
+end
+report("diff", bytes, os.clock() - t0)
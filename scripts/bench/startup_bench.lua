@@ -0,0 +1,80 @@
+-- startup_bench.lua : startup of compiler.lua with and without the bytecode cache
+--
+--   xLua startup_bench.lua [runs] [cache directory]
+--
+-- `xLua compiler.lua --help` is started `runs` times (default 20) in each
+-- of three ways and the best and median wall time of a run are printed:
+--   no cache    LUA_BYTECACHE=0, every script is parsed
+--   cold        an empty cache directory for every run, the scripts are
+--               parsed and their entries written
+--   warm        a cache that an earlier run filled, the entries are loaded
+-- The cache directories are made below the given directory (default
+-- ~/.cache/xlua-bench) and removed at the end.
+------------------------------------------------------------------------------
+if (time == nil) or (time.now_ns == nil) then
+    print("time.now_ns() is not available, run this script with xLua")
+    os.exit(1)
+end
+local windows = (package.config:sub(1,1) == "\\")
+local runs = tonumber(arg[1]) or 20
+local base = arg[2] or ((os.getenv(windows and "LOCALAPPDATA" or "HOME") or ".") .. (windows and "\\xlua-bench" or "/.cache/xlua-bench"))
+-- the interpreter running this script starts the compiler
+local exe = arg[-1] or "xLua"
+for i = -2, -10, -1 do
+    if arg[i] == nil then break end
+    exe = arg[i]
+end
+------------------------------------------------------------------------------
+local function quote( s )
+    return '"' .. s .. '"'
+end
+
+local function run( cache )
+    local cmd
+    if windows then
+        cmd = string.format('cd /d ..\\utilities && set "LUA_BYTECACHE=%s" && %s compiler.lua --help > NUL 2>&1', cache, quote(exe))
+    else
+        cmd = string.format('cd ../utilities && LUA_BYTECACHE=%s %s compiler.lua --help > /dev/null 2>&1', quote(cache), quote(exe))
+    end
+    local t0 = time.now_ns()
+    local ok = os.execute(cmd)
+    local t = (time.now_ns() - t0) / 1e6
+    if not ok then
+        print("** the compiler failed: " .. cmd)
+        os.exit(1)
+    end
+    return t
+end
+
+local function remove( dir )
+    if windows then os.execute(string.format('rmdir /s /q %s > NUL 2>&1', quote(dir)))
+    else os.execute(string.format('rm -rf %s', quote(dir))) end
+end
+
+local function report( name, t )
+    table.sort(t)
+    print(string.format("  %-9s best %7.2f ms   median %7.2f ms", name, t[1], t[(#t + 1) // 2]))
+end
+------------------------------------------------------------------------------
+-- make the interpreter path absolute enough to work from ../utilities
+if not (exe:find("^/") or exe:find("^%a:") or exe:find("^\\") or not exe:find("[/\\]")) then
+    exe = "../bench/" .. exe
+end
+print(string.format("xLua compiler.lua --help, %d runs each", runs))
+remove(base)
+
+local t = {}
+for i = 1, runs do t[i] = run("0") end
+report("no cache", t)
+
+t = {}
+for i = 1, runs do t[i] = run(base .. (windows and "\\cold" or "/cold") .. i) end
+report("cold", t)
+
+local warm = base .. (windows and "\\warm" or "/warm")
+run(warm)
+t = {}
+for i = 1, runs do t[i] = run(warm) end
+report("warm", t)
+
+remove(base)
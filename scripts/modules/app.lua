@@ -160,9 +160,11 @@ function app:message(state, message, ...)
 end
 ------------------------------------------------------------------------------
 -- this helper function takes a binary string and creates a dump of the binary
--- data, and returns the dump string.
+-- data, and returns the dump string.  The dump is rendered by the native
+-- hexdump() when running in xLua or a compiled applet.
 function app:show_bin(pkt, line_length, bin_only)
     local len = line_length or 16
+    if hexdump then return hexdump(pkt, {width = len, ascii = not bin_only}) end
 	local str = ""
     local bin_data = ""
     local pos = 0
@@ -2,7 +2,7 @@
 -- Base 64 utilities
 --
 local base64 = {}
-base64.version = 1.0
+base64.version = 1.1
 base64.__index = base64
 base64.dialect = {
 -- encode/decode dialects for supported standards.
@@ -19,6 +19,19 @@ base64.dialect = {
 }
 base64.def_mode = "standard" -- setup the default mode as standard
 ------------------------------------------------------------------------------
+-- xLua provides a native codec (cbase64), when it is present the dialect
+-- tables are built once per alphabet and reused by every encode/decode.
+local native = cbase64
+local codecs = {}
+local function native_codec( dialect )
+    local codec = codecs[dialect]
+    if not codec then
+        codec = native.new(dialect)
+        codecs[dialect] = codec
+    end
+    return codec
+end
+------------------------------------------------------------------------------
 function base64:mode( mode )
     if mode then
         self.def_mode = mode or "standard"
@@ -37,6 +50,7 @@ function base64:encode(data,mode)
     local btype = mode or self.def_mode
     if btype == true then btype = self.def_mode end
     local dialect = self.dialect[btype]
+    if native then return native_codec(dialect):encode(data) end
 
     return ((data:gsub('.', function(x)
         local r,b='',x:byte()
@@ -56,6 +70,7 @@ function base64:decode(data, mode)
     local btype = mode or self.def_mode
     if btype == true then btype = self.def_mode end
     local dialect = self.dialect[btype]
+    if native then return native_codec(dialect):decode(data) end
 
     data = string.gsub(data, '[^'..dialect..'=]', '')
     return (data:gsub('.', function(x)
@@ -70,6 +85,32 @@ function base64:decode(data, mode)
             return string.char(c)
     end))
 end
+------------------------------------------------------------------------------
+-- @brief create a streaming encoder for chunked input.  Each call to
+-- enc:update(chunk) returns the encoded complete groups, enc:finish()
+-- returns the padded remainder.
+function base64:encoder(mode)
+    local btype = mode or self.def_mode
+    if btype == true then btype = self.def_mode end
+    local dialect = self.dialect[btype]
+    if native then return native_codec(dialect):encoder() end
+
+    local codec = self
+    local tail = ""
+    return {
+        update = function(_, chunk)
+            local data = tail .. chunk
+            local size = #data - (#data % 3)
+            tail = data:sub(size+1)
+            return codec:encode(data:sub(1,size), btype)
+        end,
+        finish = function()
+            local str = codec:encode(tail, btype)
+            tail = ""
+            return str
+        end
+    }
+end
 -- ===========================================================================
 function base64.new(mode)
     return setmetatable({def_mode = mode}, base64)
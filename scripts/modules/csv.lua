@@ -524,10 +524,58 @@ local function parseHeadersAndSetupArgs(inputString, delimiter, options, fieldsT
   return endOfHeaders, parserArgs, finalHeaders
 end
 
+-- xLua and compiled applets provide ccsv, a native reader that scans a memory
+-- mapped file (or the string) and builds one row at a time.  It does not add
+-- the empty last row the Lua parser returns for a final line break when only
+-- one column is read (a single column file, or fieldsToKeep with one field).
+local native = ccsv
+
+local function nativeReader(inputFile, delimiter, options)
+  local reader
+  if options.loadFromString then
+      reader = native.new(inputFile, delimiter, options)
+  else
+      reader = native.open(inputFile, delimiter, options)
+  end
+  if reader:size() == 0 then
+      reader:close()
+      error('ftcsv: Cannot parse an empty file')
+  end
+  return reader
+end
+
+-- read the header row and give the reader the column to key mapping
+local function nativeSetupHeaders(reader, options, fieldsToKeep)
+  local modifiedHeaders = handleHeaders(reader:read() or {}, options)
+  if options.headers == false then
+      reader:rewind()
+  end
+
+  local keys = {}
+  for j = 1, #modifiedHeaders do
+      local header = modifiedHeaders[j]
+      keys[j] = (fieldsToKeep == nil or fieldsToKeep[header]) and header or false
+  end
+  reader:keys(keys, determineTotalColumnCount(modifiedHeaders, fieldsToKeep), fieldsToKeep ~= nil)
+
+  return determineRealHeaders(modifiedHeaders, fieldsToKeep)
+end
+
 -- runs the show!
 function ftcsv.parse(inputFile, delimiter, options)
   local options, fieldsToKeep = parseOptions(delimiter, options, false)
 
+  if native then
+      local reader = nativeReader(inputFile, delimiter, options)
+      local finalHeaders = nativeSetupHeaders(reader, options, fieldsToKeep)
+      local output = {}
+      for i, row in reader:rows() do
+          output[i] = row
+      end
+      reader:close()
+      return output, finalHeaders
+  end
+
   local inputString = initializeInputFromStringOrFile(inputFile, options, "*all")
 
   local endOfHeaders, parserArgs, finalHeaders = parseHeadersAndSetupArgs(inputString, delimiter, options, fieldsToKeep, true)
@@ -561,6 +609,18 @@ end
 
 function ftcsv.parseLine(inputFile, delimiter, userOptions)
   local options, fieldsToKeep = parseOptions(delimiter, userOptions, true)
+
+  -- the native reader maps the file, so bufferSize doesn't apply. With
+  -- reuseRow set, every row is returned in the same table.
+  if native then
+      if options.loadFromString == true then
+          error("ftcsv: parseLine currently doesn't support loading from string")
+      end
+      local reader = nativeReader(inputFile, delimiter, options)
+      nativeSetupHeaders(reader, options, fieldsToKeep)
+      return reader:rows(options.reuseRow, true)
+  end
+
   local inputString, file = initializeInputFile(inputFile, options)
 
 
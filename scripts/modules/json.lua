@@ -655,6 +655,30 @@ local isNumber = {
 }
 isNumber.__index = isNumber
 
+--
+-- xLua and compiled applets provide cjson, a native decoder/encoder that
+-- gives the same results.  It is used unless an option it doesn't handle
+-- is set (number objectification/stringification, unsupportedTypeEncoder).
+--
+local native = cjson
+
+local function native_decode_options(self, options)
+   return {
+      partial   = true,
+      strict    = options.strictParsing,
+      null      = options.null,
+      array_mt  = self.strictTypes and isArray  or nil,
+      object_mt = self.strictTypes and isObject or nil,
+   }
+end
+
+local function native_decode_ok(options)
+   return native
+      and not options.decodeNumbersAsObjects
+      and not options.decodeIntegerStringificationLength
+      and not options.decodeDecimalStringificationLength
+end
+
 function OBJDEF:asNumber(item)
 
    if getmetatable(item) == isNumber then
@@ -1318,6 +1342,20 @@ function OBJDEF:decode(text, etc, options)
    end
 
 
+   if native_decode_ok(options) then
+      local value, next_i, location = native.decode(text, native_decode_options(self, options))
+      if type(next_i) == 'string' then
+         self:onDecodeError(next_i, text, location, options.etc)
+         return nil, next_i -- in case the error method doesn't abort, return something sensible
+      end
+
+      local error_message = nil
+      if next_i ~= #text + 1 then
+         value, error_message = self:onTrailingGarbage(text, next_i, value, options.etc)
+      end
+      return value, error_message
+   end
+
    --
    -- Finally, go parse it
    --
@@ -1628,7 +1666,7 @@ local function encode_value(self, value, parents, etc, options, indent, for_key)
             end
             local key_indent = indent .. tostring(options.indent or "")
             local subtable_indent = key_indent .. string.rep(" ", max_key_length) .. (options.align_keys and "  " or "")
-            local FORMAT = "%s%" .. string.format("%d", max_key_length) .. "s: %s"
+            local FORMAT = max_key_length > 0 and ("%s%" .. string.format("%d", max_key_length) .. "s: %s") or "%s%s: %s" -- Lua 5.4 rejects "%0s"
 
             local COMBINED_PARTS = { }
             for i, key in ipairs(object_keys) do
@@ -1661,6 +1699,24 @@ local function encode_value(self, value, parents, etc, options, indent, for_key)
 end
 
 local function top_level_encode(self, value, etc, options)
+   if native and not self.unsupportedTypeEncoder then
+      local success, result = pcall(native.encode, value, {
+         pretty          = options.pretty,
+         indent          = options.indent,
+         align_keys      = options.align_keys,
+         array_newline   = options.array_newline,
+         null            = options.null,
+         stringsAreUtf8  = options.stringsAreUtf8,
+         noKeyConversion = self.noKeyConversion,
+         number_mt       = isNumber,
+      })
+      if not success then
+         self:onEncodeError(result, etc)
+         return nil -- in case the error method doesn't abort
+      end
+      return result
+   end
+
    local val = encode_value(self, value, {}, etc, options)
    if val == nil then
       --PRIVATE("may need to revert to the previous public verison if I can't figure out what the guy wanted")
@@ -1670,6 +1726,38 @@ local function top_level_encode(self, value, etc, options)
    end
 end
 
+--
+-- Like decode(), but with cjson available objects and arrays are only parsed when they
+-- are first indexed, so pulling a few fields out of a large document is cheap.  The
+-- nested tables must be walked with pairs()/ipairs(), not next().  Unbalanced brackets,
+-- unclosed strings and trailing garbage are reported here; any other syntax error in a
+-- part that hasn't been loaded yet is raised when that part is first used.
+--
+function OBJDEF:decode_lazy(text, etc, options)
+   if type(options) ~= 'table' then
+      options = {}
+   end
+   if etc ~= nil then
+      options.etc = etc
+   end
+   for _, name in ipairs { 'strictParsing', 'decodeNumbersAsObjects', 'decodeIntegerStringificationLength', 'decodeDecimalStringificationLength' } do
+      if options[name] == nil then
+         options[name] = self[name]
+      end
+   end
+
+   if type(text) ~= 'string' or not native_decode_ok(options) or text:match('^%s*$') then
+      return self:decode(text, etc, options)
+   end
+
+   local success, value = pcall(native.lazy, text, native_decode_options(self, options))
+   if not success then
+      self:onDecodeError(value, nil, nil, options.etc)
+      return nil, value -- in case the error method doesn't abort, return something sensible
+   end
+   return value
+end
+
 function OBJDEF:encode(value, etc, options)
    if type(self) ~= 'table' or self.__index ~= OBJDEF then
       OBJDEF:onEncodeError("JSON:encode must be called in method format", etc)
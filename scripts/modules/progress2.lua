@@ -3,17 +3,19 @@
 --
 local progress = {}
 progress.__index = progress
-progress.version = 2.0  -- API version
+progress.version = 2.1  -- API version
+local native = cprogress  -- C renderer (src/extend/progress.c) when available
 ------------------------------------------------------------------------------
 progress.size = 50         -- the number of characters the bar is wide
 progress.min = 0           -- the minimum value (usually 0)
 progress.max = 100         -- the max value for the position
 progress.step = 1          -- the step size of the bar
 progress.position = 0      -- the present position
+progress.interval = 0      -- minimum ms between two outputs of show()
 -- character set used to render the bar.  This is a table of
 -- empty, 25%, 50%, 75%, 100% for EACH step in the bar.
 progress.char = {"{c7}=", "{c4}\\", "{c12}|", "{c14}/", "{c10}#" }
-progress.bar = "{hide;c4}[${BAR}{c4}]{c7;show}"
+progress.bar = "{hide;c4}[${BAR}{c4}]{c7;show}"  -- ${PCT} is the percentage
 ------------------------------------------------------------------------------
 function progress:pos( pos )
     if pos then
@@ -53,7 +55,28 @@ function progress:render()
         end
         bar = bar..self.char[chr]
     end
-    return self.bar:gsub("${BAR}",bar)
+    local str, n = self.bar:gsub("${BAR}",bar)
+    if str:find("${PCT}", 1, true) then
+        local pct = math.floor((self.position-self.min)*100/(self.max-self.min))
+        str = str:gsub("${PCT}", tostring(math.max(0, math.min(100, pct))))
+    end
+    return str, n
+end
+------------------------------------------------------------------------------
+-- write the bar (after a "\r") through ansi() when the rendered string
+-- changed, at most once every self.interval ms.  The final position is
+-- always written.  Returns true when the bar was written.
+function progress:show( pos )
+    if pos then self.position = pos end
+    local str = self:render()
+    if str == self.shown then return false end
+    local now = (time and time.now_ns()/1e6) or (os.clock()*1000)
+    if self.shown and (self.position < self.max) and (now - self.shown_at < (self.interval or 0)) then
+        return false
+    end
+    ansi("\r"..str)
+    self.shown, self.shown_at = str, now
+    return true
 end
 ------------------------------------------------------------------------------
 -- generate a new progress bar that is tailored to the conditions of the
@@ -62,6 +85,9 @@ end
 --     max : the maximum value of the progressbar, default 100
 --     size : the number of characters used for the the rendering of the bar
 function progress.new(size, max, min)
+    if native then
+        return native.new(size or 50, max or 100, min or 0, progress.char, progress.bar)
+    end
     local T = {
         min=min or 0,
         max=max or 100,
@@ -10,10 +10,20 @@ local TOML = {
 	strict = true,
 }
 
+-- native parser, available when running in xLua or a compiled applet
+local native = ctoml
+
 -- converts TOML data into a lua table
 TOML.parse = function(toml, options)
 	options = options or {}
-	local strict = (options.strict ~= nil and options.strict or TOML.strict)
+	local strict = TOML.strict
+	if options.strict ~= nil then
+		strict = options.strict
+	end
+
+	if native then
+		return native.parse(toml, {strict = strict})
+	end
 
 	-- the official TOML definition of whitespace
 	local ws = "[\009\032]"
@@ -559,6 +569,10 @@ TOML.parse = function(toml, options)
 end
 
 TOML.encode = function(tbl)
+	if native then
+		return native.encode(tbl)
+	end
+
 	local toml = ""
 
 	local cache = {}
@@ -641,5 +655,29 @@ TOML.encode = function(tbl)
 	return toml:sub(1, -2)
 end
 
+-- reads and parses a TOML file
+-- with options.cache set (true, or a file name) the native parser keeps a
+-- binary snapshot of the table in "<filename>.cache" and reuses it until
+-- the file changes. the second result is true when the snapshot was used.
+TOML.load = function(filename, options)
+	options = options or {}
+	local strict = TOML.strict
+	if options.strict ~= nil then
+		strict = options.strict
+	end
+
+	if native then
+		return native.load(filename, {strict = strict, cache = options.cache})
+	end
+
+	local f, msg = io.open(filename, "rb")
+	if not f then
+		return nil, msg
+	end
+	local text = f:read("a")
+	f:close()
+	return TOML.parse(text, {strict = strict}), false
+end
+
 return TOML
 
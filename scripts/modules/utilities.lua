@@ -7,7 +7,10 @@ local utils = {}
 -- output format that can be used with JTAG programmers.  The arguments
 -- rawdata is a string that contains the data to be converted, and the
 -- base_address is the starting address for the data to be located.
+-- When the native hexfile library is available (xLua and compiled applets)
+-- the conversion is done there.
 function utils.bin2hex( rawdata, base_address )
+    if hexfile then return hexfile.encode(rawdata, base_address or 0x8000000) end
     local fdata = ""
     local address = base_address or 0x8000000
     local segment = 0
@@ -166,5 +166,15 @@ end
 
 ---Parses CDATA tag content.
 tree.cdata = tree.text
+
+---Indicates if the parser may build the tree itself (batch mode)
+--instead of calling starttag/endtag/text/cdata for every element.
+--This is only the case while those callbacks have not been replaced.
+--@return true if the native parser can fill self.root directly
+function tree:batch()
+    return self.starttag == tree.starttag and self.endtag == tree.endtag and
+        self.text == tree.text and self.cdata == tree.cdata
+end
+
 tree.__index = tree
 return tree
\ No newline at end of file
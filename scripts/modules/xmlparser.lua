@@ -42,6 +42,9 @@ local function hexadecimalToHtmlChar(code)
     return "&#x"..code..";"
 end
 
+-- native tokenizer, available when running in xLua or a compiled applet
+local native = cxml
+
 local XmlParser = {
     -- Private attributes/functions
     _XML        = '^([^<]*)<(%/?)([^>]-)(%/?)>',
@@ -397,6 +400,17 @@ function XmlParser:parse(xml, parseAttributes)
 
     self.handler.parseAttributes = parseAttributes
 
+    if native then
+        -- handlers that only build a tree (xmlhandler_tree) are filled in
+        -- by the native parser without a callback per element
+        if self.handler.batch and self.handler:batch() then
+            native.tree(xml, self.handler, self.options or {}, parseAttributes)
+        else
+            native.parse(xml, self.handler, self.options or {}, parseAttributes)
+        end
+        return
+    end
+
     --Stores string.find results and parameters
     --and other auxiliar variables
     local f = {
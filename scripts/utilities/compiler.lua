@@ -1,5 +1,7 @@
 -- LOG:
 -- 1.1.5 : Updated with new progress bar module.
+-- 2.4.0 : Generated code times its startup phases (LUA_STARTUP_TRACE).
+-- 2.5.0 : Generated code opens only the standard libraries the chunks use.
 ------------------------------------------------------------------------------
 -- make sure that all of the used extensions are present
 if ansi == nil then
@@ -17,7 +19,7 @@ local compile = app.new(false)  -- create the application framework object
 ------------------------------------------------------------------------------
 compile.name = "Lcompile"
 compile.brief = "Compile Lua source to binary chunk and/or C application file."
-compile.version = "2.3.0"  -- requires xLua w/ "ansi()" function
+compile.version = "2.5.0"  -- requires xLua w/ "ansi()" function
 compile.detail = [[
 Lcompile is a Lua compiler that was written in Lua!  It allows for the compilation
 of Lua source files into compiled binary modules and/or a C source file that can
@@ -85,6 +87,9 @@ compile.header = [[
 #include <stdbool.h>
 #include <stdint.h>
 #include <signal.h>
+/* phases of the start, timed when LUA_STARTUP_TRACE is set */
+void startup_begin(lua_State *L, const char *phase);
+void startup_end(lua_State *L);
 /* Internal Handlers ====================================================== */
 static lua_State *app_l = NULL;  /* Pointer to the Lua State for the Applet */
 #define APPLET_NAME "${APPLET_NAME}" /* define the name of the applet command */
@@ -160,19 +165,23 @@ ${CODE_DATA}
 LUALIB_API int luaopen_${MODNAME}( lua_State *L )
 {
     // load the chunk in bin mode and put it on the stack
+    startup_begin(L, "undump ${MODNAME}");
     luaL_loadbufferx(L, (const char*)&${MODNAME}_buffer[0], ${SIZE}, "${MODNAME}", "b");
+    startup_end(L);
     /* After loading the binary chunk, we are left with a function on the stack
      * that represents the compiled code.  This pcall runs the code loaded to
      * (in the case of a require) create the stack, otherwise, only the loaded
      * code function would be stored in the `package.loaded` table.
      */
+    startup_begin(L, "run ${MODNAME}");
     lua_pcall(L,0,1,0); // one argument is returned... the module
+    startup_end(L);
     return 1;
 }
 /* ======================================================================== */
 ]]
 ------------------------------------------------------------------------------
-compile.require_code = "   luaL_requiref(L, \"${MODNAME}\", luaopen_${MODNAME}, 1);\n   lua_pop(L,1);\n"
+compile.require_code = "   startup_begin(L, \"require ${MODNAME}\");\n   luaL_requiref(L, \"${MODNAME}\", luaopen_${MODNAME}, 1);\n   lua_pop(L,1);\n   startup_end(L);\n"
 ------------------------------------------------------------------------------
 compile.template = [[
 /* ------------------------------------------------------------------------ */
@@ -180,12 +189,17 @@ compile.template = [[
 /* ------------------------------------------------------------------------ */
 int app_run(lua_State *L)
 {
+    /* Standard libraries the chunks use: ${LIBLIST}; the others are opened
+     * when their global is first used */
+    luaL_openselectedlibs(L, ${LIBMASK}, 0);
     /* Required modules --------------------------------------------------- */
 ${REQDATA}
     lua_Integer top = lua_gettop(L);
     /* Run main application ----------------------------------------------- */
     // this call loads and runs the target application module
+    startup_begin(L, "main chunk load");
     luaL_loadbufferx(L, (const char*)&${NAME}_buffer[0], ${APPSIZE}, "${NAME}", "b");
+    startup_end(L);
 
     int status;
     int base = lua_gettop(L);  /* function index */
@@ -193,7 +207,9 @@ ${REQDATA}
     lua_insert(L, base);  /* put it under function and args */
     app_l = L;  /* to be available to 'laction' */
     signal(SIGINT, app_action);  /* set C-signal handler */
+    startup_begin(L, "main chunk run");
     status = lua_pcall(L, 0, 1, base);
+    startup_end(L);
     signal(SIGINT, SIG_DFL); /* reset C-signal handler */
     lua_remove(L, base);  /* remove message handler from the stack */
     return app_report(L, status);
@@ -233,6 +249,97 @@ local function object_file(path, modname)
     end
     return obj
 end
+------------------------------------------------------------------------------
+-- Global names a binary chunk reads through its _ENV upvalue (GETTABUP), the
+-- names are added to the set `names`.  This walks the Lua 5.4 dump format
+-- of ldump.c, stripped or not.
+local OP_GETTABUP = 11
+local function chunk_globals( chunk, names )
+    local pos = 1
+    local function byte()
+        pos = pos + 1
+        return chunk:byte(pos - 1)
+    end
+    local function size()   -- 7 bits per byte, the last one has bit 7 set
+        local x, b = 0, 0
+        repeat
+            b = byte()
+            x = (x << 7) | (b & 0x7F)
+        until b >= 0x80
+        return x
+    end
+    local function str()
+        local n = size()
+        if n == 0 then return nil end
+        pos = pos + n - 1
+        return chunk:sub(pos - n + 1, pos - 1)
+    end
+    local isize, nsize = chunk:byte(14), chunk:byte(15)
+    -- env[i] is true when upvalue i of the function is _ENV
+    local function proto( penv )
+        local code, k, env = {}, {}, {}
+        str()                   -- source
+        size(); size()          -- first and last line
+        pos = pos + 3           -- parameters, vararg, stack size
+        for i = 1, size() do
+            code[i] = string.unpack("=I4", chunk, pos)
+            pos = pos + 4
+        end
+        for i = 1, size() do
+            local t = byte()
+            if t == 0x03 then pos = pos + isize         -- integer
+            elseif t == 0x13 then pos = pos + nsize     -- float
+            elseif t == 0x04 or t == 0x14 then k[i] = str() end
+        end
+        for i = 0, size() - 1 do
+            local instack, idx = byte(), byte()
+            byte()              -- kind
+            -- upvalue 0 of the main chunk is _ENV, the others get it from their parent
+            if penv == nil then env[i] = (i == 0)
+            else env[i] = (instack == 0) and penv[idx] or false end
+        end
+        for _, i in ipairs(code) do
+            if (i & 0x7F) == OP_GETTABUP and env[(i >> 16) & 0xFF] then
+                local name = k[((i >> 24) & 0xFF) + 1]
+                if name then names[name] = true end
+            end
+        end
+        for i = 1, size() do proto(env) end
+        local n = size()        -- line info
+        pos = pos + n
+        for i = 1, size() do size(); size() end
+        for i = 1, size() do str(); size(); size() end
+        for i = 1, size() do str() end
+    end
+    pos = 16 + isize + nsize + 1   -- header, number of upvalues of the main chunk
+    proto(nil)
+    return names
+end
+------------------------------------------------------------------------------
+-- the chunk of the "0xNN, " data of a module or object
+local function hex_chunk( code )
+    local bytes = {}
+    for h in code:gmatch("0x(%x%x),") do bytes[#bytes + 1] = string.char(tonumber(h, 16)) end
+    return table.concat(bytes)
+end
+------------------------------------------------------------------------------
+-- standard libraries by the globals that open them, base and string are
+-- always opened (the string methods need the string library)
+local libs = {
+    { "package", "LUA_LOADLIBK", "require" }, { "coroutine", "LUA_COLIBK" },
+    { "table", "LUA_TABLIBK" }, { "io", "LUA_IOLIBK" }, { "os", "LUA_OSLIBK" },
+    { "math", "LUA_MATHLIBK" }, { "utf8", "LUA_UTF8LIBK" }, { "debug", "LUA_DBLIBK" },
+}
+local function lib_mask( names )
+    local used, mask = {}, { "LUA_GLIBK", "LUA_STRLIBK" }
+    for _, lib in ipairs(libs) do
+        if names[lib[1]] or (lib[3] and names[lib[3]]) then
+            used[#used + 1] = lib[1]
+            mask[#mask + 1] = lib[2]
+        end
+    end
+    return table.concat(mask, " | "), table.concat(used, ", ")
+end
 -- Applet Code ===============================================================
 ------------------------------------------------------------------------------
 function compile:get_modname( fname )
@@ -423,12 +530,14 @@ function compile:main( ifile, ofile )
     -- in a big array of module names and required data
     local source_data = {}
     local requires = ""
+    local globals = {}
     for _,source in ipairs(ifile) do
         local modname, code, data_length = self:compile(source)
         if modname == nil then 
             self:message("error","Errors detected during compilation.")
             return false, "compile error"
         end
+        chunk_globals(hex_chunk(code), globals)
         if modname == self.opts.app then
             -- when the loaded module is module identified as the applet
             -- load the code buffer into the source data, and retain the
@@ -473,7 +582,11 @@ function compile:main( ifile, ofile )
             ofile:write(code)
         end
         self:message("Info", "Writing application execution code for module {b92;c15}  %s  {c7;b0}",self.opts.app)
+        local mask, used = lib_mask(globals)
+        self:message("Info", "Standard libraries used: {c11}%s{c7}", (#used > 0) and used or "base, string")
         local tplt = self.template:gsub("${NAME}", self.opts.app or "applet")
+        tplt = tplt:gsub("${LIBMASK}", mask)
+        tplt = tplt:gsub("${LIBLIST}", (#used > 0) and ("base, string, " .. used) or "base, string")
         tplt = tplt:gsub("${APPSIZE}",applet_size)
         tplt = tplt:gsub("${REQDATA}", requires)
         tplt = tplt:gsub("${APP_CODE}", app_mod)
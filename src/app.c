@@ -1,4 +1,4 @@
-#ifndef LUA_EXE
+#if !defined(LUA_EXE) && !defined(XFERBENCH)
 /*
 ** $Id: lua.c $
 ** Lua stand-alone interpreter
@@ -27,6 +27,8 @@ int luaopen_brooks_serial(lua_State *L);
 #endif
 
 int app_run(lua_State *L);
+void startup_begin(lua_State *L, const char *phase);  /* LUA_STARTUP_TRACE */
+void startup_end(lua_State *L);
 
 #define APP_NAME   "lcomp_app"
 #define APP_EXE(L)    app_run(L)
@@ -143,6 +145,51 @@ static int dostring (lua_State *L, const char *s, const char *name) {
   return dochunk(L, luaL_loadbuffer(L, s, strlen(s), name));
 }
 
+/*
+** Standard libraries that are not opened before app_run(), each one is
+** opened by its global ('require' opens package) the first time it is
+** used.  The generated app_run() opens the ones its chunks use at once.
+*/
+static const char *const lazylibs[] = {
+  LUA_LOADLIBNAME, LUA_COLIBNAME, LUA_TABLIBNAME, LUA_IOLIBNAME,
+  LUA_OSLIBNAME, LUA_MATHLIBNAME, LUA_UTF8LIBNAME, LUA_DBLIBNAME, NULL
+};
+
+/*
+** __index of the global table: open the library named by the key, unless
+** it was opened before (the program removed its global then).
+*/
+static int lazylib (lua_State *L) {
+  const char *name = lua_tostring(L, 2);
+  lua_CFunction openf;
+  int i;
+  if (name == NULL) return 0;
+  if (strcmp(name, "require") == 0) name = LUA_LOADLIBNAME;
+  for (i = 0; lazylibs[i] != NULL && strcmp(name, lazylibs[i]) != 0; i++);
+  if (lazylibs[i] == NULL) return 0;
+  luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+  if (lua_getfield(L, -1, name) != LUA_TNIL) return 0;  /* opened before */
+  lua_getfield(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+  lua_getfield(L, -1, name);
+  openf = lua_tocfunction(L, -1);
+  if (openf == NULL) return 0;
+  luaL_requiref(L, name, openf, 1);
+  lua_pushvalue(L, 2);
+  lua_rawget(L, 1);  /* the global that was asked for */
+  return 1;
+}
+
+static void openlibs (lua_State *L) {
+  /* the string metatable serves the methods of all strings, open it now */
+  luaL_openselectedlibs(L, LUA_GLIBK | LUA_STRLIBK, ~(LUA_GLIBK | LUA_STRLIBK));
+  lua_pushglobaltable(L);
+  lua_createtable(L, 0, 1);
+  lua_pushcfunction(L, lazylib);
+  lua_setfield(L, -2, "__index");
+  lua_setmetatable(L, -2);
+  lua_pop(L, 1);
+}
+
 #if(0)
 static int handle_script (lua_State *L, char **argv) {
   int status;
@@ -166,13 +213,17 @@ static int pmain (lua_State *L) {
   int argc = (int)lua_tointeger(L, 1);
   char **argv = (char **)lua_touserdata(L, 2);
 
-  luaL_openlibs(L);
+  startup_begin(L, "luaL_openselectedlibs");
+  openlibs(L);
+  startup_end(L);
 
   /* Extenstions ---------------------------------------------------------- */
+  startup_begin(L, "luaopen_ext");
 #ifdef WIN32
   luaopen_brooks_serial(L);  /* Extend with serial() */
 #endif
   luaopen_ext(L);     /* Add general extensions */
+  startup_end(L);
   /* ---------------------------------------------------------------------- */
 
   int i, narg;
@@ -193,7 +244,10 @@ static int pmain (lua_State *L) {
 
 int main (int argc, char **argv) {
   int status, result;
-  lua_State *L = luaL_newstate();  /* create state */
+  lua_State *L;
+  startup_begin(NULL, "luaL_newstate");
+  L = luaL_newstate();  /* create state */
+  startup_end(L);
   if (L == NULL) {
     l_message(argv[0], "cannot create state: not enough memory");
     return EXIT_FAILURE;
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <string.h>
+#include <stdio.h>
 
 #include "lua.h"
 #include "lprefix.h"
@@ -18,133 +19,169 @@
 #define ANSI_SOP       ('{')
 #define ANSI_EOP       ('}')
 
+/* registry table of compiled templates, format string -> output bytes */
+#define ANSI_CACHE            ("_ANSI_CACHE_")
+#define ANSI_CACHE_MAX        (256)   /**< templates kept before the cache is dropped */
+#define ANSI_CACHE_KEYMAX     (1024)  /**< longer strings are not cached */
+#define ANSI_HASH_SIZE        (32)
+
+typedef void (*ansi_fn)(luaL_Buffer *b, uint32_t *param, uint32_t cnt);
+
 typedef struct {
 	const char *cmd;
-	void (*fn)(uint32_t *param, uint32_t cnt);
+	ansi_fn fn;
 } ansi_cmds;
 
 static bool ansi_enable = true;
 
+/* ------------------------------------------------------------------------ */
+/* add fmt with its "%u" replaced by a, then c; snprintf() was the slowest part of a template */
+static void ansi_csi( luaL_Buffer *b, const char *fmt, uint32_t a, uint32_t c )
+{
+	char seq[32], digits[10];
+	size_t n = 0;
+	uint32_t v;
+	int d;
+
+	for (; (*fmt != 0)&&(n < sizeof(seq) - 10); ++fmt) {
+		if ((fmt[0] != '%')||(fmt[1] != 'u')) {
+			seq[n++] = *fmt;
+			continue;
+		}
+		v = a;
+		a = c;
+		d = 0;
+		do {
+			digits[d++] = (char)('0' + v % 10);
+			v /= 10;
+		} while (v != 0);
+		while (d > 0) seq[n++] = digits[--d];
+		++fmt;
+	}
+	luaL_addlstring(b, seq, n);
+}
+
 /* ANSI Commands ========================================================== */
-static void ansi_fg_color( uint32_t *arg, uint32_t count)
+static void ansi_fg_color( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
 
 	uint32_t color = arg[0];
 	if (arg[0] > 15) {
 		// 256-bit color
-		printf("\x1b[38;5;%dm",color);
+		ansi_csi(b, "\x1b[38;5;%um", color, 0);
 	}
 	else if (arg[0] > 7) {
 		// high-intensity
-		printf("\x1b[9%dm", (color-8));
+		ansi_csi(b, "\x1b[9%um", (color-8), 0);
 	}
 	else {
-		printf("\x1b[3%dm",color);
+		ansi_csi(b, "\x1b[3%um", color, 0);
 	}
 }
 
-static void ansi_bg_color( uint32_t *arg, uint32_t count)
+static void ansi_bg_color( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
 
 	uint32_t color = arg[0];
 	if (arg[0] > 15) {
 		// 256-bit color
-		printf("\x1b[48;5;%dm",color);
+		ansi_csi(b, "\x1b[48;5;%um", color, 0);
 	}
 	else if (arg[0] > 7) {
 		// high-intensity
-		printf("\x1b[10%dm", (color-8));
+		ansi_csi(b, "\x1b[10%um", (color-8), 0);
 	}
 	else {
-		printf("\x1b[4%dm",color);
+		ansi_csi(b, "\x1b[4%um", color, 0);
 	}
 }
 
-static void ansi_cursor_up( uint32_t *arg, uint32_t count)
+static void ansi_cursor_up( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
-	printf("\x1b[%dA",arg[0]);
+	ansi_csi(b, "\x1b[%uA", arg[0], 0);
 }
 
-static void ansi_cursor_down( uint32_t *arg, uint32_t count)
+static void ansi_cursor_down( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
-	printf("\x1b[%dB",arg[0]);
+	ansi_csi(b, "\x1b[%uB", arg[0], 0);
 
 }
 
-static void ansi_cursor_left( uint32_t *arg, uint32_t count)
+static void ansi_cursor_left( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
-	printf("\x1b[%dD",arg[0]);
+	ansi_csi(b, "\x1b[%uD", arg[0], 0);
 
 }
 
-static void ansi_cursor_right( uint32_t *arg, uint32_t count)
+static void ansi_cursor_right( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
-	printf("\x1b[%dC",arg[0]);
+	ansi_csi(b, "\x1b[%uC", arg[0], 0);
 
 }
 
-static void ansi_set_cursor( uint32_t *arg, uint32_t count)
+static void ansi_set_cursor( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count == 0) return;
 	uint32_t row = (arg[0]==0)?1:arg[0];
 	uint32_t col = (count>1)?arg[1]:1;
-	printf("\x1b[%d;%dH",row,col);
+	ansi_csi(b, "\x1b[%u;%uH", row, col);
 }
 
-static void ansi_hide_cusor( uint32_t *arg, uint32_t count)
+static void ansi_hide_cusor( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
-	printf("\x1b[?25l");
+	luaL_addstring(b, "\x1b[?25l");
 }
 
-static void ansi_show_cursor( uint32_t *arg, uint32_t count)
+static void ansi_show_cursor( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
-	printf("\x1b[?25h");
+	luaL_addstring(b, "\x1b[?25h");
 }
 
-static void ansi_save_cursor( uint32_t *arg, uint32_t count)
+static void ansi_save_cursor( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
-	printf("\x1b[s");
+	luaL_addstring(b, "\x1b[s");
 }
 
-static void ansi_restore_cursor( uint32_t *arg, uint32_t count)
+static void ansi_restore_cursor( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
-	printf("\x1b[u");
+	luaL_addstring(b, "\x1b[u");
 }
 
-static void ansi_clear_screen( uint32_t *arg, uint32_t count)
+static void ansi_clear_screen( luaL_Buffer *b, uint32_t *arg, uint32_t count)
 {
 	if (count < 1) {
-		printf("\x1b[2J");
+		luaL_addstring(b, "\x1b[2J");
 	}
 	else {
-		printf("\x1b[%dJ",arg[0]); // 0 == cursor to top
-		                           // 1 == Cursor to bottom
-		                           // 2 == Whole screen
-		                           // 3 = Whole screen + buffer
+		ansi_csi(b, "\x1b[%uJ", arg[0], 0); // 0 == cursor to top
+		                                    // 1 == Cursor to bottom
+		                                    // 2 == Whole screen
+		                                    // 3 = Whole screen + buffer
 	}
 }
 
-static void ansi_clear_line( uint32_t *arg, uint32_t count )
+static void ansi_clear_line( luaL_Buffer *b, uint32_t *arg, uint32_t count )
 {
 	if (count < 1) {
 		// default
-		printf("\x1b[K");
+		luaL_addstring(b, "\x1b[K");
 	}
 	else {
-		printf("\x1b[%dK",arg[0]); // 0 == cursor to EOL
-		                           // 1 == Cursor to start of line
-		                           // 2 == Whole line
+		ansi_csi(b, "\x1b[%uK", arg[0], 0); // 0 == cursor to EOL
+		                                    // 1 == Cursor to start of line
+		                                    // 2 == Whole line
 
 	}
 }
 /* Command Assignment Table =============================================== */
 /* ------------------------------------------------------------------------ */
+/* in priority order for abbreviated commands, "{s}" is "show" */
 static const ansi_cmds cmds[] =
 {
 	{ "c",       ansi_fg_color },
@@ -162,43 +199,81 @@ static const ansi_cmds cmds[] =
 	{ "restore", ansi_restore_cursor },
 	{ "csr",     ansi_clear_screen },
 	{ "cln",     ansi_clear_line },
+	{ "clr",     ansi_clear_line },
 	// The last command --------------------------------------------------- */
 	{ NULL, NULL}
 };
 /* ------------------------------------------------------------------------ */
-static void ansi_exec_cmd( char *cmd, uint32_t len, uint32_t *arg, uint32_t count )
+/*
+ * Perfect hash of the command names, see ansi_hash().  Generated by
+ * searching for multipliers that give every name in cmds[] its own slot.
+ */
+static const ansi_cmds cmd_hash[ANSI_HASH_SIZE] =
+{
+	[0]  = { "hide",    ansi_hide_cusor },
+	[5]  = { "cln",     ansi_clear_line },
+	[6]  = { "bg",      ansi_bg_color },
+	[9]  = { "up",      ansi_cursor_up },
+	[12] = { "show",    ansi_show_cursor },
+	[13] = { "down",    ansi_cursor_down },
+	[14] = { "restore", ansi_restore_cursor },
+	[15] = { "save",    ansi_save_cursor },
+	[17] = { "clr",     ansi_clear_line },
+	[18] = { "b",       ansi_bg_color },
+	[24] = { "csr",     ansi_clear_screen },
+	[25] = { "mv",      ansi_set_cursor },
+	[26] = { "fg",      ansi_fg_color },
+	[27] = { "c",       ansi_fg_color },
+	[29] = { "left",    ansi_cursor_left },
+	[31] = { "right",   ansi_cursor_right },
+};
+/* ------------------------------------------------------------------------ */
+static inline uint32_t ansi_hash( const char *cmd, uint32_t len )
+{
+	return (5u*(uint8_t)cmd[0] + (uint8_t)cmd[(len > 1)?1:0] + 3u*(uint8_t)cmd[len-1]) & (ANSI_HASH_SIZE - 1);
+}
+/* ------------------------------------------------------------------------ */
+static ansi_fn ansi_find_cmd( const char *cmd, uint32_t len )
 {
-	ansi_cmds *tab = (ansi_cmds*)&cmds[0];
+	char name[8];
+	const ansi_cmds *tab;
 
-	// while there are commands in the
-	while (tab->cmd != NULL) {
-		if (strncasecmp(tab->cmd, cmd, len) == 0) {
-			void (*fn)(uint32_t *param, uint32_t cnt) = tab->fn;
-			if ((fn != NULL)&&(ansi_enable==true)) fn(arg,count);
-			// once the command is executed, return to the parser
-			return;
-		}
-		tab++;
+	if ((len > 0)&&(len < sizeof(name))) {
+		for (uint32_t indx = 0;indx<len;++indx) name[indx] = (char)tolower((int)cmd[indx]);
+		name[len] = 0;
+		tab = &cmd_hash[ansi_hash(name, len)];
+		if ((tab->cmd != NULL)&&(strcmp(tab->cmd, name) == 0)) return tab->fn;
 	}
+	/* not an exact name, take the first command it abbreviates */
+	for (tab = &cmds[0];tab->cmd != NULL;++tab) {
+		if (strncasecmp(tab->cmd, cmd, len) == 0) return tab->fn;
+	}
+	return NULL;
+}
+/* ------------------------------------------------------------------------ */
+static void ansi_exec_cmd( luaL_Buffer *b, const char *cmd, uint32_t len, uint32_t *arg, uint32_t count )
+{
+	ansi_fn fn = ansi_find_cmd(cmd, len);
+	if ((fn != NULL)&&(ansi_enable==true)) fn(b,arg,count);
 }
 /* Parser ================================================================= */
 /* ------------------------------------------------------------------------ */
-/* string parser */
-static void process_ansi_string( const char *s, uint32_t length)
+/* compile a template into the bytes it prints */
+static void process_ansi_string( luaL_Buffer *b, const char *s, size_t length)
 {
 	bool esc = false;
-	char *cmd = NULL;
+	const char *cmd = NULL;
 	uint32_t cmd_size = 0;
 	uint32_t args = 0;
 	uint32_t arg[2] = {0};
-	for (uint32_t indx = 0;(indx<length)&&(s[indx]!=0);++indx) {
+	for (size_t indx = 0;indx<length;++indx) {
 		if (esc) {
 			/*
 			 * when there is an "open" brace in the buffer, print
 			 * the character and then exit command mode.
 			 */
 			if (s[indx] == ANSI_SOP) {
-				putchar( (int) s[indx]);
+				luaL_addchar(b, s[indx]);
 				esc = false;
 			}
 			/*
@@ -210,7 +285,7 @@ static void process_ansi_string( const char *s, uint32_t length)
 					++cmd_size;
 				}
 				else {
-					cmd = (char*)&s[indx];
+					cmd = &s[indx];
 					cmd_size = 1;
 				}
 			}
@@ -236,7 +311,7 @@ static void process_ansi_string( const char *s, uint32_t length)
 			 */
 			else if ((s[indx] == ';')||(s[indx]==ANSI_EOP)) {
 				// double up command, execute the command
-				ansi_exec_cmd(cmd,cmd_size,arg,args);
+				ansi_exec_cmd(b,cmd,cmd_size,arg,args);
 				args = 0;
 				cmd = NULL;
 				cmd_size = 0;
@@ -247,31 +322,107 @@ static void process_ansi_string( const char *s, uint32_t length)
 			esc = true;
 		}
 		else {
-			// just a regular character
-			putchar((int) s[indx]);
+			// a run of regular characters
+			const char *next = memchr(&s[indx], ANSI_SOP, length - indx);
+			size_t run = (next == NULL)?(length - indx):(size_t)(next - &s[indx]);
+			luaL_addlstring(b, &s[indx], run);
+			indx += run - 1;
 		}
 	}
 }
+/* Template Cache ========================================================= */
+/* ------------------------------------------------------------------------ */
+/* push the template cache, creating it when needed */
+static void ansi_cache( lua_State *L )
+{
+	if (lua_getfield(L, LUA_REGISTRYINDEX, ANSI_CACHE) == LUA_TTABLE) return;
+	lua_pop(L,1);
+	lua_createtable(L, 0, 32);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, LUA_REGISTRYINDEX, ANSI_CACHE);
+}
 /* ------------------------------------------------------------------------ */
-/* An ANSI parsing version of "print" without newline at EOL */
+/*
+ * Add the output of the template at idx to b, compiling it on the first
+ * use.  The entry count is kept at cache[0]; once it reaches the limit the
+ * whole cache is dropped so one-off messages can not grow it forever.
+ */
+static void ansi_template( lua_State *L, luaL_Buffer *b, int cache, int idx, const char *s, size_t len )
+{
+	luaL_Buffer t;
+	lua_Integer count;
+
+	lua_pushvalue(L, idx);
+	if (lua_rawget(L, cache) == LUA_TSTRING) {
+		luaL_addvalue(b);
+		return;
+	}
+	lua_pop(L,1);
+	luaL_buffinit(L, &t);
+	process_ansi_string(&t, s, len);
+	luaL_pushresult(&t);
+	if (len <= ANSI_CACHE_KEYMAX) {
+		lua_rawgeti(L, cache, 0);
+		count = lua_tointeger(L, -1) + 1;
+		lua_pop(L,1);
+		if (count > ANSI_CACHE_MAX) {
+			lua_createtable(L, 0, 32);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, LUA_REGISTRYINDEX, ANSI_CACHE);
+			lua_replace(L, cache);
+			count = 1;
+		}
+		lua_pushinteger(L, count);
+		lua_rawseti(L, cache, 0);
+		lua_pushvalue(L, idx);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, cache);
+	}
+	luaL_addvalue(b);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * An ANSI parsing version of "print" without newline at EOL.  The whole
+ * output is assembled in one buffer and written with a single fwrite().
+ */
 int ext_ansi_print( lua_State *L )
 {
 	int n = lua_gettop(L);  /* number of arguments */
-	int i;
-	for (i = 1; i <= n; i++) {  /* for each argument */
+	int cache;
+	luaL_Buffer b;
+
+	for (int i = 1; i <= n; i++) {  /* convert the arguments to strings */
+		luaL_tolstring(L, i, NULL);
+		lua_replace(L, i);
+	}
+	ansi_cache(L);
+	cache = lua_gettop(L);
+	luaL_buffinit(L, &b);
+	for (int i = 1; i <= n; i++) {  /* for each argument */
 		size_t l;
-	    const char *s = luaL_tolstring(L, i, &l);  /* convert it to string */
-	    if (i > 1)  /* not the first element? */
-	      lua_writestring("\t", 1);  /* add a tab before it */
-	    process_ansi_string(s,l);
-	    fflush(stdout);
+		const char *s = lua_tolstring(L, i, &l);
+		const char *end = memchr(s, 0, l);  /* output stops at a NUL */
+		if (end != NULL) l = (size_t)(end - s);
+		if (i > 1)  /* not the first element? */
+			luaL_addchar(&b, '\t');  /* add a tab before it */
+		if (memchr(s, ANSI_SOP, l) == NULL) luaL_addlstring(&b, s, l);
+		else ansi_template(L, &b, cache, i, s, l);
 	}
+	fwrite(luaL_buffaddr(&b), 1, luaL_bufflen(&b), stdout);
+	fflush(stdout);
 	return 0;
 }
 /* ------------------------------------------------------------------------ */
 int ext_ansi_enable( lua_State *L )
 {
-	if (lua_isnil(L,1)) ansi_enable = true;
-	else ansi_enable = lua_toboolean(L,1);
+	bool enable;
+	if (lua_isnil(L,1)) enable = true;
+	else enable = lua_toboolean(L,1);
+	if (enable != ansi_enable) {
+		/* the cached templates were compiled for the other mode */
+		lua_pushnil(L);
+		lua_setfield(L, LUA_REGISTRYINDEX, ANSI_CACHE);
+	}
+	ansi_enable = enable;
 	return 0;
 }
@@ -0,0 +1,345 @@
+/*
+ * base64.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define B64_INVALID       (0xFF)    /**< character is not part of the alphabet */
+#define B64_PAD           ('=')     /**< padding character */
+
+#define LUA_EXT_BASE64     ("_BASE64_")
+#define LUA_EXT_BASE64_ENC ("_BASE64_ENC_")
+
+/* ------------------------------------------------------------------------ */
+/* Dialects, these mirror the base64.dialect table in modules/base64.lua */
+typedef struct {
+	const char *name;
+	const char *alphabet;
+} b64_dialect_type;
+
+static const b64_dialect_type dialects[] =
+{
+	{ "standard", "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" },
+	{ "url",      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+_" },
+	{ "imap",     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+," },
+	{ "bash",     "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ@_" },
+	{ "bcrypt",   "./ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789" },
+	{ "uuencode", " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_" },
+	{ "hqx",      "!\"#$%&'()*+,-012345689@ABCDEFGHIJKLMNPQRSTUVXYZ[`abcdefhijklmpqr" },
+	{ "passwd",   "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz" },
+	{ "xxencode", "+-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz" },
+	{ "pgp",      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" },
+	// The last dialect --------------------------------------------------- */
+	{ NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------ */
+/*
+ * The codec holds the tables that are computed when the codec is created.
+ * pair[] holds both output characters for every 12-bit value, so a 3 byte
+ * input group is encoded with two table lookups instead of four.
+ */
+typedef struct {
+	char     enc[64];          /**< encode alphabet */
+	uint8_t  dec[256];         /**< reverse lookup of the alphabet */
+	char     pair[4096][2];    /**< encoded character pairs for 12-bits */
+	bool     pad_is_digit;     /**< '=' is part of the alphabet (uuencode) */
+} b64_codec_type;
+
+typedef struct {
+	b64_codec_type *codec;
+	uint8_t  tail[2];          /**< bytes left over from the last update */
+	uint32_t tail_len;
+} b64_encoder_type;
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_codec(L,n)   ( (b64_codec_type*)luaL_checkudata(L,n,LUA_EXT_BASE64))
+#define lua_ext_get_encoder(L,n) ( (b64_encoder_type*)luaL_checkudata(L,n,LUA_EXT_BASE64_ENC))
+
+/* Codec ================================================================== */
+/* ------------------------------------------------------------------------ */
+static bool b64_init( b64_codec_type *c, const char *alphabet )
+{
+	memset(c->dec, B64_INVALID, sizeof(c->dec));
+	for (uint32_t indx = 0;indx<64;++indx) {
+		uint8_t ch = (uint8_t)alphabet[indx];
+		if (c->dec[ch] != B64_INVALID) return false; // duplicated character
+		c->enc[indx] = (char)ch;
+		c->dec[ch] = (uint8_t)indx;
+	}
+	for (uint32_t indx = 0;indx<4096;++indx) {
+		c->pair[indx][0] = c->enc[indx>>6];
+		c->pair[indx][1] = c->enc[indx&0x3F];
+	}
+	c->pad_is_digit = (c->dec[B64_PAD] != B64_INVALID);
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* encode all complete 3 byte groups, returns the number of bytes consumed */
+static size_t b64_encode_groups( const b64_codec_type *c, const uint8_t *in, size_t len, char *out )
+{
+	size_t groups = len/3;
+	for (size_t indx = 0;indx<groups;++indx) {
+		uint32_t v = ((uint32_t)in[0]<<16)|((uint32_t)in[1]<<8)|in[2];
+		out[0] = c->pair[v>>12][0];
+		out[1] = c->pair[v>>12][1];
+		out[2] = c->pair[v&0xFFF][0];
+		out[3] = c->pair[v&0xFFF][1];
+		in += 3;
+		out += 4;
+	}
+	return groups*3;
+}
+/* ------------------------------------------------------------------------ */
+/* encode the final 1 or 2 bytes with padding, returns characters written */
+static size_t b64_encode_tail( const b64_codec_type *c, const uint8_t *in, size_t len, char *out )
+{
+	if (len == 0) return 0;
+	uint32_t v = (uint32_t)in[0]<<16;
+	if (len > 1) v |= (uint32_t)in[1]<<8;
+	out[0] = c->enc[(v>>18)&0x3F];
+	out[1] = c->enc[(v>>12)&0x3F];
+	out[2] = (len > 1)?c->enc[(v>>6)&0x3F]:B64_PAD;
+	out[3] = B64_PAD;
+	return 4;
+}
+/* ------------------------------------------------------------------------ */
+static void b64_push_encoded( lua_State *L, const b64_codec_type *c, const uint8_t *in, size_t len )
+{
+	luaL_Buffer bfr;
+	char *out = luaL_buffinitsize(L, &bfr, ((len+2)/3)*4);
+	size_t used = b64_encode_groups(c, in, len, out);
+	size_t olen = (used/3)*4;
+	olen += b64_encode_tail(c, in+used, len-used, out+olen);
+	luaL_pushresultsize(&bfr, olen);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Decode a string.  Characters that are not part of the alphabet (white
+ * space, line breaks) are skipped, and padding is dropped.  When the
+ * alphabet contains '=' (uuencode) trailing '=' are treated as padding only
+ * when the data is a padded multiple of 4 characters.
+ */
+static void b64_push_decoded( lua_State *L, const b64_codec_type *c, const uint8_t *in, size_t len )
+{
+	luaL_Buffer bfr;
+	uint8_t *out = (uint8_t*)luaL_buffinitsize(L, &bfr, (len/4)*3+3);
+	size_t olen = 0;
+	uint32_t acc = 0;
+	uint32_t bits = 0;
+
+	if (c->pad_is_digit) {
+		size_t digits = 0;
+		for (size_t indx = 0;indx<len;++indx)
+			if (c->dec[in[indx]] != B64_INVALID) ++digits;
+		if ((digits%4) == 0) {
+			uint32_t pads = 0;
+			while ((len > 0)&&(pads < 2)) {
+				if (in[len-1] == B64_PAD) ++pads;
+				else if (c->dec[in[len-1]] != B64_INVALID) break;
+				--len;
+			}
+		}
+	}
+
+	size_t indx = 0;
+	while (indx < len) {
+		/* fast path, 4 valid characters on a group boundary */
+		if ((bits == 0)&&(indx+4 <= len)) {
+			uint32_t d0 = c->dec[in[indx]];
+			uint32_t d1 = c->dec[in[indx+1]];
+			uint32_t d2 = c->dec[in[indx+2]];
+			uint32_t d3 = c->dec[in[indx+3]];
+			if ((d0|d1|d2|d3) < 64) {
+				uint32_t v = (d0<<18)|(d1<<12)|(d2<<6)|d3;
+				out[olen++] = (uint8_t)(v>>16);
+				out[olen++] = (uint8_t)(v>>8);
+				out[olen++] = (uint8_t)v;
+				indx += 4;
+				continue;
+			}
+		}
+		uint32_t d = c->dec[in[indx++]];
+		if (d == B64_INVALID) continue;
+		acc = (acc<<6)|d;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			out[olen++] = (uint8_t)(acc>>bits);
+			acc &= (1u<<bits)-1;
+		}
+	}
+	luaL_pushresultsize(&bfr, olen);
+}
+/* Lua Interface ========================================================== */
+/* ------------------------------------------------------------------------ */
+static int b64_encode( lua_State *L )
+{
+	b64_codec_type *c = lua_ext_get_codec(L,1);
+	size_t len;
+	const char *data = luaL_checklstring(L,2,&len);
+	b64_push_encoded(L, c, (const uint8_t*)data, len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int b64_decode( lua_State *L )
+{
+	b64_codec_type *c = lua_ext_get_codec(L,1);
+	size_t len;
+	const char *data = luaL_checklstring(L,2,&len);
+	b64_push_decoded(L, c, (const uint8_t*)data, len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int b64_alphabet( lua_State *L )
+{
+	b64_codec_type *c = lua_ext_get_codec(L,1);
+	lua_pushlstring(L, c->enc, 64);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int b64_tostring( lua_State *L )
+{
+	b64_codec_type *c = lua_ext_get_codec(L,1);
+	lua_pushfstring(L, "base64 (%p)", c);
+	return 1;
+}
+/* Streaming Encoder ====================================================== */
+/* ------------------------------------------------------------------------ */
+/* enc:update( chunk ), returns the encoded complete groups of the stream */
+static int b64_enc_update( lua_State *L )
+{
+	b64_encoder_type *e = lua_ext_get_encoder(L,1);
+	size_t len;
+	const uint8_t *data = (const uint8_t*)luaL_checklstring(L,2,&len);
+	luaL_Buffer bfr;
+
+	if (e->codec == NULL) return luaL_error(L,"encoder is finished");
+	size_t total = e->tail_len + len;
+	char *out = luaL_buffinitsize(L, &bfr, (total/3)*4);
+	size_t olen = 0;
+
+	/* complete the group started by the previous chunk */
+	if ((e->tail_len > 0)&&(total >= 3)) {
+		uint8_t grp[3];
+		uint32_t need = 3 - e->tail_len;
+		memcpy(grp, e->tail, e->tail_len);
+		memcpy(grp+e->tail_len, data, need);
+		olen += (b64_encode_groups(e->codec, grp, 3, out)/3)*4;
+		data += need;
+		len -= need;
+		e->tail_len = 0;
+	}
+	size_t used = b64_encode_groups(e->codec, data, len, out+olen);
+	olen += (used/3)*4;
+	/* keep the remainder for the next update */
+	memcpy(e->tail+e->tail_len, data+used, len-used);
+	e->tail_len += (uint32_t)(len-used);
+	luaL_pushresultsize(&bfr, olen);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* enc:finish(), returns the padded remainder and closes the stream */
+static int b64_enc_finish( lua_State *L )
+{
+	b64_encoder_type *e = lua_ext_get_encoder(L,1);
+	char out[4];
+
+	if (e->codec == NULL) return luaL_error(L,"encoder is finished");
+	size_t olen = b64_encode_tail(e->codec, e->tail, e->tail_len, out);
+	lua_pushlstring(L, out, olen);
+	e->tail_len = 0;
+	e->codec = NULL;
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int b64_encoder( lua_State *L )
+{
+	b64_codec_type *c = lua_ext_get_codec(L,1);
+	b64_encoder_type *e = (b64_encoder_type*)lua_newuserdatauv(L, sizeof(b64_encoder_type), 1);
+	memset((void*)e,0,sizeof(b64_encoder_type));
+	e->codec = c;
+	/* keep a reference to the codec while the encoder is alive */
+	lua_pushvalue(L,1);
+	lua_setiuservalue(L,-2,1);
+	luaL_setmetatable(L, LUA_EXT_BASE64_ENC);
+	return 1;
+}
+/* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
+static const luaL_Reg b64_funcs[] = {
+		{ "encode", b64_encode },
+		{ "decode", b64_decode },
+		{ "encoder", b64_encoder },
+		{ "alphabet", b64_alphabet },
+		{NULL, NULL }
+};
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg b64_metameth[] = {
+		{"__index", NULL},  /* place holder */
+		{"__tostring", b64_tostring},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg b64_enc_funcs[] = {
+		{ "update", b64_enc_update },
+		{ "finish", b64_enc_finish },
+		{NULL, NULL }
+};
+/* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
+/* cbase64.new( mode ), mode is a dialect name or a 64 character alphabet */
+static int b64_new( lua_State *L )
+{
+	size_t len;
+	const char *mode = luaL_optlstring(L,1,"standard",&len);
+	const char *alphabet = NULL;
+
+	for (const b64_dialect_type *d = &dialects[0];d->name != NULL;++d) {
+		if (strcmp(d->name, mode) == 0) {
+			alphabet = d->alphabet;
+			break;
+		}
+	}
+	if ((alphabet == NULL)&&(len == 64)) alphabet = mode;
+	if (alphabet == NULL)
+		return luaL_error(L,"unknown base64 dialect '%s'", mode);
+
+	b64_codec_type *c = (b64_codec_type*)lua_newuserdatauv(L, sizeof(b64_codec_type), 0);
+	if (!b64_init(c, alphabet))
+		return luaL_error(L,"base64 alphabet has duplicated characters");
+	luaL_setmetatable(L, LUA_EXT_BASE64);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg b64_lib[] = {
+		{ "new", b64_new },
+		{NULL, NULL }
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_cbase64( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_BASE64);
+	luaL_setfuncs(L, b64_metameth, 0);
+	luaL_newlibtable(L, b64_funcs);
+	luaL_setfuncs(L, b64_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newmetatable(L, LUA_EXT_BASE64_ENC);
+	luaL_newlibtable(L, b64_enc_funcs);
+	luaL_setfuncs(L, b64_enc_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newlib(L, b64_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
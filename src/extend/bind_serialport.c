@@ -7,7 +7,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <string.h>
 #include <time.h>
+#ifndef WIN32
+#include <strings.h>
+#define strcmpi    strcasecmp
+#endif
 
 #include "lua.h"
 #include "lprefix.h"
@@ -19,34 +24,160 @@
 #ifdef SERIALPORT_H
 
 #include "ymodem.h"
+#include "capture.h"
+#include "lua_ext_time.h"
 
 #define TIMEOUT    (1000)    /**< global timeout for serial ops */
+#define SP_RX_BUFFER    (4096)    /**< received bytes kept between reads */
 
 #define check_nl(c)    ( (c=='\r')||(c=='\n') )
 
 /* ------------------------------------------------------------------------ */
 typedef struct {
 	HANDLE device;
-	char   name[11];
+	char   name[64];
 	uint32_t baud;
 	LUA_NUMBER stop;
 	uint32_t parity;
 	bool   initialized;
+	bool   cr;          /**< lines() ended the last line at a CR, a LF may follow */
+	capture_type *capture;  /**< log of the traffic, NULL = none */
+	uint32_t rx_pos;    /**< first unread byte in rx */
+	uint32_t rx_len;    /**< unread bytes in rx */
+	char   rx[ SP_RX_BUFFER ];
 } lua_serialport_type;
 
-HANDLE ym_serial;
+HANDLE ym_serial = SP_INVALID_HANDLE;   /**< port used by the YMODEM callbacks */
+static lua_serialport_type *ym_port = NULL;  /**< its object, when it is known, for the bytes it buffered */
+
+int lua_ext_xmodem_send( lua_State *L );
+int lua_ext_xmodem_receive( lua_State *L );
 
 #define LUA_EXT_SERIALPORT   ("_SERIALPORT_")
 /* ------------------------------------------------------------------------ */
 #define lua_ext_get_udata(L,n)   ( (lua_serialport_type*)luaL_checkudata(L,n,LUA_EXT_SERIALPORT))
 /* ------------------------------------------------------------------------ */
+static lua_serialport_type *lua_ext_get_open( lua_State *L, int n )
+{
+	lua_serialport_type *obj = lua_ext_get_udata(L,n);
+	if (obj->device == SP_INVALID_HANDLE) luaL_error(L,"serial port is not open");
+	return obj;
+}
+/* ------------------------------------------------------------------------ */
+/* handle of the open port at stack index n, for the transfer bindings */
+HANDLE lua_ext_serial_handle( lua_State *L, int n )
+{
+	return lua_ext_get_open(L,n)->device;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Make the open port at stack index n the port of the ym_* callbacks, they
+ * take the bytes it has buffered first.  Returns the handle it replaced.
+ */
+HANDLE lua_ext_serial_attach( lua_State *L, int n )
+{
+	HANDLE saved = ym_serial;
+
+	ym_port = lua_ext_get_open(L,n);
+	ym_serial = ym_port->device;
+	return saved;
+}
+/* ------------------------------------------------------------------------ */
+/* take size bytes from the receive buffer */
+static void sp_consume( lua_serialport_type *obj, uint32_t size )
+{
+	obj->rx_pos += size;
+	obj->rx_len -= size;
+	if (obj->rx_len == 0) obj->rx_pos = 0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Wait up to timeout ms for data, then add what has arrived to the receive
+ * buffer.  Returns the number of bytes added, 0 on timeout or a full buffer.
+ */
+static uint32_t sp_fill( lua_serialport_type *obj, uint32_t timeout )
+{
+	uint32_t room;
+	uint32_t br;
+
+	if (obj->rx_pos + obj->rx_len == SP_RX_BUFFER) {
+		memmove(obj->rx, &obj->rx[obj->rx_pos], obj->rx_len);
+		obj->rx_pos = 0;
+	}
+	room = SP_RX_BUFFER - (obj->rx_pos + obj->rx_len);
+	if (room == 0) return 0;
+	br = readFromSerialPortTimeout(obj->device, &obj->rx[obj->rx_pos + obj->rx_len], 1, timeout);
+	if ((br > 0)&&(room > 1)) br += readFromSerialPort(obj->device, &obj->rx[obj->rx_pos + obj->rx_len + 1], (int)(room - 1));
+	obj->rx_len += br;
+	return br;
+}
+/* ------------------------------------------------------------------------ */
+/* ms left until deadline (ns), 0 once it has passed */
+static uint32_t sp_left( int64_t deadline )
+{
+	int64_t left = (deadline - time_now_ns()) / TIME_NS_PER_MS;
+	return (left > 0) ? (uint32_t)left : 0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * A task of time.run() yields until the port is ready for events or the
+ * deadline passed and continues in k, which finds the deadline where its
+ * caller left it on the stack.  Returns when the deadline has passed or L
+ * cannot yield for I/O.
+ */
+static void sp_wait( lua_State *L, lua_serialport_type *obj, int events, int64_t deadline, lua_KFunction k )
+{
+#ifndef WIN32
+	if (time_now_ns() < deadline) time_wait_io(L, obj->device, events, deadline, k);
+#else
+	(void)L; (void)obj; (void)events; (void)deadline; (void)k;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * sp_fill() until the deadline; a task yields instead of blocking, so the
+ * caller must be continued in k with its status.  A port that was ready
+ * right after the task resumed (*status is LUA_YIELD) but has no data hung
+ * up, that ends the wait like the blocking read does.
+ */
+static uint32_t sp_fill_k( lua_State *L, lua_serialport_type *obj, int64_t deadline, lua_KFunction k, int *status )
+{
+	uint32_t br;
+	bool resumed = (*status == LUA_YIELD);
+
+	*status = LUA_OK;
+	if (!time_can_wait_io(L)) return sp_fill(obj, sp_left(deadline));
+	if (((br = sp_fill(obj, 0)) == 0)&&!resumed) sp_wait(L, obj, TIME_IO_READ, deadline, k);
+	return br;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Read up to size bytes from the port at stack index n for the other
+ * bindings: buffered bytes first, otherwise wait until the deadline (ns)
+ * for the first byte and take what else has arrived.  A task yields while
+ * it waits and the caller is continued in k, which must keep the deadline
+ * on its stack; status is the one k was called with (see sp_fill_k()).
+ */
+uint32_t lua_ext_serial_read( lua_State *L, int n, char *buffer, uint32_t size, int64_t deadline, lua_KFunction k, int *status )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,n);
+	uint32_t br;
+
+	obj->cr = false;
+	if ((obj->rx_len == 0)&&(size > 0)) sp_fill_k(L, obj, deadline, k, status);
+	br = (size < obj->rx_len) ? size : obj->rx_len;
+	memcpy(buffer, &obj->rx[obj->rx_pos], br);
+	sp_consume(obj, br);
+	return br;
+}
+/* ------------------------------------------------------------------------ */
 static int sp_open( lua_State *L )
 {
 	lua_serialport_type *obj = lua_ext_get_udata(L,1);
 	const char *name = luaL_checkstring(L,2);
 	LUA_INTEGER p_baud = luaL_optinteger(L, 3, 9600);
 	const char *p_par = luaL_optstring(L,4,"none");
-	LUA_NUMBER p_stop = luaL_optinteger(L,5, 1);
+	LUA_NUMBER p_stop = luaL_optnumber(L,5, 1);
 
 	int stop_bits = one;
 	int parity = off;
@@ -59,60 +190,332 @@ static int sp_open( lua_State *L )
 	if (strcmpi(p_par,"none")==0) parity = off;
 	else if (strcmpi(p_par,"odd")==0) parity = odd;
 	else if (strcmpi(p_par,"even")==0) parity = even;
-	else return luaL_error(L,"Parity must be odd, even, or none");
+	else if (strcmpi(p_par,"mark")==0) parity = mark;
+	else return luaL_error(L,"Parity must be odd, even, mark or none");
 
 	if (obj->initialized) {
 		// have to close port first!
 		return luaL_error(L,"port %s is already open",name);
 	}
 	// store port configuration in the port userdata
-	strcpy(obj->name, name);
+	snprintf(obj->name, sizeof(obj->name), "%s", name);
 	obj->baud = p_baud;
 	obj->stop = p_stop;
 	obj->parity = parity;
 	// open the port
 	obj->device = openSerialPort(name, p_baud, stop_bits, parity);
+	if (obj->device == SP_INVALID_HANDLE) {
+		return luaL_error(L,"unable to open serial port %s",name);
+	}
+	obj->initialized = true;
+	obj->cr = false;
+	obj->rx_pos = obj->rx_len = 0;
+	ym_serial = obj->device;
 
 	return 0;
 }
 /* ------------------------------------------------------------------------ */
+/* read() in a task, the deadline is at stack index 5 and the bytes read so far at 6 */
+static int sp_read_k( lua_State *L, int status, lua_KContext ctx )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	uint32_t size = luaL_optinteger(L,2,1);
+	int64_t deadline = (int64_t)lua_tointeger(L, 5);
+
+	(void)ctx;
+	obj->cr = false;
+	for (;;) {
+		uint32_t take = size - (uint32_t)lua_rawlen(L, 6);
+		if (take > obj->rx_len) take = obj->rx_len;
+		if (take > 0) {
+			lua_pushlstring(L, &obj->rx[obj->rx_pos], take);
+			sp_consume(obj, take);
+			lua_concat(L, 2);
+		}
+		if ((lua_rawlen(L, 6) == size)||(sp_fill_k(L, obj, deadline, sp_read_k, &status) == 0)) break;
+	}
+	lua_pushboolean(L, lua_rawlen(L, 6) < size);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
 static int sp_read( lua_State *L )
 {
 	luaL_Buffer bfr;
 
-	lua_serialport_type *obj = lua_ext_get_udata(L,1);
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
 	uint32_t size = luaL_optinteger(L,2,1);
 	uint32_t timeout = luaL_optinteger(L,3,1000);
 	uint32_t max_tries = luaL_optinteger(L,4,10);
 
-	uint32_t ntries = 0;
-
-	luaL_buffinitsize(L, &bfr, size);
-	char* b = luaL_buffaddr(&bfr);
-	uint32_t br = 0;
-	do {
-		uint32_t rb = (uint32_t) readFromSerialPort(obj->device, (char*)b+br,size-br);
-		br += rb;
-		if (rb == 0) {
-			++ntries;
-			Sleep(timeout);
-		}
-	} while ((br<size)&&(ntries < max_tries));
+	/*
+	 * wait at most timeout ms for each of the max_tries tries, the read
+	 * returns as soon as size bytes have arrived.  Bytes left over by
+	 * read_until() and lines() come first.
+	 */
+	if (time_can_wait_io(L)) {
+		lua_settop(L, 4);
+		lua_pushinteger(L, (lua_Integer)(time_now_ns() + (int64_t)timeout * ((max_tries > 0)?max_tries:1) * TIME_NS_PER_MS));
+		lua_pushliteral(L, "");
+		return sp_read_k(L, LUA_OK, 0);
+	}
+	char* b = luaL_buffinitsize(L, &bfr, size);
+	uint32_t br = (size < obj->rx_len) ? size : obj->rx_len;
+	memcpy(b, &obj->rx[obj->rx_pos], br);
+	sp_consume(obj, br);
+	obj->cr = false;
+	if (br < size) br += readFromSerialPortTimeout(obj->device, b + br, size - br, timeout * ((max_tries > 0)?max_tries:1));
 	luaL_addsize(&bfr,br);
 	luaL_pushresult(&bfr);
-	lua_pushboolean(L,ntries>max_tries);
+	lua_pushboolean(L,br<size);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* position of the plain string term in the len bytes at data, -1 if none */
+static int32_t sp_find( const char *data, uint32_t len, const char *term, size_t tlen )
+{
+	if (tlen == 0) return 0;
+	for (uint32_t i = 0; i + tlen <= len; ++i) {
+		const char *p = memchr(&data[i], term[0], len - i - tlen + 1);
+		if (p == NULL) break;
+		i = (uint32_t)(p - data);
+		if (memcmp(p, term, tlen) == 0) return (int32_t)i;
+	}
+	return -1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * data, err = port:read_until( term, max, timeout )
+ *
+ * Read until the delimiter term arrived, term is a Lua pattern when it has
+ * pattern characters (like string.find).  Returns the data including the
+ * terminator; the max bytes received and "max" when no terminator came in
+ * max bytes; nil and "timeout" when timeout ms passed, the bytes received
+ * stay for the next read.  The deadline is at stack index 5.
+ */
+static int sp_read_until_k( lua_State *L, int status, lua_KContext ctx )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	int64_t deadline = (int64_t)lua_tointeger(L, 5);
+	size_t tlen;
+	const char *term = lua_tolstring(L, 2, &tlen);
+	lua_Integer max = luaL_optinteger(L, 3, SP_RX_BUFFER);
+	bool pattern = (strpbrk(term, "^$*+?.([%-") != NULL);
+	uint32_t scanned = 0;
+
+	(void)ctx;
+	obj->cr = false;
+	for (;;) {
+		uint32_t avail = ((lua_Integer)obj->rx_len < max) ? obj->rx_len : (uint32_t)max;
+		int32_t end = -1;
+
+		if (pattern) {
+			/* e = select(2, string.find(buffered, term)), the library as loaded, not the global */
+			if (avail > scanned) {
+				lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+				lua_getfield(L, -1, LUA_STRLIBNAME);
+				lua_getfield(L, -1, "find");
+				lua_pushlstring(L, &obj->rx[obj->rx_pos], avail);
+				lua_pushvalue(L, 2);
+				lua_call(L, 2, 2);
+				if (lua_isinteger(L, -1)) end = (int32_t)lua_tointeger(L, -1);
+				lua_pop(L, 4);
+			}
+		}
+		else {
+			/* the terminator may have been split between two reads */
+			uint32_t from = (scanned >= tlen) ? scanned - (uint32_t)tlen + 1 : 0;
+			int32_t at = sp_find(&obj->rx[obj->rx_pos + from], avail - from, term, tlen);
+			if (at >= 0) end = (int32_t)(from + (uint32_t)at + tlen);
+		}
+		scanned = avail;
+		if (end >= 0) {
+			lua_pushlstring(L, &obj->rx[obj->rx_pos], (size_t)end);
+			sp_consume(obj, (uint32_t)end);
+			return 1;
+		}
+		if ((lua_Integer)obj->rx_len >= max) {
+			lua_pushlstring(L, &obj->rx[obj->rx_pos], (size_t)max);
+			sp_consume(obj, (uint32_t)max);
+			lua_pushliteral(L, "max");
+			return 2;
+		}
+		if (sp_fill_k(L, obj, deadline, sp_read_until_k, &status) == 0) {
+			lua_pushnil(L);
+			lua_pushliteral(L, "timeout");
+			return 2;
+		}
+	}
+}
+/* ------------------------------------------------------------------------ */
+static int sp_read_until( lua_State *L )
+{
+	lua_Integer max = luaL_optinteger(L, 3, SP_RX_BUFFER);
+
+	luaL_checkstring(L, 2);
+	luaL_argcheck(L, (max > 0)&&(max <= SP_RX_BUFFER), 3, "max must be 1..4096");
+	lua_settop(L, 4);
+	lua_pushinteger(L, (lua_Integer)time_now_ns() + luaL_optinteger(L, 4, TIMEOUT) * TIME_NS_PER_MS);
+	return sp_read_until_k(L, LUA_OK, 0);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * lines() iterator, a line ends at CR, LF or CR LF and is returned without
+ * it.  The deadline is at stack index 3.
+ */
+static int sp_lines_k( lua_State *L, int status, lua_KContext ctx )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	int64_t deadline = (int64_t)lua_tointeger(L, 3);
+	uint32_t scanned = 0;
+
+	(void)ctx;
+	for (;;) {
+		/* the LF of a CR LF that was split between two reads */
+		if (obj->cr && (obj->rx_len > 0)) {
+			if (obj->rx[obj->rx_pos] == '\n') sp_consume(obj, 1);
+			obj->cr = false;
+		}
+		for (; scanned < obj->rx_len; ++scanned) {
+			char c = obj->rx[obj->rx_pos + scanned];
+			if (check_nl(c)) {
+				lua_pushlstring(L, &obj->rx[obj->rx_pos], scanned);
+				sp_consume(obj, scanned + 1);
+				obj->cr = (c == '\r');
+				return 1;
+			}
+		}
+		/* a line that does not fit the buffer is returned in pieces */
+		if (obj->rx_len == SP_RX_BUFFER) {
+			lua_pushlstring(L, &obj->rx[obj->rx_pos], obj->rx_len);
+			sp_consume(obj, obj->rx_len);
+			return 1;
+		}
+		if (sp_fill_k(L, obj, deadline, sp_lines_k, &status) == 0) {
+			lua_pushnil(L);
+			return 1;
+		}
+	}
+}
+/* ------------------------------------------------------------------------ */
+static int sp_lines_next( lua_State *L )
+{
+	lua_settop(L, 2);
+	lua_pushinteger(L, (lua_Integer)time_now_ns() + lua_tointeger(L, lua_upvalueindex(1)) * TIME_NS_PER_MS);
+	return sp_lines_k(L, LUA_OK, 0);
+}
+/* ------------------------------------------------------------------------ */
+/* for line in port:lines( timeout ) do ... end, ends when no line came in timeout ms */
+static int sp_lines( lua_State *L )
+{
+	lua_ext_get_open(L,1);
+	lua_pushinteger(L, luaL_optinteger(L, 2, TIMEOUT));
+	lua_pushcclosure(L, sp_lines_next, 1);
+	lua_pushvalue(L, 1);
 	return 2;
 }
 /* ------------------------------------------------------------------------ */
+/* write() in a task, the number of bytes written so far is at stack index 3, the deadline at 4 */
+static int sp_write_k( lua_State *L, int status, lua_KContext ctx )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	size_t len = 0;
+	char *data = (char*)lua_tolstring(L, 2, &len);
+	lua_Integer bw = lua_tointeger(L, 3);
+
+	(void)ctx;
+	while ((size_t)bw < len) {
+		uint32_t n = writeToSerialPortNow(obj->device, data + bw, (int)(len - (size_t)bw));
+		bw += n;
+		if (n > 0) {
+			status = LUA_OK;
+			continue;
+		}
+		/* ready but nothing written, the port hung up */
+		if (status == LUA_YIELD) break;
+		lua_pushinteger(L, bw);
+		lua_replace(L, 3);
+		sp_wait(L, obj, TIME_IO_WRITE, (int64_t)lua_tointeger(L, 4), sp_write_k);
+		break;
+	}
+	lua_pushinteger(L, bw);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
 static int sp_write( lua_State *L )
 {
-	lua_serialport_type *obj = lua_ext_get_udata(L,1);
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
 	if (lua_type(L,2) != LUA_TSTRING)
 		return luaL_error(L,"Argument 2 expected string.");
-	uint32_t len = 0;
+	size_t len = 0;
 	char *data = (char*)lua_tolstring(L, 2, &len);
 
-	lua_pushinteger( L, writeToSerialPort(obj->device, data, len));
+	if (time_can_wait_io(L)) {
+		lua_settop(L, 2);
+		lua_pushinteger(L, 0);
+		lua_pushinteger(L, (lua_Integer)(time_now_ns() + TIMEOUT * TIME_NS_PER_MS));
+		return sp_write_k(L, LUA_OK, 0);
+	}
+	lua_pushinteger( L, writeToSerialPort(obj->device, data, (int)len));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* wait until the written data has left the port */
+static int sp_drain( lua_State *L )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	lua_pushboolean(L, drainSerialPort(obj->device));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* discard received data that has not been read */
+static int sp_flush( lua_State *L )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	flushSerialPort(obj->device);
+	obj->rx_pos = obj->rx_len = 0;
+	obj->cr = false;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* tap of the port's capture */
+static void sp_capture_tap( void *ctx, bool tx, const char *data, uint32_t size )
+{
+	capture_write((capture_type*)ctx, tx, data, size);
+}
+/* ------------------------------------------------------------------------ */
+static void sp_capture_stop( lua_serialport_type *obj )
+{
+	if (obj->capture == NULL) return;
+	setSerialPortTap(obj->device, NULL, NULL);
+	capture_close(obj->capture);
+	obj->capture = NULL;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * port:capture( path, size ) logs everything the port sends and receives,
+ * transfers included, to a capture file with a ring of size bytes;
+ * port:capture() stops it.  Returns true or nil, message.
+ */
+static int sp_capture( lua_State *L )
+{
+	lua_serialport_type *obj = lua_ext_get_open(L,1);
+	const char *path = luaL_optstring(L, 2, NULL);
+	lua_Integer size = luaL_optinteger(L, 3, CAPTURE_DEFAULT_SIZE);
+
+	sp_capture_stop(obj);
+	if (path != NULL) {
+		luaL_argcheck(L, (size >= CAPTURE_MIN_SIZE)&&(size <= (lua_Integer)UINT32_MAX), 3, "size must be at least 65536");
+		if ((obj->capture = capture_create(path, (uint32_t)size, obj->name, obj->baud)) == NULL) {
+			return luaL_fileresult(L, 0, path);
+		}
+		if (!setSerialPortTap(obj->device, sp_capture_tap, obj->capture)) {
+			sp_capture_stop(obj);
+			lua_pushnil(L);
+			lua_pushliteral(L, "too many ports are captured");
+			return 2;
+		}
+	}
+	lua_pushboolean(L, true);
 	return 1;
 }
 /* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
@@ -120,9 +523,14 @@ static int sp_gc (lua_State *L)
 {
   lua_serialport_type *obj = lua_ext_get_udata(L,1);
 
-  if (obj->device != NULL) {
+  if (obj->device != SP_INVALID_HANDLE) {
+	  sp_capture_stop(obj);
+	  if (ym_serial == obj->device) ym_serial = SP_INVALID_HANDLE;
+	  if (ym_port == obj) ym_port = NULL;
 	  closeSerialPort(obj->device);
-	  obj->device = NULL;
+	  obj->device = SP_INVALID_HANDLE;
+	  obj->initialized = false;
+	  obj->rx_pos = obj->rx_len = 0;
   }
   return 0;
 }
@@ -130,10 +538,10 @@ static int sp_gc (lua_State *L)
 static int sp_tostring (lua_State *L)
 {
 	lua_serialport_type *obj = lua_ext_get_udata(L,1);
-	if (obj->device == NULL)
+	if (obj->device == SP_INVALID_HANDLE)
 		lua_pushliteral(L, "serial (closed)");
 	else
-		lua_pushfstring(L, "serial (%p)", obj->device);
+		lua_pushfstring(L, "serial (%s)", obj->name);
   return 1;
 }
 /* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
@@ -142,7 +550,14 @@ static int sp_tostring (lua_State *L)
 static const luaL_Reg lua_ext_serial_funcs[] = {
 		{ "open", sp_open },
 		{ "read", sp_read },
+		{ "read_until", sp_read_until },
+		{ "lines", sp_lines },
 		{ "write", sp_write },
+		{ "drain", sp_drain },
+		{ "flush", sp_flush },
+		{ "capture", sp_capture },
+		{ "xmodem_send", lua_ext_xmodem_send },
+		{ "xmodem_receive", lua_ext_xmodem_receive },
 		{ "close", sp_gc },
 		{NULL, NULL }
 };
@@ -160,11 +575,12 @@ static int sp_new_serial( lua_State *L )
 {
 	lua_serialport_type *p = (lua_serialport_type *)lua_newuserdatauv(L, sizeof(lua_serialport_type), 0);
 	memset((void*)p,0,sizeof(lua_serialport_type));
+	p->device = SP_INVALID_HANDLE;
 	luaL_setmetatable(L, LUA_EXT_SERIALPORT);
 	return 1;
 }
 /* ------------------------------------------------------------------------ */
-LUALIB_API int __cdecl luaopen_brooks_serial( lua_State *L)
+LUALIB_API int luaopen_brooks_serial( lua_State *L)
 {
 	/* build the serial port extension Lua interface */
 	luaL_newmetatable(L, LUA_EXT_SERIALPORT);  /* metatable for serial extension */
@@ -182,22 +598,59 @@ LUALIB_API int __cdecl luaopen_brooks_serial( lua_State *L)
 /* ------------------------------------------------------------------------ */
 
 /* YMODEM Bindings to serial poert interface ------------------------------ */
+/* the attached port object when it belongs to ym_serial */
+static lua_serialport_type *ym_buffered( void )
+{
+	if ((ym_port == NULL)||(ym_port->device != ym_serial)||(ym_port->device == SP_INVALID_HANDLE)) return NULL;
+	return ym_port;
+}
+/* ------------------------------------------------------------------------ */
 void ym_flush( void )
 {
+	lua_serialport_type *obj = ym_buffered();
 
+	if (obj != NULL) obj->rx_pos = obj->rx_len = 0;
+	if (ym_serial != SP_INVALID_HANDLE) flushSerialPort(ym_serial);
 }
 /* ------------------------------------------------------------------------ */
 void ym_putc(char c)
 {
-	writeToSerialPort(ym_serial, &c, 1);
+	if (ym_serial != SP_INVALID_HANDLE) writeToSerialPort(ym_serial, &c, 1);
 }
 /* ------------------------------------------------------------------------ */
 uint32_t ym_getc( uint32_t timeout)
 {
-	uint32_t
+	lua_serialport_type *obj = ym_buffered();
+	char c;
+
+	if (ym_serial == SP_INVALID_HANDLE) return 0xFFFFFFFF;
+	if ((obj != NULL)&&(obj->rx_len > 0)) {
+		c = obj->rx[obj->rx_pos];
+		sp_consume(obj, 1);
+		return (uint8_t)c;
+	}
+	if (readFromSerialPortTimeout(ym_serial, &c, 1, timeout) == 0) return 0xFFFFFFFF;
+	return (uint8_t)c;
+}
+/* ------------------------------------------------------------------------ */
+void ym_send( uint8_t* packet, uint32_t size)
+{
+	if (ym_serial != SP_INVALID_HANDLE) writeToSerialPort(ym_serial, (char*)packet, (int)size);
 }
 /* ------------------------------------------------------------------------ */
-void ym_send( uint8_t* packet, uint32_t size);
-uint32_t ym_receive(uint8_t* packet, uint32_t size, uint32_t timeout);
+uint32_t ym_receive(uint8_t* packet, uint32_t size, uint32_t timeout)
+{
+	lua_serialport_type *obj = ym_buffered();
+	uint32_t br = 0;
+
+	if (ym_serial == SP_INVALID_HANDLE) return 0;
+	if ((obj != NULL)&&(obj->rx_len > 0)) {
+		br = (size < obj->rx_len) ? size : obj->rx_len;
+		memcpy(packet, &obj->rx[obj->rx_pos], br);
+		sp_consume(obj, br);
+		if (br == size) return br;
+	}
+	return br + readFromSerialPortTimeout(ym_serial, (char*)&packet[br], size - br, timeout);
+}
 
-#endif
\ No newline at end of file
+#endif
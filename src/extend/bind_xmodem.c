@@ -0,0 +1,263 @@
+/*
+ * bind_xmodem.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "serialport.h"
+#include "ymodem.h"
+#include "ym_file.h"
+
+/* stack of a running transfer: port, source or sink, options, then these */
+#define XMODEM_PROGRESS       (4)     /**< progress(blocks, bytes) or nil */
+#define XMODEM_CHUNK          (5)     /**< data the reader returned last */
+#define XMODEM_STATE          (6)     /**< the lua_xmodem_type, light userdata */
+
+#define XMODEM_EVERY          (16)    /**< default blocks between progress calls */
+
+typedef struct {
+	lua_State *L;         /**< state of the running transfer */
+	int fn;               /**< stack index of the reader or writer, 0 = file */
+	size_t pos;           /**< bytes of the chunk that were sent */
+	bool eof;             /**< the reader has no more data */
+	bool failed;          /**< a Lua function raised an error, it is on the stack */
+	bool cancelled;       /**< a Lua function returned false */
+	bool send;            /**< send, else receive */
+	bool large;           /**< 1024 byte blocks */
+	bool ascii;           /**< the received data has no padding */
+	uint32_t res;         /**< result of the engine */
+} lua_xmodem_type;
+
+extern HANDLE ym_serial;
+HANDLE lua_ext_serial_handle( lua_State *L, int n );
+HANDLE lua_ext_serial_attach( lua_State *L, int n );
+
+/* Stream ================================================================= */
+/* ------------------------------------------------------------------------ */
+/* call the function at the top of the stack with nargs arguments */
+static uint32_t xmodem_call( lua_xmodem_type *x, int nargs, int nresults )
+{
+	if (lua_pcall(x->L, nargs, nresults, 0) != LUA_OK) {
+		/* keep the error on the stack, it is raised once the engine returns */
+		x->failed = true;
+		return YM_RES_CANCEL;
+	}
+	return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/* fill data from the chunks the reader returns, nil or "" ends the data */
+static uint32_t xmodem_read( ym_file_type *f, uint8_t *data, uint32_t size, uint32_t *br )
+{
+	lua_xmodem_type *x = (lua_xmodem_type*)f->ctx;
+	lua_State *L = x->L;
+	const char *chunk;
+	size_t len;
+
+	*br = 0;
+	while ((*br < size) && !x->eof) {
+		chunk = lua_tolstring(L, XMODEM_CHUNK, &len);
+		if (x->pos < len) {
+			size_t n = ((len - x->pos) < (size - *br)) ? (len - x->pos) : (size - *br);
+			memcpy(&data[*br], &chunk[x->pos], n);
+			x->pos += n;
+			*br += (uint32_t)n;
+			continue;
+		}
+		lua_pushvalue(L, x->fn);
+		if (xmodem_call(x, 0, 1) != YM_RES_OK) return YM_RES_CANCEL;
+		if (lua_isnil(L, -1)) x->eof = true;
+		else if (lua_type(L, -1) != LUA_TSTRING) {
+			lua_pushliteral(L, "reader must return a string or nil");
+			x->failed = true;
+			return YM_RES_CANCEL;
+		}
+		else if (lua_rawlen(L, -1) == 0) x->eof = true;
+		lua_replace(L, XMODEM_CHUNK);
+		x->pos = 0;
+	}
+	return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/* hand a block to the writer, false cancels the transfer */
+static uint32_t xmodem_write( ym_file_type *f, const uint8_t *data, uint32_t size )
+{
+	lua_xmodem_type *x = (lua_xmodem_type*)f->ctx;
+	lua_State *L = x->L;
+	bool go;
+
+	lua_pushvalue(L, x->fn);
+	lua_pushlstring(L, (const char*)data, size);
+	if (xmodem_call(x, 1, 1) != YM_RES_OK) return YM_RES_CANCEL;
+	go = lua_isnil(L, -1) || lua_toboolean(L, -1);
+	lua_pop(L,1);
+	x->cancelled = !go;
+	return (go) ? YM_RES_OK : YM_RES_CANCEL;
+}
+/* ------------------------------------------------------------------------ */
+static uint32_t xmodem_progress( ym_file_type *f )
+{
+	lua_xmodem_type *x = (lua_xmodem_type*)f->ctx;
+	lua_State *L = x->L;
+	bool go;
+
+	lua_pushvalue(L, XMODEM_PROGRESS);
+	lua_pushinteger(L, (lua_Integer)f->blocks);
+	lua_pushinteger(L, (lua_Integer)f->bytes);
+	if (xmodem_call(x, 2, 1) != YM_RES_OK) return YM_RES_CANCEL;
+	go = lua_isnil(L, -1) || lua_toboolean(L, -1);
+	lua_pop(L,1);
+	x->cancelled = !go;
+	return (go) ? YM_RES_OK : YM_RES_CANCEL;
+}
+
+/* Transfer =============================================================== */
+/* ------------------------------------------------------------------------ */
+/*
+ * The engine, called by lua_pcall() with the stack of the transfer.  An
+ * error of a callback, or one raised by the Lua API calls around them,
+ * comes back to xmodem_run(), which puts the engine state back first.
+ */
+static int xmodem_engine( lua_State *L )
+{
+	lua_xmodem_type *x = (lua_xmodem_type*)lua_touserdata(L, XMODEM_STATE);
+
+	x->res = (x->send) ? ymodem_send_xmodem_unsafe(x->large) : ymodem_receive_xmodem_unsafe(x->ascii);
+	if (x->failed) return lua_error(L);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* integer option key of the table at stack index 3, def when it is not set */
+static uint32_t xmodem_opt( lua_State *L, const char *key, uint32_t def )
+{
+	lua_Integer v = def;
+
+	if (lua_getfield(L, 3, key) != LUA_TNIL) {
+		if (!lua_isinteger(L, -1)) luaL_error(L, "option '%s' must be an integer", key);
+		v = lua_tointeger(L, -1);
+		if ((v < 0) || (v > (lua_Integer)UINT32_MAX)) luaL_error(L, "option '%s' is out of range", key);
+	}
+	lua_pop(L,1);
+	return (uint32_t)v;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Set up f from the source or sink at stack index 2: a path is opened, a
+ * Lua file is used from its current position and a function becomes the
+ * reader or writer.  Then read the options, attach the port and run the
+ * engine.  Returns true, bytes or nil, message.
+ */
+static int xmodem_run( lua_State *L, bool send )
+{
+	lua_xmodem_type x;
+	ym_file_type f;
+	ym_timing_type saved_timing;
+	ym_timing_type timing;
+	luaL_Stream *stream;
+	HANDLE saved;
+	bool owned = false;
+	uint32_t block, res;
+	int status;
+
+	lua_ext_serial_handle(L, 1);
+	lua_settop(L, 3);
+	if (!lua_isnil(L, 3)) luaL_checktype(L, 3, LUA_TTABLE);
+	else {
+		lua_newtable(L);
+		lua_replace(L, 3);
+	}
+	memset(&x, 0, sizeof(x));
+	memset(&f, 0, sizeof(f));
+	x.L = L;
+	x.send = send;
+	f.ctx = &x;
+
+	/* options, the timing of the engine is put back when the transfer ended */
+	ymodem_get_timing(&saved_timing);
+	timing = saved_timing;
+	timing.start_delay = xmodem_opt(L, "delay", 0);
+	timing.char_timeout = xmodem_opt(L, "timeout", saved_timing.char_timeout);
+	timing.handshake_timeout = xmodem_opt(L, "handshake", saved_timing.handshake_timeout);
+	timing.max_tries = xmodem_opt(L, "tries", saved_timing.max_tries);
+	block = xmodem_opt(L, "block", 1024);
+	luaL_argcheck(L, (block == 128)||(block == 1024), 3, "block must be 128 or 1024");
+	x.large = (block == 1024);
+	f.every = xmodem_opt(L, "every", XMODEM_EVERY);
+	lua_getfield(L, 3, "ascii");
+	x.ascii = lua_toboolean(L, -1);
+	lua_pop(L,1);
+	if (lua_getfield(L, 3, "progress") != LUA_TNIL) {
+		luaL_checktype(L, -1, LUA_TFUNCTION);
+		f.progress = xmodem_progress;
+	}
+	lua_pushliteral(L, "");      /* XMODEM_CHUNK */
+	lua_pushlightuserdata(L, &x);  /* XMODEM_STATE */
+	/* the engine gets the same stack, nothing is pushed after the file is open */
+	lua_pushcfunction(L, xmodem_engine);
+	for (int i = 1; i <= XMODEM_STATE; ++i) lua_pushvalue(L, i);
+
+	if (lua_isfunction(L, 2)) {
+		x.fn = 2;
+		f.read = xmodem_read;
+		f.write = xmodem_write;
+	}
+	else if ((stream = (luaL_Stream*)luaL_testudata(L, 2, LUA_FILEHANDLE)) != NULL) {
+		if (stream->closef == NULL) return luaL_error(L, "attempt to use a closed file");
+		f.fp = stream->f;
+		f.start = ftell(f.fp);
+	}
+	else {
+		const char *path = luaL_checkstring(L, 2);
+		if ((f.fp = fopen(path, (send) ? "rb" : "wb")) == NULL) return luaL_fileresult(L, 0, path);
+		owned = true;
+	}
+
+	saved = lua_ext_serial_attach(L, 1);
+	ymodem_set_timing(&timing);
+	ym_file_attach(&f);
+	status = lua_pcall(L, XMODEM_STATE, 0, 0);
+	res = x.res;
+	/* the file of a path is closed here, the one of a Lua file is left open */
+	if (owned) {
+		if ((fclose(f.fp) != 0) && !send) res = YM_RES_ERROR;
+	}
+	else if (f.fp != NULL) fflush(f.fp);
+	f.fp = NULL;
+	ym_file_attach(NULL);
+	ymodem_set_timing(&saved_timing);
+	ym_serial = saved;
+
+	if (status != LUA_OK) return lua_error(L);
+	if ((res == YM_RES_OK) || (!send && (res == YM_RES_END_OF_TRANSFER))) {
+		lua_pushboolean(L, true);
+		lua_pushinteger(L, (lua_Integer)f.bytes);
+		return 2;
+	}
+	lua_pushnil(L);
+	if (res == YM_RES_TIMEOUT) lua_pushliteral(L, "timeout");
+	else if ((res == YM_RES_CANCEL) || x.cancelled) lua_pushliteral(L, "cancelled");
+	else lua_pushliteral(L, "transfer failed");
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* ok, bytes = port:xmodem_send( path_or_reader, options ) */
+int lua_ext_xmodem_send( lua_State *L )
+{
+	return xmodem_run(L, true);
+}
+/* ------------------------------------------------------------------------ */
+/* ok, bytes = port:xmodem_receive( path_or_writer, options ) */
+int lua_ext_xmodem_receive( lua_State *L )
+{
+	return xmodem_run(L, false);
+}
+/* ------------------------------------------------------------------------ */
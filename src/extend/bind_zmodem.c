@@ -0,0 +1,241 @@
+/*
+ * bind_zmodem.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "serialport.h"
+#include "zmodem.h"
+#include "ym_file.h"
+
+#define LUA_EXT_ZMODEM        ("_ZMODEM_")
+
+/* user values of the transfer object */
+#define ZMODEM_UV_PORT        (1)     /**< serial port the transfer runs on */
+#define ZMODEM_UV_PROGRESS    (2)     /**< progress(name, offset, size) */
+
+typedef struct {
+	zm_options_type opt;
+	lua_State *L;         /**< state of the running transfer */
+	int progress;         /**< stack index of the progress function, 0 = none */
+	bool failed;          /**< the progress function raised an error */
+} lua_zmodem_type;
+
+extern HANDLE ym_serial;
+HANDLE lua_ext_serial_handle( lua_State *L, int n );
+HANDLE lua_ext_serial_attach( lua_State *L, int n );
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_zmodem(L,n)  ( (lua_zmodem_type*)luaL_checkudata(L,n,LUA_EXT_ZMODEM))
+
+/* Transfer =============================================================== */
+/* ------------------------------------------------------------------------ */
+/* engine progress callback, returning false cancels the transfer */
+static bool zmodem_progress( void *ctx, const char *name, uint32_t offset, uint32_t size )
+{
+	lua_zmodem_type *z = (lua_zmodem_type*)ctx;
+	lua_State *L = z->L;
+	bool go;
+
+	lua_pushvalue(L, z->progress);
+	lua_pushstring(L, name);
+	lua_pushinteger(L, (lua_Integer)offset);
+	if (size == YM_SIZE_UNKNOWN) lua_pushnil(L);
+	else lua_pushinteger(L, (lua_Integer)size);
+	if (lua_pcall(L, 3, 1, 0) != LUA_OK) {
+		/* keep the error on the stack, it is raised once the engine returns */
+		z->failed = true;
+		return false;
+	}
+	go = lua_isnil(L, -1) || lua_toboolean(L, -1);
+	lua_pop(L,1);
+	return go;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Run the engine on the object's port with the file stream f, then
+ * return true, files, bytes or nil, message.
+ */
+static int zmodem_run( lua_State *L, lua_zmodem_type *z, ym_file_type *f, bool send )
+{
+	HANDLE saved;
+	uint32_t res;
+
+	lua_getiuservalue(L, 1, ZMODEM_UV_PORT);
+	saved = lua_ext_serial_attach(L, -1);
+	lua_pop(L,1);
+
+	z->L = L;
+	z->failed = false;
+	z->progress = 0;
+	z->opt.progress = NULL;
+	z->opt.ctx = z;
+	if (lua_getiuservalue(L, 1, ZMODEM_UV_PROGRESS) == LUA_TFUNCTION) {
+		z->progress = lua_gettop(L);
+		z->opt.progress = zmodem_progress;
+	}
+
+	ym_file_attach(f);
+	res = (send) ? zmodem_send(&z->opt) : zmodem_receive(&z->opt);
+	ym_file_attach(NULL);
+	ym_serial = saved;
+
+	if (z->failed) return lua_error(L);
+	if (res == YM_RES_OK) {
+		lua_pushboolean(L, true);
+		lua_pushinteger(L, (lua_Integer)f->files);
+		lua_pushinteger(L, (lua_Integer)f->bytes);
+		return 3;
+	}
+	lua_pushnil(L);
+	if (res == YM_RES_TIMEOUT) lua_pushliteral(L, "timeout");
+	else if (res == YM_RES_CANCEL) lua_pushliteral(L, "cancelled");
+	else if (f->name[0] != 0) lua_pushfstring(L, "transfer of %s failed", f->name);
+	else lua_pushliteral(L, "transfer failed");
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* ok, files, bytes = z:send( path, ... ) or z:send{ path, ... } */
+static int zmodem_send_files( lua_State *L )
+{
+	lua_zmodem_type *z = lua_ext_get_zmodem(L, 1);
+	ym_file_type f;
+	const char **paths;
+	int count;
+
+	if (lua_istable(L, 2)) {
+		count = (int)luaL_len(L, 2);
+		for (int i = 1; i <= count; ++i) lua_geti(L, 2, i);
+		lua_remove(L, 2);
+		lua_settop(L, count + 1);
+	}
+	count = lua_gettop(L) - 1;
+	paths = (const char**)lua_newuserdatauv(L, sizeof(const char*) * ((count > 0)?count:1), 0);
+	for (int i = 0; i < count; ++i) paths[i] = luaL_checkstring(L, i + 2);
+
+	memset(&f, 0, sizeof(f));
+	f.paths = paths;
+	f.count = (uint32_t)count;
+	return zmodem_run(L, z, &f, true);
+}
+/* ------------------------------------------------------------------------ */
+/* ok, files, bytes = z:receive( dir ) */
+static int zmodem_receive_files( lua_State *L )
+{
+	lua_zmodem_type *z = lua_ext_get_zmodem(L, 1);
+	ym_file_type f;
+
+	memset(&f, 0, sizeof(f));
+	f.dir = luaL_optstring(L, 2, NULL);
+	f.resume = z->opt.resume;
+	return zmodem_run(L, z, &f, false);
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg zmodem_funcs[] = {
+		{"send", zmodem_send_files},
+		{"receive", zmodem_receive_files},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* z.field, methods first, then the options */
+static int zmodem_index( lua_State *L )
+{
+	lua_zmodem_type *z = lua_ext_get_zmodem(L, 1);
+	const char *key = lua_tostring(L, 2);
+
+	if (lua_getfield(L, lua_upvalueindex(1), (key != NULL)?key:"") != LUA_TNIL) return 1;
+	lua_pop(L,1);
+	if (key != NULL) {
+		if (strcmp(key, "window") == 0) { lua_pushinteger(L, z->opt.window); return 1; }
+		if (strcmp(key, "block") == 0) { lua_pushinteger(L, z->opt.block); return 1; }
+		if (strcmp(key, "timeout") == 0) { lua_pushinteger(L, z->opt.timeout); return 1; }
+		if (strcmp(key, "resume") == 0) { lua_pushboolean(L, z->opt.resume); return 1; }
+		if (strcmp(key, "progress") == 0) { lua_getiuservalue(L, 1, ZMODEM_UV_PROGRESS); return 1; }
+		if (strcmp(key, "port") == 0) { lua_getiuservalue(L, 1, ZMODEM_UV_PORT); return 1; }
+	}
+	lua_pushnil(L);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* set option key of the transfer object at stack index n to the value at v */
+static void zmodem_set( lua_State *L, int n, const char *key, int v )
+{
+	lua_zmodem_type *z = lua_ext_get_zmodem(L, n);
+
+	if (strcmp(key, "window") == 0) z->opt.window = (uint32_t)luaL_checkinteger(L, v);
+	else if (strcmp(key, "block") == 0) {
+		lua_Integer block = luaL_checkinteger(L, v);
+		luaL_argcheck(L, (block >= 32)&&(block <= 1024), v, "block must be 32..1024");
+		z->opt.block = (uint32_t)block;
+	}
+	else if (strcmp(key, "timeout") == 0) z->opt.timeout = (uint32_t)luaL_checkinteger(L, v);
+	else if (strcmp(key, "resume") == 0) z->opt.resume = lua_toboolean(L, v);
+	else if (strcmp(key, "progress") == 0) {
+		if (!lua_isnil(L, v)) luaL_checktype(L, v, LUA_TFUNCTION);
+		lua_pushvalue(L, v);
+		lua_setiuservalue(L, n, ZMODEM_UV_PROGRESS);
+	}
+	else luaL_error(L, "zmodem has no option '%s'", key);
+}
+/* ------------------------------------------------------------------------ */
+static int zmodem_newindex( lua_State *L )
+{
+	zmodem_set(L, 1, luaL_checkstring(L, 2), 3);
+	return 0;
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* z = zmodem.new( port, options ) */
+static int zmodem_new( lua_State *L )
+{
+	lua_zmodem_type *z;
+
+	lua_ext_serial_handle(L, 1);
+	z = (lua_zmodem_type*)lua_newuserdatauv(L, sizeof(lua_zmodem_type), 2);
+	memset(z, 0, sizeof(lua_zmodem_type));
+	zmodem_default_options(&z->opt);
+	luaL_setmetatable(L, LUA_EXT_ZMODEM);
+	lua_pushvalue(L, 1);
+	lua_setiuservalue(L, -2, ZMODEM_UV_PORT);
+
+	if (lua_istable(L, 2)) {
+		int n = lua_gettop(L);
+		lua_pushnil(L);
+		while (lua_next(L, 2)) {
+			luaL_argcheck(L, lua_type(L, -2) == LUA_TSTRING, 2, "option names must be strings");
+			zmodem_set(L, n, lua_tostring(L, -2), lua_gettop(L));
+			lua_pop(L,1);
+		}
+	}
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg zmodem_lib[] = {
+		{"new", zmodem_new},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_zmodem( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_ZMODEM);
+	luaL_newlib(L, zmodem_funcs);
+	lua_pushcclosure(L, zmodem_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, zmodem_newindex);
+	lua_setfield(L, -2, "__newindex");
+	lua_pop(L,1);
+
+	luaL_newlib(L, zmodem_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
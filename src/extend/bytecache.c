@@ -0,0 +1,261 @@
+/*
+ * bytecache.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "lua_ext_bytecache.h"
+
+#define BYTECACHE_PATH        (4096)
+#define BYTECACHE_KEY         (BYTECACHE_PATH * 2 + 128)
+
+static int bytecache_on = -1;        /**< -1 until the directory was looked up */
+static char bytecache_dir[ BYTECACHE_PATH - 32 ];  /**< room for the name of an entry */
+
+/* Entries ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* create the directory of the cache and its parents, only for this user */
+static void bytecache_mkdirs( void )
+{
+	char path[ BYTECACHE_PATH ];
+
+	snprintf(path, sizeof(path), "%s", bytecache_dir);
+	for (char *c = path + 1; ; ++c) {
+		if ((*c == '/')||(*c == '\\')||(*c == 0)) {
+			char end = *c;
+			*c = 0;
+#ifdef WIN32
+			_mkdir(path);
+#else
+			mkdir(path, 0700);
+#endif
+			if (end == 0) break;
+			*c = end;
+		}
+	}
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * The entries are loaded without verification, so the directory must be
+ * one that no other user can write to: it is created when it is missing
+ * and must be owned by this user and not writable by group or others.
+ */
+static bool bytecache_private( void )
+{
+#ifdef WIN32
+	struct _stat st;
+
+	if (_stat(bytecache_dir, &st) != 0) {
+		bytecache_mkdirs();
+		if (_stat(bytecache_dir, &st) != 0) return false;
+	}
+	return (st.st_mode & _S_IFDIR) != 0;
+#else
+	struct stat st;
+
+	if (stat(bytecache_dir, &st) != 0) {
+		bytecache_mkdirs();
+		if (stat(bytecache_dir, &st) != 0) return false;
+	}
+	if (!S_ISDIR(st.st_mode)) return false;
+	if ((st.st_uid != geteuid())||((st.st_mode & (S_IWGRP | S_IWOTH)) != 0)) {
+		fprintf(stderr, "xLua: %s is not a private directory, the bytecode cache is off\n", bytecache_dir);
+		return false;
+	}
+	return true;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+/* the directory of the cache, false when the cache is off */
+static bool bytecache_enabled( void )
+{
+	const char *dir, *sub;
+	int n;
+
+	if (bytecache_on >= 0) return bytecache_on != 0;
+	bytecache_on = 0;
+	if ((dir = getenv(BYTECACHE_VAR)) != NULL) {
+		if ((dir[0] == 0)||(strcmp(dir, "0") == 0)) return false;
+		sub = "";
+	}
+#ifdef WIN32
+	else if ((dir = getenv("LOCALAPPDATA")) != NULL) sub = "\\xlua";
+#else
+	else if (((dir = getenv("XDG_CACHE_HOME")) != NULL)&&(dir[0] != 0)) sub = "/xlua";
+	else if ((dir = getenv("HOME")) != NULL) sub = "/.cache/xlua";
+#endif
+	else return false;
+	n = snprintf(bytecache_dir, sizeof(bytecache_dir), "%s%s", dir, sub);
+	bytecache_on = ((n > 0)&&(n < (int)sizeof(bytecache_dir))&&bytecache_private());
+	return bytecache_on != 0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Key of the source fname in key and the path of its entry in entry.  The
+ * entry is named by a hash of the file and the name it is loaded as, so a
+ * changed file replaces its old entry.  Returns the length of the key or
+ * 0 when the file cannot be found, st is the file's status.
+ */
+static size_t bytecache_key( const char *fname, char *key, char *entry, struct stat *st )
+{
+	char full[ BYTECACHE_PATH ];
+	uint64_t hash = 14695981039346656037ULL;  /* FNV-1a */
+	long nsec = 0;
+	int n;
+
+#ifdef WIN32
+	if (_fullpath(full, fname, sizeof(full)) == NULL) return 0;
+#else
+	if (realpath(fname, full) == NULL) return 0;
+#endif
+	if (stat(full, st) != 0) return 0;
+#if defined(__linux__)
+	nsec = st->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+	nsec = st->st_mtimespec.tv_nsec;
+#endif
+	n = snprintf(key, BYTECACHE_KEY, "%s\n%s\n%lld.%09ld %lld\n%s\n", full, fname,
+			(long long)st->st_mtime, nsec, (long long)st->st_size, LUA_RELEASE);
+	if ((n <= 0)||(n >= BYTECACHE_KEY)) return 0;
+	for (const char *c = full; *c != 0; ++c) hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+	hash *= 1099511628211ULL;  /* a 0 between the two names */
+	for (const char *c = fname; *c != 0; ++c) hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+	snprintf(entry, BYTECACHE_PATH, "%s/%016llx.luac", bytecache_dir, (unsigned long long)hash);
+	return (size_t)n;
+}
+/* ------------------------------------------------------------------------ */
+/* load the chunk of entry when it starts with key, LUA_OK or the load error */
+static int bytecache_load( lua_State *L, const char *entry, const char *key, size_t klen, const char *fname )
+{
+	FILE *fp;
+	char *data;
+	long size;
+	int status = LUA_ERRFILE;
+
+	if ((fp = fopen(entry, "rb")) == NULL) return LUA_ERRFILE;
+	if ((fseek(fp, 0, SEEK_END) == 0)&&((size = ftell(fp)) > (long)klen)&&(fseek(fp, 0, SEEK_SET) == 0)) {
+		if ((data = (char*)malloc((size_t)size)) != NULL) {
+			if ((fread(data, 1, (size_t)size, fp) == (size_t)size)&&(memcmp(data, key, klen) == 0)) {
+				status = luaL_loadbufferx(L, data + klen, (size_t)size - klen, fname, "b");
+				if (status != LUA_OK) lua_pop(L,1);
+			}
+			free(data);
+		}
+	}
+	fclose(fp);
+	return status;
+}
+/* ------------------------------------------------------------------------ */
+static int bytecache_writer( lua_State *L, const void *p, size_t sz, void *ud )
+{
+	(void)L;
+	return (fwrite(p, 1, sz, (FILE*)ud) == sz) ? 0 : 1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Write the function at the top of the stack to entry.  It goes to a file
+ * of this process first that is renamed to the entry, any error leaves the
+ * cache as it was.
+ */
+static void bytecache_store( lua_State *L, const char *entry, const char *key, size_t klen )
+{
+	char tmp[ BYTECACHE_PATH + 32 ];
+	FILE *fp;
+	bool ok;
+
+#ifdef WIN32
+	snprintf(tmp, sizeof(tmp), "%s.%d.tmp", entry, _getpid());
+#else
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", entry, (long)getpid());
+#endif
+	if ((fp = fopen(tmp, "wb")) == NULL) return;
+	ok = (fwrite(key, 1, klen, fp) == klen);
+	ok = ok && (lua_dump(L, bytecache_writer, fp, 0) == 0);
+	ok = (fclose(fp) == 0) && ok;
+#ifdef WIN32
+	ok = ok && MoveFileExA(tmp, entry, MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && (rename(tmp, entry) == 0);
+#endif
+	if (!ok) remove(tmp);
+}
+/* ------------------------------------------------------------------------ */
+int bytecache_loadfile( lua_State *L, const char *fname )
+{
+	char key[ BYTECACHE_KEY ];
+	char entry[ BYTECACHE_PATH ];
+	struct stat st;
+	char name[ BYTECACHE_PATH + 1 ];
+	size_t klen;
+	int status;
+
+	if ((fname == NULL) || !bytecache_enabled()) return luaL_loadfile(L, fname);
+	if ((klen = bytecache_key(fname, key, entry, &st)) == 0) return luaL_loadfile(L, fname);
+	snprintf(name, sizeof(name), "@%s", fname);
+	if (bytecache_load(L, entry, key, klen, name) == LUA_OK) return LUA_OK;
+	if ((status = luaL_loadfile(L, fname)) != LUA_OK) return status;
+	/* a file changed in the last seconds can change again with the same mtime */
+	if ((time_t)st.st_mtime < time(NULL) - 1) bytecache_store(L, entry, key, klen);
+	return LUA_OK;
+}
+
+/* Searcher =============================================================== */
+/* ------------------------------------------------------------------------ */
+/* the Lua file searcher of loadlib.c, the chunk is loaded through the cache */
+static int bytecache_searcher( lua_State *L )
+{
+	const char *name = luaL_checkstring(L, 1);
+	const char *filename;
+
+	lua_getfield(L, lua_upvalueindex(1), "searchpath");
+	lua_pushvalue(L, 1);
+	if (lua_getfield(L, lua_upvalueindex(1), "path") != LUA_TSTRING)
+		return luaL_error(L, "'package.path' must be a string");
+	lua_call(L, 2, 2);
+	if (lua_isnil(L, -2)) return 1;  /* not found, the message is on the top */
+	lua_pop(L,1);
+	filename = lua_tostring(L, -1);
+	if (bytecache_loadfile(L, filename) == LUA_OK) {
+		lua_pushstring(L, filename);  /* 2nd argument to the module */
+		return 2;
+	}
+	return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+			name, filename, lua_tostring(L, -1));
+}
+/* ------------------------------------------------------------------------ */
+void bytecache_install( lua_State *L )
+{
+	if (!bytecache_enabled()) return;
+	luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+	if (lua_getfield(L, -1, LUA_LOADLIBNAME) == LUA_TTABLE) {
+		if (lua_getfield(L, -1, "searchers") == LUA_TTABLE) {
+			lua_pushvalue(L, -2);
+			lua_pushcclosure(L, bytecache_searcher, 1);
+			lua_rawseti(L, -2, 2);  /* in place of the Lua file searcher */
+		}
+		lua_pop(L,1);
+	}
+	lua_pop(L,2);
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,581 @@
+/*
+ * capture.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#ifndef WIN32
+#define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "capture.h"
+#include "lua_ext_time.h"
+
+#define LUA_EXT_REPLAY        ("_REPLAY_")
+
+/* user values of the replay object */
+#define REPLAY_UV_RECORDS     (1)     /**< record stream of the capture */
+
+struct capture_s {
+	capture_header_type *hdr;
+	uint8_t *ring;
+	size_t mapped;         /**< bytes of the mapping, header included */
+	int fd;
+	int64_t start;         /**< monotonic time of the start */
+	int64_t last_ns;       /**< time of the newest record, ns after the start */
+	uint64_t len_at;       /**< position of the length of the newest record */
+	uint32_t rec_len;      /**< bytes in the newest record */
+	bool tx;               /**< direction of the newest record */
+	bool open;             /**< bytes may still be added to the newest record */
+};
+
+/* replay of a capture through a pty */
+typedef struct {
+	int master;            /**< pty master, the application opens name */
+	int slave;             /**< kept open so the master does not hang up between opens */
+	char name[64];
+	const uint8_t *rec;    /**< record stream, oldest first */
+	uint32_t len;
+	uint32_t pos;          /**< next record in rec */
+	int64_t t0;            /**< capture time of the first record */
+	int64_t t;             /**< capture time of the current record */
+	/* current record */
+	bool have;             /**< it has been parsed */
+	bool tx;
+	const uint8_t *data;
+	uint32_t size;
+	uint32_t done;         /**< bytes of a received record written to the pty */
+	/* timing */
+	lua_Number speed;      /**< 1 = original timing, 0 = as fast as possible */
+	bool sync;             /**< wait for the application to send the captured bytes */
+	uint32_t timeout;      /**< ms the application may take for that */
+	int64_t start;         /**< monotonic time run() started */
+	int64_t offset;        /**< ns the schedule was moved by waiting for the application */
+	int64_t wait_until;    /**< deadline of the current wait for the application, 0 = none */
+	/* statistics */
+	lua_Integer sent, received, expected;
+} replay_type;
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_replay(L,n)   ( (replay_type*)luaL_checkudata(L,n,LUA_EXT_REPLAY))
+
+/* Writer ================================================================= */
+#ifndef WIN32
+/* ------------------------------------------------------------------------ */
+static void capture_put( capture_type *cap, const uint8_t *data, uint32_t size );
+/* ------------------------------------------------------------------------ */
+/* byte at ring position p */
+static uint8_t capture_at( const capture_type *cap, uint64_t p )
+{
+	return cap->ring[p % cap->hdr->size];
+}
+/* ------------------------------------------------------------------------ */
+/* LEB128 number at ring position *p */
+static uint64_t capture_varint( const capture_type *cap, uint64_t *p )
+{
+	uint64_t v = 0;
+	uint8_t c;
+
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		c = capture_at(cap, (*p)++);
+		v |= (uint64_t)(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) break;
+	}
+	return v;
+}
+/* ------------------------------------------------------------------------ */
+/* overwrite the oldest record, the next one becomes the tail */
+static void capture_drop( capture_type *cap )
+{
+	capture_header_type *h = cap->hdr;
+	uint64_t p = h->tail + 1;
+	uint32_t len;
+
+	capture_varint(cap, &p);
+	len = capture_at(cap, p) | ((uint32_t)capture_at(cap, p + 1) << 8);
+	h->tail = p + 2 + len;
+	if (h->tail < h->head) {
+		p = h->tail + 1;
+		h->tail_ns += (int64_t)capture_varint(cap, &p) * 1000;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* append to the ring, the oldest records make room */
+static void capture_put( capture_type *cap, const uint8_t *data, uint32_t size )
+{
+	capture_header_type *h = cap->hdr;
+	uint32_t at = (uint32_t)(h->head % h->size);
+	uint32_t n = h->size - at;
+
+	while (h->head + size - h->tail > h->size) capture_drop(cap);
+	if (n > size) n = size;
+	memcpy(&cap->ring[at], data, n);
+	memcpy(cap->ring, data + n, size - n);
+	h->head += size;
+}
+/* ------------------------------------------------------------------------ */
+/* start a record at now (ns after the start) */
+static void capture_begin( capture_type *cap, bool tx, int64_t now )
+{
+	capture_header_type *h = cap->hdr;
+	uint64_t dt = (now > cap->last_ns) ? (uint64_t)(now - cap->last_ns) / 1000 : 0;
+	uint8_t rec[16];
+	uint32_t n = 0;
+
+	/* the time is kept in us steps so the reader adds up to the same value */
+	cap->last_ns += (int64_t)dt * 1000;
+	rec[n++] = tx ? CAPTURE_TX : 0;
+	do {
+		rec[n++] = (uint8_t)((dt & 0x7F) | ((dt > 0x7F) ? 0x80 : 0));
+		dt >>= 7;
+	} while (dt > 0);
+	rec[n++] = 0;
+	rec[n++] = 0;
+	while (h->head + n - h->tail > h->size) capture_drop(cap);
+	if (h->tail == h->head) h->tail_ns = cap->last_ns;
+	cap->len_at = h->head + n - 2;
+	capture_put(cap, rec, n);
+	cap->rec_len = 0;
+	cap->tx = tx;
+	cap->open = true;
+}
+/* ------------------------------------------------------------------------ */
+capture_type *capture_create( const char *path, uint32_t size, const char *port, uint32_t baud )
+{
+	capture_type *cap;
+	int fd;
+	void *map;
+	size_t mapped = sizeof(capture_header_type) + size;
+
+	if (size < CAPTURE_MIN_SIZE) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) return NULL;
+	if ((ftruncate(fd, (off_t)mapped) != 0)||
+		((map = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+		int e = errno;
+		close(fd);
+		errno = e;
+		return NULL;
+	}
+	if ((cap = (capture_type*)calloc(1, sizeof(capture_type))) == NULL) {
+		munmap(map, mapped);
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	cap->hdr = (capture_header_type*)map;
+	cap->ring = (uint8_t*)map + sizeof(capture_header_type);
+	cap->mapped = mapped;
+	cap->fd = fd;
+	cap->start = time_now_ns();
+	memcpy(cap->hdr->magic, CAPTURE_MAGIC, sizeof(cap->hdr->magic));
+	cap->hdr->version = CAPTURE_VERSION;
+	cap->hdr->size = size;
+	cap->hdr->started = (int64_t)time(NULL);
+	cap->hdr->baud = baud;
+	strncpy(cap->hdr->port, (port != NULL) ? port : "", sizeof(cap->hdr->port) - 1);
+	return cap;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Log size bytes sent (tx) or received.  Bytes that follow within
+ * CAPTURE_MERGE_NS of a record's start in the same direction are added to
+ * it, so a protocol that reads byte by byte does not cost a record header
+ * for each byte.
+ */
+void capture_write( capture_type *cap, bool tx, const char *data, uint32_t size )
+{
+	int64_t now = time_now_ns() - cap->start;
+
+	while (size > 0) {
+		uint32_t n;
+
+		if (!cap->open || (cap->tx != tx) || (now - cap->last_ns >= CAPTURE_MERGE_NS)||
+			(cap->rec_len == CAPTURE_RECORD_MAX)) capture_begin(cap, tx, now);
+		n = CAPTURE_RECORD_MAX - cap->rec_len;
+		if (n > size) n = size;
+		capture_put(cap, (const uint8_t*)data, n);
+		cap->rec_len += n;
+		cap->ring[cap->len_at % cap->hdr->size] = (uint8_t)cap->rec_len;
+		cap->ring[(cap->len_at + 1) % cap->hdr->size] = (uint8_t)(cap->rec_len >> 8);
+		data += n;
+		size -= n;
+	}
+}
+/* ------------------------------------------------------------------------ */
+void capture_close( capture_type *cap )
+{
+	if (cap == NULL) return;
+	msync(cap->hdr, cap->mapped, MS_ASYNC);
+	munmap(cap->hdr, cap->mapped);
+	close(cap->fd);
+	free(cap);
+}
+#else
+/* ------------------------------------------------------------------------ */
+capture_type *capture_create( const char *path, uint32_t size, const char *port, uint32_t baud )
+{
+	(void)path; (void)size; (void)port; (void)baud;
+	errno = ENOSYS;
+	return NULL;
+}
+/* ------------------------------------------------------------------------ */
+void capture_write( capture_type *cap, bool tx, const char *data, uint32_t size )
+{
+	(void)cap; (void)tx; (void)data; (void)size;
+}
+/* ------------------------------------------------------------------------ */
+void capture_close( capture_type *cap )
+{
+	(void)cap;
+}
+#endif
+
+/* Reader ================================================================= */
+/* ------------------------------------------------------------------------ */
+/*
+ * Push the records of the capture file at path as one string, oldest
+ * first, and return it; t0 is the time of the first record.  Raises an
+ * error when the file is not a capture.
+ */
+static const uint8_t *capture_load( lua_State *L, const char *path, uint32_t *len, int64_t *t0 )
+{
+	capture_header_type h;
+	FILE *fp = fopen(path, "rb");
+	luaL_Buffer b;
+	uint32_t at, n;
+	char *p;
+
+	if (fp == NULL) luaL_error(L, "%s: %s", path, strerror(errno));
+	if ((fread(&h, sizeof(h), 1, fp) != 1)||(memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic)) != 0)||
+		(h.version != CAPTURE_VERSION)||(h.head < h.tail)||(h.head - h.tail > h.size)) {
+		fclose(fp);
+		luaL_error(L, "%s: not a capture file", path);
+	}
+	*len = (uint32_t)(h.head - h.tail);
+	*t0 = h.tail_ns;
+	at = (uint32_t)(h.tail % h.size);
+	n = (*len < h.size - at) ? *len : h.size - at;
+	p = luaL_buffinitsize(L, &b, *len);
+	if ((fseek(fp, (long)(sizeof(h) + at), SEEK_SET) != 0)||(fread(p, 1, n, fp) != n)||
+		(fseek(fp, (long)sizeof(h), SEEK_SET) != 0)||(fread(p + n, 1, *len - n, fp) != *len - n)) {
+		fclose(fp);
+		luaL_error(L, "%s: capture file is truncated", path);
+	}
+	fclose(fp);
+	luaL_pushresultsize(&b, *len);
+	return (const uint8_t*)lua_tostring(L, -1);
+}
+/* ------------------------------------------------------------------------ */
+/* parse the record at *pos, false at the end or when the record is damaged */
+static bool capture_next( const uint8_t *rec, uint32_t len, uint32_t *pos, bool *tx, int64_t *dt, const uint8_t **data, uint32_t *size )
+{
+	uint32_t p = *pos;
+	uint64_t v = 0;
+
+	if (p + 1 >= len) return false;
+	*tx = (rec[p++] & CAPTURE_TX) != 0;
+	for (uint32_t shift = 0; (p < len)&&(shift < 64); shift += 7) {
+		v |= (uint64_t)(rec[p] & 0x7F) << shift;
+		if ((rec[p++] & 0x80) == 0) break;
+	}
+	if (p + 2 > len) return false;
+	*size = rec[p] | ((uint32_t)rec[p + 1] << 8);
+	p += 2;
+	if (p + *size > len) return false;
+	*dt = (int64_t)v * 1000;
+	*data = &rec[p];
+	*pos = p + *size;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* iterator of records(), the upvalues are the records, position and time */
+static int capture_records_next( lua_State *L )
+{
+	size_t len;
+	const uint8_t *rec = (const uint8_t*)lua_tolstring(L, lua_upvalueindex(1), &len);
+	uint32_t pos = (uint32_t)lua_tointeger(L, lua_upvalueindex(2));
+	int64_t t = (int64_t)lua_tointeger(L, lua_upvalueindex(3));
+	const uint8_t *data;
+	uint32_t size;
+	int64_t dt;
+	bool tx;
+
+	if (!capture_next(rec, (uint32_t)len, &pos, &tx, &dt, &data, &size)) return 0;
+	/* the first record is at t0, its delta belongs to a record that was overwritten */
+	if (lua_tointeger(L, lua_upvalueindex(2)) != 0) t += dt;
+	lua_pushinteger(L, pos);
+	lua_replace(L, lua_upvalueindex(2));
+	lua_pushinteger(L, (lua_Integer)t);
+	lua_replace(L, lua_upvalueindex(3));
+	lua_pushnumber(L, (lua_Number)t / (lua_Number)TIME_NS_PER_MS);
+	lua_pushstring(L, tx ? "tx" : "rx");
+	lua_pushlstring(L, (const char*)data, size);
+	return 3;
+}
+/* ------------------------------------------------------------------------ */
+/* for ms, dir, data in capture.records( path ) do ... end */
+static int capture_records( lua_State *L )
+{
+	uint32_t len;
+	int64_t t0;
+
+	capture_load(L, luaL_checkstring(L, 1), &len, &t0);
+	lua_pushinteger(L, 0);
+	lua_pushinteger(L, (lua_Integer)t0);
+	lua_pushcclosure(L, capture_records_next, 3);
+	return 1;
+}
+
+/* Replay ================================================================= */
+#ifndef WIN32
+/* ------------------------------------------------------------------------ */
+static int replay_run_k( lua_State *L, int status, lua_KContext ctx );
+/* ------------------------------------------------------------------------ */
+/* monotonic time the current record is due */
+static int64_t replay_due( const replay_type *r )
+{
+	int64_t due = r->start + r->offset;
+
+	if (r->speed > 0) due += (int64_t)((lua_Number)(r->t - r->t0) / r->speed);
+	return due;
+}
+/* ------------------------------------------------------------------------ */
+/* wait for the pty or the deadline, a task of time.run() yields meanwhile */
+static void replay_wait( lua_State *L, replay_type *r, int events, int64_t deadline )
+{
+	struct pollfd pfd;
+	int64_t left = deadline - time_now_ns();
+
+	if (left <= 0) return;
+	time_wait_io(L, r->master, events, deadline, replay_run_k);
+	pfd.fd = r->master;
+	pfd.events = (events & TIME_IO_WRITE) ? POLLOUT : POLLIN;
+	pfd.revents = 0;
+	poll(&pfd, 1, (int)((left + TIME_NS_PER_MS - 1) / TIME_NS_PER_MS));
+}
+/* ------------------------------------------------------------------------ */
+/* run() until the last record was replayed, all state is in the object */
+static int replay_run_k( lua_State *L, int status, lua_KContext ctx )
+{
+	replay_type *r = lua_ext_get_replay(L, 1);
+	uint8_t sink[256];
+
+	(void)status;
+	(void)ctx;
+	for (;;) {
+		ssize_t n;
+		int64_t now, dt;
+
+		/* what the application sends is counted and dropped */
+		while ((n = read(r->master, sink, sizeof(sink))) > 0) r->received += n;
+		if (!r->have) {
+			bool first = (r->pos == 0);
+			if (!capture_next(r->rec, r->len, &r->pos, &r->tx, &dt, &r->data, &r->size)) break;
+			r->t = first ? r->t0 : r->t + dt;
+			r->have = true;
+			r->done = 0;
+			r->wait_until = 0;
+			if (r->tx) r->expected += r->size;
+		}
+		now = time_now_ns();
+		if (r->tx) {
+			if (r->sync && (r->received < r->expected)) {
+				if (r->wait_until == 0) r->wait_until = now + (int64_t)r->timeout * TIME_NS_PER_MS;
+				if (now >= r->wait_until) goto timeout;
+				replay_wait(L, r, TIME_IO_READ, r->wait_until);
+				continue;
+			}
+			/* an application slower than the device moves the rest of the schedule */
+			if (r->sync && (now > replay_due(r))) r->offset += now - replay_due(r);
+			r->have = false;
+			continue;
+		}
+		if (now < replay_due(r)) {
+			replay_wait(L, r, TIME_IO_READ, replay_due(r));
+			continue;
+		}
+		n = write(r->master, r->data + r->done, r->size - r->done);
+		if (n > 0) {
+			r->done += (uint32_t)n;
+			r->wait_until = 0;
+		}
+		if (r->done < r->size) {
+			/* the application does not read, the pty is full */
+			if (r->wait_until == 0) r->wait_until = now + (int64_t)r->timeout * TIME_NS_PER_MS;
+			if (now >= r->wait_until) goto timeout;
+			replay_wait(L, r, TIME_IO_WRITE, r->wait_until);
+			continue;
+		}
+		r->sent += r->size;
+		r->have = false;
+	}
+	lua_pushinteger(L, r->sent);
+	lua_pushinteger(L, r->received);
+	return 2;
+
+timeout:
+	lua_pushnil(L);
+	lua_pushliteral(L, "timeout");
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * sent, received = r:run()
+ * Write the received records of the capture to the pty at their time,
+ * divided by speed, and count what the application sends.  With sync the
+ * replay waits up to timeout ms for the application to send as many bytes
+ * as the capture did before going on, nil, "timeout" when it does not.
+ */
+static int replay_run( lua_State *L )
+{
+	replay_type *r = lua_ext_get_replay(L, 1);
+	size_t len;
+
+	if (r->master < 0) return luaL_error(L, "replay is closed");
+	lua_settop(L, 1);
+	lua_getiuservalue(L, 1, REPLAY_UV_RECORDS);
+	r->rec = (const uint8_t*)lua_tolstring(L, -1, &len);
+	r->len = (uint32_t)len;
+	lua_pop(L,1);
+	r->pos = 0;
+	r->have = false;
+	r->start = time_now_ns();
+	r->offset = 0;
+	r->sent = r->received = r->expected = 0;
+	return replay_run_k(L, LUA_OK, 0);
+}
+/* ------------------------------------------------------------------------ */
+static int replay_close( lua_State *L )
+{
+	replay_type *r = lua_ext_get_replay(L, 1);
+
+	if (r->master >= 0) close(r->master);
+	if (r->slave >= 0) close(r->slave);
+	r->master = r->slave = -1;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg replay_funcs[] = {
+		{"run", replay_run},
+		{"close", replay_close},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* r.field, methods first, then the pty name, options and counters */
+static int replay_index( lua_State *L )
+{
+	replay_type *r = lua_ext_get_replay(L, 1);
+	const char *key = lua_tostring(L, 2);
+
+	if (lua_getfield(L, lua_upvalueindex(1), (key != NULL)?key:"") != LUA_TNIL) return 1;
+	lua_pop(L,1);
+	if (key != NULL) {
+		if (strcmp(key, "name") == 0) { lua_pushstring(L, r->name); return 1; }
+		if (strcmp(key, "speed") == 0) { lua_pushnumber(L, r->speed); return 1; }
+		if (strcmp(key, "sync") == 0) { lua_pushboolean(L, r->sync); return 1; }
+		if (strcmp(key, "sent") == 0) { lua_pushinteger(L, r->sent); return 1; }
+		if (strcmp(key, "received") == 0) { lua_pushinteger(L, r->received); return 1; }
+		if (strcmp(key, "expected") == 0) { lua_pushinteger(L, r->expected); return 1; }
+	}
+	lua_pushnil(L);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* r = capture.replay( path, {speed = 1, sync = false, timeout = 5000} ) */
+static int capture_replay( lua_State *L )
+{
+	const char *path = luaL_checkstring(L, 1);
+	replay_type *r;
+	struct termios tio;
+	uint32_t len;
+	int64_t t0;
+
+	r = (replay_type*)lua_newuserdatauv(L, sizeof(replay_type), 1);
+	memset(r, 0, sizeof(replay_type));
+	r->master = r->slave = -1;
+	r->speed = 1;
+	r->timeout = 5000;
+	luaL_setmetatable(L, LUA_EXT_REPLAY);
+	if (lua_istable(L, 2)) {
+		if (lua_getfield(L, 2, "speed") != LUA_TNIL) r->speed = luaL_checknumber(L, -1);
+		if (lua_getfield(L, 2, "sync") != LUA_TNIL) r->sync = lua_toboolean(L, -1);
+		if (lua_getfield(L, 2, "timeout") != LUA_TNIL) r->timeout = (uint32_t)luaL_checkinteger(L, -1);
+		lua_pop(L,3);
+	}
+	luaL_argcheck(L, r->speed >= 0, 2, "speed must not be negative");
+	capture_load(L, path, &len, &t0);
+	r->t0 = t0;
+	lua_setiuservalue(L, -2, REPLAY_UV_RECORDS);
+
+	if (((r->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0)||(grantpt(r->master) != 0)||
+		(unlockpt(r->master) != 0)||(ptsname_r(r->master, r->name, sizeof(r->name)) != 0)||
+		((r->slave = open(r->name, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0)) {
+		int e = errno;
+		replay_close(L);
+		return luaL_error(L, "replay pty: %s", strerror(e));
+	}
+	/* raw until the application sets its own mode, the data must not be echoed or translated */
+	if (tcgetattr(r->slave, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(r->slave, TCSANOW, &tio);
+	}
+	fcntl(r->master, F_SETFL, fcntl(r->master, F_GETFL) | O_NONBLOCK);
+	return 1;
+}
+#else
+/* ------------------------------------------------------------------------ */
+static int capture_replay( lua_State *L )
+{
+	return luaL_error(L, "capture.replay() needs a pty, it is not supported on this platform");
+}
+#endif
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg capture_lib[] = {
+		{"records", capture_records},
+		{"replay", capture_replay},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_capture( lua_State *L )
+{
+#ifndef WIN32
+	luaL_newmetatable(L, LUA_EXT_REPLAY);
+	luaL_newlib(L, replay_funcs);
+	lua_pushcclosure(L, replay_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, replay_close);
+	lua_setfield(L, -2, "__gc");
+	lua_pushcfunction(L, replay_close);
+	lua_setfield(L, -2, "__close");
+	lua_pop(L,1);
+#endif
+
+	luaL_newlib(L, capture_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,65 @@
+/*
+ * capture.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef SRC_EXTEND_CAPTURE_H_
+#define SRC_EXTEND_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Types ------------------------------------------------------------------ */
+/*
+ * A capture file is a header followed by a ring of records, the ring is
+ * mapped into memory so logging is a copy and never waits for the disk.
+ * Once the ring is full the oldest records are overwritten.  A record is
+ *
+ *   flags (1 byte, CAPTURE_TX), time since the previous record in us
+ *   (LEB128), length (2 bytes, little endian), data
+ *
+ * the first record that was kept is at tail_ns.  All other fields are in
+ * the byte order of the host that wrote the file.
+ */
+typedef struct {
+    char     magic[8];       /* CAPTURE_MAGIC */
+    uint32_t version;
+    uint32_t size;           /* bytes in the ring that follows the header */
+    uint64_t head;           /* bytes written since the start, the ring position is head % size */
+    uint64_t tail;           /* start of the oldest record that was not overwritten */
+    int64_t  tail_ns;        /* time of that record, ns after the start */
+    int64_t  started;        /* wall clock of the start, s since the epoch */
+    uint32_t baud;
+    uint32_t reserved;
+    char     port[72];
+} capture_header_type;
+
+typedef struct capture_s capture_type;
+
+/* Definitions and constants ============================================== */
+#define CAPTURE_MAGIC           ("SERCAP\r\n")
+#define CAPTURE_VERSION         (1)
+#define CAPTURE_TX              (0x01)      /* record flag, sent by us; received otherwise */
+#define CAPTURE_DEFAULT_SIZE    (1048576)
+#define CAPTURE_MIN_SIZE        (65536)
+#define CAPTURE_RECORD_MAX      (4096)      /* longer writes and reads are split */
+#define CAPTURE_MERGE_NS        (1000000)   /* bytes within 1 ms of a record's start join it */
+
+/* Public API ------------------------------------------------------------- */
+
+/* NULL with errno set when the file cannot be created and mapped */
+capture_type *capture_create( const char *path, uint32_t size, const char *port, uint32_t baud );
+void capture_write( capture_type *cap, bool tx, const char *data, uint32_t size );
+void capture_close( capture_type *cap );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_EXTEND_CAPTURE_H_ */
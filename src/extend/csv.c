@@ -0,0 +1,479 @@
+/*
+ * csv.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define LUA_EXT_CSV           ("_CSV_")
+
+/* Uservalues of a reader */
+#define CSV_SOURCE            (1)   /**< the string being parsed (ccsv.new) */
+#define CSV_KEYS              (2)   /**< column number -> row key, false to skip */
+
+/* Word at a time search, 8 bytes per step */
+#define SWAR_ONES             (0x0101010101010101ULL)
+#define SWAR_HIGH             (0x8080808080808080ULL)
+#define swar_zero(v)          ( ((v) - SWAR_ONES) & ~(v) & SWAR_HIGH )
+#define swar_byte(v,c)        swar_zero((v) ^ (SWAR_ONES*(uint8_t)(c)))
+
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	const char *start;
+	size_t len;
+	const char *tail;      /**< text after the closing quote of a quoted field */
+	size_t tail_len;
+	bool quoted;           /**< contains "" pairs to collapse */
+} csv_field_type;
+
+/*
+ * A reader walks a memory mapped file (or a Lua string) one record at a
+ * time, so only the current row is ever converted to Lua strings.
+ */
+typedef struct {
+	const char *data;
+	size_t len;
+	size_t pos;
+	size_t start;          /**< first record, after the BOM */
+	uint32_t row;          /**< data rows read, for error messages */
+	char delim;
+	bool ignore_quotes;
+	bool mapped;
+	bool closed;
+	bool keyed;            /**< keys() was called, rows are keyed by header */
+	bool ignore_extra;     /**< extra columns are dropped, not an error */
+	uint32_t headers;      /**< number of header keys */
+	uint32_t columns;      /**< fields a row must have */
+	csv_field_type *field;
+	uint32_t count;
+	uint32_t cap;
+#ifdef WIN32
+	HANDLE file;
+	HANDLE map;
+#endif
+} csv_reader_type;
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_reader(L,n)  ( (csv_reader_type*)luaL_checkudata(L,n,LUA_EXT_CSV))
+
+/* File Mapping =========================================================== */
+/* ------------------------------------------------------------------------ */
+static bool csv_map( csv_reader_type *r, const char *path )
+{
+#ifdef WIN32
+	LARGE_INTEGER size;
+
+	r->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (r->file == INVALID_HANDLE_VALUE) return false;
+	if (!GetFileSizeEx(r->file, &size)) {
+		CloseHandle(r->file);
+		return false;
+	}
+	r->len = (size_t)size.QuadPart;
+	r->mapped = true;
+	if (r->len == 0) return true;
+	r->map = CreateFileMappingA(r->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (r->map != NULL) r->data = (const char*)MapViewOfFile(r->map, FILE_MAP_READ, 0, 0, 0);
+	if (r->data == NULL) {
+		if (r->map != NULL) CloseHandle(r->map);
+		CloseHandle(r->file);
+		r->mapped = false;
+		return false;
+	}
+	return true;
+#else
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) return false;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	r->len = (size_t)st.st_size;
+	r->mapped = true;
+	if (r->len > 0) {
+		void *p = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			r->mapped = false;
+			return false;
+		}
+		madvise(p, r->len, MADV_SEQUENTIAL);
+		r->data = (const char*)p;
+	}
+	close(fd);
+	return true;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+static void csv_unmap( csv_reader_type *r )
+{
+	if (!r->mapped) return;
+#ifdef WIN32
+	if (r->data != NULL) UnmapViewOfFile((void*)r->data);
+	if (r->map != NULL) CloseHandle(r->map);
+	CloseHandle(r->file);
+#else
+	if (r->data != NULL) munmap((void*)r->data, r->len);
+#endif
+	r->mapped = false;
+	r->data = NULL;
+	r->len = 0;
+}
+
+/* Record Scanner ========================================================= */
+/* ------------------------------------------------------------------------ */
+/* end of an unquoted field: the delimiter, CR or LF */
+static const char *csv_scan( const char *p, const char *end, char delim )
+{
+	while (end - p >= 8) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		if (swar_byte(v,delim) | swar_byte(v,'\n') | swar_byte(v,'\r')) break;
+		p += 8;
+	}
+	while ((p < end)&&(*p != delim)&&(*p != '\n')&&(*p != '\r')) ++p;
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+static csv_field_type *csv_add_field( lua_State *L, csv_reader_type *r )
+{
+	if (r->count == r->cap) {
+		uint32_t cap = (r->cap == 0)?32:r->cap*2;
+		csv_field_type *p = (csv_field_type*)realloc(r->field, cap*sizeof(csv_field_type));
+		if (p == NULL) luaL_error(L, "ftcsv: not enough memory");
+		r->field = p;
+		r->cap = cap;
+	}
+	csv_field_type *f = &r->field[r->count++];
+	memset((void*)f,0,sizeof(csv_field_type));
+	return f;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Split the next record into fields, returns false at the end of the data.
+ * Quoted fields may hold delimiters, line breaks and "" pairs; the quote
+ * search uses memchr(), which the C libraries vectorize.
+ */
+static bool csv_record( lua_State *L, csv_reader_type *r )
+{
+	const char *p = r->data + r->pos;
+	const char *end = r->data + r->len;
+
+	r->count = 0;
+	if (p >= end) return false;
+	for (;;) {
+		csv_field_type *f = csv_add_field(L, r);
+
+		if ((!r->ignore_quotes)&&(p < end)&&(*p == '"')) {
+			const char *q = ++p;
+			for (;;) {
+				q = (const char*)memchr(q, '"', end - q);
+				if (q == NULL) {
+					luaL_error(L, "ftcsv: can't find closing quote in row %d. Try running with the option ignoreQuotes=true if the source incorrectly uses quotes.", (int)r->row + 1);
+				}
+				if ((q + 1 < end)&&(q[1] == '"')) {
+					f->quoted = true;
+					q += 2;
+				}
+				else break;
+			}
+			f->start = p;
+			f->len = q - p;
+			p = q + 1;
+			if ((p < end)&&(*p != r->delim)&&(*p != '\n')&&(*p != '\r')) {
+				/* text after the closing quote is kept, quote included */
+				f->tail = q;
+				p = csv_scan(p, end, r->delim);
+				f->tail_len = p - q;
+			}
+		}
+		else {
+			f->start = p;
+			p = csv_scan(p, end, r->delim);
+			f->len = p - f->start;
+		}
+
+		if (p >= end) break;
+		if (*p == r->delim) {
+			++p;
+			continue;
+		}
+		if ((*p == '\r')&&(p + 1 < end)&&(p[1] == '\n')) ++p;
+		++p;
+		break;
+	}
+	r->pos = p - r->data;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static void csv_push_field( lua_State *L, csv_field_type *f )
+{
+	if ((!f->quoted)&&(f->tail == NULL)) {
+		lua_pushlstring(L, f->start, f->len);
+		return;
+	}
+	luaL_Buffer b;
+	const char *p = f->start;
+	const char *end = f->start + f->len;
+	luaL_buffinit(L, &b);
+	while (p < end) {
+		const char *q = (const char*)memchr(p, '"', end - p);
+		if (q == NULL) q = end;
+		else ++q;  /* keep one quote of the pair */
+		luaL_addlstring(&b, p, q - p);
+		p = (q < end)?q + 1:end;
+	}
+	if (f->tail != NULL) luaL_addlstring(&b, f->tail, f->tail_len);
+	luaL_pushresult(&b);
+}
+/* ------------------------------------------------------------------------ */
+/* fill the table at index t with the record, keyed by header when set */
+static void csv_fill( lua_State *L, csv_reader_type *r, int t, int keys )
+{
+	if (!r->keyed) {
+		for (uint32_t indx = 0;indx<r->count;++indx) {
+			csv_push_field(L, &r->field[indx]);
+			lua_rawseti(L, t, (lua_Integer)indx + 1);
+		}
+		return;
+	}
+	for (uint32_t indx = 0;indx<r->count;++indx) {
+		if (indx >= r->headers) {
+			if (r->ignore_extra) break;
+			luaL_error(L, "ftcsv: too many columns in row %d", (int)r->row);
+		}
+		if (lua_rawgeti(L, keys, (lua_Integer)indx + 1) == LUA_TBOOLEAN) {
+			lua_pop(L,1);
+			continue;
+		}
+		csv_push_field(L, &r->field[indx]);
+		lua_rawset(L, t);
+	}
+	if (r->count < r->columns) luaL_error(L, "ftcsv: too few columns in row %d", (int)r->row);
+}
+/* ------------------------------------------------------------------------ */
+static void csv_check( lua_State *L, csv_reader_type *r )
+{
+	if (r->closed) luaL_error(L, "ftcsv: attempt to use a closed reader");
+}
+
+/* Lua Interface ========================================================== */
+/* ------------------------------------------------------------------------ */
+static csv_reader_type *csv_new_reader( lua_State *L, int delim, int opts )
+{
+	size_t len;
+	const char *d = luaL_optlstring(L, delim, ",", &len);
+
+	luaL_argcheck(L, len == 1, delim, "the delimiter must be exactly one character");
+	csv_reader_type *r = (csv_reader_type*)lua_newuserdatauv(L, sizeof(csv_reader_type), 2);
+	memset((void*)r,0,sizeof(csv_reader_type));
+	r->delim = d[0];
+	if (lua_istable(L,opts)) {
+		lua_getfield(L, opts, "ignoreQuotes");
+		r->ignore_quotes = lua_toboolean(L,-1);
+		lua_pop(L,1);
+	}
+	luaL_setmetatable(L, LUA_EXT_CSV);
+	return r;
+}
+/* ------------------------------------------------------------------------ */
+/* skip a UTF-8 byte order mark */
+static void csv_bom( csv_reader_type *r )
+{
+	if ((r->len >= 3)&&(memcmp(r->data, "\xEF\xBB\xBF", 3) == 0)) r->start = 3;
+	r->pos = r->start;
+}
+/* ------------------------------------------------------------------------ */
+/* reader = ccsv.open( filename, delimiter, opts ) */
+static int csv_open( lua_State *L )
+{
+	const char *path = luaL_checkstring(L,1);
+	csv_reader_type *r = csv_new_reader(L, 2, 3);
+
+	if (!csv_map(r, path)) return luaL_error(L, "ftcsv: File not found at %s", path);
+	csv_bom(r);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* reader = ccsv.new( text, delimiter, opts ) */
+static int csv_new( lua_State *L )
+{
+	size_t len;
+	const char *text = luaL_checklstring(L,1,&len);
+	csv_reader_type *r = csv_new_reader(L, 2, 3);
+
+	r->data = text;
+	r->len = len;
+	lua_pushvalue(L,1);
+	lua_setiuservalue(L, -2, CSV_SOURCE);
+	csv_bom(r);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * reader:keys( keys, columns, ignore_extra )
+ * keys[n] is the row key for column n (false to drop the column), columns
+ * the number of fields a row must have.
+ */
+static int csv_keys( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L,1);
+
+	luaL_checktype(L,2,LUA_TTABLE);
+	r->columns = (uint32_t)luaL_checkinteger(L,3);
+	r->ignore_extra = lua_toboolean(L,4);
+	r->headers = (uint32_t)lua_rawlen(L,2);
+	r->keyed = true;
+	r->row = 0;
+	lua_settop(L,2);
+	lua_setiuservalue(L, 1, CSV_KEYS);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* row = reader:read( row ), fills (or creates) the row table, nil at the end */
+static int csv_read( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L,1);
+
+	csv_check(L,r);
+	lua_settop(L,2);
+	if (!csv_record(L, r)) {
+		lua_pushnil(L);
+		return 1;
+	}
+	++r->row;
+	if (lua_isnil(L,2)) {
+		lua_createtable(L, r->keyed?0:(int)r->count, r->keyed?(int)r->headers:0);
+		lua_replace(L,2);
+	}
+	else luaL_checktype(L,2,LUA_TTABLE);
+	lua_getiuservalue(L, 1, CSV_KEYS);
+	csv_fill(L, r, 2, 3);
+	lua_settop(L,2);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int csv_rows_next( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L, lua_upvalueindex(1));
+
+	csv_check(L,r);
+	lua_settop(L,0);
+	if (!csv_record(L, r)) {
+		if (lua_toboolean(L, lua_upvalueindex(3))) csv_unmap(r);
+		return 0;
+	}
+	++r->row;
+	lua_pushinteger(L, (lua_Integer)r->row);
+	lua_pushvalue(L, lua_upvalueindex(2));
+	if (lua_isnil(L,-1)) {
+		lua_pop(L,1);
+		lua_createtable(L, r->keyed?0:(int)r->count, r->keyed?(int)r->headers:0);
+	}
+	lua_getiuservalue(L, lua_upvalueindex(1), CSV_KEYS);
+	csv_fill(L, r, 2, 3);
+	lua_settop(L,2);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * for n, row in reader:rows( reuse, close ) do ... end
+ * With reuse set every row is written into the same table, with close
+ * set the file is unmapped when the last row has been read.
+ */
+static int csv_rows( lua_State *L )
+{
+	lua_ext_get_reader(L,1);
+	lua_settop(L,3);
+	if (lua_toboolean(L,2)) lua_newtable(L);
+	else lua_pushnil(L);
+	lua_replace(L,2);
+	lua_pushboolean(L, lua_toboolean(L,3));
+	lua_replace(L,3);
+	lua_pushcclosure(L, csv_rows_next, 3);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* go back to the first record, the row count restarts */
+static int csv_rewind( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L,1);
+
+	csv_check(L,r);
+	r->pos = r->start;
+	r->row = 0;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static int csv_size( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L,1);
+	lua_pushinteger(L, (lua_Integer)r->len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int csv_close( lua_State *L )
+{
+	csv_reader_type *r = lua_ext_get_reader(L,1);
+
+	csv_unmap(r);
+	free(r->field);
+	r->field = NULL;
+	r->count = r->cap = 0;
+	r->data = NULL;
+	r->len = r->pos = 0;
+	r->closed = true;
+	return 0;
+}
+
+static const luaL_Reg csv_funcs[] = {
+		{"keys", csv_keys},
+		{"read", csv_read},
+		{"rows", csv_rows},
+		{"rewind", csv_rewind},
+		{"size", csv_size},
+		{"close", csv_close},
+		{NULL, NULL}
+};
+
+static const luaL_Reg csv_lib[] = {
+		{"open", csv_open},
+		{"new", csv_new},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_ccsv( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_CSV);
+	lua_pushcfunction(L, csv_close);
+	lua_setfield(L, -2, "__gc");
+	luaL_newlibtable(L, csv_funcs);
+	luaL_setfuncs(L, csv_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newlib(L, csv_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
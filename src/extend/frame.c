@@ -0,0 +1,748 @@
+/*
+ * frame.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "ymodem.h"
+#include "lua_ext_time.h"
+
+#define LUA_EXT_FRAMER        ("_FRAMER_")
+#define LUA_EXT_FRAMEVIEW     ("_FRAMEVIEW_")
+
+#define FRAME_QUEUE           (64)    /**< decoded frames waiting for next() */
+#define FRAME_DEFAULT_MAX     (1024)
+
+/* SLIP, RFC 1055 */
+#define SLIP_END              (0xC0)
+#define SLIP_ESC              (0xDB)
+#define SLIP_ESC_END          (0xDC)
+#define SLIP_ESC_ESC          (0xDD)
+
+enum { FRAME_COBS, FRAME_SLIP, FRAME_LENGTH };
+static const char *const frame_kinds[] = { "cobs", "slip", "length", NULL };
+
+/* a decoded frame in the ring */
+typedef struct {
+	uint32_t begin;        /**< first byte the frame occupies, header included */
+	uint32_t pos;          /**< first payload byte */
+	uint32_t len;          /**< payload bytes */
+} frame_slot_type;
+
+/*
+ * Positions count up from 0 and wrap with uint32_t, byte p lives at
+ * buf[p % size].  Received bytes are appended at end and decoded in place
+ * from raw: the payload of a COBS or SLIP frame is never longer than its
+ * encoding, so the decoder writes at wr behind the bytes it reads and the
+ * payload ends up in the ring without another buffer.  The ring holds the
+ * frame handed out last, the queued ones, the frame being decoded in
+ * [start, wr) and the input not decoded yet in [raw, end).  Decoding stops
+ * while the queue is full, so no input is lost until the ring is.
+ */
+typedef struct {
+	int kind;
+	uint32_t size;         /**< bytes in the ring */
+	uint32_t max;          /**< largest payload */
+	bool crc;              /**< frames end with a CRC-16 of the payload */
+	uint32_t width;        /**< bytes of the length field of "length" frames */
+	int sync;              /**< byte that starts a "length" frame, -1 = none */
+	uint32_t start, wr, raw, end;
+	/* decoder state */
+	uint32_t left;         /**< COBS: data bytes left in the block */
+	bool zero;             /**< COBS: the block is followed by a zero */
+	bool open;             /**< a frame has started */
+	bool esc;              /**< SLIP: the last byte was ESC */
+	bool hunt;             /**< drop bytes up to the next delimiter */
+	/* frames */
+	frame_slot_type q[ FRAME_QUEUE ];
+	uint32_t qhead, qtail;
+	frame_slot_type cur;   /**< frame of the views handed out */
+	bool held;             /**< cur is in use */
+	uint32_t gen;          /**< counts up when cur is released */
+	/* statistics */
+	lua_Integer received, errors, dropped;
+	uint8_t buf[];
+} framer_type;
+
+/* a zero copy view of a frame, valid until the framer releases it */
+typedef struct {
+	framer_type *f;
+	uint32_t gen;
+	uint32_t pos;
+	uint32_t len;
+} frameview_type;
+
+uint32_t lua_ext_serial_read( lua_State *L, int n, char *buffer, uint32_t size, int64_t deadline, lua_KFunction k, int *status );
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_framer(L,n)   ( (framer_type*)luaL_checkudata(L,n,LUA_EXT_FRAMER))
+#define frame_at(f,p)             ( (f)->buf[(p) % (f)->size] )
+
+/* Decoder ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* bytes of the ring in use */
+static uint32_t frame_used( const framer_type *f )
+{
+	uint32_t base = f->start;
+
+	if (f->held) base = f->cur.begin;
+	else if (f->qhead != f->qtail) base = f->q[f->qtail % FRAME_QUEUE].begin;
+	return f->end - base;
+}
+/* ------------------------------------------------------------------------ */
+/* throw away the frame being decoded, hunt for the next delimiter */
+static void frame_drop( framer_type *f, bool hunt )
+{
+	f->dropped += (lua_Integer)(f->wr - f->start);
+	f->wr = f->start;
+	f->left = 0;
+	f->zero = false;
+	f->open = false;
+	f->esc = false;
+	f->hunt = hunt;
+}
+/* ------------------------------------------------------------------------ */
+/* a bad frame, at a delimiter the next one starts right away */
+static void frame_error( framer_type *f, bool at_delimiter )
+{
+	++f->errors;
+	frame_drop(f, !at_delimiter);
+}
+/* ------------------------------------------------------------------------ */
+/* store a decoded byte, false when the frame is too long */
+static bool frame_put( framer_type *f, uint8_t c )
+{
+	if ((f->wr - f->start) >= f->max + ((f->crc) ? 2 : 0)) {
+		frame_error(f, false);
+		return false;
+	}
+	frame_at(f, f->wr++) = c;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* queue the payload [begin + skip, end - trailer) as a frame */
+static void frame_push( framer_type *f, uint32_t begin, uint32_t skip, uint32_t end )
+{
+	uint32_t len = end - begin - skip;
+	frame_slot_type *s;
+
+	if (f->crc) {
+		uint8_t crc[2];
+		uint32_t sum = 0;
+
+		if (len < 2) {
+			++f->errors;
+			return;
+		}
+		len -= 2;
+		/* the CRC may be split by the end of the ring */
+		for (uint32_t p = begin + skip, n; p != begin + skip + len; p += n) {
+			n = f->size - p % f->size;
+			if (n > begin + skip + len - p) n = begin + skip + len - p;
+			sum = ymodem_crc16(&frame_at(f, p), n, sum);
+		}
+		crc[0] = frame_at(f, begin + skip + len);
+		crc[1] = frame_at(f, begin + skip + len + 1);
+		if (sum != (((uint32_t)crc[0] << 8) | crc[1])) {
+			++f->errors;
+			return;
+		}
+	}
+	s = &f->q[f->qhead++ % FRAME_QUEUE];
+	s->begin = begin;
+	s->pos = begin + skip;
+	s->len = len;
+	++f->received;
+}
+/* ------------------------------------------------------------------------ */
+/* the frame at start is complete, queue it and start the next one */
+static void frame_end( framer_type *f )
+{
+	frame_push(f, f->start, 0, f->wr);
+	f->start = f->wr;
+	f->left = 0;
+	f->zero = false;
+	f->open = false;
+	f->esc = false;
+}
+/* ------------------------------------------------------------------------ */
+/* COBS: a code byte n is followed by n-1 data bytes and, for n < 0xFF, a zero */
+static void frame_cobs( framer_type *f, uint8_t c )
+{
+	if (c == 0) {
+		if (f->hunt) f->hunt = false;
+		else if (f->left != 0) frame_error(f, true);
+		else if (f->open) frame_end(f);
+		return;
+	}
+	if (f->hunt) return;
+	if (f->left == 0) {
+		if (f->zero && !frame_put(f, 0)) return;
+		f->zero = (c != 0xFF);
+		f->left = c - 1;
+		f->open = true;
+	}
+	else if (frame_put(f, c)) --f->left;
+}
+/* ------------------------------------------------------------------------ */
+static void frame_slip( framer_type *f, uint8_t c )
+{
+	if (c == SLIP_END) {
+		if (f->hunt) f->hunt = false;
+		else if (f->esc) frame_error(f, true);
+		else if (f->wr != f->start) frame_end(f);
+		return;
+	}
+	if (f->hunt) return;
+	if (f->esc) {
+		f->esc = false;
+		if (c == SLIP_ESC_END) c = SLIP_END;
+		else if (c == SLIP_ESC_ESC) c = SLIP_ESC;
+		else {
+			frame_error(f, false);
+			return;
+		}
+	}
+	else if (c == SLIP_ESC) {
+		f->esc = true;
+		return;
+	}
+	frame_put(f, c);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * [sync] length payload [crc], the length counts the payload only.  A bad
+ * length or CRC drops one byte and looks for a frame at the next one.
+ */
+static void frame_length( framer_type *f )
+{
+	uint32_t header = f->width + ((f->sync >= 0) ? 1 : 0);
+	uint32_t trailer = (f->crc) ? 2 : 0;
+
+	while ((f->wr != f->start) && ((f->qhead - f->qtail) < FRAME_QUEUE)) {
+		uint32_t avail = f->wr - f->start;
+		uint32_t len = 0;
+		uint32_t errors;
+
+		if ((f->sync >= 0) && (frame_at(f, f->start) != (uint8_t)f->sync)) {
+			++f->start;
+			++f->dropped;
+			continue;
+		}
+		if (avail < header) break;
+		for (uint32_t i = header - f->width; i < header; ++i) len = (len << 8) | frame_at(f, f->start + i);
+		if (len > f->max) {
+			++f->errors;
+			++f->start;
+			++f->dropped;
+			continue;
+		}
+		if (avail < header + len + trailer) break;
+		errors = (uint32_t)f->errors;
+		frame_push(f, f->start, header, f->start + header + len + trailer);
+		if ((uint32_t)f->errors != errors) {
+			++f->start;
+			++f->dropped;
+			continue;
+		}
+		f->start += header + len + trailer;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* decode the input in the ring until it is used up or the queue is full */
+static void frame_decode( framer_type *f )
+{
+	if (f->kind == FRAME_LENGTH) {
+		/* the frames are sent as they are, only their bounds are found */
+		f->raw = f->wr = f->end;
+		frame_length(f);
+		return;
+	}
+	while ((f->raw != f->end) && ((f->qhead - f->qtail) < FRAME_QUEUE)) {
+		uint8_t c = frame_at(f, f->raw++);
+
+		if (f->kind == FRAME_COBS) frame_cobs(f, c);
+		else frame_slip(f, c);
+	}
+	/* the input is used up, the next one goes right after the decoded bytes */
+	if (f->raw == f->end) f->raw = f->end = f->wr;
+}
+/* ------------------------------------------------------------------------ */
+/* append as much of data to the input as fits, returns the bytes taken */
+static uint32_t frame_append( framer_type *f, const uint8_t *data, uint32_t n )
+{
+	uint32_t room = f->size - frame_used(f);
+	uint32_t p = f->end % f->size;
+
+	if (n > room) n = room;
+	if (p + n > f->size) {
+		memcpy(&f->buf[p], data, f->size - p);
+		memcpy(f->buf, data + (f->size - p), n - (f->size - p));
+	}
+	else memcpy(&f->buf[p], data, n);
+	f->end += n;
+	return n;
+}
+/* ------------------------------------------------------------------------ */
+/* the views of the last frame expire, its bytes are free again */
+static void frame_release( framer_type *f )
+{
+	++f->gen;
+	f->held = false;
+}
+/* ------------------------------------------------------------------------ */
+/* hand out the next queued frame as a view, or nil */
+static int frame_push_next( lua_State *L, framer_type *f, int self )
+{
+	frameview_type *v;
+
+	if (f->qhead == f->qtail) {
+		lua_pushnil(L);
+		return 1;
+	}
+	f->cur = f->q[f->qtail++ % FRAME_QUEUE];
+	f->held = true;
+	v = (frameview_type*)lua_newuserdatauv(L, sizeof(frameview_type), 1);
+	v->f = f;
+	v->gen = f->gen;
+	v->pos = f->cur.pos;
+	v->len = f->cur.len;
+	luaL_setmetatable(L, LUA_EXT_FRAMEVIEW);
+	/* keep the framer alive while the view is */
+	lua_pushvalue(L, self);
+	lua_setiuservalue(L, -2, 1);
+	return 1;
+}
+
+/* Framer ================================================================= */
+/* ------------------------------------------------------------------------ */
+/* n = f:feed( data ), decode received bytes, returns the frames waiting */
+static int frame_feed( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+	size_t n;
+	const char *data = luaL_checklstring(L, 2, &n);
+
+	frame_decode(f);
+	while (n > 0) {
+		uint32_t taken = frame_append(f, (const uint8_t*)data, (uint32_t)n);
+
+		frame_decode(f);
+		if (taken == 0) break;
+		data += taken;
+		n -= taken;
+	}
+	/* the ring is full of frames nobody took */
+	f->dropped += (lua_Integer)n;
+	lua_pushinteger(L, (lua_Integer)(f->qhead - f->qtail));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* view = f:next(), the views of the previous frame expire */
+static int frame_next( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+
+	frame_release(f);
+	return frame_push_next(L, f, 1);
+}
+/* ------------------------------------------------------------------------ */
+/* frames() iterator, the data (upvalue 1) is taken from offset (upvalue 2) as the frames are */
+static int frame_iter( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+	size_t n;
+	const char *data = lua_tolstring(L, lua_upvalueindex(1), &n);
+	size_t offset = (size_t)lua_tointeger(L, lua_upvalueindex(2));
+
+	frame_release(f);
+	frame_decode(f);
+	while ((f->qhead == f->qtail) && (offset < n)) {
+		uint32_t taken = frame_append(f, (const uint8_t*)data + offset, (uint32_t)(n - offset));
+
+		frame_decode(f);
+		offset += taken;
+		if (taken == 0) {
+			/* only a frame longer than the ring can get here */
+			f->dropped += (lua_Integer)(n - offset);
+			offset = n;
+		}
+	}
+	lua_pushinteger(L, (lua_Integer)offset);
+	lua_replace(L, lua_upvalueindex(2));
+	return frame_push_next(L, f, 1);
+}
+/* ------------------------------------------------------------------------ */
+/* for view in f:frames( data ) do ... end, decodes data as the loop goes */
+static int frame_frames( lua_State *L )
+{
+	lua_ext_get_framer(L, 1);
+	luaL_optstring(L, 2, "");
+	lua_settop(L, 2);
+	if (lua_isnil(L, 2)) lua_pushliteral(L, "");
+	else lua_pushvalue(L, 2);
+	lua_pushinteger(L, 0);
+	lua_pushcclosure(L, frame_iter, 2);
+	lua_pushvalue(L, 1);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* f:read() until a frame is complete or the deadline at stack index 4 passed */
+static int frame_read_k( lua_State *L, int status, lua_KContext ctx )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+	int64_t deadline = (int64_t)lua_tointeger(L, 4);
+
+	(void)ctx;
+	frame_decode(f);
+	while (f->qhead == f->qtail) {
+		uint32_t room = f->size - frame_used(f);
+		uint8_t *p = &frame_at(f, f->end);
+		uint32_t br;
+
+		if (room > f->size - f->end % f->size) room = f->size - f->end % f->size;
+		/* the port's buffered bytes, else wait for the first byte and take what else is there */
+		br = lua_ext_serial_read(L, 2, (char*)p, room, deadline, frame_read_k, &status);
+		if (br == 0) {
+			lua_pushnil(L);
+			lua_pushliteral(L, "timeout");
+			return 2;
+		}
+		f->end += br;
+		frame_decode(f);
+	}
+	return frame_push_next(L, f, 1);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * view = f:read( port, timeout ), the bytes are read from the port straight
+ * into the ring until a frame is complete.  Returns nil, "timeout" when no
+ * frame arrived within timeout ms; a task of time.run() yields meanwhile.
+ */
+static int frame_read( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+
+	lua_settop(L, 3);
+	frame_release(f);
+	lua_pushinteger(L, (lua_Integer)time_now_ns() + luaL_optinteger(L, 3, 1000) * TIME_NS_PER_MS);
+	return frame_read_k(L, LUA_OK, 0);
+}
+/* ------------------------------------------------------------------------ */
+static void frame_add_slip( luaL_Buffer *b, uint8_t c )
+{
+	if (c == SLIP_END) {
+		luaL_addchar(b, (char)SLIP_ESC);
+		luaL_addchar(b, (char)SLIP_ESC_END);
+	}
+	else if (c == SLIP_ESC) {
+		luaL_addchar(b, (char)SLIP_ESC);
+		luaL_addchar(b, (char)SLIP_ESC_ESC);
+	}
+	else luaL_addchar(b, (char)c);
+}
+/* ------------------------------------------------------------------------ */
+/* s = f:encode( payload ), the payload as one frame on the wire */
+static int frame_encode( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+	size_t n;
+	const uint8_t *data = (const uint8_t*)luaL_checklstring(L, 2, &n);
+	uint8_t crc[2];
+	uint32_t total = (uint32_t)n + ((f->crc) ? 2 : 0);
+	luaL_Buffer b;
+
+	luaL_argcheck(L, n <= f->max, 2, "payload is longer than max");
+	if (f->crc) {
+		uint32_t sum = ymodem_crc16(data, (uint32_t)n, 0);
+		crc[0] = (uint8_t)(sum >> 8);
+		crc[1] = (uint8_t)sum;
+	}
+	luaL_buffinit(L, &b);
+	if (f->kind == FRAME_COBS) {
+		/* worst case one code byte per 254 data bytes */
+		char *out = luaL_prepbuffsize(&b, total + total / 254 + 2);
+		uint32_t code = 0, w = 1;
+
+		for (uint32_t i = 0; i < total; ++i) {
+			uint8_t c = (i < n) ? data[i] : crc[i - n];
+			if (c != 0) {
+				out[w++] = (char)c;
+				if (w - code < 0xFF) continue;
+			}
+			/* a zero or a full block closes the block */
+			out[code] = (char)(w - code);
+			code = w++;
+		}
+		out[code] = (char)(w - code);
+		out[w++] = 0;
+		luaL_addsize(&b, w);
+	}
+	else if (f->kind == FRAME_SLIP) {
+		luaL_addchar(&b, (char)SLIP_END);
+		for (size_t i = 0; i < n; ++i) frame_add_slip(&b, data[i]);
+		if (f->crc) {
+			frame_add_slip(&b, crc[0]);
+			frame_add_slip(&b, crc[1]);
+		}
+		luaL_addchar(&b, (char)SLIP_END);
+	}
+	else {
+		if (f->sync >= 0) luaL_addchar(&b, (char)f->sync);
+		for (uint32_t i = f->width; i > 0; --i) luaL_addchar(&b, (char)(n >> (8 * (i - 1))));
+		luaL_addlstring(&b, (const char*)data, n);
+		if (f->crc) luaL_addlstring(&b, (const char*)crc, 2);
+	}
+	luaL_pushresult(&b);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* drop everything that was received, all views expire */
+static int frame_reset( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+
+	f->qtail = f->qhead;
+	f->raw = f->end;
+	f->start = f->wr = f->end;
+	frame_drop(f, false);
+	frame_release(f);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg frame_funcs[] = {
+		{"feed", frame_feed},
+		{"next", frame_next},
+		{"frames", frame_frames},
+		{"read", frame_read},
+		{"encode", frame_encode},
+		{"reset", frame_reset},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* f.field, methods first, then the state and the counters */
+static int frame_index( lua_State *L )
+{
+	framer_type *f = lua_ext_get_framer(L, 1);
+	const char *key = lua_tostring(L, 2);
+
+	if (lua_getfield(L, lua_upvalueindex(1), (key != NULL)?key:"") != LUA_TNIL) return 1;
+	lua_pop(L,1);
+	if (key != NULL) {
+		if (strcmp(key, "kind") == 0) { lua_pushstring(L, frame_kinds[f->kind]); return 1; }
+		if (strcmp(key, "max") == 0) { lua_pushinteger(L, f->max); return 1; }
+		if (strcmp(key, "size") == 0) { lua_pushinteger(L, f->size); return 1; }
+		if (strcmp(key, "pending") == 0) { lua_pushinteger(L, f->qhead - f->qtail); return 1; }
+		if (strcmp(key, "received") == 0) { lua_pushinteger(L, f->received); return 1; }
+		if (strcmp(key, "errors") == 0) { lua_pushinteger(L, f->errors); return 1; }
+		if (strcmp(key, "dropped") == 0) { lua_pushinteger(L, f->dropped); return 1; }
+	}
+	lua_pushnil(L);
+	return 1;
+}
+
+/* Frame views ============================================================ */
+/* ------------------------------------------------------------------------ */
+static frameview_type *frame_get_view( lua_State *L, int n )
+{
+	frameview_type *v = (frameview_type*)luaL_checkudata(L, n, LUA_EXT_FRAMEVIEW);
+	if (v->gen != v->f->gen) luaL_error(L, "frame view has expired");
+	return v;
+}
+/* ------------------------------------------------------------------------ */
+/* Lua string positions i..j of a view of len bytes, 0 based, false if empty */
+static bool frame_range( lua_State *L, int n, uint32_t len, lua_Integer def_j, uint32_t *from, uint32_t *to )
+{
+	lua_Integer i = luaL_optinteger(L, n, 1);
+	lua_Integer j = luaL_optinteger(L, n + 1, def_j);
+
+	if (i < 0) i = (lua_Integer)len + i + 1;
+	if (j < 0) j = (lua_Integer)len + j + 1;
+	if (i < 1) i = 1;
+	if (j > (lua_Integer)len) j = (lua_Integer)len;
+	if (i > j) return false;
+	*from = (uint32_t)(i - 1);
+	*to = (uint32_t)j;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static void frame_push_bytes( lua_State *L, const frameview_type *v, uint32_t from, uint32_t to )
+{
+	framer_type *f = v->f;
+	uint32_t p = (v->pos + from) % f->size;
+	uint32_t n = to - from;
+	luaL_Buffer b;
+
+	luaL_buffinit(L, &b);
+	if (p + n > f->size) {
+		luaL_addlstring(&b, (const char*)&f->buf[p], f->size - p);
+		n -= f->size - p;
+		p = 0;
+	}
+	luaL_addlstring(&b, (const char*)&f->buf[p], n);
+	luaL_pushresult(&b);
+}
+/* ------------------------------------------------------------------------ */
+/* s = view:sub( i, j ), like string.sub */
+static int frameview_sub( lua_State *L )
+{
+	frameview_type *v = frame_get_view(L, 1);
+	uint32_t from, to;
+
+	if (!frame_range(L, 2, v->len, -1, &from, &to)) lua_pushliteral(L, "");
+	else frame_push_bytes(L, v, from, to);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* ... = view:byte( i, j ), like string.byte */
+static int frameview_byte( lua_State *L )
+{
+	frameview_type *v = frame_get_view(L, 1);
+	lua_Integer i = luaL_optinteger(L, 2, 1);
+	uint32_t from, to;
+
+	if (!frame_range(L, 2, v->len, i, &from, &to)) return 0;
+	luaL_checkstack(L, (int)(to - from), "frame slice too long");
+	for (uint32_t k = from; k < to; ++k) lua_pushinteger(L, frame_at(v->f, v->pos + k));
+	return (int)(to - from);
+}
+/* ------------------------------------------------------------------------ */
+/* n = view:uint( i, size, little ), an unsigned integer of size bytes at i */
+static int frameview_uint( lua_State *L )
+{
+	frameview_type *v = frame_get_view(L, 1);
+	lua_Integer i = luaL_checkinteger(L, 2);
+	lua_Integer size = luaL_optinteger(L, 3, 1);
+	bool little = lua_toboolean(L, 4);
+	lua_Unsigned value = 0;
+
+	luaL_argcheck(L, (size >= 1) && (size <= 8), 3, "size must be 1..8");
+	luaL_argcheck(L, (i >= 1) && (i + size - 1 <= (lua_Integer)v->len), 2, "out of the frame");
+	for (lua_Integer k = 0; k < size; ++k) {
+		uint32_t p = v->pos + (uint32_t)(i - 1 + ((little) ? size - 1 - k : k));
+		value = (value << 8) | frame_at(v->f, p);
+	}
+	lua_pushinteger(L, (lua_Integer)value);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int frameview_len( lua_State *L )
+{
+	lua_pushinteger(L, frame_get_view(L, 1)->len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int frameview_tostring( lua_State *L )
+{
+	frameview_type *v = frame_get_view(L, 1);
+
+	frame_push_bytes(L, v, 0, v->len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg frameview_funcs[] = {
+		{"sub", frameview_sub},
+		{"byte", frameview_byte},
+		{"uint", frameview_uint},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* view[i] is the byte at i, other keys are the methods */
+static int frameview_index( lua_State *L )
+{
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		frameview_type *v = frame_get_view(L, 1);
+		lua_Integer i = luaL_checkinteger(L, 2);
+
+		if ((i >= 1) && (i <= (lua_Integer)v->len)) lua_pushinteger(L, frame_at(v->f, v->pos + (uint32_t)(i - 1)));
+		else lua_pushnil(L);
+		return 1;
+	}
+	lua_getfield(L, lua_upvalueindex(1), luaL_checkstring(L, 2));
+	return 1;
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+static lua_Integer frame_opt_integer( lua_State *L, const char *key, lua_Integer def )
+{
+	lua_Integer v = def;
+
+	if (lua_getfield(L, 2, key) != LUA_TNIL) v = luaL_checkinteger(L, -1);
+	lua_pop(L,1);
+	return v;
+}
+/* ------------------------------------------------------------------------ */
+/* f = frame.new( kind, options ) */
+static int frame_new( lua_State *L )
+{
+	int kind = luaL_checkoption(L, 1, NULL, frame_kinds);
+	lua_Integer max = FRAME_DEFAULT_MAX;
+	lua_Integer size, width = 2, sync = -1;
+	bool crc = (kind == FRAME_LENGTH);
+	framer_type *f;
+
+	if (!lua_isnoneornil(L, 2)) {
+		luaL_checktype(L, 2, LUA_TTABLE);
+		max = frame_opt_integer(L, "max", max);
+		width = frame_opt_integer(L, "width", width);
+		sync = frame_opt_integer(L, "sync", sync);
+		if (lua_getfield(L, 2, "crc") != LUA_TNIL) crc = lua_toboolean(L, -1);
+		lua_pop(L,1);
+	}
+	luaL_argcheck(L, (max >= 1) && (max <= 0x1000000), 2, "max must be 1..16M");
+	luaL_argcheck(L, (width >= 1) && (width <= 4), 2, "width must be 1..4");
+	luaL_argcheck(L, (sync >= -1) && (sync <= 255), 2, "sync must be a byte");
+	if (width < 4) luaL_argcheck(L, max < ((lua_Integer)1 << (8 * width)), 2, "max does not fit the length field");
+	/* the frame handed out, a full one in decoding and some queued */
+	size = (lua_isnoneornil(L, 2)) ? 0 : frame_opt_integer(L, "size", 0);
+	if (size < 4 * (max + 8)) size = 4 * (max + 8);
+
+	f = (framer_type*)lua_newuserdatauv(L, sizeof(framer_type) + (size_t)size, 0);
+	memset(f, 0, sizeof(framer_type));
+	f->kind = kind;
+	f->size = (uint32_t)size;
+	f->max = (uint32_t)max;
+	f->crc = crc;
+	f->width = (uint32_t)width;
+	f->sync = (int)sync;
+	luaL_setmetatable(L, LUA_EXT_FRAMER);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg frame_lib[] = {
+		{"new", frame_new},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_frame( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_FRAMER);
+	luaL_newlib(L, frame_funcs);
+	lua_pushcclosure(L, frame_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newmetatable(L, LUA_EXT_FRAMEVIEW);
+	luaL_newlib(L, frameview_funcs);
+	lua_pushcclosure(L, frameview_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, frameview_len);
+	lua_setfield(L, -2, "__len");
+	lua_pushcfunction(L, frameview_tostring);
+	lua_setfield(L, -2, "__tostring");
+	lua_pop(L,1);
+
+	luaL_newlib(L, frame_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,157 @@
+/*
+ * hexdump.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define DUMP_DEFAULT_WIDTH   (16)
+#define DUMP_MAX_WIDTH       (256)
+
+/* ANSI colors used when the dump is rendered for ansi() */
+#define DUMP_ANSI_OFFSET     "{c6}"
+#define DUMP_ANSI_HEX        "{c14}"
+#define DUMP_ANSI_ASCII      "{c7}"
+
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	uint32_t width;      /**< bytes per line */
+	bool     ascii;      /**< add the ASCII column */
+	bool     ansi;       /**< add color commands for ansi() */
+	bool     offset;     /**< prefix each line with the address */
+	uint64_t address;    /**< address of the first byte */
+	luaL_Buffer *bfr;
+	FILE *fp;
+} dump_opts_type;
+
+static const char dump_digits[] = "0123456789ABCDEF";
+
+/* ------------------------------------------------------------------------ */
+static void dump_emit( dump_opts_type *o, const char *s, size_t len )
+{
+	if (o->fp != NULL) fwrite(s, 1, len, o->fp);
+	else luaL_addlstring(o->bfr, s, len);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Render one line into a local buffer and emit it.  The layout is the one
+ * used by app:show_bin(), "[XX]" for each byte, then two spaces and the
+ * printable characters.  A short last line is padded so the ASCII column
+ * lines up.
+ */
+static void dump_line( dump_opts_type *o, const uint8_t *data, uint32_t len )
+{
+	char line[DUMP_MAX_WIDTH*7 + 64];
+	char *p = line;
+
+	if (o->offset) {
+		if (o->ansi) { memcpy(p, DUMP_ANSI_OFFSET, 4); p += 4; }
+		for (int shift = 28;shift>=0;shift -= 4) *p++ = dump_digits[(o->address>>shift)&0xF];
+		*p++ = ':';
+		*p++ = ' ';
+	}
+	if (o->ansi) { memcpy(p, DUMP_ANSI_HEX, 5); p += 5; }
+	for (uint32_t indx = 0;indx<len;++indx) {
+		p[0] = '[';
+		p[1] = dump_digits[data[indx]>>4];
+		p[2] = dump_digits[data[indx]&0xF];
+		p[3] = ']';
+		p += 4;
+	}
+	if (o->ascii) {
+		for (uint32_t indx = len;indx<o->width;++indx) {
+			memcpy(p, "    ", 4);
+			p += 4;
+		}
+		*p++ = ' ';
+		*p++ = ' ';
+		if (o->ansi) { memcpy(p, DUMP_ANSI_ASCII, 4); p += 4; }
+		for (uint32_t indx = 0;indx<len;++indx) {
+			char c = ((data[indx] >= 32)&&(data[indx] < 127))?(char)data[indx]:'.';
+			*p++ = c;
+			if ((o->ansi)&&(c == '{')) *p++ = '{';  /* escape for ansi() */
+		}
+	}
+	*p++ = '\n';
+	dump_emit(o, line, p-line);
+	o->address += len;
+}
+/* ------------------------------------------------------------------------ */
+static void dump_all( dump_opts_type *o, const uint8_t *data, size_t len )
+{
+	if (len == 0) {
+		dump_line(o, data, 0);
+		return;
+	}
+	while (len > 0) {
+		uint32_t n = (len > o->width)?o->width:(uint32_t)len;
+		dump_line(o, data, n);
+		data += n;
+		len -= n;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* read the options table at index n */
+static void dump_options( lua_State *L, int n, dump_opts_type *o )
+{
+	memset((void*)o,0,sizeof(dump_opts_type));
+	o->width = DUMP_DEFAULT_WIDTH;
+	o->ascii = true;
+	if (lua_isnoneornil(L,n)) return;
+	luaL_checktype(L,n,LUA_TTABLE);
+
+	lua_getfield(L,n,"width");
+	o->width = (uint32_t)luaL_optinteger(L,-1,DUMP_DEFAULT_WIDTH);
+	if ((o->width < 1)||(o->width > DUMP_MAX_WIDTH))
+		luaL_error(L,"width must be 1 to %d bytes", DUMP_MAX_WIDTH);
+	lua_getfield(L,n,"ascii");
+	o->ascii = lua_isnil(L,-1) || lua_toboolean(L,-1);
+	lua_getfield(L,n,"ansi");
+	o->ansi = lua_toboolean(L,-1);
+	lua_getfield(L,n,"offset");
+	o->offset = !lua_isnil(L,-1);
+	o->address = (uint64_t)luaL_optinteger(L,-1,0);
+	lua_pop(L,4);
+}
+/* ------------------------------------------------------------------------ */
+/* str = hexdump( data, opts ) */
+int ext_hexdump( lua_State *L )
+{
+	size_t len;
+	const char *data = luaL_checklstring(L,1,&len);
+	dump_opts_type o;
+	luaL_Buffer bfr;
+
+	dump_options(L, 2, &o);
+	luaL_buffinit(L, &bfr);
+	o.bfr = &bfr;
+	dump_all(&o, (const uint8_t*)data, len);
+	luaL_pushresult(&bfr);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* hexdump_write( file, data, opts ), returns the address after the data */
+int ext_hexdump_write( lua_State *L )
+{
+	luaL_Stream *p = (luaL_Stream*)luaL_checkudata(L, 1, LUA_FILEHANDLE);
+	size_t len;
+	const char *data = luaL_checklstring(L,2,&len);
+	dump_opts_type o;
+
+	if (p->closef == NULL) return luaL_error(L,"attempt to use a closed file");
+	dump_options(L, 3, &o);
+	o.fp = p->f;
+	dump_all(&o, (const uint8_t*)data, len);
+	lua_pushinteger(L, (lua_Integer)o.address);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
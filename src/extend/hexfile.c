@@ -0,0 +1,762 @@
+/*
+ * hexfile.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define HEX_DEFAULT_BASE      (0x8000000)  /**< default base, same as utilities.bin2hex */
+#define HEX_DEFAULT_LINE      (16)         /**< data bytes per record */
+#define HEX_MAX_LINE          (600)        /**< longest record text accepted */
+
+/* Intel HEX record types */
+#define IHEX_DATA             (0x00)
+#define IHEX_EOF              (0x01)
+#define IHEX_EXT_SEGMENT      (0x02)
+#define IHEX_START_SEGMENT    (0x03)
+#define IHEX_EXT_LINEAR       (0x04)
+#define IHEX_START_LINEAR     (0x05)
+
+#define LUA_EXT_HEXFILE       ("_HEXFILE_")
+
+/* ------------------------------------------------------------------------ */
+typedef enum {
+	hex_ihex = 0,
+	hex_s19,
+	hex_s28,
+	hex_s37
+} hex_format_type;
+
+typedef struct {
+	uint32_t addr;
+	uint32_t len;
+	uint32_t cap;
+	uint8_t *data;
+} hex_run_type;
+
+/*
+ * A memory image is kept as a sorted list of non-overlapping runs.  Runs
+ * that touch are joined, so sequential records grow a single run.
+ */
+typedef struct {
+	hex_run_type *run;
+	uint32_t count;
+	uint32_t cap;
+	uint32_t start;
+	bool     has_start;
+} hex_image_type;
+
+typedef struct {
+	hex_format_type format;
+	uint32_t line;
+	const char *header;
+	size_t header_len;
+	luaL_Buffer *bfr;
+	FILE *fp;
+	uint32_t records;
+} hex_writer_type;
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_image(L,n)   ( (hex_image_type*)luaL_checkudata(L,n,LUA_EXT_HEXFILE))
+#define _hex_end(r)              ( (uint64_t)(r)->addr + (r)->len )
+
+/* Image ================================================================== */
+/* ------------------------------------------------------------------------ */
+static void img_clear( hex_image_type *img )
+{
+	for (uint32_t indx = 0;indx<img->count;++indx) free(img->run[indx].data);
+	free(img->run);
+	img->run = NULL;
+	img->count = 0;
+	img->cap = 0;
+}
+/* ------------------------------------------------------------------------ */
+/* first run that ends at or after addr (touching counts) */
+static uint32_t img_first( const hex_image_type *img, uint64_t addr )
+{
+	uint32_t lo = 0, hi = img->count;
+	while (lo < hi) {
+		uint32_t mid = (lo+hi)/2;
+		if (_hex_end(&img->run[mid]) < addr) lo = mid+1;
+		else hi = mid;
+	}
+	return lo;
+}
+/* ------------------------------------------------------------------------ */
+/* number of runs that start at or before addr */
+static uint32_t img_upto( const hex_image_type *img, uint64_t addr )
+{
+	uint32_t lo = 0, hi = img->count;
+	while (lo < hi) {
+		uint32_t mid = (lo+hi)/2;
+		if (img->run[mid].addr <= addr) lo = mid+1;
+		else hi = mid;
+	}
+	return lo;
+}
+/* ------------------------------------------------------------------------ */
+static bool img_reserve( hex_run_type *r, uint32_t size )
+{
+	if (size <= r->cap) return true;
+	uint32_t cap = (r->cap < 256)?256:r->cap;
+	while (cap < size) cap = (cap > 0x7FFFFFFF)?size:cap*2;
+	uint8_t *p = (uint8_t*)realloc(r->data, cap);
+	if (p == NULL) return false;
+	r->data = p;
+	r->cap = cap;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Write data into the image at addr, data that is already present in the
+ * image is replaced.  Returns false when memory could not be allocated.
+ */
+static bool img_put( hex_image_type *img, uint32_t addr, const uint8_t *data, uint32_t len )
+{
+	if (len == 0) return true;
+	uint64_t end = (uint64_t)addr + len;
+	uint32_t i = img_first(img, addr);
+	uint32_t j = img_upto(img, end);
+
+	if (i >= j) {
+		/* nothing overlaps or touches, insert a new run at i */
+		if (img->count == img->cap) {
+			uint32_t cap = (img->cap == 0)?8:img->cap*2;
+			hex_run_type *p = (hex_run_type*)realloc(img->run, cap*sizeof(hex_run_type));
+			if (p == NULL) return false;
+			img->run = p;
+			img->cap = cap;
+		}
+		hex_run_type r = { .addr = addr, .len = 0, .cap = 0, .data = NULL };
+		if (!img_reserve(&r, len)) return false;
+		memcpy(r.data, data, len);
+		r.len = len;
+		memmove(&img->run[i+1], &img->run[i], (img->count-i)*sizeof(hex_run_type));
+		img->run[i] = r;
+		img->count++;
+		return true;
+	}
+	hex_run_type *r = &img->run[i];
+	if ((j == i+1)&&(r->addr <= addr)) {
+		/* a single run, overwrite or append (sequential records) */
+		uint32_t off = addr - r->addr;
+		if (off+len > r->len) {
+			if (!img_reserve(r, off+len)) return false;
+			r->len = off+len;
+		}
+		memcpy(r->data+off, data, len);
+		return true;
+	}
+	/* join runs i..j-1 and the new data into one run */
+	uint32_t first = (r->addr < addr)?r->addr:addr;
+	uint64_t last = _hex_end(&img->run[j-1]);
+	if (last < end) last = end;
+	hex_run_type n = { .addr = first, .len = 0, .cap = 0, .data = NULL };
+	if (!img_reserve(&n, (uint32_t)(last-first))) return false;
+	n.len = (uint32_t)(last-first);
+	for (uint32_t k = i;k<j;++k) {
+		memcpy(n.data + (img->run[k].addr-first), img->run[k].data, img->run[k].len);
+		free(img->run[k].data);
+	}
+	memcpy(n.data + (addr-first), data, len);
+	img->run[i] = n;
+	memmove(&img->run[i+1], &img->run[j], (img->count-j)*sizeof(hex_run_type));
+	img->count -= (j-i-1);
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* copy the image contents of [first,last] into out, gaps are left as is */
+static void img_copy( const hex_image_type *img, uint32_t first, uint32_t last, uint8_t *out )
+{
+	for (uint32_t k = img_first(img, first);k<img->count;++k) {
+		const hex_run_type *r = &img->run[k];
+		if (r->addr > last) break;
+		uint32_t a = (r->addr > first)?r->addr:first;
+		uint64_t e = _hex_end(r);
+		if (e > (uint64_t)last+1) e = (uint64_t)last+1;
+		if (e > a) memcpy(out + (a-first), r->data + (a-r->addr), (size_t)(e-a));
+	}
+}
+/* Record Writer ========================================================== */
+/* ------------------------------------------------------------------------ */
+static void hex_emit( hex_writer_type *w, const char *s, size_t len )
+{
+	if (w->fp != NULL) fwrite(s, 1, len, w->fp);
+	else luaL_addlstring(w->bfr, s, len);
+}
+/* ------------------------------------------------------------------------ */
+static char *hex_byte( char *p, uint32_t v, uint32_t *sum )
+{
+	p[0] = hex_digits[(v>>4)&0xF];
+	p[1] = hex_digits[v&0xF];
+	*sum += v&0xFF;
+	return p+2;
+}
+/* ------------------------------------------------------------------------ */
+static void ihex_record( hex_writer_type *w, uint32_t type, uint32_t offset, const uint8_t *data, uint32_t len )
+{
+	char line[HEX_MAX_LINE];
+	uint32_t sum = 0;
+	char *p = line;
+	*p++ = ':';
+	p = hex_byte(p, len, &sum);
+	p = hex_byte(p, offset>>8, &sum);
+	p = hex_byte(p, offset, &sum);
+	p = hex_byte(p, type, &sum);
+	for (uint32_t indx = 0;indx<len;++indx) p = hex_byte(p, data[indx], &sum);
+	p = hex_byte(p, (~sum)+1, &sum);
+	*p++ = '\n';
+	hex_emit(w, line, p-line);
+}
+/* ------------------------------------------------------------------------ */
+static void srec_record( hex_writer_type *w, char type, uint32_t abytes, uint32_t addr, const uint8_t *data, uint32_t len )
+{
+	char line[HEX_MAX_LINE];
+	uint32_t sum = 0;
+	char *p = line;
+	*p++ = 'S';
+	*p++ = type;
+	p = hex_byte(p, abytes+len+1, &sum);
+	for (uint32_t indx = abytes;indx>0;--indx) p = hex_byte(p, addr>>((indx-1)*8), &sum);
+	for (uint32_t indx = 0;indx<len;++indx) p = hex_byte(p, data[indx], &sum);
+	p = hex_byte(p, ~sum, &sum);
+	*p++ = '\n';
+	hex_emit(w, line, p-line);
+}
+/* ------------------------------------------------------------------------ */
+static void ihex_write( hex_writer_type *w, const hex_image_type *img )
+{
+	uint32_t upper = 0;  /* upper 16-bits of the address, starts at 0 */
+	for (uint32_t k = 0;k<img->count;++k) {
+		const hex_run_type *r = &img->run[k];
+		uint32_t off = 0;
+		while (off < r->len) {
+			uint32_t addr = r->addr + off;
+			uint32_t size = r->len - off;
+			if (size > w->line) size = w->line;
+			/* records can not cross a 64K boundary */
+			if (size > 0x10000 - (addr&0xFFFF)) size = 0x10000 - (addr&0xFFFF);
+			if ((addr>>16) != upper) {
+				uint8_t seg[2] = { (uint8_t)(addr>>24), (uint8_t)(addr>>16) };
+				upper = addr>>16;
+				ihex_record(w, IHEX_EXT_LINEAR, 0, seg, 2);
+			}
+			ihex_record(w, IHEX_DATA, addr&0xFFFF, r->data+off, size);
+			off += size;
+		}
+	}
+	if (img->has_start) {
+		uint8_t start[4] = {
+				(uint8_t)(img->start>>24), (uint8_t)(img->start>>16),
+				(uint8_t)(img->start>>8), (uint8_t)img->start };
+		ihex_record(w, IHEX_START_LINEAR, 0, start, 4);
+	}
+	ihex_record(w, IHEX_EOF, 0, NULL, 0);
+}
+/* ------------------------------------------------------------------------ */
+static void srec_write( hex_writer_type *w, const hex_image_type *img )
+{
+	uint32_t abytes = (w->format == hex_s19)?2:((w->format == hex_s28)?3:4);
+	char data_type = (char)('0' + abytes - 1);     /* S1, S2, S3 */
+	char end_type = (char)('0' + 11 - abytes);     /* S9, S8, S7 */
+	uint32_t max = 255 - abytes - 1;
+	uint32_t line = (w->line > max)?max:w->line;
+
+	srec_record(w, '0', 2, 0, (const uint8_t*)w->header, (uint32_t)w->header_len);
+	for (uint32_t k = 0;k<img->count;++k) {
+		const hex_run_type *r = &img->run[k];
+		uint32_t off = 0;
+		while (off < r->len) {
+			uint32_t size = r->len - off;
+			if (size > line) size = line;
+			srec_record(w, data_type, abytes, r->addr+off, r->data+off, size);
+			w->records++;
+			off += size;
+		}
+	}
+	if (w->records <= 0xFFFF) srec_record(w, '5', 2, w->records, NULL, 0);
+	else srec_record(w, '6', 3, w->records, NULL, 0);
+	srec_record(w, end_type, abytes, (img->has_start)?img->start:0, NULL, 0);
+}
+/* ------------------------------------------------------------------------ */
+/* read the writer options from the table at index n */
+static void hex_options( lua_State *L, int n, hex_writer_type *w )
+{
+	static const char *const formats[] = { "ihex", "s19", "s28", "s37", NULL };
+	memset((void*)w,0,sizeof(hex_writer_type));
+	w->format = hex_ihex;
+	w->line = HEX_DEFAULT_LINE;
+	w->header = "";
+	if (lua_isnoneornil(L,n)) return;
+	luaL_checktype(L,n,LUA_TTABLE);
+	lua_getfield(L,n,"format");
+	w->format = (hex_format_type)luaL_checkoption(L,-1,"ihex",formats);
+	lua_getfield(L,n,"line");
+	w->line = (uint32_t)luaL_optinteger(L,-1,HEX_DEFAULT_LINE);
+	if ((w->line < 1)||(w->line > 255)) luaL_error(L,"line length must be 1 to 255 bytes");
+	lua_pop(L,2);
+	/* the header string is left on the stack while the writer uses it */
+	lua_getfield(L,n,"header");
+	w->header = luaL_optlstring(L,-1,"",&w->header_len);
+	if (w->header_len > 250) w->header_len = 250;
+}
+/* ------------------------------------------------------------------------ */
+static void hex_write_image( lua_State *L, hex_writer_type *w, const hex_image_type *img )
+{
+	if ((w->format == hex_s19)||(w->format == hex_s28)) {
+		uint64_t limit = (w->format == hex_s19)?0x10000:0x1000000;
+		if ((img->count > 0)&&(_hex_end(&img->run[img->count-1]) > limit))
+			luaL_error(L,"image does not fit the %s address range", (w->format == hex_s19)?"S19":"S28");
+	}
+	if (w->format == hex_ihex) ihex_write(w, img);
+	else srec_write(w, img);
+}
+/* Record Reader ========================================================== */
+/* ------------------------------------------------------------------------ */
+static int hex_nibble( char c )
+{
+	if ((c >= '0')&&(c <= '9')) return c-'0';
+	if ((c >= 'A')&&(c <= 'F')) return c-'A'+10;
+	if ((c >= 'a')&&(c <= 'f')) return c-'a'+10;
+	return -1;
+}
+/* ------------------------------------------------------------------------ */
+/* convert the hex digits of a record to bytes, returns count or -1 */
+static int hex_bytes( const char *s, size_t len, uint8_t *out )
+{
+	if (len&1) return -1;
+	for (size_t indx = 0;indx<len;indx += 2) {
+		int hi = hex_nibble(s[indx]);
+		int lo = hex_nibble(s[indx+1]);
+		if ((hi < 0)||(lo < 0)) return -1;
+		*out++ = (uint8_t)((hi<<4)|lo);
+	}
+	return (int)(len/2);
+}
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	uint32_t base;    /* extended address from record type 02/04 */
+	uint32_t line;
+	bool     done;
+} hex_reader_type;
+
+/* parse one record, returns NULL or an error message */
+static const char *hex_parse_line( hex_reader_type *rd, hex_image_type *img, const char *s, size_t len )
+{
+	uint8_t rec[HEX_MAX_LINE/2];
+	uint32_t sum = 0;
+
+	while ((len > 0)&&((s[len-1] == '\r')||(s[len-1] == '\n')||(s[len-1] == ' ')||(s[len-1] == '\t'))) --len;
+	while ((len > 0)&&((*s == ' ')||(*s == '\t'))) { ++s; --len; }
+	if ((len == 0)||(rd->done)) return NULL;
+	if (len > HEX_MAX_LINE) return "record too long";
+
+	if (s[0] == ':') {
+		int n = hex_bytes(s+1, len-1, rec);
+		if ((n < 5)||(n != rec[0]+5)) return "malformed record";
+		for (int indx = 0;indx<n;++indx) sum += rec[indx];
+		if (sum&0xFF) return "checksum error";
+		uint32_t offset = ((uint32_t)rec[1]<<8)|rec[2];
+		uint8_t *data = &rec[4];
+		switch (rec[3]) {
+		case IHEX_DATA:
+			if (!img_put(img, rd->base+offset, data, rec[0])) return "not enough memory";
+			break;
+		case IHEX_EOF:
+			rd->done = true;
+			break;
+		case IHEX_EXT_SEGMENT:
+			if (rec[0] != 2) return "malformed record";
+			rd->base = (((uint32_t)data[0]<<8)|data[1])<<4;
+			break;
+		case IHEX_START_SEGMENT:
+			if (rec[0] != 4) return "malformed record";
+			img->start = ((((uint32_t)data[0]<<8)|data[1])<<4) + (((uint32_t)data[2]<<8)|data[3]);
+			img->has_start = true;
+			break;
+		case IHEX_EXT_LINEAR:
+			if (rec[0] != 2) return "malformed record";
+			rd->base = (((uint32_t)data[0]<<8)|data[1])<<16;
+			break;
+		case IHEX_START_LINEAR:
+			if (rec[0] != 4) return "malformed record";
+			img->start = ((uint32_t)data[0]<<24)|((uint32_t)data[1]<<16)|((uint32_t)data[2]<<8)|data[3];
+			img->has_start = true;
+			break;
+		default:
+			return "unknown record type";
+		}
+	}
+	else if ((s[0] == 'S')&&(len >= 2)) {
+		int n = hex_bytes(s+2, len-2, rec);
+		if ((n < 1)||(n != rec[0]+1)) return "malformed record";
+		for (int indx = 0;indx<n;++indx) sum += rec[indx];
+		if ((sum&0xFF) != 0xFF) return "checksum error";
+		uint32_t abytes = 0;
+		bool data = false;
+		switch (s[1]) {
+		case '1': abytes = 2; data = true; break;
+		case '2': abytes = 3; data = true; break;
+		case '3': abytes = 4; data = true; break;
+		case '7': abytes = 4; break;
+		case '8': abytes = 3; break;
+		case '9': abytes = 2; break;
+		case '0': case '5': case '6': return NULL;  /* header and counts */
+		default:
+			return "unknown record type";
+		}
+		if ((uint32_t)rec[0] < abytes+1) return "malformed record";
+		uint32_t addr = 0;
+		for (uint32_t indx = 0;indx<abytes;++indx) addr = (addr<<8)|rec[1+indx];
+		if (data) {
+			if (!img_put(img, addr, &rec[1+abytes], rec[0]-abytes-1)) return "not enough memory";
+		}
+		else {
+			img->start = addr;
+			img->has_start = true;
+			rd->done = true;
+		}
+	}
+	else return "unknown record";
+	return NULL;
+}
+/* Lua Interface ========================================================== */
+/* ------------------------------------------------------------------------ */
+static hex_image_type *hex_new_image( lua_State *L )
+{
+	hex_image_type *img = (hex_image_type*)lua_newuserdatauv(L, sizeof(hex_image_type), 0);
+	memset((void*)img,0,sizeof(hex_image_type));
+	luaL_setmetatable(L, LUA_EXT_HEXFILE);
+	return img;
+}
+/* ------------------------------------------------------------------------ */
+static FILE *hex_check_file( lua_State *L, int n )
+{
+	luaL_Stream *p = (luaL_Stream*)luaL_checkudata(L, n, LUA_FILEHANDLE);
+	if (p->closef == NULL) luaL_error(L,"attempt to use a closed file");
+	return p->f;
+}
+/* ------------------------------------------------------------------------ */
+/* img:put( address, data ) */
+static int hex_put( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	uint32_t addr = (uint32_t)luaL_checkinteger(L,2);
+	size_t len;
+	const char *data = luaL_checklstring(L,3,&len);
+	if ((uint64_t)addr+len > 0x100000000ULL) return luaL_error(L,"data exceeds the 32-bit address space");
+	if (!img_put(img, addr, (const uint8_t*)data, (uint32_t)len)) return luaL_error(L,"not enough memory");
+	lua_settop(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:merge( other ), data in other replaces data in img */
+static int hex_merge( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	hex_image_type *other = lua_ext_get_image(L,2);
+	for (uint32_t k = 0;(k<other->count)&&(other != img);++k) {
+		if (!img_put(img, other->run[k].addr, other->run[k].data, other->run[k].len))
+			return luaL_error(L,"not enough memory");
+	}
+	if (other->has_start) {
+		img->start = other->start;
+		img->has_start = true;
+	}
+	lua_settop(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* returns the range [first,last] from the optional arguments at n, n+1 */
+static bool hex_range( lua_State *L, const hex_image_type *img, int n, uint32_t *first, uint32_t *last )
+{
+	if (img->count == 0) {
+		*first = (uint32_t)luaL_optinteger(L,n,0);
+		*last = (uint32_t)luaL_optinteger(L,n+1,*first);
+		return !lua_isnoneornil(L,n+1);
+	}
+	*first = (uint32_t)luaL_optinteger(L,n,img->run[0].addr);
+	*last = (uint32_t)luaL_optinteger(L,n+1,(lua_Integer)(_hex_end(&img->run[img->count-1])-1));
+	if (*last < *first) luaL_error(L,"invalid address range");
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* img:split( first, last ), returns a new image with data in [first,last] */
+static int hex_split( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	uint32_t first = (uint32_t)luaL_checkinteger(L,2);
+	uint32_t last = (uint32_t)luaL_optinteger(L,3,0xFFFFFFFF);
+	hex_image_type *part = hex_new_image(L);
+	if (last < first) return luaL_error(L,"invalid address range");
+	for (uint32_t k = img_first(img, first);k<img->count;++k) {
+		const hex_run_type *r = &img->run[k];
+		if (r->addr > last) break;
+		uint32_t a = (r->addr > first)?r->addr:first;
+		uint64_t e = _hex_end(r);
+		if (e > (uint64_t)last+1) e = (uint64_t)last+1;
+		if ((e > a)&&(!img_put(part, a, r->data + (a-r->addr), (uint32_t)(e-a))))
+			return luaL_error(L,"not enough memory");
+	}
+	if ((img->has_start)&&(img->start >= first)&&(img->start <= last)) {
+		part->start = img->start;
+		part->has_start = true;
+	}
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:fill( value, first, last ), fills the gaps in [first,last] */
+static int hex_fill( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	uint8_t value = (uint8_t)luaL_optinteger(L,2,0xFF);
+	uint32_t first, last;
+	if (!hex_range(L, img, 3, &first, &last)) return luaL_error(L,"image is empty, a range is required");
+	uint64_t size = (uint64_t)last - first + 1;
+	if (size > 0xFFFFFFFF) return luaL_error(L,"fill range is too large");
+	uint8_t *bfr = (uint8_t*)malloc((size_t)size);
+	if (bfr == NULL) return luaL_error(L,"not enough memory");
+	memset(bfr, value, (size_t)size);
+	img_copy(img, first, last, bfr);
+	bool ok = img_put(img, first, bfr, (uint32_t)size);
+	free(bfr);
+	if (!ok) return luaL_error(L,"not enough memory");
+	lua_settop(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:get( first, last, fill ), returns the binary data of the range */
+static int hex_get( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	uint32_t first, last;
+	uint8_t value = (uint8_t)luaL_optinteger(L,4,0xFF);
+	if (!hex_range(L, img, 2, &first, &last)) {
+		lua_pushliteral(L,"");
+		lua_pushinteger(L,first);
+		return 2;
+	}
+	luaL_Buffer bfr;
+	size_t size = (size_t)((uint64_t)last - first + 1);
+	uint8_t *out = (uint8_t*)luaL_buffinitsize(L, &bfr, size);
+	memset(out, value, size);
+	img_copy(img, first, last, out);
+	luaL_pushresultsize(&bfr, size);
+	lua_pushinteger(L,first);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* img:blocks(), returns a table of { address=, data= } blocks */
+static int hex_blocks( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	lua_createtable(L, img->count, 0);
+	for (uint32_t k = 0;k<img->count;++k) {
+		lua_createtable(L, 0, 2);
+		lua_pushinteger(L, img->run[k].addr);
+		lua_setfield(L,-2,"address");
+		lua_pushlstring(L, (const char*)img->run[k].data, img->run[k].len);
+		lua_setfield(L,-2,"data");
+		lua_rawseti(L,-2,k+1);
+	}
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:range(), returns the first and last address of the image */
+static int hex_image_range( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	if (img->count == 0) return 0;
+	lua_pushinteger(L, img->run[0].addr);
+	lua_pushinteger(L, (lua_Integer)(_hex_end(&img->run[img->count-1])-1));
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* img:start( address ), set or read the execution start address */
+static int hex_start( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	if (lua_gettop(L) > 1) {
+		img->has_start = !lua_isnil(L,2);
+		img->start = (uint32_t)luaL_optinteger(L,2,0);
+		return 0;
+	}
+	if (!img->has_start) return 0;
+	lua_pushinteger(L, img->start);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:encode( opts ) */
+static int hex_image_encode( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	hex_writer_type w;
+	luaL_Buffer bfr;
+	hex_options(L, 2, &w);
+	luaL_buffinit(L, &bfr);
+	w.bfr = &bfr;
+	hex_write_image(L, &w, img);
+	luaL_pushresult(&bfr);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* img:write( file, opts ) */
+static int hex_image_write( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	FILE *fp = hex_check_file(L,2);
+	hex_writer_type w;
+	hex_options(L, 3, &w);
+	w.fp = fp;
+	hex_write_image(L, &w, img);
+	lua_settop(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int hex_gc( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	img_clear(img);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static int hex_tostring( lua_State *L )
+{
+	hex_image_type *img = lua_ext_get_image(L,1);
+	lua_pushfstring(L, "hexfile (%d blocks)", (int)img->count);
+	return 1;
+}
+/* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
+/* hexfile.new( data, base ) */
+static int hex_new( lua_State *L )
+{
+	size_t len = 0;
+	const char *data = luaL_optlstring(L,1,NULL,&len);
+	uint32_t base = (uint32_t)luaL_optinteger(L,2,HEX_DEFAULT_BASE);
+	hex_image_type *img = hex_new_image(L);
+	if ((data != NULL)&&(!img_put(img, base, (const uint8_t*)data, (uint32_t)len)))
+		return luaL_error(L,"not enough memory");
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* hexfile.decode( text or file ), reads Intel HEX or S-record data */
+static int hex_decode( lua_State *L )
+{
+	hex_reader_type rd = { .base = 0, .line = 0, .done = false };
+	const char *err = NULL;
+	hex_image_type *img = hex_new_image(L);
+
+	if (lua_type(L,1) == LUA_TSTRING) {
+		size_t len;
+		const char *s = lua_tolstring(L,1,&len);
+		const char *end = s+len;
+		while ((s < end)&&(err == NULL)) {
+			const char *nl = memchr(s, '\n', end-s);
+			const char *eol = (nl != NULL)?nl:end;
+			++rd.line;
+			err = hex_parse_line(&rd, img, s, eol-s);
+			s = eol+1;
+		}
+	}
+	else {
+		FILE *fp = hex_check_file(L,1);
+		char line[HEX_MAX_LINE+4];
+		while ((err == NULL)&&(fgets(line, sizeof(line), fp) != NULL)) {
+			++rd.line;
+			size_t len = strlen(line);
+			if ((len == sizeof(line)-1)&&(line[len-1] != '\n')) err = "record too long";
+			else err = hex_parse_line(&rd, img, line, len);
+		}
+	}
+	if (err != NULL) return luaL_error(L,"hexfile: line %d: %s", (int)rd.line, err);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* hexfile.encode( data, base, opts ), utilities.bin2hex() compatible */
+static int hex_encode( lua_State *L )
+{
+	size_t len;
+	const char *data = luaL_checklstring(L,1,&len);
+	uint32_t base = (uint32_t)luaL_optinteger(L,2,HEX_DEFAULT_BASE);
+	hex_run_type r = { .addr = base, .len = (uint32_t)len, .cap = 0, .data = (uint8_t*)data };
+	hex_image_type img = { .run = &r, .count = (len > 0)?1:0, .cap = 1 };
+	hex_writer_type w;
+	luaL_Buffer bfr;
+	hex_options(L, 3, &w);
+	luaL_buffinit(L, &bfr);
+	w.bfr = &bfr;
+	hex_write_image(L, &w, &img);
+	luaL_pushresult(&bfr);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* hexfile.write( file, data, base, opts ) */
+static int hex_write( lua_State *L )
+{
+	FILE *fp = hex_check_file(L,1);
+	size_t len;
+	const char *data = luaL_checklstring(L,2,&len);
+	uint32_t base = (uint32_t)luaL_optinteger(L,3,HEX_DEFAULT_BASE);
+	hex_run_type r = { .addr = base, .len = (uint32_t)len, .cap = 0, .data = (uint8_t*)data };
+	hex_image_type img = { .run = &r, .count = (len > 0)?1:0, .cap = 1 };
+	hex_writer_type w;
+	hex_options(L, 4, &w);
+	w.fp = fp;
+	hex_write_image(L, &w, &img);
+	return 0;
+}
+/* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
+static const luaL_Reg hex_image_funcs[] = {
+		{ "put", hex_put },
+		{ "merge", hex_merge },
+		{ "split", hex_split },
+		{ "fill", hex_fill },
+		{ "get", hex_get },
+		{ "blocks", hex_blocks },
+		{ "range", hex_image_range },
+		{ "start", hex_start },
+		{ "encode", hex_image_encode },
+		{ "write", hex_image_write },
+		{NULL, NULL }
+};
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg hex_metameth[] = {
+		{"__index", NULL},  /* place holder */
+		{"__gc", hex_gc},
+		{"__tostring", hex_tostring},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg hex_lib[] = {
+		{ "new", hex_new },
+		{ "decode", hex_decode },
+		{ "encode", hex_encode },
+		{ "write", hex_write },
+		{NULL, NULL }
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_hexfile( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_HEXFILE);
+	luaL_setfuncs(L, hex_metameth, 0);
+	luaL_newlibtable(L, hex_image_funcs);
+	luaL_setfuncs(L, hex_image_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newlib(L, hex_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
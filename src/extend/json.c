@@ -0,0 +1,1674 @@
+/*
+ * json.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define JSON_MAX_DEPTH        (1000)      /**< deepest nesting accepted by the decoder and encoder */
+#define JSON_CHUNK            (65536)     /**< read size used by cjson.stream() */
+
+#define LUA_EXT_JSON_VEC      ("_JSON_VEC_")
+#define LUA_EXT_JSON_PARSER   ("_JSON_PARSER_")
+#define LUA_EXT_JSON_DOC      ("_JSON_DOC_")
+
+/* Character classes used by the scanners */
+#define JC_WS                 (0x01)      /**< JSON whitespace */
+#define JC_NUM                (0x02)      /**< may be part of a number */
+#define JC_STR                (0x04)      /**< ends a plain run in a string being decoded */
+#define JC_ESC                (0x08)      /**< must be escaped when encoding */
+#define JC_NEST               (0x10)      /**< '"', '{', '}', '[' or ']' */
+
+/*
+ * Word at a time tests, these check 8 bytes per step for the characters
+ * that end a plain run in a string.  Loads go through memcpy so unaligned
+ * text is fine on every target.
+ */
+#define SWAR_ONES             (0x0101010101010101ULL)
+#define SWAR_HIGH             (0x8080808080808080ULL)
+#define swar_zero(v)          ( ((v) - SWAR_ONES) & ~(v) & SWAR_HIGH )
+#define swar_byte(v,c)        swar_zero((v) ^ (SWAR_ONES*(uint8_t)(c)))
+#define swar_less(v,n)        ( ((v) - SWAR_ONES*(n)) & ~(v) & SWAR_HIGH )
+
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	lua_State *L;
+	const char *text;      /**< first byte, error positions count from here */
+	const char *end;
+	size_t base;           /**< stream offset of text[0] */
+	bool strict;           /**< same as strictParsing in JSON.lua */
+	int null_idx;          /**< stack index of the value used for null, 0 for nil */
+	int array_mt;          /**< stack index of the metatable for arrays, 0 for none */
+	int object_mt;         /**< stack index of the metatable for objects, 0 for none */
+	int lazy_pos;          /**< lazy mode: stack index of the node position table */
+	int lazy_mt;           /**< lazy mode: stack index of the node metatable */
+	int target;            /**< stack index of a table to fill instead of a new one */
+	int depth;
+	const char *err;       /**< message of the last error */
+	size_t err_pos;        /**< 1-based byte position of the error, 0 if unknown */
+} json_dec_type;
+
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+} json_vec_type;
+
+typedef struct {
+	const char *str;
+	size_t len;
+	bool numeric;          /**< key was a number, converted to a string */
+	bool isint;
+	lua_Integer inum;
+	lua_Number num;
+} json_key_type;
+
+typedef struct {
+	lua_State *L;
+	json_vec_type *out;
+	json_vec_type *keys;   /**< keys of the objects being encoded, innermost last */
+	json_vec_type *indent; /**< current indentation */
+	const char *step;      /**< options.indent */
+	size_t step_len;
+	bool pretty;
+	bool align_keys;
+	bool array_newline;
+	bool utf8;             /**< stringsAreUtf8, escape U+2028 and U+2029 */
+	bool no_key_conversion;
+	int null_idx;
+	int number_mt;
+	int depth;
+	const void *parents[JSON_MAX_DEPTH];
+} json_enc_type;
+
+/* SAX parser states */
+enum {
+	sax_value = 0,
+	sax_first_value,
+	sax_key,
+	sax_first_key,
+	sax_colon,
+	sax_next,
+	sax_done
+};
+
+typedef struct {
+	char *buf;             /**< bytes received but not parsed yet */
+	size_t len;
+	size_t cap;
+	size_t offset;         /**< stream offset of buf[0] */
+	int state;
+	int depth;
+	bool strict;
+	bool multiple;         /**< accept a sequence of documents */
+	bool busy;
+	bool failed;
+	bool finished;
+	char stack[JSON_MAX_DEPTH];
+} json_sax_type;
+
+typedef struct {
+	const char *text;
+	size_t len;
+	bool strict;
+} json_doc_type;
+
+/* Uservalues of a lazy document */
+#define DOC_TEXT              (1)
+#define DOC_NULL              (2)
+#define DOC_ARRAY_MT          (3)
+#define DOC_OBJECT_MT         (4)
+#define DOC_POSITIONS         (5)
+#define DOC_NODE_MT           (6)
+
+/* Stack slots of the protected SAX run */
+#define SAX_HANDLER           (3)
+#define SAX_NULL              (4)
+
+static uint8_t json_class[256];
+
+/* ------------------------------------------------------------------------ */
+#define lua_ext_get_parser(L,n)  ( (json_sax_type*)luaL_checkudata(L,n,LUA_EXT_JSON_PARSER))
+
+/* Scanner ================================================================ */
+/* ------------------------------------------------------------------------ */
+static void json_init_class( void )
+{
+	for (int c = 0;c<256;++c) {
+		uint8_t k = 0;
+		if ((c == ' ')||(c == '\t')||(c == '\n')||(c == '\r')) k |= JC_WS;
+		if (((c >= '0')&&(c <= '9'))||(c == '-')||(c == '+')||(c == '.')||(c == 'e')||(c == 'E')) k |= JC_NUM;
+		if ((c == '"')||(c == '\\')||(c < 0x20)||(c >= 0x80)) k |= JC_STR;
+		if ((c == '"')||(c == '\\')||(c < 0x20)) k |= JC_ESC;
+		if ((c == '"')||(c == '{')||(c == '}')||(c == '[')||(c == ']')) k |= JC_NEST;
+		json_class[c] = k;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static inline uint64_t swar_load( const char *p )
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+/* ------------------------------------------------------------------------ */
+static inline const char *json_ws( const char *p, const char *end )
+{
+	while ((p < end)&&(json_class[(uint8_t)*p] & JC_WS)) ++p;
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+/* skip plain ASCII inside a string, stops at '"', '\\', controls and UTF-8 */
+static const char *json_plain( const char *p, const char *end )
+{
+	while (end - p >= 8) {
+		uint64_t v = swar_load(p);
+		if (swar_byte(v,'"') | swar_byte(v,'\\') | swar_less(v,0x20) | (v & SWAR_HIGH)) break;
+		p += 8;
+	}
+	while ((p < end)&&!(json_class[(uint8_t)*p] & JC_STR)) ++p;
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+/* find the next '"' or '\\' */
+static const char *json_quote( const char *p, const char *end )
+{
+	while (end - p >= 8) {
+		uint64_t v = swar_load(p);
+		if (swar_byte(v,'"') | swar_byte(v,'\\')) break;
+		p += 8;
+	}
+	while ((p < end)&&(*p != '"')&&(*p != '\\')) ++p;
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+/* closing quote of the string whose body starts at p, NULL if not there */
+static const char *json_string_end( const char *p, const char *end )
+{
+	for (;;) {
+		p = json_quote(p, end);
+		if (p >= end) return NULL;
+		if (*p == '"') return p;
+		p += 2;  /* backslash and the escaped byte */
+		if (p > end) return NULL;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static int json_utf8_len( uint8_t c )
+{
+	if (c < 0x80) return 1;
+	if ((c < 0xC2)||(c >= 0xF5)) return 0;
+	if (c < 0xE0) return 2;
+	if (c < 0xF0) return 3;
+	return 4;
+}
+/* ------------------------------------------------------------------------ */
+/* UTF-8 for a \u escape, lone surrogates become '?' as in JSON.lua */
+static size_t json_utf8( uint32_t cp, char *out )
+{
+	if (cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = (char)(0xC0 | (cp>>6));
+		out[1] = (char)(0x80 | (cp&0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		if ((cp >= 0xD800)&&(cp <= 0xDFFF)) {
+			out[0] = '?';
+			return 1;
+		}
+		out[0] = (char)(0xE0 | (cp>>12));
+		out[1] = (char)(0x80 | ((cp>>6)&0x3F));
+		out[2] = (char)(0x80 | (cp&0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (cp>>18));
+	out[1] = (char)(0x80 | ((cp>>12)&0x3F));
+	out[2] = (char)(0x80 | ((cp>>6)&0x3F));
+	out[3] = (char)(0x80 | (cp&0x3F));
+	return 4;
+}
+/* ------------------------------------------------------------------------ */
+static bool json_hex4( const char *p, const char *end, uint32_t *v )
+{
+	uint32_t r = 0;
+
+	if (end - p < 4) return false;
+	for (int k = 0;k<4;++k) {
+		char c = p[k];
+		r <<= 4;
+		if ((c >= '0')&&(c <= '9')) r |= (uint32_t)(c - '0');
+		else if ((c >= 'a')&&(c <= 'f')) r |= (uint32_t)(c - 'a' + 10);
+		else if ((c >= 'A')&&(c <= 'F')) r |= (uint32_t)(c - 'A' + 10);
+		else return false;
+	}
+	*v = r;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static inline bool json_match( const char *p, const char *end, const char *lit, size_t n )
+{
+	return ((size_t)(end - p) >= n)&&(memcmp(p, lit, n) == 0);
+}
+
+/* Decoder ================================================================ */
+/* ------------------------------------------------------------------------ */
+/*
+ * Report a syntax error.  The message and the position are kept in the
+ * context so cjson.decode() can hand them back the way JSON.lua reports
+ * them, the raised error is what the lazy and streaming modes see.
+ */
+static void dec_fail( json_dec_type *d, const char *p, const char *msg )
+{
+	d->err = msg;
+	d->err_pos = (p == NULL)?0:(size_t)(p - d->text) + d->base + 1;
+	if (d->err_pos == 0) luaL_error(d->L, "cjson: %s", msg);
+	luaL_error(d->L, "cjson: %s at byte %I", msg, (lua_Integer)d->err_pos);
+}
+/* ------------------------------------------------------------------------ */
+static const char *dec_utf8( json_dec_type *d, const char *p, bool escaped )
+{
+	int n = json_utf8_len((uint8_t)*p);
+
+	if (n == 0) {
+		dec_fail(d, p, escaped?"non-utf8 sequence after backslash escape":"non-utf8 sequence");
+	}
+	for (int k = 1;k<n;++k) {
+		if ((p + k >= d->end)||(((uint8_t)p[k] & 0xC0) != 0x80)) {
+			dec_fail(d, p, escaped?"incomplete utf8 sequence after backslash escape":"incomplete utf8 sequence");
+		}
+	}
+	return p + n;
+}
+/* ------------------------------------------------------------------------ */
+/* p is the byte after the backslash */
+static const char *dec_escape( json_dec_type *d, luaL_Buffer *b, const char *p )
+{
+	uint32_t cp, lo;
+	char utf[4];
+
+	if (p >= d->end) dec_fail(d, p, "unfinished \\ escape");
+	switch (*p) {
+	case '"':
+	case '/':
+	case '\\': luaL_addchar(b, *p); return p + 1;
+	case 'b':  luaL_addchar(b, '\b'); return p + 1;
+	case 'f':  luaL_addchar(b, '\f'); return p + 1;
+	case 'n':  luaL_addchar(b, '\n'); return p + 1;
+	case 'r':  luaL_addchar(b, '\r'); return p + 1;
+	case 't':  luaL_addchar(b, '\t'); return p + 1;
+	case 'u':
+		if (json_hex4(p + 1, d->end, &cp)) {
+			p += 5;
+			/* a high surrogate followed by a low one is a single codepoint */
+			if ((cp >= 0xD800)&&(cp <= 0xDBFF)&&(d->end - p >= 6)&&(p[0] == '\\')&&(p[1] == 'u')
+					&&json_hex4(p + 2, d->end, &lo)&&(lo >= 0xDC00)&&(lo <= 0xDFFF)) {
+				cp = 0x10000 + ((cp - 0xD800)<<10) + (lo - 0xDC00);
+				p += 6;
+			}
+			luaL_addlstring(b, utf, json_utf8(cp, utf));
+			return p;
+		}
+		break;
+	default:
+		break;
+	}
+	if (d->strict) dec_fail(d, p, "illegal use of backslash escape");
+	/* anything else stands for itself */
+	const char *q = dec_utf8(d, p, true);
+	luaL_addlstring(b, p, q - p);
+	return q;
+}
+/* ------------------------------------------------------------------------ */
+/* p is the opening quote, pushes the string */
+static const char *dec_string( json_dec_type *d, const char *p )
+{
+	const char *start = p++;
+	const char *run = p;
+	bool escaped = false;
+	luaL_Buffer b;
+
+	for (;;) {
+		p = json_plain(p, d->end);
+		if (p >= d->end) dec_fail(d, start, "unclosed string");
+		uint8_t c = (uint8_t)*p;
+		if (c == '"') break;
+		if (c == '\\') {
+			if (!escaped) {
+				luaL_buffinit(d->L, &b);
+				escaped = true;
+			}
+			luaL_addlstring(&b, run, p - run);
+			p = dec_escape(d, &b, p + 1);
+			run = p;
+		}
+		else if (c < 0x20) {
+			if (d->strict) dec_fail(d, p + 1, "Unescaped control character");
+			++p;
+		}
+		else p = dec_utf8(d, p, false);
+	}
+	if (escaped) {
+		luaL_addlstring(&b, run, p - run);
+		luaL_pushresult(&b);
+	}
+	else lua_pushlstring(d->L, run, p - run);
+	return p + 1;
+}
+/* ------------------------------------------------------------------------ */
+static const char *dec_number( json_dec_type *d, const char *p )
+{
+	const char *start = p;
+	const char *end = d->end;
+	bool is_int = true;
+	int digits = 0;
+	uint64_t v = 0;
+
+	if ((p < end)&&(*p == '-')) ++p;
+	if ((p < end)&&(*p == '0')) {
+		++p;
+		digits = 1;
+	}
+	else if ((p < end)&&(*p >= '1')&&(*p <= '9')) {
+		while ((p < end)&&(*p >= '0')&&(*p <= '9')) {
+			v = v*10 + (uint64_t)(*p++ - '0');
+			++digits;
+		}
+	}
+	else dec_fail(d, start, "expected number");
+
+	if ((end - p >= 2)&&(p[0] == '.')&&(p[1] >= '0')&&(p[1] <= '9')) {
+		is_int = false;
+		p += 2;
+		while ((p < end)&&(*p >= '0')&&(*p <= '9')) ++p;
+	}
+	if ((p < end)&&((*p == 'e')||(*p == 'E'))) {
+		const char *q = p + 1;
+		if ((q < end)&&((*q == '+')||(*q == '-'))) ++q;
+		if ((q < end)&&(*q >= '0')&&(*q <= '9')) {
+			is_int = false;
+			p = q;
+			while ((p < end)&&(*p >= '0')&&(*p <= '9')) ++p;
+		}
+	}
+	if ((is_int)&&(digits <= 18)) {
+		lua_pushinteger(d->L, (*start == '-')?-(lua_Integer)v:(lua_Integer)v);
+		return p;
+	}
+	/* everything else goes through the conversion tonumber() uses */
+	char tmp[64];
+	size_t len = (size_t)(p - start);
+	size_t ok;
+	if (len < sizeof(tmp)) {
+		memcpy(tmp, start, len);
+		tmp[len] = '\0';
+		ok = lua_stringtonumber(d->L, tmp);
+	}
+	else {
+		lua_pushlstring(d->L, start, len);
+		ok = lua_stringtonumber(d->L, lua_tostring(d->L, -1));
+		if (ok) lua_remove(d->L, -2);
+	}
+	if (!ok) dec_fail(d, start, "bad number");
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+static void dec_table( json_dec_type *d, const char *p, int mt )
+{
+	if (++d->depth > JSON_MAX_DEPTH) dec_fail(d, p, "too deeply nested");
+	luaL_checkstack(d->L, 6, "cjson: too deeply nested");
+	if (d->target != 0) {
+		lua_pushvalue(d->L, d->target);
+		d->target = 0;
+	}
+	else {
+		lua_newtable(d->L);
+		if (mt != 0) {
+			lua_pushvalue(d->L, mt);
+			lua_setmetatable(d->L, -2);
+		}
+	}
+}
+
+static const char *dec_value( json_dec_type *d, const char *p );
+/* ------------------------------------------------------------------------ */
+/*
+ * Value inside a container.  In lazy mode nested containers are not
+ * parsed, they become empty tables that load themselves on first use.
+ */
+static const char *dec_member( json_dec_type *d, const char *p )
+{
+	if (d->lazy_pos != 0) {
+		const char *start = p = json_ws(p, d->end);
+		int depth = 0;
+
+		if ((p < d->end)&&((*p == '{')||(*p == '['))) {
+			lua_newtable(d->L);
+			lua_pushvalue(d->L, d->lazy_mt);
+			lua_setmetatable(d->L, -2);
+			lua_pushvalue(d->L, -1);
+			lua_pushinteger(d->L, (lua_Integer)(p - d->text));
+			lua_rawset(d->L, d->lazy_pos);
+			while (p < d->end) {
+				while ((p < d->end)&&!(json_class[(uint8_t)*p] & JC_NEST)) ++p;
+				if (p >= d->end) break;
+				switch (*p++) {
+				case '"':
+					p = json_string_end(p, d->end);
+					if (p == NULL) dec_fail(d, start, "unclosed string");
+					++p;
+					break;
+				case '{':
+				case '[':
+					++depth;
+					break;
+				default:
+					if (--depth == 0) return p;
+					break;
+				}
+			}
+			dec_fail(d, start, (*start == '{')?"unclosed '{'":"unclosed '['");
+		}
+	}
+	return dec_value(d, p);
+}
+/* ------------------------------------------------------------------------ */
+static const char *dec_object( json_dec_type *d, const char *p )
+{
+	const char *start = p;
+
+	dec_table(d, p, d->object_mt);
+	p = json_ws(p + 1, d->end);
+	if ((p < d->end)&&(*p == '}')) {
+		--d->depth;
+		return p + 1;
+	}
+	while (p < d->end) {
+		if (*p != '"') dec_fail(d, p, "expected string's opening quote");
+		p = json_ws(dec_string(d, p), d->end);
+		if ((p >= d->end)||(*p != ':')) dec_fail(d, p, "expected colon");
+		p = json_ws(dec_member(d, p + 1), d->end);
+		lua_rawset(d->L, -3);
+		if ((p < d->end)&&(*p == '}')) {
+			--d->depth;
+			return p + 1;
+		}
+		if ((p >= d->end)||(*p != ',')) dec_fail(d, p, "expected comma or '}'");
+		p = json_ws(p + 1, d->end);
+	}
+	dec_fail(d, start, "unclosed '{'");
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+static const char *dec_array( json_dec_type *d, const char *p )
+{
+	const char *start = p;
+	lua_Integer indx = 1;
+
+	dec_table(d, p, d->array_mt);
+	p = json_ws(p + 1, d->end);
+	if ((p < d->end)&&(*p == ']')) {
+		--d->depth;
+		return p + 1;
+	}
+	while (p < d->end) {
+		p = json_ws(dec_member(d, p), d->end);
+		lua_rawseti(d->L, -2, indx++);
+		if ((p < d->end)&&(*p == ']')) {
+			--d->depth;
+			return p + 1;
+		}
+		if ((p >= d->end)||(*p != ',')) dec_fail(d, p, "expected comma or ']'");
+		p = json_ws(p + 1, d->end);
+	}
+	dec_fail(d, start, "unclosed '['");
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+static const char *dec_value( json_dec_type *d, const char *p )
+{
+	p = json_ws(p, d->end);
+	if (p >= d->end) dec_fail(d, NULL, "unexpected end of string");
+	switch (*p) {
+	case '"':
+		return dec_string(d, p);
+	case '{':
+		return dec_object(d, p);
+	case '[':
+		return dec_array(d, p);
+	case 't':
+		if (json_match(p, d->end, "true", 4)) {
+			lua_pushboolean(d->L, 1);
+			return p + 4;
+		}
+		break;
+	case 'f':
+		if (json_match(p, d->end, "false", 5)) {
+			lua_pushboolean(d->L, 0);
+			return p + 5;
+		}
+		break;
+	case 'n':
+		if (json_match(p, d->end, "null", 4)) {
+			if (d->null_idx != 0) lua_pushvalue(d->L, d->null_idx);
+			else lua_pushnil(d->L);
+			return p + 4;
+		}
+		break;
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+		return dec_number(d, p);
+	default:
+		break;
+	}
+	dec_fail(d, p, "can't parse JSON");
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+/* push the option, returns its stack index or 0 (and pops it) when nil */
+static int dec_option( lua_State *L, int n, const char *name, bool table )
+{
+	int t = lua_getfield(L, n, name);
+
+	if ((t == LUA_TNIL)||((!table)&&(t == LUA_TBOOLEAN)&&(!lua_toboolean(L,-1)))) {
+		lua_pop(L,1);
+		return 0;
+	}
+	if ((table)&&(t != LUA_TTABLE)) luaL_error(L, "cjson: %s must be a table", name);
+	return lua_gettop(L);
+}
+/* ------------------------------------------------------------------------ */
+/* read the decode options table at index n, values are left on the stack */
+static void dec_options( lua_State *L, int n, json_dec_type *d )
+{
+	if (lua_isnoneornil(L,n)) return;
+	luaL_checktype(L,n,LUA_TTABLE);
+	lua_getfield(L,n,"strict");
+	d->strict = lua_toboolean(L,-1);
+	lua_pop(L,1);
+	d->null_idx = dec_option(L, n, "null", false);
+	d->array_mt = dec_option(L, n, "array_mt", true);
+	d->object_mt = dec_option(L, n, "object_mt", true);
+}
+/* ------------------------------------------------------------------------ */
+static int json_decode_p( lua_State *L )
+{
+	json_dec_type *d = (json_dec_type*)lua_touserdata(L,1);
+
+	dec_options(L, 2, d);
+	const char *p = json_ws(dec_value(d, d->text), d->end);
+	lua_pushinteger(L, (lua_Integer)(p - d->text) + 1);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * value = cjson.decode( text, opts )
+ * A syntax error returns nil, the message and the byte position.  With
+ * opts.partial the position after the value is returned as well and
+ * anything that follows it is left to the caller.
+ */
+static int json_decode( lua_State *L )
+{
+	json_dec_type d;
+	size_t len;
+	const char *text = luaL_checklstring(L,1,&len);
+
+	memset((void*)&d,0,sizeof(json_dec_type));
+	lua_settop(L,2);
+	d.L = L;
+	d.text = text;
+	d.end = text + len;
+	lua_pushcfunction(L, json_decode_p);
+	lua_pushlightuserdata(L, &d);
+	lua_pushvalue(L,2);
+	if (lua_pcall(L,2,2,0) != LUA_OK) {
+		if (d.err == NULL) return lua_error(L);
+		lua_pushnil(L);
+		lua_pushstring(L, d.err);
+		if (d.err_pos != 0) lua_pushinteger(L, (lua_Integer)d.err_pos);
+		else lua_pushnil(L);
+		return 3;
+	}
+	if ((lua_istable(L,2))&&(lua_getfield(L,2,"partial") != LUA_TNIL)&&(lua_toboolean(L,-1))) {
+		lua_pop(L,1);
+		return 2;
+	}
+	if ((size_t)lua_tointeger(L,4) != len + 1) {
+		lua_pushnil(L);
+		lua_pushliteral(L, "trailing garbage");
+		lua_pushvalue(L,4);
+		return 3;
+	}
+	lua_settop(L,3);
+	return 1;
+}
+
+/* Lazy Documents ========================================================= */
+/* ------------------------------------------------------------------------ */
+/*
+ * A lazy node is an empty table with the document's node metatable.  The
+ * first index, assignment, length or pairs() parses that container one
+ * level deep, fills the table in place and gives it its final metatable.
+ */
+static void lazy_load( lua_State *L, int node )
+{
+	json_doc_type *doc = (json_doc_type*)lua_touserdata(L, lua_upvalueindex(1));
+	int top = lua_gettop(L);
+	json_dec_type d;
+
+	node = lua_absindex(L,node);
+	luaL_checktype(L,node,LUA_TTABLE);
+	memset((void*)&d,0,sizeof(json_dec_type));
+	d.L = L;
+	d.text = doc->text;
+	d.end = doc->text + doc->len;
+	d.strict = doc->strict;
+
+	lua_getiuservalue(L, lua_upvalueindex(1), DOC_POSITIONS);
+	d.lazy_pos = lua_gettop(L);
+	lua_pushvalue(L,node);
+	if (lua_rawget(L,d.lazy_pos) != LUA_TNUMBER) {
+		/* loaded already (or not one of ours), just drop the metatable */
+		lua_settop(L,top);
+		lua_pushnil(L);
+		lua_setmetatable(L,node);
+		return;
+	}
+	const char *p = doc->text + lua_tointeger(L,-1);
+	lua_pop(L,1);
+	if (lua_getiuservalue(L, lua_upvalueindex(1), DOC_NULL) != LUA_TNIL) d.null_idx = lua_gettop(L);
+	if (lua_getiuservalue(L, lua_upvalueindex(1), DOC_ARRAY_MT) != LUA_TNIL) d.array_mt = lua_gettop(L);
+	if (lua_getiuservalue(L, lua_upvalueindex(1), DOC_OBJECT_MT) != LUA_TNIL) d.object_mt = lua_gettop(L);
+	lua_getiuservalue(L, lua_upvalueindex(1), DOC_NODE_MT);
+	d.lazy_mt = lua_gettop(L);
+
+	d.target = node;
+	if (*p == '{') dec_object(&d, p);
+	else dec_array(&d, p);
+	lua_pop(L,1);
+
+	lua_pushvalue(L,node);
+	lua_pushnil(L);
+	lua_rawset(L,d.lazy_pos);
+	if (*p == '{') {
+		if (d.object_mt != 0) lua_pushvalue(L,d.object_mt);
+		else lua_pushnil(L);
+	}
+	else {
+		if (d.array_mt != 0) lua_pushvalue(L,d.array_mt);
+		else lua_pushnil(L);
+	}
+	lua_setmetatable(L,node);
+	lua_settop(L,top);
+}
+/* ------------------------------------------------------------------------ */
+static int lazy_index( lua_State *L )
+{
+	lazy_load(L,1);
+	lua_settop(L,2);
+	lua_gettable(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int lazy_newindex( lua_State *L )
+{
+	lazy_load(L,1);
+	lua_settop(L,3);
+	lua_settable(L,1);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static int lazy_len( lua_State *L )
+{
+	lazy_load(L,1);
+	lua_pushinteger(L, luaL_len(L,1));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int json_next( lua_State *L )
+{
+	luaL_checktype(L,1,LUA_TTABLE);
+	lua_settop(L,2);
+	if (lua_next(L,1)) return 2;
+	lua_pushnil(L);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int lazy_pairs( lua_State *L )
+{
+	lazy_load(L,1);
+	lua_pushcfunction(L, json_next);
+	lua_pushvalue(L,1);
+	lua_pushnil(L);
+	return 3;
+}
+/* ------------------------------------------------------------------------ */
+static int lazy_loadf( lua_State *L )
+{
+	lazy_load(L,1);
+	return 0;
+}
+
+static const luaL_Reg json_lazy_meta[] = {
+		{"__index", lazy_index},
+		{"__newindex", lazy_newindex},
+		{"__len", lazy_len},
+		{"__pairs", lazy_pairs},
+		{"__cjson_load", lazy_loadf},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* value = cjson.lazy( text, opts ) */
+static int json_lazy( lua_State *L )
+{
+	size_t len;
+	const char *text = luaL_checklstring(L,1,&len);
+	json_dec_type d;
+
+	memset((void*)&d,0,sizeof(json_dec_type));
+	lua_settop(L,2);
+	d.L = L;
+	d.text = text;
+	d.end = text + len;
+	dec_options(L, 2, &d);
+
+	json_doc_type *doc = (json_doc_type*)lua_newuserdatauv(L, sizeof(json_doc_type), 6);
+	int doc_idx = lua_gettop(L);
+	doc->text = text;
+	doc->len = len;
+	doc->strict = d.strict;
+	luaL_setmetatable(L, LUA_EXT_JSON_DOC);
+	lua_pushvalue(L,1);
+	lua_setiuservalue(L, doc_idx, DOC_TEXT);
+	if (d.null_idx != 0) {
+		lua_pushvalue(L, d.null_idx);
+		lua_setiuservalue(L, doc_idx, DOC_NULL);
+	}
+	if (d.array_mt != 0) {
+		lua_pushvalue(L, d.array_mt);
+		lua_setiuservalue(L, doc_idx, DOC_ARRAY_MT);
+	}
+	if (d.object_mt != 0) {
+		lua_pushvalue(L, d.object_mt);
+		lua_setiuservalue(L, doc_idx, DOC_OBJECT_MT);
+	}
+	/* node -> position, weak so dropped nodes don't pin anything */
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushliteral(L, "k");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	d.lazy_pos = lua_gettop(L);
+	lua_pushvalue(L, -1);
+	lua_setiuservalue(L, doc_idx, DOC_POSITIONS);
+
+	luaL_newlibtable(L, json_lazy_meta);
+	lua_pushvalue(L, doc_idx);
+	luaL_setfuncs(L, json_lazy_meta, 1);
+	d.lazy_mt = lua_gettop(L);
+	lua_pushvalue(L, -1);
+	lua_setiuservalue(L, doc_idx, DOC_NODE_MT);
+
+	const char *p = json_ws(dec_member(&d, text), d.end);
+	if (p != d.end) dec_fail(&d, p, "trailing garbage");
+	return 1;
+}
+
+/* Streaming (SAX) Parser ================================================= */
+/* ------------------------------------------------------------------------ */
+/* call handler:name(...) with the nargs values on the top of the stack */
+static void sax_emit( lua_State *L, const char *name, int nargs )
+{
+	if (lua_getfield(L, SAX_HANDLER, name) != LUA_TFUNCTION) {
+		lua_pop(L, nargs + 1);
+		return;
+	}
+	lua_insert(L, -1 - nargs);
+	lua_pushvalue(L, SAX_HANDLER);
+	lua_insert(L, -1 - nargs);
+	lua_call(L, nargs + 1, 0);
+}
+/* ------------------------------------------------------------------------ */
+/* true when the scalar at p is complete in the buffer */
+static bool sax_complete( const char *p, const char *end, bool eof )
+{
+	if (eof) return true;
+	switch (*p) {
+	case '"':
+		return json_string_end(p + 1, end) != NULL;
+	case 't':
+	case 'n':
+		return (end - p >= 4)||(memcmp(p, (*p == 't')?"true":"null", end - p) != 0);
+	case 'f':
+		return (end - p >= 5)||(memcmp(p, "false", end - p) != 0);
+	default:
+		if (json_class[(uint8_t)*p] & JC_NUM) {
+			while ((p < end)&&(json_class[(uint8_t)*p] & JC_NUM)) ++p;
+			return p < end;
+		}
+		return true;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static void sax_closed( json_sax_type *s )
+{
+	s->state = (s->depth == 0)?sax_done:sax_next;
+}
+/* ------------------------------------------------------------------------ */
+static int sax_run_p( lua_State *L )
+{
+	json_sax_type *s = (json_sax_type*)lua_touserdata(L,1);
+	bool eof = lua_toboolean(L,2);
+	json_dec_type d;
+
+	lua_settop(L,2);
+	lua_getiuservalue(L,1,1);
+	lua_getiuservalue(L,1,2);
+	memset((void*)&d,0,sizeof(json_dec_type));
+	d.L = L;
+	d.text = s->buf;
+	d.end = s->buf + s->len;
+	d.base = s->offset;
+	d.strict = s->strict;
+	d.null_idx = lua_isnil(L,SAX_NULL)?0:SAX_NULL;
+
+	const char *p = s->buf;
+	for (;;) {
+		p = json_ws(p, d.end);
+		if (p >= d.end) break;
+		switch (s->state) {
+		case sax_done:
+			if (!s->multiple) dec_fail(&d, p, "trailing garbage");
+			s->state = sax_value;
+			continue;
+		case sax_first_key:
+			if (*p == '}') {
+				--s->depth;
+				++p;
+				sax_emit(L, "end_object", 0);
+				sax_closed(s);
+				continue;
+			}
+			/* fall through */
+		case sax_key:
+			if (*p != '"') dec_fail(&d, p, "expected string's opening quote");
+			if (!sax_complete(p, d.end, eof)) break;
+			p = dec_string(&d, p);
+			s->state = sax_colon;
+			sax_emit(L, "key", 1);
+			continue;
+		case sax_colon:
+			if (*p != ':') dec_fail(&d, p, "expected colon");
+			++p;
+			s->state = sax_value;
+			continue;
+		case sax_next:
+			if (*p == ',') {
+				++p;
+				s->state = (s->stack[s->depth - 1] == '{')?sax_key:sax_value;
+				continue;
+			}
+			if (s->stack[s->depth - 1] == '{') {
+				if (*p != '}') dec_fail(&d, p, "expected comma or '}'");
+				--s->depth;
+				++p;
+				sax_emit(L, "end_object", 0);
+			}
+			else {
+				if (*p != ']') dec_fail(&d, p, "expected comma or ']'");
+				--s->depth;
+				++p;
+				sax_emit(L, "end_array", 0);
+			}
+			sax_closed(s);
+			continue;
+		case sax_first_value:
+			if (*p == ']') {
+				--s->depth;
+				++p;
+				sax_emit(L, "end_array", 0);
+				sax_closed(s);
+				continue;
+			}
+			/* fall through */
+		default:
+			if ((*p == '{')||(*p == '[')) {
+				if (s->depth >= JSON_MAX_DEPTH) dec_fail(&d, p, "too deeply nested");
+				s->stack[s->depth++] = *p;
+				s->state = (*p == '{')?sax_first_key:sax_first_value;
+				sax_emit(L, (*p++ == '{')?"start_object":"start_array", 0);
+				continue;
+			}
+			if (!sax_complete(p, d.end, eof)) break;
+			p = dec_value(&d, p);
+			sax_closed(s);
+			sax_emit(L, "value", 1);
+			continue;
+		}
+		break;
+	}
+
+	/* keep what could not be parsed yet */
+	size_t used = (size_t)(p - s->buf);
+	memmove(s->buf, p, s->len - used);
+	s->len -= used;
+	s->offset += used;
+
+	if (eof) {
+		bool ok = (s->state == sax_done)||((s->multiple)&&(s->depth == 0)&&(s->state == sax_value));
+		if (!ok) dec_fail(&d, NULL, "unexpected end of string");
+	}
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static char *sax_reserve( lua_State *L, json_sax_type *s, size_t n )
+{
+	if (s->len + n > s->cap) {
+		size_t cap = (s->cap == 0)?JSON_CHUNK:s->cap;
+		while (cap < s->len + n) cap *= 2;
+		char *p = (char*)realloc(s->buf, cap);
+		if (p == NULL) luaL_error(L, "cjson: not enough memory");
+		s->buf = p;
+		s->cap = cap;
+	}
+	return s->buf + s->len;
+}
+/* ------------------------------------------------------------------------ */
+static void sax_check( lua_State *L, json_sax_type *s )
+{
+	if (s->busy) luaL_error(L, "cjson: parser is busy");
+	if (s->failed) luaL_error(L, "cjson: parser has failed");
+	if (s->finished) luaL_error(L, "cjson: parser is finished");
+}
+/* ------------------------------------------------------------------------ */
+/* parse what is buffered, callbacks run inside, errors mark the parser failed */
+static void sax_call( lua_State *L, int n, json_sax_type *s, bool eof )
+{
+	lua_pushcfunction(L, sax_run_p);
+	lua_pushvalue(L, n);
+	lua_pushboolean(L, eof);
+	s->busy = true;
+	int status = lua_pcall(L,2,0,0);
+	s->busy = false;
+	if (status != LUA_OK) {
+		s->failed = true;
+		lua_error(L);
+	}
+	if (eof) s->finished = true;
+}
+/* ------------------------------------------------------------------------ */
+static int sax_feed( lua_State *L )
+{
+	json_sax_type *s = lua_ext_get_parser(L,1);
+	size_t len;
+	const char *chunk = luaL_checklstring(L,2,&len);
+
+	sax_check(L,s);
+	memcpy(sax_reserve(L, s, len), chunk, len);
+	s->len += len;
+	sax_call(L, 1, s, false);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static int sax_finish( lua_State *L )
+{
+	json_sax_type *s = lua_ext_get_parser(L,1);
+
+	sax_check(L,s);
+	sax_call(L, 1, s, true);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* bytes consumed so far */
+static int sax_position( lua_State *L )
+{
+	json_sax_type *s = lua_ext_get_parser(L,1);
+	lua_pushinteger(L, (lua_Integer)s->offset);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int sax_gc( lua_State *L )
+{
+	json_sax_type *s = lua_ext_get_parser(L,1);
+	free(s->buf);
+	s->buf = NULL;
+	s->len = s->cap = 0;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static json_sax_type *sax_new( lua_State *L, int handler, int opts )
+{
+	luaL_checktype(L,handler,LUA_TTABLE);
+	json_sax_type *s = (json_sax_type*)lua_newuserdatauv(L, sizeof(json_sax_type), 2);
+	memset((void*)s,0,sizeof(json_sax_type));
+	luaL_setmetatable(L, LUA_EXT_JSON_PARSER);
+	lua_pushvalue(L, handler);
+	lua_setiuservalue(L, -2, 1);
+	if (!lua_isnoneornil(L,opts)) {
+		luaL_checktype(L,opts,LUA_TTABLE);
+		lua_getfield(L,opts,"strict");
+		s->strict = lua_toboolean(L,-1);
+		lua_getfield(L,opts,"multiple");
+		s->multiple = lua_toboolean(L,-1);
+		lua_pop(L,2);
+		lua_getfield(L,opts,"null");
+		lua_setiuservalue(L, -2, 2);
+	}
+	return s;
+}
+/* ------------------------------------------------------------------------ */
+/* parser = cjson.parser( handler, opts ) */
+static int json_parser( lua_State *L )
+{
+	lua_settop(L,2);
+	sax_new(L, 1, 2);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * cjson.stream( source, handler, opts )
+ * Source is a string, a file handle (read in JSON_CHUNK pieces) or a
+ * function returning chunks until nil or an empty string.
+ */
+static int json_stream( lua_State *L )
+{
+	lua_settop(L,3);
+	json_sax_type *s = sax_new(L, 2, 3);
+	int n = lua_gettop(L);
+
+	if (lua_type(L,1) == LUA_TSTRING) {
+		size_t len;
+		const char *text = lua_tolstring(L,1,&len);
+		memcpy(sax_reserve(L, s, len), text, len);
+		s->len += len;
+	}
+	else if (lua_isfunction(L,1)) {
+		for (;;) {
+			size_t len;
+			lua_pushvalue(L,1);
+			lua_call(L,0,1);
+			const char *chunk = lua_tolstring(L,-1,&len);
+			if ((chunk == NULL)||(len == 0)) break;
+			memcpy(sax_reserve(L, s, len), chunk, len);
+			s->len += len;
+			lua_pop(L,1);
+			sax_call(L, n, s, false);
+		}
+		lua_settop(L,n);
+	}
+	else {
+		luaL_Stream *f = (luaL_Stream*)luaL_checkudata(L, 1, LUA_FILEHANDLE);
+		if (f->closef == NULL) return luaL_error(L,"attempt to use a closed file");
+		for (;;) {
+			size_t got = fread(sax_reserve(L, s, JSON_CHUNK), 1, JSON_CHUNK, f->f);
+			if (got == 0) break;
+			s->len += got;
+			sax_call(L, n, s, false);
+		}
+		if (ferror(f->f)) return luaL_error(L, "cjson: read error");
+	}
+	sax_call(L, n, s, true);
+	lua_pushboolean(L,1);
+	return 1;
+}
+
+/* Encoder ================================================================ */
+/* ------------------------------------------------------------------------ */
+static int vec_gc( lua_State *L )
+{
+	json_vec_type *v = (json_vec_type*)luaL_checkudata(L,1,LUA_EXT_JSON_VEC);
+	free(v->data);
+	v->data = NULL;
+	v->len = v->cap = 0;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* growable buffer owned by a userdata, so an error can't leak it */
+static json_vec_type *vec_new( lua_State *L )
+{
+	json_vec_type *v = (json_vec_type*)lua_newuserdatauv(L, sizeof(json_vec_type), 0);
+	memset((void*)v,0,sizeof(json_vec_type));
+	luaL_setmetatable(L, LUA_EXT_JSON_VEC);
+	return v;
+}
+/* ------------------------------------------------------------------------ */
+static char *vec_reserve( lua_State *L, json_vec_type *v, size_t n )
+{
+	if (v->len + n > v->cap) {
+		size_t cap = (v->cap == 0)?256:v->cap;
+		while (cap < v->len + n) cap *= 2;
+		char *p = (char*)realloc(v->data, cap);
+		if (p == NULL) luaL_error(L, "cjson: not enough memory");
+		v->data = p;
+		v->cap = cap;
+	}
+	return v->data + v->len;
+}
+/* ------------------------------------------------------------------------ */
+static inline void vec_add( lua_State *L, json_vec_type *v, const char *s, size_t n )
+{
+	memcpy(vec_reserve(L, v, n), s, n);
+	v->len += n;
+}
+/* ------------------------------------------------------------------------ */
+static inline void vec_addc( lua_State *L, json_vec_type *v, char c )
+{
+	*vec_reserve(L, v, 1) = c;
+	v->len++;
+}
+/* ------------------------------------------------------------------------ */
+static void vec_fill( lua_State *L, json_vec_type *v, char c, size_t n )
+{
+	memset(vec_reserve(L, v, n), c, n);
+	v->len += n;
+}
+#define vec_addliteral(L,v,s)   vec_add(L,v,"" s, sizeof(s) - 1)
+
+/* ------------------------------------------------------------------------ */
+/* next byte that needs escaping, 0xE2 is checked when stringsAreUtf8 is set */
+static const char *enc_scan( const char *p, const char *end, bool utf8 )
+{
+	while (end - p >= 8) {
+		uint64_t v = swar_load(p);
+		uint64_t hit = swar_byte(v,'"') | swar_byte(v,'\\') | swar_less(v,0x20);
+		if (utf8) hit |= swar_byte(v,0xE2);
+		if (hit) break;
+		p += 8;
+	}
+	while ((p < end)&&!(json_class[(uint8_t)*p] & JC_ESC)&&((!utf8)||((uint8_t)*p != 0xE2))) ++p;
+	return p;
+}
+/* ------------------------------------------------------------------------ */
+static bool enc_is_separator( const char *p, const char *end )
+{
+	return (end - p >= 3)&&((uint8_t)p[1] == 0x80)&&(((uint8_t)p[2] == 0xA8)||((uint8_t)p[2] == 0xA9));
+}
+/* ------------------------------------------------------------------------ */
+/* escape rules of JSON.lua, '/' is left alone */
+static void enc_string( json_enc_type *e, const char *s, size_t len )
+{
+	static const char hex[] = "0123456789abcdef";
+	lua_State *L = e->L;
+	json_vec_type *o = e->out;
+	const char *end = s + len;
+	const char *run = s;
+
+	vec_addc(L, o, '"');
+	for (;;) {
+		s = enc_scan(s, end, e->utf8);
+		if (s >= end) break;
+		vec_add(L, o, run, s - run);
+		uint8_t c = (uint8_t)*s++;
+		switch (c) {
+		case '"':  vec_addliteral(L, o, "\\\""); break;
+		case '\\': vec_addliteral(L, o, "\\\\"); break;
+		case '\n': vec_addliteral(L, o, "\\n"); break;
+		case '\r': vec_addliteral(L, o, "\\r"); break;
+		case '\t': vec_addliteral(L, o, "\\t"); break;
+		case '\b': vec_addliteral(L, o, "\\b"); break;
+		case '\f': vec_addliteral(L, o, "\\f"); break;
+		case 0xE2:
+			if (enc_is_separator(s - 1, end)) {
+				vec_addliteral(L, o, "\\u202");
+				vec_addc(L, o, ((uint8_t)s[1] == 0xA8)?'8':'9');
+				s += 2;
+			}
+			else vec_addc(L, o, (char)c);
+			break;
+		default: {
+			char u[6] = {'\\', 'u', '0', '0', hex[c>>4], hex[c&0xF]};
+			vec_add(L, o, u, 6);
+			break;
+		}
+		}
+		run = s;
+	}
+	vec_add(L, o, run, end - run);
+	vec_addc(L, o, '"');
+}
+/* ------------------------------------------------------------------------ */
+/* length of the encoded key, for align_keys */
+static size_t enc_string_len( json_enc_type *e, const char *s, size_t len )
+{
+	const char *end = s + len;
+	size_t n = len + 2;
+
+	for (;;) {
+		s = enc_scan(s, end, e->utf8);
+		if (s >= end) return n;
+		uint8_t c = (uint8_t)*s;
+		if (c == 0xE2) {
+			if (enc_is_separator(s, end)) {
+				n += 3;
+				s += 2;
+			}
+		}
+		else if ((c == '"')||(c == '\\')||(c == '\n')||(c == '\r')||(c == '\t')||(c == '\b')||(c == '\f')) n += 1;
+		else n += 5;
+		++s;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* same text as tostring(), except for NaN and the infinities */
+static void enc_number( json_enc_type *e, int idx )
+{
+	char tmp[64];
+	int n;
+
+	if (lua_isinteger(e->L,idx)) {
+		n = snprintf(tmp, sizeof(tmp), LUA_INTEGER_FMT, (LUAI_UACINT)lua_tointeger(e->L,idx));
+	}
+	else {
+		lua_Number v = lua_tonumber(e->L,idx);
+		if (v != v) {
+			vec_addliteral(e->L, e->out, "null");
+			return;
+		}
+		if (v >= HUGE_VAL) {
+			vec_addliteral(e->L, e->out, "1e+9999");
+			return;
+		}
+		if (v <= -HUGE_VAL) {
+			vec_addliteral(e->L, e->out, "-1e+9999");
+			return;
+		}
+		n = snprintf(tmp, sizeof(tmp), LUA_NUMBER_FMT, (LUAI_UACNUMBER)v);
+		if (tmp[strspn(tmp, "-0123456789")] == '\0') {
+			tmp[n++] = '.';
+			tmp[n++] = '0';
+		}
+	}
+	vec_add(e->L, e->out, tmp, (size_t)n);
+}
+/* ------------------------------------------------------------------------ */
+static int enc_key_cmp( const void *a, const void *b )
+{
+	const json_key_type *ka = (const json_key_type*)a;
+	const json_key_type *kb = (const json_key_type*)b;
+
+	if (ka->numeric) return (ka->num < kb->num)?-1:((ka->num > kb->num)?1:0);
+	/* the same comparison Lua uses for strings, so the order matches table.sort() */
+	const char *l = ka->str, *r = kb->str;
+	size_t ll = ka->len, lr = kb->len;
+	for (;;) {
+		int temp = strcoll(l, r);
+		if (temp != 0) return temp;
+		size_t len = strlen(l);
+		if (len == lr) return (len == ll)?0:1;
+		if (len == ll) return -1;
+		++len;
+		l += len; ll -= len;
+		r += len; lr -= len;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static inline json_key_type *enc_key( json_enc_type *e, size_t mark, size_t indx )
+{
+	return (json_key_type*)(e->keys->data + mark) + indx;
+}
+/* ------------------------------------------------------------------------ */
+static void enc_push_key( json_enc_type *e, json_key_type *k, int idx )
+{
+	if (!k->numeric) lua_pushlstring(e->L, k->str, k->len);
+	else if (k->isint) lua_pushinteger(e->L, k->inum);
+	else lua_pushnumber(e->L, k->num);
+	lua_gettable(e->L, idx);
+}
+
+static void enc_value( json_enc_type *e, int idx );
+/* ------------------------------------------------------------------------ */
+static void enc_array( json_enc_type *e, int idx, lua_Integer count )
+{
+	lua_State *L = e->L;
+	size_t ind = e->indent->len;
+
+	if (e->array_newline) {
+		vec_add(L, e->indent, e->step, e->step_len);
+		vec_addliteral(L, e->out, "[\n");
+		vec_add(L, e->out, e->indent->data, e->indent->len);
+	}
+	else vec_add(L, e->out, "[ ", e->pretty?2:1);
+	for (lua_Integer indx = 1;indx<=count;++indx) {
+		if (indx > 1) {
+			if (e->array_newline) {
+				vec_addliteral(L, e->out, ",\n");
+				vec_add(L, e->out, e->indent->data, e->indent->len);
+			}
+			else vec_add(L, e->out, ", ", e->pretty?2:1);
+		}
+		lua_geti(L, idx, indx);
+		enc_value(e, -1);
+		lua_pop(L,1);
+	}
+	if (e->array_newline) {
+		e->indent->len = ind;
+		vec_addc(L, e->out, '\n');
+		vec_add(L, e->out, e->indent->data, ind);
+		vec_addc(L, e->out, ']');
+	}
+	else if (e->pretty) vec_addliteral(L, e->out, " ]");
+	else vec_addc(L, e->out, ']');
+}
+/* ------------------------------------------------------------------------ */
+static void enc_object( json_enc_type *e, int idx, size_t mark, size_t count )
+{
+	lua_State *L = e->L;
+
+	if (!e->pretty) {
+		vec_addc(L, e->out, '{');
+		for (size_t indx = 0;indx<count;++indx) {
+			json_key_type *k = enc_key(e, mark, indx);
+			if (indx > 0) vec_addc(L, e->out, ',');
+			enc_string(e, k->str, k->len);
+			vec_addc(L, e->out, ':');
+			enc_push_key(e, k, idx);
+			enc_value(e, -1);
+			lua_pop(L,1);
+		}
+		vec_addc(L, e->out, '}');
+		return;
+	}
+
+	size_t ind = e->indent->len;
+	size_t width = 0;
+	if (e->align_keys) {
+		for (size_t indx = 0;indx<count;++indx) {
+			json_key_type *k = enc_key(e, mark, indx);
+			size_t n = enc_string_len(e, k->str, k->len);
+			if (n > width) width = n;
+		}
+	}
+	vec_add(L, e->indent, e->step, e->step_len);
+	size_t key_ind = e->indent->len;
+
+	vec_addliteral(L, e->out, "{\n");
+	for (size_t indx = 0;indx<count;++indx) {
+		json_key_type *k = enc_key(e, mark, indx);
+		if (indx > 0) vec_addliteral(L, e->out, ",\n");
+		vec_add(L, e->out, e->indent->data, key_ind);
+		if (e->align_keys) vec_fill(L, e->out, ' ', width - enc_string_len(e, k->str, k->len));
+		enc_string(e, k->str, k->len);
+		vec_addliteral(L, e->out, ": ");
+		/* nested tables line up under the value */
+		vec_fill(L, e->indent, ' ', width + (e->align_keys?2:0));
+		enc_push_key(e, k, idx);
+		enc_value(e, -1);
+		lua_pop(L,1);
+		e->indent->len = key_ind;
+	}
+	e->indent->len = ind;
+	vec_addc(L, e->out, '\n');
+	vec_add(L, e->out, e->indent->data, ind);
+	vec_addc(L, e->out, '}');
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Tables follow JSON.lua: only positive number keys make an array sized by
+ * the largest key, anything else is an object with sorted keys, and mixed
+ * tables get their number keys converted to strings after the string keys.
+ */
+static void enc_table( json_enc_type *e, int idx )
+{
+	lua_State *L = e->L;
+	const void *ptr;
+
+	idx = lua_absindex(L,idx);
+	if ((e->number_mt != 0)&&(lua_getmetatable(L,idx))) {
+		bool is_number = lua_rawequal(L, -1, e->number_mt);
+		lua_pop(L,1);
+		if (is_number) {
+			size_t len;
+			const char *s = luaL_tolstring(L,idx,&len);
+			vec_add(L, e->out, s, len);
+			lua_pop(L,1);
+			return;
+		}
+	}
+	/* lazy nodes from cjson.lazy() are loaded before they are walked */
+	if (luaL_getmetafield(L, idx, "__cjson_load") != LUA_TNIL) {
+		lua_pushvalue(L,idx);
+		lua_call(L,1,0);
+	}
+
+	ptr = lua_topointer(L,idx);
+	for (int indx = 0;indx<e->depth;++indx) {
+		if (e->parents[indx] == ptr) {
+			luaL_tolstring(L,idx,NULL);
+			luaL_error(L, "table %s is a child of itself", lua_tostring(L,-1));
+		}
+	}
+	if (e->depth >= JSON_MAX_DEPTH) luaL_error(L, "cjson: too deeply nested");
+	luaL_checkstack(L, 8, "cjson: too deeply nested");
+	e->parents[e->depth++] = ptr;
+
+	size_t mark = e->keys->len;
+	size_t nstr = 0, nnum = 0;
+	bool must_be_strings = false;
+	bool have_max = false;
+	lua_Number max = 0;
+	json_key_type k;
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		lua_pop(L,1);
+		memset((void*)&k,0,sizeof(json_key_type));
+		switch (lua_type(L,-1)) {
+		case LUA_TSTRING:
+			k.str = lua_tolstring(L,-1,&k.len);
+			++nstr;
+			break;
+		case LUA_TBOOLEAN:
+			k.str = lua_toboolean(L,-1)?"true":"false";
+			k.len = strlen(k.str);
+			++nstr;
+			break;
+		case LUA_TNUMBER:
+			k.numeric = true;
+			k.isint = lua_isinteger(L,-1);
+			k.inum = lua_tointeger(L,-1);
+			k.num = lua_tonumber(L,-1);
+			if ((k.num <= 0)||(k.num >= HUGE_VAL)) must_be_strings = true;
+			else if ((!have_max)||(k.num > max)) {
+				max = k.num;
+				have_max = true;
+			}
+			++nnum;
+			break;
+		default:
+			luaL_error(L, "can't encode table with a key of type %s", luaL_typename(L,-1));
+			break;
+		}
+		vec_add(L, e->keys, (const char*)&k, sizeof(json_key_type));
+	}
+
+	if ((nstr == 0)&&(!must_be_strings)) {
+		if (nnum > 0) enc_array(e, idx, (lua_Integer)floor(max));
+		else {
+			bool object = false;
+			if (luaL_getmetafield(L, idx, "__tostring") != LUA_TNIL) {
+				lua_pop(L,1);
+				object = (strcmp(luaL_tolstring(L,idx,NULL), "JSON object") == 0);
+				lua_pop(L,1);
+			}
+			if (!object) vec_addliteral(L, e->out, "[]");
+			else if (e->pretty) {
+				vec_addliteral(L, e->out, "{\n\n");
+				vec_add(L, e->out, e->indent->data, e->indent->len);
+				vec_addc(L, e->out, '}');
+			}
+			else vec_addliteral(L, e->out, "{}");
+		}
+	}
+	else {
+		/* string keys first, sorted, then the number keys in numeric order */
+		size_t count = nstr + nnum;
+		json_key_type *base = enc_key(e, mark, 0);
+		size_t s = 0, n = count;
+		while (s < n) {
+			if (!base[s].numeric) ++s;
+			else {
+				json_key_type t = base[s];
+				base[s] = base[--n];
+				base[n] = t;
+			}
+		}
+		qsort(base, nstr, sizeof(json_key_type), enc_key_cmp);
+		if (nnum > 0) {
+			if (e->no_key_conversion) {
+				luaL_error(L, "a table with both numeric and string keys could be an object or array; aborting");
+			}
+			qsort(base + nstr, nnum, sizeof(json_key_type), enc_key_cmp);
+			lua_createtable(L, (int)nnum, 0);  /* keeps the converted keys alive */
+			for (size_t indx = nstr;indx<count;++indx) {
+				json_key_type *kp = enc_key(e, mark, indx);
+				if (kp->isint) lua_pushinteger(L, kp->inum);
+				else lua_pushnumber(L, kp->num);
+				kp->str = lua_tolstring(L,-1,&kp->len);
+				lua_pushvalue(L,-1);
+				if (lua_rawget(L,idx) != LUA_TNIL) {
+					luaL_error(L, "conflict converting table with mixed-type keys into a JSON object: key %s exists both as a string and a number.", kp->str);
+				}
+				lua_pop(L,1);
+				lua_rawseti(L, -2, (lua_Integer)(indx - nstr + 1));
+			}
+		}
+		enc_object(e, idx, mark, count);
+		if (nnum > 0) lua_pop(L,1);
+	}
+	e->keys->len = mark;
+	e->depth--;
+}
+/* ------------------------------------------------------------------------ */
+static void enc_value( json_enc_type *e, int idx )
+{
+	lua_State *L = e->L;
+	int t = lua_type(L,idx);
+
+	if ((t == LUA_TNIL)||((e->null_idx != 0)&&(lua_compare(L, idx, e->null_idx, LUA_OPEQ)))) {
+		vec_addliteral(L, e->out, "null");
+		return;
+	}
+	switch (t) {
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L,idx,&len);
+		enc_string(e, s, len);
+		break;
+	}
+	case LUA_TNUMBER:
+		enc_number(e, idx);
+		break;
+	case LUA_TBOOLEAN:
+		if (lua_toboolean(L,idx)) vec_addliteral(L, e->out, "true");
+		else vec_addliteral(L, e->out, "false");
+		break;
+	case LUA_TTABLE:
+		enc_table(e, idx);
+		break;
+	default:
+		luaL_error(L, "can't convert %s to JSON", lua_typename(L,t));
+		break;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* read the encode options table at index n, values are left on the stack */
+static void enc_options( lua_State *L, int n, json_enc_type *e )
+{
+	e->step = "";
+	if (lua_isnoneornil(L,n)) return;
+	luaL_checktype(L,n,LUA_TTABLE);
+	lua_getfield(L,n,"pretty");
+	e->pretty = lua_toboolean(L,-1);
+	lua_getfield(L,n,"align_keys");
+	e->align_keys = lua_toboolean(L,-1);
+	lua_getfield(L,n,"array_newline");
+	e->array_newline = lua_toboolean(L,-1);
+	lua_getfield(L,n,"stringsAreUtf8");
+	e->utf8 = lua_toboolean(L,-1);
+	lua_getfield(L,n,"noKeyConversion");
+	e->no_key_conversion = lua_toboolean(L,-1);
+	lua_pop(L,5);
+	if (lua_getfield(L,n,"indent") != LUA_TNIL) {
+		e->step = lua_tolstring(L,-1,&e->step_len);
+		if (e->step == NULL) luaL_error(L, "cjson: indent must be a string");
+	}
+	e->null_idx = dec_option(L, n, "null", false);
+	e->number_mt = dec_option(L, n, "number_mt", true);
+}
+/* ------------------------------------------------------------------------ */
+/* str = cjson.encode( value, opts ) */
+static int json_encode( lua_State *L )
+{
+	json_enc_type *e;
+
+	luaL_checkany(L,1);
+	lua_settop(L,2);
+	e = (json_enc_type*)lua_newuserdatauv(L, sizeof(json_enc_type), 0);
+	memset((void*)e,0,sizeof(json_enc_type));
+	e->L = L;
+	enc_options(L, 2, e);
+	e->out = vec_new(L);
+	e->keys = vec_new(L);
+	e->indent = vec_new(L);
+	enc_value(e, 1);
+	lua_pushlstring(L, e->out->data, e->out->len);
+	return 1;
+}
+
+/* Lua Interface ========================================================== */
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg json_parser_funcs[] = {
+		{"feed", sax_feed},
+		{"finish", sax_finish},
+		{"position", sax_position},
+		{NULL, NULL}
+};
+
+static const luaL_Reg json_lib[] = {
+		{"decode", json_decode},
+		{"lazy", json_lazy},
+		{"encode", json_encode},
+		{"parser", json_parser},
+		{"stream", json_stream},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_cjson( lua_State *L )
+{
+	json_init_class();
+
+	luaL_newmetatable(L, LUA_EXT_JSON_PARSER);
+	lua_pushcfunction(L, sax_gc);
+	lua_setfield(L, -2, "__gc");
+	luaL_newlibtable(L, json_parser_funcs);
+	luaL_setfuncs(L, json_parser_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newmetatable(L, LUA_EXT_JSON_VEC);
+	lua_pushcfunction(L, vec_gc);
+	lua_setfield(L, -2, "__gc");
+	lua_pop(L,1);
+
+	luaL_newmetatable(L, LUA_EXT_JSON_DOC);
+	lua_pop(L,1);
+
+	luaL_newlib(L, json_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,32 @@
+/*
+ * lua_ext_bytecache.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef SRC_LUA_EXT_BYTECACHE_H_
+#define SRC_LUA_EXT_BYTECACHE_H_
+
+#include "lua.h"
+
+/*
+ * Cache of the compiled scripts that xLua loads from source files: the
+ * main script and the modules require() finds on package.path.  A chunk
+ * is kept as the string.dump() of the source, keyed by the absolute path,
+ * the name it was loaded as, its mtime and size and the Lua release.  The
+ * cache is in LUA_BYTECACHE, or $XDG_CACHE_HOME/xlua, ~/.cache/xlua
+ * (%LOCALAPPDATA%\xlua on Windows) when it is not set; "0" turns it off.
+ * Entries are written to a temporary file and renamed, so programs that
+ * run at the same time never read a partial entry.  The directory is made
+ * with mode 0700; one owned by another user or writable by group or others
+ * turns the cache off.
+ */
+#define BYTECACHE_VAR         "LUA_BYTECACHE"
+
+/* replace the Lua file searcher of package.searchers with the cached one */
+void bytecache_install( lua_State *L );
+/* luaL_loadfile() through the cache, fname NULL is stdin (not cached) */
+int bytecache_loadfile( lua_State *L, const char *fname );
+
+#endif /* SRC_LUA_EXT_BYTECACHE_H_ */
@@ -0,0 +1,26 @@
+/*
+ * lua_ext_startup.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef SRC_LUA_EXT_STARTUP_H_
+#define SRC_LUA_EXT_STARTUP_H_
+
+#include "lua.h"
+
+/*
+ * Phases of the start of xLua and of the applets, timed when the
+ * environment variable LUA_STARTUP_TRACE is set: "1" prints a table to
+ * stderr when the program ends, any other value (but "0") is the path of a
+ * Chrome trace-event JSON file.  Phases nest, L is NULL while there is no
+ * state (the heap is not known then).
+ */
+#define STARTUP_TRACE_VAR     "LUA_STARTUP_TRACE"
+
+void startup_begin( lua_State *L, const char *phase );
+void startup_end( lua_State *L );
+void startup_report( void );
+
+#endif /* SRC_LUA_EXT_STARTUP_H_ */
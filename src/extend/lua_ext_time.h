@@ -0,0 +1,30 @@
+/*
+ * lua_ext_time.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef SRC_LUA_EXT_TIME_H_
+#define SRC_LUA_EXT_TIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lua.h"
+
+#define TIME_NS_PER_MS        (1000000LL)
+
+/* events of time_wait_io() */
+#define TIME_IO_READ          (1)
+#define TIME_IO_WRITE         (2)
+
+int64_t time_now_ns( void );
+void time_sleep_until( int64_t deadline );
+
+/* scheduler tasks of time.spawn()/time.run() */
+bool time_in_task( lua_State *L );
+bool time_can_wait_io( lua_State *L );
+void time_wait_io( lua_State *L, int fd, int events, int64_t deadline, lua_KFunction k );
+
+#endif /* SRC_LUA_EXT_TIME_H_ */
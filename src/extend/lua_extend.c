@@ -11,7 +11,7 @@
 
 #ifdef WIN32
 /* When windows is being used as the host OS, include the windows headers, and
- * the console IO headers to access functions like Sleep() and kbhit() 
+ * the console IO headers to access functions like Sleep()
  */
 #include <Windows.h>
 #include <conio.h>
@@ -20,47 +20,7 @@
 
 #include <unistd.h>
 #include <stdio.h>
-#include <sys/select.h>
-#include <sys/ioctl.h>
-#include <termios.h>
 #include <string.h>
-
-int kbhit() 
-{
-	struct termios old, current;
-
-	tcgetattr(0, &old); /* grab old terminal i/o settings */
-  	memcpy(&current, &old, sizeof(struct termios)); /* make new settings same as old settings */
-  	current.c_lflag &= ~ICANON; /* disable buffered i/o */
-	current.c_lflag &= ~ECHO; /* set no echo mode */
-  	tcsetattr(0, TCSANOW, &current); /* use these new terminal i/o settings now */
-
-    int bytesWaiting;
-    ioctl(0, FIONREAD, &bytesWaiting);
-
-	tcsetattr(0, TCSANOW, &old);
-
-    return bytesWaiting;
-}
-
-#define Sleep( ms )              usleep( ms * 1000 )
-
-int getch( void )
-{
-	struct termios old, current;
-	int ch = 0;
-
-	if (kbhit() ) {
-		tcgetattr(0, &old); /* grab old terminal i/o settings */
-		memcpy(&current, &old, sizeof(struct termios)); /* make new settings same as old settings */
-		current.c_lflag &= ~ICANON; /* disable buffered i/o */
-		current.c_lflag &= ~ECHO; /* set no echo mode */
-		tcsetattr(0, TCSANOW, &current); /* use these new terminal i/o settings now */
-		ch = getchar();
-		tcsetattr(0, TCSANOW, &old);
-	}
-	return ch;
-}
 #endif
 
 
@@ -71,13 +31,26 @@ int getch( void )
 
 int ext_ansi_print( lua_State *L );
 int ext_ansi_enable( lua_State *L );
+int ext_hexdump( lua_State *L );
+int ext_delay( lua_State *L );
+int ext_kbhit( lua_State *L );
+int ext_getc( lua_State *L );
+int ext_getkey( lua_State *L );
+int ext_hexdump_write( lua_State *L );
+int luaopen_cbase64( lua_State *L );
+int luaopen_hexfile( lua_State *L );
+int luaopen_cjson( lua_State *L );
+int luaopen_ccsv( lua_State *L );
+int luaopen_ctoml( lua_State *L );
+int luaopen_cxml( lua_State *L );
+int luaopen_time( lua_State *L );
+int luaopen_term( lua_State *L );
+int luaopen_screen( lua_State *L );
+int luaopen_cprogress( lua_State *L );
+int luaopen_zmodem( lua_State *L );
+int luaopen_frame( lua_State *L );
+int luaopen_capture( lua_State *L );
 
-static int lua_ext_delay( lua_State* L)
-{
-	uint32_t ms_delay = luaL_optinteger(L,1,1);
-	Sleep(ms_delay);
-	return 0;
-}
 /* ======================================================================== */
 #define swap_endian(v,bytes)   do {\
     for (uint32_t indx=0;indx<bytes/2;++indx) {\
@@ -328,22 +301,6 @@ static int lua_encrypt(lua_State *L)
 	return 3;
 }
 
-/* ------------------------------------------------------------------------ */
-static int lua_ext_getchar( lua_State *L)
-{
-	int v = getch();
-	if (v != 0) {
-		lua_pushlstring(L,(const char*)&v,1);
-	}
-	else lua_pushnil(L);
-	return 1;
-}
-/* ------------------------------------------------------------------------ */
-static int lua_ext_kbhit( lua_State *L )
-{
-	lua_pushboolean(L,kbhit());
-	return 1;
-}
 /* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- */
 LUALIB_API int luaopen_ext( lua_State *L)
 {
@@ -353,13 +310,17 @@ LUALIB_API int luaopen_ext( lua_State *L)
 	 * well as some other operations that are nice in C, but are a pain
 	 * using Lua (like type casting).
 	 */
-	lua_pushcfunction(L, lua_ext_delay);
+	lua_pushcfunction(L, ext_delay);
 	lua_setglobal(L, "delay");
 
 	lua_pushcfunction(L,ext_ansi_print);
 	lua_setglobal(L,"ansi");
 	lua_pushcfunction(L,ext_ansi_enable);
 	lua_setglobal(L,"ansi_enable");
+	lua_pushcfunction(L,ext_hexdump);
+	lua_setglobal(L,"hexdump");
+	lua_pushcfunction(L,ext_hexdump_write);
+	lua_setglobal(L,"hexdump_write");
 
 	lua_pushcfunction(L,conv_uint64);
 	lua_setglobal(L,"uint64");
@@ -381,12 +342,45 @@ LUALIB_API int luaopen_ext( lua_State *L)
 	lua_pushcfunction(L,conv_int16);
 	lua_setglobal(L,"int16");
 
-	lua_pushcfunction(L,lua_ext_getchar);
+	lua_pushcfunction(L,ext_getc);
 	lua_setglobal(L,"getc");
-	lua_pushcfunction(L,lua_ext_kbhit);
+	lua_pushcfunction(L,ext_kbhit);
 	lua_setglobal(L,"kbhit");
+	lua_pushcfunction(L,ext_getkey);
+	lua_setglobal(L,"getkey");
 
 	lua_register(L,"encrypt",lua_encrypt);
+
+	/*
+	 * Native libraries used by the modules when running in xLua or in a
+	 * compiled applet, these are also available through "require".
+	 */
+	luaL_requiref(L, "cbase64", luaopen_cbase64, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "hexfile", luaopen_hexfile, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "cjson", luaopen_cjson, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "ccsv", luaopen_ccsv, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "ctoml", luaopen_ctoml, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "cxml", luaopen_cxml, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "time", luaopen_time, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "term", luaopen_term, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "screen", luaopen_screen, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "cprogress", luaopen_cprogress, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "zmodem", luaopen_zmodem, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "frame", luaopen_frame, 1);
+	lua_pop(L,1);
+	luaL_requiref(L, "capture", luaopen_capture, 1);
+	lua_pop(L,1);
 	return 0;
 }
 
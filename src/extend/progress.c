@@ -0,0 +1,371 @@
+/*
+ * progress.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#include "lua_ext_time.h"
+
+#define LUA_EXT_PROGRESS      ("_PROGRESS_")
+
+/* user values of the progress object */
+#define PROGRESS_UV_CHAR      (1)     /**< glyph table, empty..full */
+#define PROGRESS_UV_BAR       (2)     /**< format string with ${BAR} and ${PCT} */
+#define PROGRESS_UV_FIELDS    (3)     /**< other fields set by the script */
+#define PROGRESS_UV_TEXT      (4)     /**< last rendered string */
+
+#define PROGRESS_GLYPHS       (5)
+#define PROGRESS_NONE         (-1)
+
+typedef struct {
+	lua_Number min;
+	lua_Number max;
+	lua_Number step;
+	lua_Number position;
+	lua_Integer size;
+	lua_Integer interval;  /**< ms between two outputs of show() */
+	lua_Integer key;       /**< visible state of the cached text */
+	int pct;               /**< percentage of the cached text */
+	int count;             /**< ${BAR} count of the cached text */
+	bool pct_shown;        /**< the format contains ${PCT} */
+	lua_Integer shown_key; /**< visible state on the terminal */
+	int shown_pct;
+	int64_t shown_at;
+} progress_type;
+
+int ext_ansi_print( lua_State *L );
+
+#define lua_ext_get_progress(L,n)  ( (progress_type*)luaL_checkudata(L,n,LUA_EXT_PROGRESS))
+
+/* Rendering ============================================================== */
+/* ------------------------------------------------------------------------ */
+/*
+ * The cells the bar shows at the current position, as one number: whole
+ * steps * 8 + glyph of the partial step.  Two positions with the same key
+ * render the same bar.
+ */
+static lua_Integer progress_key( const progress_type *p, lua_Number *frac_out, lua_Number *fill_out )
+{
+	lua_Number step_size = (p->max - p->min) / (lua_Number)p->size;
+	lua_Number frac = p->position / step_size;
+	lua_Number fill = floor(frac);
+	lua_Integer partial;
+
+	frac = frac - fill;
+	*frac_out = frac;
+	*fill_out = fill;
+	if (isnan(fill)||(fill < 0)) return 0;
+	if (fill >= (lua_Number)p->size) return p->size * 8;
+	partial = (frac > 0)?(lua_Integer)floor((frac*4)+1):1;
+	return (lua_Integer)fill * 8 + ((partial > 1)?partial:0);
+}
+/* ------------------------------------------------------------------------ */
+static int progress_percent( const progress_type *p )
+{
+	lua_Number pct;
+
+	if (!p->pct_shown) return 0;
+	pct = (p->position - p->min) * 100 / (p->max - p->min);
+	/* as progress2.lua: math.min(100, nan) is 100, so min == max shows 100 from min on */
+	if (isnan(pct)) return 100;
+	if (pct < 0) return 0;
+	if (pct > 100) return 100;
+	return (int)floor(pct);
+}
+/* ------------------------------------------------------------------------ */
+/* the glyph strings, they stay referenced by the char table */
+static void progress_glyphs( lua_State *L, int chars, const char **glyph, size_t *len )
+{
+	for (int indx = 0;indx<PROGRESS_GLYPHS;++indx) {
+		if (lua_rawgeti(L, chars, indx + 1) != LUA_TSTRING) {
+			luaL_error(L, "progress: char[%d] is not a string", indx + 1);
+		}
+		glyph[indx] = lua_tolstring(L, -1, &len[indx]);
+		lua_pop(L,1);
+	}
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Push the rendered bar, reusing the last string when the visible cells
+ * and the percentage have not changed.  Returns the ${BAR} count.
+ */
+static int progress_render_text( lua_State *L, int idx, progress_type *p )
+{
+	lua_Number frac, fill;
+	lua_Integer key = progress_key(p, &frac, &fill);
+	int pct = progress_percent(p);
+	const char *fmt, *mark, *glyph[PROGRESS_GLYPHS];
+	size_t glyph_len[PROGRESS_GLYPHS];
+	int chars, count = 0;
+	luaL_Buffer b;
+
+	if ((key == p->key)&&(pct == p->pct)) {
+		if (lua_getiuservalue(L, idx, PROGRESS_UV_TEXT) == LUA_TSTRING) return p->count;
+		lua_pop(L,1);
+	}
+	lua_getiuservalue(L, idx, PROGRESS_UV_CHAR);
+	chars = lua_gettop(L);
+	progress_glyphs(L, chars, glyph, glyph_len);
+	lua_getiuservalue(L, idx, PROGRESS_UV_BAR);
+	fmt = lua_tostring(L, -1);
+	luaL_buffinit(L, &b);
+	while ((mark = strstr(fmt, "${")) != NULL) {
+		luaL_addlstring(&b, fmt, (size_t)(mark - fmt));
+		if (strncmp(mark, "${BAR}", 6) == 0) {
+			for (lua_Integer step = 1;step<=p->size;++step) {
+				int chr = 1;
+				if (fill >= (lua_Number)step) chr = 5;
+				else if (((fill+1) == (lua_Number)step)&&(frac > 0)) chr = (int)floor((frac*4)+1);
+				luaL_addlstring(&b, glyph[chr-1], glyph_len[chr-1]);
+			}
+			++count;
+			fmt = mark + 6;
+		}
+		else if (strncmp(mark, "${PCT}", 6) == 0) {
+			char num[8];
+			int n = snprintf(num, sizeof(num), "%d", pct);
+			luaL_addlstring(&b, num, (size_t)n);
+			fmt = mark + 6;
+		}
+		else {
+			luaL_addlstring(&b, mark, 2);
+			fmt = mark + 2;
+		}
+	}
+	luaL_addstring(&b, fmt);
+	luaL_pushresult(&b);
+	lua_replace(L, chars);
+	lua_pop(L,1);                       /* format */
+	lua_pushvalue(L, -1);
+	lua_setiuservalue(L, idx, PROGRESS_UV_TEXT);
+	p->key = key;
+	p->pct = pct;
+	p->count = count;
+	return count;
+}
+/* ------------------------------------------------------------------------ */
+/* numbers keep the integer subtype when they have an integral value */
+static void progress_push_number( lua_State *L, lua_Number n )
+{
+	lua_Integer i;
+	if (lua_numbertointeger(n, &i) && ((lua_Number)i == n)) lua_pushinteger(L, i);
+	else lua_pushnumber(L, n);
+}
+
+/* Methods ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* str = PB:render() */
+static int progress_render( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	int count;
+
+	lua_settop(L, 1);
+	count = progress_render_text(L, 1, p);
+	lua_pushinteger(L, count);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* current, str = PB:pos( new ) */
+static int progress_pos( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	int count;
+
+	if (!lua_isnoneornil(L, 2)) {
+		p->position = luaL_checknumber(L, 2);
+		return 0;
+	}
+	lua_settop(L, 1);
+	progress_push_number(L, p->position);
+	count = progress_render_text(L, 1, p);
+	lua_pushinteger(L, count);
+	return 3;
+}
+/* ------------------------------------------------------------------------ */
+/* str = PB:next() */
+static int progress_next( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	int count;
+
+	p->position += p->step;
+	if (p->position > p->max) p->position = p->max;
+	lua_settop(L, 1);
+	count = progress_render_text(L, 1, p);
+	lua_pushinteger(L, count);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * shown = PB:show( pos )
+ * Write "\r" and the bar through ansi() when the visible cells or the
+ * percentage changed, at most once every PB.interval ms.  The first and
+ * the final (max) position are always written.
+ */
+static int progress_show( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	lua_Number frac, fill;
+	lua_Integer key;
+	int64_t now;
+	bool last;
+
+	if (!lua_isnoneornil(L, 2)) p->position = luaL_checknumber(L, 2);
+	lua_settop(L, 1);
+	key = progress_key(p, &frac, &fill);
+	last = (p->position >= p->max);
+	if ((key == p->shown_key)&&(progress_percent(p) == p->shown_pct)) {
+		lua_pushboolean(L, false);
+		return 1;
+	}
+	now = time_now_ns();
+	if ((p->shown_key != PROGRESS_NONE)&&!last&&(now - p->shown_at < p->interval * TIME_NS_PER_MS)) {
+		lua_pushboolean(L, false);
+		return 1;
+	}
+	lua_pushcfunction(L, ext_ansi_print);
+	lua_pushliteral(L, "\r");
+	progress_render_text(L, 1, p);
+	lua_concat(L, 2);
+	lua_call(L, 1, 0);
+	p->shown_key = key;
+	p->shown_pct = p->pct;
+	p->shown_at = now;
+	lua_pushboolean(L, true);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static const luaL_Reg progress_funcs[] = {
+		{"render", progress_render},
+		{"pos", progress_pos},
+		{"next", progress_next},
+		{"show", progress_show},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+/* PB.field, methods first, then the bar settings, then script fields */
+static int progress_index( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	/* lua_tostring() would turn a number key into a string on the stack */
+	const char *key = (lua_type(L, 2) == LUA_TSTRING) ? lua_tostring(L, 2) : NULL;
+
+	if (lua_getfield(L, lua_upvalueindex(1), (key != NULL)?key:"") != LUA_TNIL) return 1;
+	lua_pop(L,1);
+	if (key != NULL) {
+		if (strcmp(key, "position") == 0) { progress_push_number(L, p->position); return 1; }
+		if (strcmp(key, "min") == 0) { progress_push_number(L, p->min); return 1; }
+		if (strcmp(key, "max") == 0) { progress_push_number(L, p->max); return 1; }
+		if (strcmp(key, "step") == 0) { progress_push_number(L, p->step); return 1; }
+		if (strcmp(key, "size") == 0) { lua_pushinteger(L, p->size); return 1; }
+		if (strcmp(key, "interval") == 0) { lua_pushinteger(L, p->interval); return 1; }
+		if (strcmp(key, "char") == 0) { lua_getiuservalue(L, 1, PROGRESS_UV_CHAR); return 1; }
+		if (strcmp(key, "bar") == 0) { lua_getiuservalue(L, 1, PROGRESS_UV_BAR); return 1; }
+	}
+	lua_getiuservalue(L, 1, PROGRESS_UV_FIELDS);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+static int progress_newindex( lua_State *L )
+{
+	progress_type *p = lua_ext_get_progress(L, 1);
+	const char *key = (lua_type(L, 2) == LUA_TSTRING) ? lua_tostring(L, 2) : NULL;
+
+	if (key != NULL) {
+		if (strcmp(key, "position") == 0) { p->position = luaL_checknumber(L, 3); return 0; }
+		if (strcmp(key, "step") == 0) { p->step = luaL_optnumber(L, 3, 1); return 0; }
+		if (strcmp(key, "interval") == 0) { p->interval = luaL_optinteger(L, 3, 0); return 0; }
+		p->key = PROGRESS_NONE;       /* the rest changes how the bar looks */
+		p->shown_key = PROGRESS_NONE;
+		if (strcmp(key, "min") == 0) { p->min = luaL_checknumber(L, 3); return 0; }
+		if (strcmp(key, "max") == 0) { p->max = luaL_checknumber(L, 3); return 0; }
+		if (strcmp(key, "size") == 0) {
+			p->size = luaL_checkinteger(L, 3);
+			luaL_argcheck(L, p->size >= 0, 3, "size must not be negative");
+			return 0;
+		}
+		if (strcmp(key, "char") == 0) {
+			luaL_checktype(L, 3, LUA_TTABLE);
+			lua_settop(L, 3);
+			lua_setiuservalue(L, 1, PROGRESS_UV_CHAR);
+			return 0;
+		}
+		if (strcmp(key, "bar") == 0) {
+			p->pct_shown = (strstr(luaL_checkstring(L, 3), "${PCT}") != NULL);
+			lua_settop(L, 3);
+			lua_setiuservalue(L, 1, PROGRESS_UV_BAR);
+			return 0;
+		}
+	}
+	lua_getiuservalue(L, 1, PROGRESS_UV_FIELDS);
+	lua_pushvalue(L, 2);
+	lua_pushvalue(L, 3);
+	lua_rawset(L, -3);
+	return 0;
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+/*
+ * PB = cprogress.new( size, max, min, char, bar )
+ * char and bar are the glyph table and format of progress2.lua.  A size of
+ * 0 renders ${BAR} empty, as the Lua bar does.
+ */
+static int progress_new( lua_State *L )
+{
+	progress_type *p;
+
+	p = (progress_type*)lua_newuserdatauv(L, sizeof(progress_type), 4);
+	memset(p, 0, sizeof(progress_type));
+	p->size = luaL_optinteger(L, 1, 50);
+	p->max = luaL_optnumber(L, 2, 100);
+	p->min = luaL_optnumber(L, 3, 0);
+	p->step = 1;
+	p->key = PROGRESS_NONE;
+	p->shown_key = PROGRESS_NONE;
+	luaL_argcheck(L, p->size >= 0, 1, "size must not be negative");
+	luaL_checktype(L, 4, LUA_TTABLE);
+	luaL_checkstring(L, 5);
+	lua_pushvalue(L, 4);
+	lua_setiuservalue(L, -2, PROGRESS_UV_CHAR);
+	lua_pushvalue(L, 5);
+	lua_setiuservalue(L, -2, PROGRESS_UV_BAR);
+	lua_newtable(L);
+	lua_setiuservalue(L, -2, PROGRESS_UV_FIELDS);
+	luaL_setmetatable(L, LUA_EXT_PROGRESS);
+	return 1;
+}
+
+static const luaL_Reg progress_lib[] = {
+		{"new", progress_new},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_cprogress( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_PROGRESS);
+	luaL_newlibtable(L, progress_funcs);
+	luaL_setfuncs(L, progress_funcs, 0);
+	lua_pushcclosure(L, progress_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, progress_newindex);
+	lua_setfield(L, -2, "__newindex");
+	lua_pop(L,1);
+
+	luaL_newlib(L, progress_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,540 @@
+/*
+ * screen.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define LUA_EXT_SCREEN        ("_SCREEN_")
+
+#define SCREEN_DEFAULT        (-1)    /**< the terminal's own color */
+#define SCREEN_BLANK          (' ')
+#define SCREEN_MAX_SIZE       (1000)  /**< rows or cols */
+
+/*
+ * One character cell.  The glyph is a single UTF-8 character with the
+ * first byte in the low bits, colors use the 0-255 model of ansi().
+ */
+typedef struct {
+	uint32_t glyph;
+	int16_t fg;
+	int16_t bg;
+} screen_cell_type;
+
+/*
+ * Scripts draw into back; flush() sends the cells that differ from front
+ * (what the terminal shows) and then copies them to front.
+ */
+typedef struct {
+	int rows;
+	int cols;
+	screen_cell_type *front;
+	screen_cell_type *back;
+	int16_t fg;            /**< pen used by put(), fill() and clear() */
+	int16_t bg;
+	bool clear;            /**< the next flush starts from a cleared screen */
+} screen_type;
+
+/* terminal state while a frame is emitted, 0 is an unknown position */
+typedef struct {
+	int row;
+	int col;
+	bool pen;
+	int16_t fg;
+	int16_t bg;
+} screen_emit_type;
+
+#define lua_ext_get_screen(L,n)  ( (screen_type*)luaL_checkudata(L,n,LUA_EXT_SCREEN))
+
+/* Cells ================================================================== */
+/* ------------------------------------------------------------------------ */
+static inline bool screen_cell_equal( const screen_cell_type *a, const screen_cell_type *b )
+{
+	return (a->glyph == b->glyph)&&(a->fg == b->fg)&&(a->bg == b->bg);
+}
+/* ------------------------------------------------------------------------ */
+static inline int screen_glyph_bytes( uint32_t glyph, char *out )
+{
+	uint8_t lead = (uint8_t)glyph;
+	int len = (lead < 0x80)?1:((lead < 0xE0)?2:((lead < 0xF0)?3:4));
+	for (int indx = 0;indx<len;++indx) out[indx] = (char)(glyph >> (8*indx));
+	return len;
+}
+/* ------------------------------------------------------------------------ */
+/* decode one character of s, invalid UTF-8 becomes '?' */
+static size_t screen_next_glyph( const char *s, size_t len, uint32_t *glyph )
+{
+	const uint8_t *p = (const uint8_t*)s;
+	size_t n = (p[0] < 0xC0)?1:((p[0] < 0xE0)?2:((p[0] < 0xF0)?3:4));
+
+	if ((p[0] >= 0x80)&&((p[0] < 0xC0)||(p[0] > 0xF4)||(n > len))) {
+		*glyph = '?';
+		return 1;
+	}
+	*glyph = 0;
+	for (size_t indx = 0;indx<n;++indx) {
+		if ((indx > 0)&&((p[indx] & 0xC0) != 0x80)) {
+			*glyph = '?';
+			return indx;
+		}
+		*glyph |= (uint32_t)p[indx] << (8*indx);
+	}
+	return n;
+}
+/* ------------------------------------------------------------------------ */
+static void screen_fill_cells( screen_cell_type *cells, size_t count, uint32_t glyph, int16_t fg, int16_t bg )
+{
+	for (size_t indx = 0;indx<count;++indx) {
+		cells[indx].glyph = glyph;
+		cells[indx].fg = fg;
+		cells[indx].bg = bg;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static int16_t screen_opt_color( lua_State *L, int arg, int16_t def )
+{
+	lua_Integer c;
+
+	if (lua_isnoneornil(L, arg)) return def;
+	c = luaL_checkinteger(L, arg);
+	luaL_argcheck(L, (c >= SCREEN_DEFAULT)&&(c <= 255), arg, "color out of range");
+	return (int16_t)c;
+}
+/* ------------------------------------------------------------------------ */
+static void screen_alloc( lua_State *L, screen_type *s, int rows, int cols )
+{
+	size_t count = (size_t)rows * (size_t)cols;
+	screen_cell_type *front = (screen_cell_type*)malloc(count * sizeof(screen_cell_type));
+	screen_cell_type *back = (screen_cell_type*)malloc(count * sizeof(screen_cell_type));
+
+	if ((front == NULL)||(back == NULL)) {
+		free(front);
+		free(back);
+		luaL_error(L, "screen: out of memory");
+	}
+	screen_fill_cells(front, count, SCREEN_BLANK, SCREEN_DEFAULT, SCREEN_DEFAULT);
+	screen_fill_cells(back, count, SCREEN_BLANK, SCREEN_DEFAULT, SCREEN_DEFAULT);
+	if (s->back != NULL) {
+		/* keep what was drawn in the part that is still visible */
+		for (int r = 0;(r<rows)&&(r<s->rows);++r) {
+			memcpy(&back[(size_t)r*cols], &s->back[(size_t)r*s->cols],
+				(size_t)((cols < s->cols)?cols:s->cols) * sizeof(screen_cell_type));
+		}
+	}
+	free(s->front);
+	free(s->back);
+	s->front = front;
+	s->back = back;
+	s->rows = rows;
+	s->cols = cols;
+	s->clear = true;
+}
+/* ------------------------------------------------------------------------ */
+/* size of the terminal on stdout, 24x80 when it is not a terminal */
+static void screen_term_size( int *rows, int *cols )
+{
+	*rows = 24;
+	*cols = 80;
+#ifdef WIN32
+	CONSOLE_SCREEN_BUFFER_INFO info;
+	if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+		*rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+		*cols = info.srWindow.Right - info.srWindow.Left + 1;
+	}
+#else
+	struct winsize ws;
+	if ((ioctl(1, TIOCGWINSZ, &ws) == 0)&&(ws.ws_row > 0)&&(ws.ws_col > 0)) {
+		*rows = ws.ws_row;
+		*cols = ws.ws_col;
+	}
+#endif
+}
+
+/* Frame Output =========================================================== */
+/* ------------------------------------------------------------------------ */
+static void screen_color( luaL_Buffer *b, int16_t color, bool bg )
+{
+	char seq[16];
+	int n;
+
+	if (color == SCREEN_DEFAULT) n = snprintf(seq, sizeof(seq), "%d9", bg?4:3);
+	else if (color > 15) n = snprintf(seq, sizeof(seq), "%d8;5;%d", bg?4:3, color);
+	else if (color > 7) n = snprintf(seq, sizeof(seq), "%s%d", bg?"10":"9", color - 8);
+	else n = snprintf(seq, sizeof(seq), "%d%d", bg?4:3, color);
+	luaL_addlstring(b, seq, (size_t)n);
+}
+/* ------------------------------------------------------------------------ */
+/* one SGR sequence with only the colors that change */
+static void screen_pen( luaL_Buffer *b, screen_emit_type *e, int16_t fg, int16_t bg )
+{
+	bool sep = false;
+
+	if (e->pen && (fg == e->fg) && (bg == e->bg)) return;
+	luaL_addstring(b, "\x1b[");
+	if (!e->pen) {
+		luaL_addchar(b, '0');
+		sep = true;
+	}
+	if ((fg != SCREEN_DEFAULT || e->pen) && (!e->pen || fg != e->fg)) {
+		if (sep) luaL_addchar(b, ';');
+		screen_color(b, fg, false);
+		sep = true;
+	}
+	if ((bg != SCREEN_DEFAULT || e->pen) && (!e->pen || bg != e->bg)) {
+		if (sep) luaL_addchar(b, ';');
+		screen_color(b, bg, true);
+	}
+	luaL_addchar(b, 'm');
+	e->pen = true;
+	e->fg = fg;
+	e->bg = bg;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Move the cursor with the shortest sequence: CR/LF, a relative move,
+ * reprinting a few unchanged cells, or an absolute position.
+ */
+static void screen_move( luaL_Buffer *b, screen_emit_type *e, const screen_type *s, int row, int col )
+{
+	char seq[24], rel[24];
+	int n, nrel = -1;
+
+	if ((e->row == row)&&(e->col == col)) return;
+	if ((row == 1)&&(col == 1)) n = snprintf(seq, sizeof(seq), "\x1b[H");
+	else if (col == 1) n = snprintf(seq, sizeof(seq), "\x1b[%dH", row);
+	else n = snprintf(seq, sizeof(seq), "\x1b[%d;%dH", row, col);
+
+	if ((e->row != 0)&&(col == 1)&&((row == e->row)||(row == e->row + 1))) {
+		nrel = snprintf(rel, sizeof(rel), (row == e->row)?"\r":"\r\n");
+	}
+	else if ((e->col != 0)&&(row == e->row)&&(col > e->col)) {
+		const screen_cell_type *cell = &s->back[(size_t)(row-1)*s->cols + (e->col-1)];
+		int gap = col - e->col, len = 0;
+		bool same = e->pen;
+
+		nrel = snprintf(rel, sizeof(rel), (gap == 1)?"\x1b[C":"\x1b[%dC", gap);
+		/* the skipped cells are unchanged, print them again when that is shorter */
+		for (int indx = 0;same && (indx<gap) && (len < nrel);++indx) {
+			same = (cell[indx].fg == e->fg)&&(cell[indx].bg == e->bg);
+			if (same) len += screen_glyph_bytes(cell[indx].glyph, &rel[len]);
+		}
+		if (same && (len < nrel)) nrel = len;
+		else nrel = snprintf(rel, sizeof(rel), (gap == 1)?"\x1b[C":"\x1b[%dC", gap);
+	}
+	if ((nrel >= 0)&&(nrel < n)) luaL_addlstring(b, rel, (size_t)nrel);
+	else luaL_addlstring(b, seq, (size_t)n);
+	e->row = row;
+	e->col = col;
+}
+/* ------------------------------------------------------------------------ */
+/* add the bytes that bring the terminal from front to back */
+static void screen_frame( luaL_Buffer *b, screen_type *s )
+{
+	screen_emit_type e = { 0, 0, false, SCREEN_DEFAULT, SCREEN_DEFAULT };
+	size_t count = (size_t)s->rows * (size_t)s->cols;
+
+	if (s->clear) {
+		luaL_addstring(b, "\x1b[0m\x1b[2J");
+		screen_fill_cells(s->front, count, SCREEN_BLANK, SCREEN_DEFAULT, SCREEN_DEFAULT);
+		e.pen = true;
+		s->clear = false;
+	}
+	for (int r = 1;r<=s->rows;++r) {
+		screen_cell_type *front = &s->front[(size_t)(r-1)*s->cols];
+		screen_cell_type *back = &s->back[(size_t)(r-1)*s->cols];
+		for (int c = 1;c<=s->cols;++c) {
+			char g[4];
+			if (screen_cell_equal(&front[c-1], &back[c-1])) continue;
+			screen_move(b, &e, s, r, c);
+			screen_pen(b, &e, back[c-1].fg, back[c-1].bg);
+			luaL_addlstring(b, g, (size_t)screen_glyph_bytes(back[c-1].glyph, g));
+			front[c-1] = back[c-1];
+			/* the terminal holds the cursor on the last column, position is unknown */
+			e.col = (c < s->cols)?c + 1:0;
+		}
+	}
+	if (e.pen && ((e.fg != SCREEN_DEFAULT)||(e.bg != SCREEN_DEFAULT))) luaL_addstring(b, "\x1b[0m");
+}
+
+/* Screen Methods ========================================================= */
+/* ------------------------------------------------------------------------ */
+static int screen_gc( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	free(s->front);
+	free(s->back);
+	s->front = NULL;
+	s->back = NULL;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * row, col = s:put( row, col, text, fg, bg )
+ * Draw text into the back buffer.  "{c n}" and "{b n}" (also fg/bg)
+ * change the color as in ansi(), "{{" is a brace and "\n" continues on
+ * the next row.  Returns the position after the text.
+ */
+static int screen_put( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	int row = (int)luaL_checkinteger(L, 2);
+	int col = (int)luaL_checkinteger(L, 3), start = col;
+	size_t len;
+	const char *text = luaL_checklstring(L, 4, &len);
+	int16_t fg = screen_opt_color(L, 5, s->fg);
+	int16_t bg = screen_opt_color(L, 6, s->bg);
+	size_t indx = 0;
+
+	while (indx < len) {
+		uint32_t glyph;
+		if ((text[indx] == '{')&&((indx + 1 < len)&&(text[indx+1] != '{'))) {
+			/* color commands */
+			while ((indx < len)&&(text[indx] != '}')) {
+				char cmd[4];
+				size_t n = 0;
+				long value = 0;
+				bool digits = false;
+				++indx;
+				while ((indx < len)&&(((text[indx]|0x20) >= 'a')&&((text[indx]|0x20) <= 'z'))) {
+					if (n < sizeof(cmd) - 1) cmd[n++] = (char)(text[indx]|0x20);
+					++indx;
+				}
+				cmd[n] = 0;
+				while ((indx < len)&&(text[indx] >= '0')&&(text[indx] <= '9')) {
+					value = value*10 + (text[indx++] - '0');
+					digits = true;
+				}
+				while ((indx < len)&&(text[indx] != ';')&&(text[indx] != '}')) ++indx;
+				if (digits && (value <= 255)) {
+					if ((strcmp(cmd, "c") == 0)||(strcmp(cmd, "fg") == 0)) fg = (int16_t)value;
+					else if ((strcmp(cmd, "b") == 0)||(strcmp(cmd, "bg") == 0)) bg = (int16_t)value;
+				}
+			}
+			++indx;
+			continue;
+		}
+		if ((text[indx] == '{')&&(++indx >= len)) break;     /* "{{" */
+		if (text[indx] == '\n') {
+			++row;
+			col = start;
+			++indx;
+			continue;
+		}
+		indx += screen_next_glyph(&text[indx], len - indx, &glyph);
+		if (glyph < 0x20) continue;
+		if ((row >= 1)&&(row <= s->rows)&&(col >= 1)&&(col <= s->cols)) {
+			screen_cell_type *cell = &s->back[(size_t)(row-1)*s->cols + (col-1)];
+			cell->glyph = glyph;
+			cell->fg = fg;
+			cell->bg = bg;
+		}
+		++col;
+	}
+	lua_pushinteger(L, row);
+	lua_pushinteger(L, col);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* s:fill( row, col, height, width, char, fg, bg ) */
+static int screen_fill( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	int row = (int)luaL_checkinteger(L, 2);
+	int col = (int)luaL_checkinteger(L, 3);
+	int height = (int)luaL_checkinteger(L, 4);
+	int width = (int)luaL_checkinteger(L, 5);
+	size_t len;
+	const char *ch = luaL_optlstring(L, 6, " ", &len);
+	int16_t fg = screen_opt_color(L, 7, s->fg);
+	int16_t bg = screen_opt_color(L, 8, s->bg);
+	uint32_t glyph = SCREEN_BLANK;
+	int r0 = (row < 1)?1:row, r1 = row + height - 1;
+	int c0 = (col < 1)?1:col, c1 = col + width - 1;
+
+	if (len > 0) screen_next_glyph(ch, len, &glyph);
+	if (r1 > s->rows) r1 = s->rows;
+	if (c1 > s->cols) c1 = s->cols;
+	for (int r = r0;r<=r1;++r) {
+		if (c1 >= c0) screen_fill_cells(&s->back[(size_t)(r-1)*s->cols + (c0-1)], (size_t)(c1 - c0 + 1), glyph, fg, bg);
+	}
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* s:clear( fg, bg ), blank the back buffer */
+static int screen_clear( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	int16_t fg = screen_opt_color(L, 2, s->fg);
+	int16_t bg = screen_opt_color(L, 3, s->bg);
+	screen_fill_cells(s->back, (size_t)s->rows * (size_t)s->cols, SCREEN_BLANK, fg, bg);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* s:color( fg, bg ), the pen for later drawing, -1 is the terminal color */
+static int screen_set_color( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	s->fg = screen_opt_color(L, 2, s->fg);
+	s->bg = screen_opt_color(L, 3, s->bg);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* char, fg, bg = s:get( row, col ), from the back buffer */
+static int screen_get( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	int row = (int)luaL_checkinteger(L, 2);
+	int col = (int)luaL_checkinteger(L, 3);
+	screen_cell_type *cell;
+	char g[4];
+
+	if ((row < 1)||(row > s->rows)||(col < 1)||(col > s->cols)) return 0;
+	cell = &s->back[(size_t)(row-1)*s->cols + (col-1)];
+	lua_pushlstring(L, g, (size_t)screen_glyph_bytes(cell->glyph, g));
+	lua_pushinteger(L, cell->fg);
+	lua_pushinteger(L, cell->bg);
+	return 3;
+}
+/* ------------------------------------------------------------------------ */
+/* n = s:flush(), write the changed cells to stdout, n is the byte count */
+static int screen_flush( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	luaL_Buffer b;
+
+	luaL_buffinit(L, &b);
+	screen_frame(&b, s);
+	if (luaL_bufflen(&b) > 0) {
+		fwrite(luaL_buffaddr(&b), 1, luaL_bufflen(&b), stdout);
+		fflush(stdout);
+	}
+	lua_pushinteger(L, (lua_Integer)luaL_bufflen(&b));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* str = s:render(), the bytes flush() would write */
+static int screen_render( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	luaL_Buffer b;
+
+	luaL_buffinit(L, &b);
+	screen_frame(&b, s);
+	luaL_pushresult(&b);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* s:invalidate(), redraw everything on the next flush */
+static int screen_invalidate( lua_State *L )
+{
+	lua_ext_get_screen(L, 1)->clear = true;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* rows, cols = s:size() */
+static int screen_size( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	lua_pushinteger(L, s->rows);
+	lua_pushinteger(L, s->cols);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* s:resize( rows, cols ), keeps the drawing and redraws on the next flush */
+static int screen_resize( lua_State *L )
+{
+	screen_type *s = lua_ext_get_screen(L, 1);
+	int rows, cols;
+
+	screen_term_size(&rows, &cols);
+	rows = (int)luaL_optinteger(L, 2, rows);
+	cols = (int)luaL_optinteger(L, 3, cols);
+	luaL_argcheck(L, (rows > 0)&&(rows <= SCREEN_MAX_SIZE), 2, "invalid size");
+	luaL_argcheck(L, (cols > 0)&&(cols <= SCREEN_MAX_SIZE), 3, "invalid size");
+	screen_alloc(L, s, rows, cols);
+	return 0;
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* s = screen.new( rows, cols ), the terminal size by default */
+static int screen_new( lua_State *L )
+{
+	screen_type *s;
+	int rows, cols;
+
+	screen_term_size(&rows, &cols);
+	rows = (int)luaL_optinteger(L, 1, rows);
+	cols = (int)luaL_optinteger(L, 2, cols);
+	luaL_argcheck(L, (rows > 0)&&(rows <= SCREEN_MAX_SIZE), 1, "invalid size");
+	luaL_argcheck(L, (cols > 0)&&(cols <= SCREEN_MAX_SIZE), 2, "invalid size");
+	s = (screen_type*)lua_newuserdatauv(L, sizeof(screen_type), 0);
+	memset(s, 0, sizeof(screen_type));
+	s->fg = SCREEN_DEFAULT;
+	s->bg = SCREEN_DEFAULT;
+	luaL_setmetatable(L, LUA_EXT_SCREEN);
+	screen_alloc(L, s, rows, cols);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* rows, cols = screen.termsize() */
+static int screen_termsize( lua_State *L )
+{
+	int rows, cols;
+	screen_term_size(&rows, &cols);
+	lua_pushinteger(L, rows);
+	lua_pushinteger(L, cols);
+	return 2;
+}
+
+static const luaL_Reg screen_funcs[] = {
+		{"put", screen_put},
+		{"fill", screen_fill},
+		{"clear", screen_clear},
+		{"color", screen_set_color},
+		{"get", screen_get},
+		{"flush", screen_flush},
+		{"render", screen_render},
+		{"invalidate", screen_invalidate},
+		{"size", screen_size},
+		{"resize", screen_resize},
+		{NULL, NULL}
+};
+
+static const luaL_Reg screen_lib[] = {
+		{"new", screen_new},
+		{"termsize", screen_termsize},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_screen( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_SCREEN);
+	lua_pushcfunction(L, screen_gc);
+	lua_setfield(L, -2, "__gc");
+	luaL_newlibtable(L, screen_funcs);
+	luaL_setfuncs(L, screen_funcs, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L,1);
+
+	luaL_newlib(L, screen_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
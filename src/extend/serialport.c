@@ -1,8 +1,49 @@
+#include <stddef.h>
+#include "serialport.h"
+
+/* Taps =================================================================== */
+#define SP_MAX_TAPS          (8)
+
+static struct {
+	HANDLE port;
+	sp_tap_type tap;
+	void *ctx;
+} sp_taps[ SP_MAX_TAPS ];
+static uint32_t sp_tap_count;          /**< taps in use, the I/O path only looks when > 0 */
+
+/* ------------------------------------------------------------------------ */
+bool setSerialPortTap(HANDLE hSerial, sp_tap_type tap, void *ctx)
+{
+	int free_slot = -1;
+
+	for (int i = 0; i < SP_MAX_TAPS; ++i) {
+		if ((sp_taps[i].tap != NULL)&&(sp_taps[i].port == hSerial)) {
+			sp_taps[i].tap = NULL;
+			sp_tap_count--;
+		}
+		if ((sp_taps[i].tap == NULL)&&(free_slot < 0)) free_slot = i;
+	}
+	if (tap == NULL) return true;
+	if (free_slot < 0) return false;
+	sp_taps[free_slot].port = hSerial;
+	sp_taps[free_slot].ctx = ctx;
+	sp_taps[free_slot].tap = tap;
+	sp_tap_count++;
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static void sp_tap(HANDLE hSerial, bool tx, const char *data, uint32_t size)
+{
+	if ((sp_tap_count == 0)||(size == 0)) return;
+	for (int i = 0; i < SP_MAX_TAPS; ++i) {
+		if ((sp_taps[i].tap != NULL)&&(sp_taps[i].port == hSerial)) sp_taps[i].tap(sp_taps[i].ctx, tx, data, size);
+	}
+}
+
 #ifdef WIN32
 
 #include <stdio.h>
 #include <windows.h>
-#include "serialport.h"
 #include "lua_ext_error.h"
 #include "ymodem.h"
 
@@ -91,6 +132,7 @@ DWORD readFromSerialPort(HANDLE hSerial, char * buffer, int buffersize)
     {
     	error_log(__LINE__, __FILE__, 5, "ReadFile");
     }
+    sp_tap(hSerial, false, buffer, dwBytesRead);
     return dwBytesRead;
 }
 
@@ -107,6 +149,7 @@ DWORD writeToSerialPort(HANDLE hSerial, char * data, int length)
 	if(!WriteFile(hSerial, data, length, &dwBytesRead, NULL)){
 		error_log(__LINE__, __FILE__, 6, "WriteFile");
 	}
+	sp_tap(hSerial, true, data, dwBytesRead);
 	return dwBytesRead;
 }
 
@@ -115,7 +158,302 @@ void closeSerialPort(HANDLE hSerial)
 	if (hSerial == NULL) {
 		error_log(__LINE__, __FILE__, 7, "Null pointer passed to handle");
 	}
-	else CloseHandle(hSerial);
+	else {
+		setSerialPortTap(hSerial, NULL, NULL);
+		CloseHandle(hSerial);
+	}
+}
+
+/**
+	\brief Read until size bytes arrived or timeout ms passed.  ReadFile()
+	returns after the COMMTIMEOUTS interval, so data is returned soon
+	after it arrives.
+	*/
+uint32_t readFromSerialPortTimeout(HANDLE hSerial, char * buffer, uint32_t size, uint32_t timeout)
+{
+	ULONGLONG deadline = GetTickCount64() + timeout;
+	uint32_t br = 0;
+
+	while (br < size) {
+		br += (uint32_t)readFromSerialPort(hSerial, buffer + br, (int)(size - br));
+		if ((br < size)&&(GetTickCount64() >= deadline)) break;
+	}
+	return br;
+}
+
+uint32_t writeToSerialPortNow(HANDLE hSerial, char * data, int length)
+{
+	return (uint32_t)writeToSerialPort(hSerial, data, length);
+}
+
+bool drainSerialPort(HANDLE hSerial)
+{
+	return FlushFileBuffers(hSerial) != 0;
+}
+
+void flushSerialPort(HANDLE hSerial)
+{
+	PurgeComm(hSerial, PURGE_RXCLEAR);
+}
+
+#else
+/* POSIX termios backend ================================================== */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "lua_ext_error.h"
+
+#define SP_WRITE_TIMEOUT     (1000)  /**< ms a write waits for room in the driver */
+
+#if defined(__linux__) && defined(TCGETS2)
+/* from <asm/termbits.h>, that header clashes with <termios.h>; TCGETS2 uses this name */
+struct termios2 {
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+#define SP_BOTHER            (0010000)
+#define SP_CBAUD             (0010017)
+#endif
+
+/* ------------------------------------------------------------------------ */
+static int64_t sp_now_ms( void )
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+/* ------------------------------------------------------------------------ */
+/* termios constant for a standard rate, 0 when there is none */
+static speed_t sp_speed( uint32_t baudrate )
+{
+	static const struct { uint32_t rate; speed_t speed; } rates[] = {
+		{50, B50}, {110, B110}, {150, B150}, {300, B300}, {600, B600},
+		{1200, B1200}, {2400, B2400}, {4800, B4800}, {9600, B9600},
+		{19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+		{230400, B230400},
+#ifdef B460800
+		{460800, B460800},
+#endif
+#ifdef B500000
+		{500000, B500000},
+#endif
+#ifdef B921600
+		{921600, B921600},
+#endif
+#ifdef B1000000
+		{1000000, B1000000},
+#endif
+	};
+	for (size_t indx = 0;indx<sizeof(rates)/sizeof(rates[0]);++indx) {
+		if (rates[indx].rate == baudrate) return rates[indx].speed;
+	}
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* any other rate through the Linux termios2 interface */
+static bool sp_set_custom_speed( int fd, uint32_t baudrate )
+{
+#if defined(__linux__) && defined(TCGETS2)
+	struct termios2 tio;
+
+	if (ioctl(fd, TCGETS2, &tio) != 0) return false;
+	tio.c_cflag &= ~SP_CBAUD;
+	tio.c_cflag |= SP_BOTHER;
+	tio.c_ispeed = baudrate;
+	tio.c_ospeed = baudrate;
+	return ioctl(fd, TCSETS2, &tio) == 0;
+#else
+	(void)fd;
+	(void)baudrate;
+	errno = EINVAL;
+	return false;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+/**
+	\brief Opens a new connection to a serial port
+	\param portname		device path, names without a '/' are taken from /dev
+	\param baudrate		any rate the driver accepts (BOTHER on Linux)
+	\param stopbits		the number of stop bits (one, onePointFive or two)
+	\param parity		the parity (even, odd, off or mark)
+	\return			non-blocking, exclusively locked descriptor or SP_INVALID_HANDLE
+	*/
+HANDLE openSerialPort(const char *portname, uint32_t baudrate, enum Stopbits stopbits, enum Paritycheck parity)
+{
+	char full_path[256];
+	struct termios tio;
+	speed_t speed = sp_speed(baudrate);
+	int fd;
+
+	snprintf(full_path, sizeof(full_path), (portname[0] == '/')?"%s":"/dev/%s", portname);
+	fd = open(full_path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		error_log(__LINE__, __FILE__, 1, "open %s: %s", full_path, strerror(errno));
+		return SP_INVALID_HANDLE;
+	}
+	/* one owner at a time: advisory lock for other applets, TIOCEXCL for the rest */
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		error_log(__LINE__, __FILE__, 2, "%s is in use", full_path);
+		close(fd);
+		errno = EBUSY;
+		return SP_INVALID_HANDLE;
+	}
+#ifdef TIOCEXCL
+	ioctl(fd, TIOCEXCL);
+#endif
+	if (tcgetattr(fd, &tio) != 0) {
+		error_log(__LINE__, __FILE__, 3, "tcgetattr: %s", strerror(errno));
+		close(fd);
+		return SP_INVALID_HANDLE;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
+	tio.c_cflag |= CS8;
+	if (stopbits != one) tio.c_cflag |= CSTOPB;
+	if (parity == odd) tio.c_cflag |= PARENB | PARODD;
+	else if (parity == even) tio.c_cflag |= PARENB;
+#ifdef CMSPAR
+	else if (parity == mark) tio.c_cflag |= PARENB | PARODD | CMSPAR;
+#endif
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	if (speed != 0) {
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+	}
+	if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+		error_log(__LINE__, __FILE__, 4, "tcsetattr: %s", strerror(errno));
+		close(fd);
+		return SP_INVALID_HANDLE;
+	}
+	if ((speed == 0)&&!sp_set_custom_speed(fd, baudrate)) {
+		error_log(__LINE__, __FILE__, 5, "baud rate %u: %s", baudrate, strerror(errno));
+		close(fd);
+		errno = EINVAL;
+		return SP_INVALID_HANDLE;
+	}
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t readFromSerialPort(HANDLE hSerial, char * buffer, int buffersize)
+{
+	ssize_t n = read(hSerial, buffer, (size_t)buffersize);
+	if (n < 0) {
+		if ((errno != EAGAIN)&&(errno != EINTR)) error_log(__LINE__, __FILE__, 6, "read: %s", strerror(errno));
+		return 0;
+	}
+	sp_tap(hSerial, false, buffer, (uint32_t)n);
+	return (uint32_t)n;
+}
+/* ------------------------------------------------------------------------ */
+/**
+	\brief Read until size bytes arrived or timeout ms passed.  poll()
+	wakes up as soon as data arrives, there is no polling interval.
+	*/
+uint32_t readFromSerialPortTimeout(HANDLE hSerial, char * buffer, uint32_t size, uint32_t timeout)
+{
+	int64_t deadline = sp_now_ms() + timeout;
+	uint32_t br = 0;
+
+	while (br < size) {
+		struct pollfd pfd = { hSerial, POLLIN, 0 };
+		int64_t left;
+		ssize_t n = read(hSerial, buffer + br, size - br);
+
+		if (n > 0) {
+			sp_tap(hSerial, false, buffer + br, (uint32_t)n);
+			br += (uint32_t)n;
+			continue;
+		}
+		/* with VMIN = 0 a tty read() returns 0 when there is no data */
+		if ((n < 0)&&(errno != EAGAIN)&&(errno != EINTR)) {
+			error_log(__LINE__, __FILE__, 6, "read: %s", strerror(errno));
+			break;
+		}
+		left = deadline - sp_now_ms();
+		if (left <= 0) break;
+		if ((poll(&pfd, 1, (int)left) < 0)&&(errno != EINTR)) break;
+		/* a hang-up with no data left, e.g. the other side of a pty closed */
+		if ((pfd.revents & (POLLERR | POLLNVAL))||((pfd.revents & (POLLHUP|POLLIN)) == POLLHUP)) break;
+	}
+	return br;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t writeToSerialPort(HANDLE hSerial, char * data, int length)
+{
+	int64_t deadline = sp_now_ms() + SP_WRITE_TIMEOUT;
+	uint32_t bw = 0;
+
+	while (bw < (uint32_t)length) {
+		struct pollfd pfd = { hSerial, POLLOUT, 0 };
+		int64_t left;
+		ssize_t n = write(hSerial, data + bw, (size_t)length - bw);
+
+		if (n > 0) {
+			sp_tap(hSerial, true, data + bw, (uint32_t)n);
+			bw += (uint32_t)n;
+			continue;
+		}
+		if ((n < 0)&&(errno != EAGAIN)&&(errno != EINTR)) {
+			error_log(__LINE__, __FILE__, 7, "write: %s", strerror(errno));
+			break;
+		}
+		left = deadline - sp_now_ms();
+		if (left <= 0) break;
+		poll(&pfd, 1, (int)left);
+	}
+	return bw;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t writeToSerialPortNow(HANDLE hSerial, char * data, int length)
+{
+	ssize_t n = write(hSerial, data, (size_t)length);
+	if (n < 0) {
+		if ((errno != EAGAIN)&&(errno != EINTR)) error_log(__LINE__, __FILE__, 7, "write: %s", strerror(errno));
+		return 0;
+	}
+	sp_tap(hSerial, true, data, (uint32_t)n);
+	return (uint32_t)n;
+}
+/* ------------------------------------------------------------------------ */
+bool drainSerialPort(HANDLE hSerial)
+{
+	int res;
+	while (((res = tcdrain(hSerial)) != 0)&&(errno == EINTR));
+	return res == 0;
+}
+/* ------------------------------------------------------------------------ */
+void flushSerialPort(HANDLE hSerial)
+{
+	tcflush(hSerial, TCIFLUSH);
+}
+/* ------------------------------------------------------------------------ */
+void closeSerialPort(HANDLE hSerial)
+{
+	if (hSerial == SP_INVALID_HANDLE) {
+		error_log(__LINE__, __FILE__, 8, "Invalid handle passed to close");
+	}
+	else {
+		setSerialPortTap(hSerial, NULL, NULL);
+		flock(hSerial, LOCK_UN);
+		close(hSerial);
+	}
 }
 
 #endif
@@ -1,7 +1,10 @@
 #ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
 
 #ifdef WIN32
-#define SERIALPORT_H
 #include <windows.h>
 
 
@@ -75,6 +78,87 @@ DWORD writeToSerialPort(HANDLE hSerial, char * data, int length);
 
 void closeSerialPort(HANDLE hSerial);
 
+#define SP_INVALID_HANDLE    (NULL)
+
+#else
+/* POSIX termios backend ================================================== */
+
+typedef int HANDLE;                  /**< file descriptor of the open port */
+
+#define SP_INVALID_HANDLE    (-1)
+
+enum Stopbits
+{
+	one = 1,
+	onePointFive = 3,                /**< not supported by termios, uses two */
+	two = 2
+};
+
+enum Paritycheck
+{
+	off = 0,
+	odd = 1,
+	even = 2,
+	mark = 3
+};
+
+/**
+	\brief Opens a new connection to a serial port
+	\param portname		device path, names without a '/' are taken from /dev
+	\param baudrate		any rate the driver accepts (BOTHER on Linux)
+	\param stopbits		the number of stop bits (one, onePointFive or two)
+	\param parity		the parity (even, odd, off or mark)
+	\return			non-blocking, exclusively locked descriptor or SP_INVALID_HANDLE
+	*/
+HANDLE openSerialPort(const char *portname, uint32_t baudrate, enum Stopbits stopbits, enum Paritycheck parity);
+
+/**
+	\brief Read the data that is waiting, does not block
+	\return				amount of data that was read
+	*/
+uint32_t readFromSerialPort(HANDLE hSerial, char * buffer, int buffersize);
+/**
+	\brief write data to the serial port, waits up to a second for room
+	\return			amount of data that was written
+	*/
+uint32_t writeToSerialPort(HANDLE hSerial, char * data, int length);
+
+void closeSerialPort(HANDLE hSerial);
+
 #endif
 
+/* Common API ============================================================= */
+
+/** called with the bytes a port sent (tx) or received */
+typedef void (*sp_tap_type)(void *ctx, bool tx, const char *data, uint32_t size);
+
+/**
+	\brief Pass all data read from or written to the port to tap, NULL removes it
+	\return			false when too many ports have a tap
+	*/
+bool setSerialPortTap(HANDLE hSerial, sp_tap_type tap, void *ctx);
+
+/**
+	\brief Read until size bytes arrived or timeout ms passed
+	\param hSerial		handle of the open port
+	\param buffer		pointer to the area where the read data will be written
+	\param size			number of bytes wanted
+	\param timeout		time limit for the whole read in ms
+	\return				amount of data that was read
+	*/
+uint32_t readFromSerialPortTimeout(HANDLE hSerial, char * buffer, uint32_t size, uint32_t timeout);
+/**
+	\brief Write what the driver takes without waiting for room
+	\return			amount of data that was written
+	*/
+uint32_t writeToSerialPortNow(HANDLE hSerial, char * data, int length);
+/**
+	\brief wait until all written data has been sent
+	*/
+bool drainSerialPort(HANDLE hSerial);
+/**
+	\brief discard received data that has not been read
+	*/
+void flushSerialPort(HANDLE hSerial);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+ * startup.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lua_ext_startup.h"
+#include "lua_ext_time.h"
+
+#define STARTUP_MAX_PHASES    (128)
+#define STARTUP_MAX_DEPTH     (8)
+#define STARTUP_NAME          (48)
+
+typedef struct {
+	char    name[ STARTUP_NAME ];
+	int     depth;
+	int64_t begin;        /**< ns after the first phase began */
+	int64_t end;          /**< -1 while the phase runs */
+	int64_t heap;         /**< bytes in use when the phase ended, -1 = no state */
+} startup_phase_type;
+
+static int startup_on = -1;          /**< -1 until LUA_STARTUP_TRACE was read */
+static const char *startup_out = NULL;
+static int64_t startup_t0 = 0;
+static startup_phase_type startup_phases[ STARTUP_MAX_PHASES ];
+static int startup_count = 0;
+static int startup_open[ STARTUP_MAX_DEPTH ];  /**< phases that have not ended */
+static int startup_depth = 0;
+
+/* ------------------------------------------------------------------------ */
+static bool startup_enabled( void )
+{
+	if (startup_on < 0) {
+		startup_out = getenv(STARTUP_TRACE_VAR);
+		startup_on = ((startup_out != NULL)&&(startup_out[0] != 0)&&(strcmp(startup_out, "0") != 0));
+		startup_t0 = time_now_ns();
+		/* os.exit() does not return to main(), report when the process ends */
+		if (startup_on) atexit(startup_report);
+	}
+	return startup_on != 0;
+}
+/* ------------------------------------------------------------------------ */
+static int64_t startup_heap( lua_State *L )
+{
+	if (L == NULL) return -1;
+	return (int64_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+/* ------------------------------------------------------------------------ */
+void startup_begin( lua_State *L, const char *phase )
+{
+	startup_phase_type *p;
+
+	(void)L;
+	if (!startup_enabled()) return;
+	if ((startup_count == STARTUP_MAX_PHASES)||(startup_depth == STARTUP_MAX_DEPTH)) return;
+	p = &startup_phases[startup_count];
+	snprintf(p->name, sizeof(p->name), "%s", phase);
+	p->depth = startup_depth;
+	p->end = -1;
+	p->heap = -1;
+	startup_open[startup_depth++] = startup_count++;
+	p->begin = time_now_ns() - startup_t0;
+}
+/* ------------------------------------------------------------------------ */
+void startup_end( lua_State *L )
+{
+	int64_t now;
+	startup_phase_type *p;
+
+	if (!startup_enabled()||(startup_depth == 0)) return;
+	now = time_now_ns() - startup_t0;
+	p = &startup_phases[startup_open[--startup_depth]];
+	p->end = now;
+	p->heap = startup_heap(L);
+}
+/* ------------------------------------------------------------------------ */
+static void startup_table( FILE *fp )
+{
+	fprintf(fp, "%-40s %10s %10s %10s\n", "startup phase", "start ms", "time ms", "heap KB");
+	for (int i = 0; i < startup_count; ++i) {
+		startup_phase_type *p = &startup_phases[i];
+		int indent = 2 * p->depth;
+
+		fprintf(fp, "%*s%-*s %10.3f ", indent, "", 40 - indent, p->name, (double)p->begin / 1e6);
+		if (p->end < 0) fprintf(fp, "%10s ", "-");
+		else fprintf(fp, "%10.3f ", (double)(p->end - p->begin) / 1e6);
+		if (p->heap < 0) fprintf(fp, "%10s\n", "-");
+		else fprintf(fp, "%10.1f\n", (double)p->heap / 1024.0);
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* complete events for the phases and a counter of the heap, times in us */
+static void startup_json( FILE *fp )
+{
+	const char *sep = "";
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (int i = 0; i < startup_count; ++i) {
+		startup_phase_type *p = &startup_phases[i];
+		int64_t end = (p->end < 0) ? (time_now_ns() - startup_t0) : p->end;
+
+		fprintf(fp, "%s{\"name\":\"", sep);
+		for (const char *c = p->name; *c != 0; ++c) {
+			if ((*c == '"')||(*c == '\\')) fputc('\\', fp);
+			if ((unsigned char)*c >= 0x20) fputc(*c, fp);
+		}
+		fprintf(fp, "\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+				(double)p->begin / 1e3, (double)(end - p->begin) / 1e3);
+		sep = ",\n";
+		if (p->heap >= 0) {
+			fprintf(fp, ",\n{\"name\":\"heap\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{\"bytes\":%lld}}",
+					(double)end / 1e3, (long long)p->heap);
+		}
+	}
+	fprintf(fp, "\n]}\n");
+}
+/* ------------------------------------------------------------------------ */
+/* print or write the phases that were traced, once */
+void startup_report( void )
+{
+	FILE *fp;
+
+	if (!startup_enabled()||(startup_count == 0)) return;
+	if (strcmp(startup_out, "1") == 0) startup_table(stderr);
+	else if ((fp = fopen(startup_out, "w")) != NULL) {
+		startup_json(fp);
+		fclose(fp);
+	}
+	else fprintf(stderr, "%s: cannot write %s\n", STARTUP_TRACE_VAR, startup_out);
+	startup_count = 0;
+}
+/* ------------------------------------------------------------------------ */
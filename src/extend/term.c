@@ -0,0 +1,475 @@
+/*
+ * term.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#include "lua_ext_time.h"
+
+#define TERM_KEY_MAX          (16)    /**< longest key sequence kept */
+#define TERM_RING_SIZE        (64)    /**< queued key events, power of 2 */
+#define TERM_PENDING_MAX      (256)   /**< bytes read but not decoded yet */
+#define TERM_ESC_MS           (25)    /**< wait for the rest of an escape sequence */
+
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	uint8_t len;
+	char raw[TERM_KEY_MAX];
+} term_key_type;
+
+/*
+ * The terminal session, there is only one per process.  Raw mode is
+ * entered once on first use and left at exit (or by term.close()).
+ */
+typedef struct {
+	bool open;
+	bool raw;              /**< the terminal settings were changed */
+	bool eof;
+	bool registered;       /**< the atexit() handler is installed */
+#ifndef WIN32
+	struct termios saved;
+#endif
+	uint8_t pending[TERM_PENDING_MAX];
+	size_t npending;
+	term_key_type ring[TERM_RING_SIZE];
+	uint32_t head;
+	uint32_t tail;
+} term_session_type;
+
+static term_session_type term;
+
+/* Key Queue ============================================================== */
+/* ------------------------------------------------------------------------ */
+static inline uint32_t term_queued( void )
+{
+	return term.head - term.tail;
+}
+/* ------------------------------------------------------------------------ */
+/* keys are dropped when the queue is full, the oldest ones are kept */
+static void term_push( const uint8_t *raw, size_t len )
+{
+	term_key_type *k;
+
+	if (term_queued() >= TERM_RING_SIZE) return;
+	if (len > TERM_KEY_MAX) len = TERM_KEY_MAX;
+	k = &term.ring[term.head & (TERM_RING_SIZE - 1)];
+	memcpy(k->raw, raw, len);
+	k->len = (uint8_t)len;
+	term.head++;
+}
+/* ------------------------------------------------------------------------ */
+static term_key_type *term_pop( void )
+{
+	if (term_queued() == 0) return NULL;
+	return &term.ring[term.tail++ & (TERM_RING_SIZE - 1)];
+}
+
+/* Session ================================================================ */
+/* ------------------------------------------------------------------------ */
+static void term_restore( void )
+{
+#ifndef WIN32
+	if (term.raw) tcsetattr(0, TCSANOW, &term.saved);
+#endif
+	term.raw = false;
+	term.open = false;
+}
+/* ------------------------------------------------------------------------ */
+/* enter raw mode: no line buffering and no echo, signals still work */
+static void term_open( void )
+{
+	if (term.open) return;
+	term.open = true;
+#ifndef WIN32
+	if (isatty(0) && (tcgetattr(0, &term.saved) == 0)) {
+		struct termios raw = term.saved;
+		raw.c_lflag &= ~(ICANON|ECHO);
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+		term.raw = (tcsetattr(0, TCSANOW, &raw) == 0);
+	}
+#endif
+	if (!term.registered) {
+		atexit(term_restore);
+		term.registered = true;
+	}
+}
+
+/* Decoding =============================================================== */
+#ifndef WIN32
+/* ------------------------------------------------------------------------ */
+/*
+ * Length of the key at p, 0 when more bytes are needed.  Handles CSI
+ * (ESC [ ... final), SS3 (ESC O x), Alt+key (ESC x) and UTF-8 characters.
+ */
+static size_t term_key_length( const uint8_t *p, size_t n )
+{
+	size_t len;
+
+	if (p[0] != 0x1B) {
+		if (p[0] < 0xC0) return 1;
+		len = (p[0] < 0xE0)?2:((p[0] < 0xF0)?3:4);
+		return (n >= len)?len:0;
+	}
+	if (n < 2) return 0;
+	if (p[1] == '[') {
+		if ((n >= 3)&&(p[2] == '[')) return (n >= 4)?4:0;   /* Linux console F1-F5 */
+		for (len = 2;len<n;++len) {
+			if ((p[len] >= 0x40)&&(p[len] <= 0x7E)) return len + 1;
+			if ((p[len] < 0x20)||(p[len] > 0x3F)||(len >= TERM_KEY_MAX - 1)) return 1;
+		}
+		return 0;
+	}
+	if (p[1] == 'O') return (n >= 3)?3:0;
+	if (p[1] == 0x1B) return 1;
+	len = term_key_length(p + 1, n - 1);
+	return (len == 0)?0:len + 1;
+}
+/* ------------------------------------------------------------------------ */
+/* move complete keys from the pending bytes to the queue */
+static void term_decode( bool flush )
+{
+	size_t used = 0;
+
+	while (used < term.npending) {
+		size_t len = term_key_length(term.pending + used, term.npending - used);
+		if (len == 0) {
+			if (!flush) break;
+			len = 1;         /* a lone ESC, or a sequence that never completed */
+		}
+		term_push(term.pending + used, len);
+		used += len;
+	}
+	memmove(term.pending, term.pending + used, term.npending - used);
+	term.npending -= used;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Read what is waiting on stdin, waiting up to ms (-1 forever) for the
+ * first byte.  Returns false on timeout.
+ */
+static bool term_fill( int ms )
+{
+	struct pollfd pfd = { 0, POLLIN, 0 };
+	int n;
+
+	if (term.eof) return false;
+	n = poll(&pfd, 1, ms);
+	if (n <= 0) return false;
+	n = (int)read(0, term.pending + term.npending, TERM_PENDING_MAX - term.npending);
+	if (n <= 0) {
+		if ((n == 0)||((errno != EINTR)&&(errno != EAGAIN))) term.eof = true;
+		return false;
+	}
+	term.npending += (size_t)n;
+	term_decode(false);
+	while (term.npending > 0) {
+		/* the rest of an escape sequence normally follows right away */
+		if (poll(&pfd, 1, TERM_ESC_MS) <= 0) {
+			term_decode(true);
+			break;
+		}
+		n = (int)read(0, term.pending + term.npending, TERM_PENDING_MAX - term.npending);
+		if (n <= 0) {
+			term_decode(true);
+			break;
+		}
+		term.npending += (size_t)n;
+		term_decode(false);
+	}
+	return true;
+}
+#else
+/* ------------------------------------------------------------------------ */
+static bool term_fill( int ms )
+{
+	HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+	int64_t deadline = time_now_ns() + (int64_t)ms * TIME_NS_PER_MS;
+
+	for (;;) {
+		if (_kbhit()) {
+			while (_kbhit() && (term_queued() < TERM_RING_SIZE)) {
+				uint8_t raw[2];
+				raw[0] = (uint8_t)_getch();
+				if ((raw[0] == 0)||(raw[0] == 0xE0)) {
+					raw[1] = (uint8_t)_getch();
+					term_push(raw, 2);
+				} else {
+					term_push(raw, 1);
+				}
+			}
+			return true;
+		}
+		if (ms == 0) return false;
+		int64_t left = deadline - time_now_ns();
+		if ((ms > 0)&&(left <= 0)) return false;
+		WaitForSingleObject(in, (ms < 0)?INFINITE:(DWORD)((left + TIME_NS_PER_MS - 1) / TIME_NS_PER_MS));
+	}
+}
+#endif
+/* ------------------------------------------------------------------------ */
+/* wait up to ms (-1 forever) for a key */
+static term_key_type *term_wait( int ms )
+{
+	int64_t deadline = time_now_ns() + (int64_t)ms * TIME_NS_PER_MS;
+
+	while (term_queued() == 0) {
+		int left = ms;
+		if (ms > 0) {
+			int64_t ns = deadline - time_now_ns();
+			if (ns <= 0) return NULL;
+			left = (int)((ns + TIME_NS_PER_MS - 1) / TIME_NS_PER_MS);
+		}
+		if (!term_fill(left) && (ms == 0 || term.eof)) return NULL;
+	}
+	return term_pop();
+}
+
+/* Key Names ============================================================== */
+/* ------------------------------------------------------------------------ */
+static const char *term_tilde_key( int code )
+{
+	switch (code) {
+	case 1: case 7: return "home";
+	case 2: return "insert";
+	case 3: return "delete";
+	case 4: case 8: return "end";
+	case 5: return "pageup";
+	case 6: return "pagedown";
+	case 11: return "f1";
+	case 12: return "f2";
+	case 13: return "f3";
+	case 14: return "f4";
+	case 15: return "f5";
+	case 17: return "f6";
+	case 18: return "f7";
+	case 19: return "f8";
+	case 20: return "f9";
+	case 21: return "f10";
+	case 23: return "f11";
+	case 24: return "f12";
+	default: return NULL;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static const char *term_letter_key( char c )
+{
+	switch (c) {
+	case 'A': return "up";
+	case 'B': return "down";
+	case 'C': return "right";
+	case 'D': return "left";
+	case 'H': return "home";
+	case 'F': return "end";
+	case 'P': return "f1";
+	case 'Q': return "f2";
+	case 'R': return "f3";
+	case 'S': return "f4";
+	case 'M': return "enter";
+	case 'Z': return "shift-tab";
+	default: return NULL;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* push the name of a single byte key */
+static void term_byte_name( lua_State *L, uint8_t c )
+{
+	switch (c) {
+	case '\r': case '\n': lua_pushliteral(L, "enter"); return;
+	case '\t': lua_pushliteral(L, "tab"); return;
+	case 0x08: case 0x7F: lua_pushliteral(L, "backspace"); return;
+	case 0x1B: lua_pushliteral(L, "escape"); return;
+	case 0x00: lua_pushliteral(L, "ctrl-space"); return;
+	default: break;
+	}
+	if (c < 0x20) lua_pushfstring(L, "ctrl-%c", (int)(c + 'a' - 1));
+	else lua_pushlstring(L, (const char*)&c, 1);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Push the name of a key: a printable character is its own name, other
+ * keys are named "up", "f5", "ctrl-a", "alt-x", "ctrl-shift-left", ...
+ */
+static void term_key_name( lua_State *L, const term_key_type *k )
+{
+	const uint8_t *p = (const uint8_t*)k->raw;
+	const char *name = NULL;
+	int param[2] = { 0, 0 }, np = 0, mods;
+
+#ifdef WIN32
+	if ((k->len == 2)&&((p[0] == 0)||(p[0] == 0xE0))) {
+		static const struct { uint8_t code; const char *name; } keys[] = {
+			{72,"up"}, {80,"down"}, {75,"left"}, {77,"right"}, {71,"home"}, {79,"end"},
+			{73,"pageup"}, {81,"pagedown"}, {82,"insert"}, {83,"delete"},
+			{59,"f1"}, {60,"f2"}, {61,"f3"}, {62,"f4"}, {63,"f5"}, {64,"f6"},
+			{65,"f7"}, {66,"f8"}, {67,"f9"}, {68,"f10"}, {133,"f11"}, {134,"f12"},
+		};
+		for (size_t indx = 0;indx<sizeof(keys)/sizeof(keys[0]);++indx) {
+			if (keys[indx].code == p[1]) name = keys[indx].name;
+		}
+		if (name != NULL) lua_pushstring(L, name);
+		else lua_pushliteral(L, "unknown");
+		return;
+	}
+#endif
+	if (k->len == 1) {
+		term_byte_name(L, p[0]);
+		return;
+	}
+	if (p[0] != 0x1B) {                           /* UTF-8 character */
+		lua_pushlstring(L, k->raw, k->len);
+		return;
+	}
+	if ((k->len == 4)&&(p[1] == '[')&&(p[2] == '[')) {
+		lua_pushfstring(L, "f%d", (int)(p[3] - 'A' + 1));
+		return;
+	}
+	if ((k->len == 3)&&(p[1] == 'O')) {
+		name = term_letter_key((char)p[2]);
+	} else if ((k->len >= 3)&&(p[1] == '[')) {
+		for (size_t indx = 2;indx<(size_t)k->len - 1;++indx) {
+			if ((p[indx] >= '0')&&(p[indx] <= '9')) param[np] = param[np]*10 + (p[indx] - '0');
+			else if ((p[indx] == ';')&&(np < 1)) ++np;
+		}
+		name = (p[k->len - 1] == '~')?term_tilde_key(param[0]):term_letter_key((char)p[k->len - 1]);
+		mods = (param[1] > 1)?param[1] - 1:0;
+		if ((name != NULL)&&(mods != 0)) {
+			lua_pushfstring(L, "%s%s%s%s", (mods & 4)?"ctrl-":"", (mods & 2)?"alt-":"", (mods & 1)?"shift-":"", name);
+			return;
+		}
+	} else {
+		/* ESC followed by a key is Alt+key */
+		term_key_type alt;
+		alt.len = (uint8_t)(k->len - 1);
+		memcpy(alt.raw, k->raw + 1, alt.len);
+		term_key_name(L, &alt);
+		lua_pushfstring(L, "alt-%s", lua_tostring(L, -1));
+		lua_remove(L, -2);
+		return;
+	}
+	if (name != NULL) lua_pushstring(L, name);
+	else lua_pushliteral(L, "unknown");
+}
+
+/* Lua Functions ========================================================== */
+/* ------------------------------------------------------------------------ */
+/* bool = kbhit(), a key is waiting */
+int ext_kbhit( lua_State *L )
+{
+	term_open();
+	if (term_queued() == 0) term_fill(0);
+	lua_pushboolean(L, term_queued() > 0);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* str = getc(), the bytes of the next key or nil, does not block */
+int ext_getc( lua_State *L )
+{
+	term_key_type *k;
+
+	term_open();
+	k = term_wait(0);
+	if (k == NULL) lua_pushnil(L);
+	else lua_pushlstring(L, k->raw, k->len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* name, raw = getkey( timeout ), waits timeout ms (forever when nil) */
+int ext_getkey( lua_State *L )
+{
+	lua_Integer ms = luaL_optinteger(L, 1, -1);
+	term_key_type *k;
+
+	term_open();
+	k = term_wait((ms < 0)?-1:(int)ms);
+	if (k == NULL) {
+		lua_pushnil(L);
+		return 1;
+	}
+	term_key_name(L, k);
+	lua_pushlstring(L, k->raw, k->len);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* term.open(), enter raw mode now rather than on the first read */
+static int term_lua_open( lua_State *L )
+{
+	term_open();
+	lua_pushboolean(L, term.raw);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* term.close(), restore the terminal settings */
+static int term_lua_close( lua_State *L )
+{
+	(void)L;
+	term_restore();
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* n = term.flush(), drop the queued keys */
+static int term_lua_flush( lua_State *L )
+{
+	lua_pushinteger(L, (lua_Integer)term_queued());
+	term.tail = term.head;
+	term.npending = 0;
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* n = term.pending(), number of queued keys */
+static int term_lua_pending( lua_State *L )
+{
+	lua_pushinteger(L, (lua_Integer)term_queued());
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* bool = term.isatty(), stdin is a terminal */
+static int term_lua_isatty( lua_State *L )
+{
+#ifdef WIN32
+	lua_pushboolean(L, _isatty(0));
+#else
+	lua_pushboolean(L, isatty(0));
+#endif
+	return 1;
+}
+
+static const luaL_Reg term_lib[] = {
+		{"open", term_lua_open},
+		{"close", term_lua_close},
+		{"flush", term_lua_flush},
+		{"pending", term_lua_pending},
+		{"isatty", term_lua_isatty},
+		{"kbhit", ext_kbhit},
+		{"getc", ext_getc},
+		{"getkey", ext_getkey},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_term( lua_State *L )
+{
+	luaL_newlib(L, term_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
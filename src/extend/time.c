@@ -0,0 +1,446 @@
+/*
+ * time.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#include "lua_ext_time.h"
+
+/* registry table of scheduler tasks, thread -> wake time (ns) */
+#define LUA_EXT_TIME_TASKS    ("_TIME_TASKS_")
+
+/* registry table of I/O waits, fd * 2 + (write) -> thread and thread -> that key */
+#define LUA_EXT_TIME_IO       ("_TIME_IO_")
+
+/* first value yielded by delay() so the scheduler can tell it from a plain yield */
+static const char time_delay_tag = 'd';
+/* first value yielded by time_wait_io(), followed by fd, events and deadline */
+static const char time_io_tag = 'i';
+
+#ifdef __linux__
+#define TIME_IO_EVENTS        (16)    /**< events taken per epoll_wait() */
+static int time_epoll = -1;           /**< epoll set of the I/O waits, kept for the process */
+#endif
+
+/* Clock ================================================================== */
+/* ------------------------------------------------------------------------ */
+/* monotonic time in ns, not related to the wall clock */
+int64_t time_now_ns( void )
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (int64_t)((count.QuadPart / freq.QuadPart) * 1000000000LL +
+		((count.QuadPart % freq.QuadPart) * 1000000000LL) / freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+/* block the process until the monotonic clock reaches deadline */
+void time_sleep_until( int64_t deadline )
+{
+#ifdef WIN32
+	int64_t left;
+	while ((left = deadline - time_now_ns()) > 0) {
+		Sleep((DWORD)((left + TIME_NS_PER_MS - 1) / TIME_NS_PER_MS));
+	}
+#else
+	struct timespec ts;
+	if (deadline <= 0) return;
+	ts.tv_sec = (time_t)(deadline / 1000000000LL);
+	ts.tv_nsec = (long)(deadline % 1000000000LL);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+/* Scheduler ============================================================== */
+/* ------------------------------------------------------------------------ */
+static void time_tasks( lua_State *L )
+{
+	if (lua_getfield(L, LUA_REGISTRYINDEX, LUA_EXT_TIME_TASKS) == LUA_TTABLE) return;
+	lua_pop(L,1);
+	lua_newtable(L);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, LUA_REGISTRYINDEX, LUA_EXT_TIME_TASKS);
+}
+/* ------------------------------------------------------------------------ */
+/* true when L is a task of the scheduler and may yield to it */
+bool time_in_task( lua_State *L )
+{
+	bool task;
+
+	if (!lua_isyieldable(L)) return false;
+	time_tasks(L);
+	lua_pushthread(L);
+	task = (lua_rawget(L, -2) != LUA_TNIL);
+	lua_pop(L,2);
+	return task;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Wait for the deadline, yielding to the scheduler from a task and
+ * sleeping otherwise.
+ */
+static int time_wait( lua_State *L, int64_t deadline )
+{
+	if (time_in_task(L)) {
+		lua_pushlightuserdata(L, (void*)&time_delay_tag);
+		lua_pushinteger(L, (lua_Integer)deadline);
+		return lua_yield(L, 2);
+	}
+	time_sleep_until(deadline);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* true when L is a task and the scheduler can wait for its I/O */
+bool time_can_wait_io( lua_State *L )
+{
+#ifdef __linux__
+	return time_in_task(L);
+#else
+	(void)L;
+	return false;
+#endif
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Yield the task until fd is ready for events (TIME_IO_READ/WRITE) or the
+ * deadline passed, then continue in k.  The deadline does not fit the
+ * context of k on 32-bit builds, k finds it where the caller left it on
+ * the stack.  Does not return in a task, the caller blocks itself otherwise.
+ */
+void time_wait_io( lua_State *L, int fd, int events, int64_t deadline, lua_KFunction k )
+{
+	if (!time_can_wait_io(L)) return;
+	lua_pushlightuserdata(L, (void*)&time_io_tag);
+	lua_pushinteger(L, fd);
+	lua_pushinteger(L, events);
+	lua_pushinteger(L, (lua_Integer)deadline);
+	lua_yieldk(L, 4, 0, k);
+}
+/* ------------------------------------------------------------------------ */
+/* delay( ms ), the global delay() */
+int ext_delay( lua_State *L )
+{
+	lua_Integer ms = luaL_optinteger(L, 1, 1);
+	return time_wait(L, time_now_ns() + ((ms > 0)?ms:0) * TIME_NS_PER_MS);
+}
+/* ------------------------------------------------------------------------ */
+/* time.sleep_until( deadline ) */
+static int time_sleep_until_ns( lua_State *L )
+{
+	return time_wait(L, (int64_t)luaL_checkinteger(L, 1));
+}
+/* ------------------------------------------------------------------------ */
+/* task = time.spawn( fn, ... ) */
+static int time_spawn( lua_State *L )
+{
+	int n = lua_gettop(L);
+	lua_State *co;
+
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	co = lua_newthread(L);
+	lua_rotate(L, 1, 1);              /* thread, fn, args */
+	lua_xmove(L, co, n);
+	time_tasks(L);
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, (lua_Integer)time_now_ns());
+	lua_rawset(L, -3);
+	lua_pop(L,1);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* the task that is due first is left on the stack, false when there is none */
+static bool time_next_task( lua_State *L, int tasks, int64_t *wake )
+{
+	bool found = false;
+
+	lua_pushnil(L);                   /* best task */
+	lua_pushnil(L);
+	while (lua_next(L, tasks)) {
+		int64_t t = (int64_t)lua_tointeger(L, -1);
+		lua_pop(L,1);
+		if (!found || (t < *wake)) {
+			*wake = t;
+			found = true;
+			lua_pushvalue(L, -1);
+			lua_replace(L, -3);
+		}
+	}
+	if (!found) lua_pop(L,1);
+	return found;
+}
+/* I/O waits ============================================================== */
+#ifdef __linux__
+/* ------------------------------------------------------------------------ */
+/* the I/O wait table on the stack, its index is returned */
+static int time_io( lua_State *L )
+{
+	if (lua_getfield(L, LUA_REGISTRYINDEX, LUA_EXT_TIME_IO) != LUA_TTABLE) {
+		lua_pop(L,1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, LUA_EXT_TIME_IO);
+	}
+	return lua_gettop(L);
+}
+/* ------------------------------------------------------------------------ */
+/* set the epoll events of fd to the waits in the table at io */
+static bool time_io_update( lua_State *L, int io, int fd )
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	if (lua_rawgeti(L, io, (lua_Integer)fd * 2) != LUA_TNIL) ev.events |= EPOLLIN;
+	if (lua_rawgeti(L, io, (lua_Integer)fd * 2 + 1) != LUA_TNIL) ev.events |= EPOLLOUT;
+	lua_pop(L,2);
+	if (ev.events == 0) {
+		epoll_ctl(time_epoll, EPOLL_CTL_DEL, fd, NULL);
+		return true;
+	}
+	if (epoll_ctl(time_epoll, EPOLL_CTL_MOD, fd, &ev) == 0) return true;
+	return (errno == ENOENT)&&(epoll_ctl(time_epoll, EPOLL_CTL_ADD, fd, &ev) == 0);
+}
+/* ------------------------------------------------------------------------ */
+/* drop the I/O wait of the thread at stack index t */
+static void time_io_clear( lua_State *L, int t )
+{
+	int io = time_io(L);
+
+	lua_pushvalue(L, t);
+	if (lua_rawget(L, io) == LUA_TNUMBER) {
+		lua_Integer key = lua_tointeger(L, -1);
+		lua_pushvalue(L, t);
+		lua_pushnil(L);
+		lua_rawset(L, io);
+		lua_pushnil(L);
+		lua_rawseti(L, io, key);
+		time_io_update(L, io, (int)(key / 2));
+	}
+	lua_pop(L,2);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Let the thread at stack index t wait for fd, false when fd cannot be
+ * waited for (e.g. a regular file, that is always ready).  One task waits
+ * for each direction of a descriptor, a second one replaces the first.
+ */
+static bool time_io_add( lua_State *L, int t, int fd, int events )
+{
+	lua_Integer key = (lua_Integer)fd * 2 + ((events & TIME_IO_WRITE) ? 1 : 0);
+	int io;
+	bool ok;
+
+	if ((time_epoll < 0)&&((time_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)) return false;
+	io = time_io(L);
+	lua_pushvalue(L, t);
+	lua_rawseti(L, io, key);
+	lua_pushvalue(L, t);
+	lua_pushinteger(L, key);
+	lua_rawset(L, io);
+	ok = time_io_update(L, io, fd);
+	lua_pop(L,1);
+	if (!ok) time_io_clear(L, t);
+	return ok;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Wait for the I/O of the tasks until the deadline, the tasks that became
+ * ready are set to wake now and counted.  A descriptor that hung up without
+ * data wakes its reader at its deadline.
+ */
+static int time_io_poll( lua_State *L, int tasks, int64_t deadline )
+{
+	struct epoll_event ev[ TIME_IO_EVENTS ];
+	int64_t left = deadline - time_now_ns();
+	int io = time_io(L);
+	int n, woken = 0;
+
+	lua_pushnil(L);
+	if (lua_next(L, io) == 0) {
+		lua_pop(L,1);
+		return 0;
+	}
+	lua_pop(L,2);
+	n = epoll_wait(time_epoll, ev, TIME_IO_EVENTS, (left > 0) ? (int)((left + TIME_NS_PER_MS - 1) / TIME_NS_PER_MS) : 0);
+	for (int i = 0; i < n; ++i) {
+		int fd = ev[i].data.fd;
+		for (int dir = 0; dir < 2; ++dir) {
+			uint32_t ready = (dir == 0) ? EPOLLIN : EPOLLOUT;
+			int t;
+			if ((ev[i].events & (ready | EPOLLERR | EPOLLHUP)) == 0) continue;
+			if (lua_rawgeti(L, io, (lua_Integer)fd * 2 + dir) == LUA_TNIL) {
+				lua_pop(L,1);
+				continue;
+			}
+			t = lua_gettop(L);
+			if ((ev[i].events & ready)||(dir == 1)) {
+				lua_pushvalue(L, t);
+				lua_pushinteger(L, (lua_Integer)time_now_ns());
+				lua_rawset(L, tasks);
+				woken++;
+			}
+			time_io_clear(L, t);
+			lua_pop(L,1);
+		}
+		/* a descriptor that was closed or has no waiter any more */
+		time_io_update(L, io, fd);
+	}
+	lua_pop(L,1);
+	return woken;
+}
+#endif
+/* ------------------------------------------------------------------------ */
+/*
+ * time.run()
+ * Run the spawned tasks until all of them have finished.  A task waiting
+ * in delay() or sleep_until() is resumed when its deadline has passed, a
+ * task that calls coroutine.yield() goes to the back of the line.  On Linux
+ * a task waiting for a port in time_wait_io() is resumed by epoll when the
+ * port is ready, or at its deadline.
+ */
+static int time_run( lua_State *L )
+{
+	int tasks;
+	int64_t wake = 0;
+
+	if (time_in_task(L)) return luaL_error(L, "time.run() called from a task");
+	lua_settop(L, 0);
+	time_tasks(L);
+	tasks = lua_gettop(L);
+	while (time_next_task(L, tasks, &wake)) {
+		lua_State *co = lua_tothread(L, -1);
+		int nargs = 0, nres = 0, status;
+
+#ifdef __linux__
+		/* tasks whose I/O became ready meanwhile are due now, pick again */
+		if (time_io_poll(L, tasks, wake) > 0) {
+			lua_pop(L,1);
+			continue;
+		}
+		time_io_clear(L, lua_gettop(L));
+#endif
+		time_sleep_until(wake);
+		if ((lua_status(co) == LUA_OK)&&(lua_gettop(co) > 0)) nargs = lua_gettop(co) - 1;
+		status = lua_resume(co, L, nargs, &nres);
+		if (status == LUA_YIELD) {
+			wake = time_now_ns();
+			if ((nres >= 2)&&(lua_touserdata(co, -nres) == (void*)&time_delay_tag)) {
+				wake = (int64_t)lua_tointeger(co, -nres + 1);
+			}
+			else if ((nres >= 4)&&(lua_touserdata(co, -nres) == (void*)&time_io_tag)) {
+				wake = (int64_t)lua_tointeger(co, -nres + 3);
+#ifdef __linux__
+				if (!time_io_add(L, lua_gettop(L), (int)lua_tointeger(co, -nres + 1), (int)lua_tointeger(co, -nres + 2))) {
+					wake = time_now_ns();
+				}
+#endif
+			}
+			lua_pop(co, nres);
+			lua_pushinteger(L, (lua_Integer)wake);
+		} else {
+			if (status != LUA_OK) {
+				luaL_traceback(L, co, lua_tostring(co, -1), 0);
+				lua_pushvalue(L, -2);
+				lua_pushnil(L);
+				lua_rawset(L, tasks);
+				return lua_error(L);
+			}
+			lua_pushnil(L);
+		}
+		lua_rawset(L, tasks);
+	}
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/* n = time.now_ns() */
+static int time_now( lua_State *L )
+{
+	lua_pushinteger(L, (lua_Integer)time_now_ns());
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* s = time.seconds(), monotonic seconds as a float */
+static int time_seconds( lua_State *L )
+{
+	lua_pushnumber(L, (lua_Number)time_now_ns() / 1e9);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* deadline = time.deadline( ms ), the now_ns() value ms from now */
+static int time_deadline( lua_State *L )
+{
+	lua_Number ms = luaL_checknumber(L, 1);
+	lua_pushinteger(L, (lua_Integer)(time_now_ns() + (int64_t)(ms * (lua_Number)TIME_NS_PER_MS)));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* ms = time.remaining( deadline ), 0 once it has passed */
+static int time_remaining( lua_State *L )
+{
+	int64_t left = (int64_t)luaL_checkinteger(L, 1) - time_now_ns();
+	lua_pushnumber(L, (left > 0)?(lua_Number)left / (lua_Number)TIME_NS_PER_MS:0);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* time.expired( deadline ) */
+static int time_expired( lua_State *L )
+{
+	lua_pushboolean(L, time_now_ns() >= (int64_t)luaL_checkinteger(L, 1));
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* ms = time.elapsed( start ), ms since a now_ns() value */
+static int time_elapsed( lua_State *L )
+{
+	int64_t d = time_now_ns() - (int64_t)luaL_checkinteger(L, 1);
+	lua_pushnumber(L, (lua_Number)d / (lua_Number)TIME_NS_PER_MS);
+	return 1;
+}
+
+static const luaL_Reg time_lib[] = {
+		{"now_ns", time_now},
+		{"seconds", time_seconds},
+		{"deadline", time_deadline},
+		{"remaining", time_remaining},
+		{"expired", time_expired},
+		{"elapsed", time_elapsed},
+		{"delay", ext_delay},
+		{"sleep_until", time_sleep_until_ns},
+		{"spawn", time_spawn},
+		{"run", time_run},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_time( lua_State *L )
+{
+	luaL_newlib(L, time_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
@@ -0,0 +1,1309 @@
+/*
+ * toml.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define LUA_EXT_TOML_BUF      ("_TOML_BUF_")
+
+#define TOML_MAX_DEPTH        (256)
+#define TOML_MAX_NUMBER       (128)
+
+/*
+ * Table states, kept in a side table while parsing so the redefinition
+ * rules of TOML 1.0 can be checked.
+ */
+#define TOML_IMPLICIT         (1)   /**< created by a header path, [a] in [a.b] */
+#define TOML_HEADER           (2)   /**< defined by a [header] */
+#define TOML_DOTTED           (3)   /**< created by a dotted key, a.b = 1 */
+#define TOML_INLINE           (4)   /**< inline table, sealed */
+#define TOML_ARRAY            (5)   /**< static array, sealed */
+#define TOML_TABLES           (6)   /**< array of tables, [[a]] */
+
+/* Snapshot format */
+#define TOML_SNAP_MAGIC       ("xTML")
+#define TOML_SNAP_VERSION     (1)
+#define TOML_SNAP_FALSE       ('f')
+#define TOML_SNAP_TRUE        ('t')
+#define TOML_SNAP_INT         ('i')
+#define TOML_SNAP_NUM         ('n')
+#define TOML_SNAP_STR         ('s')
+#define TOML_SNAP_TABLE       ('T')
+
+/* ------------------------------------------------------------------------ */
+/* growable scratch memory, owned by a userdata so errors do not leak it */
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+} toml_buf_type;
+
+typedef struct {
+	lua_State *L;
+	const char *text;
+	const char *p;
+	const char *end;
+	bool strict;
+	int root;              /**< stack index of the result */
+	int defs;              /**< stack index of the table -> state map */
+	int current;           /**< stack index of the table for key/value pairs */
+	int depth;
+	toml_buf_type *bfr;
+} toml_parser_type;
+
+typedef struct {
+	char magic[4];
+	uint8_t version;
+	uint8_t strict;
+	uint8_t int_size;
+	uint8_t num_size;
+	uint64_t mtime;
+	uint64_t size;
+	uint64_t hash;
+} toml_snap_header_type;
+
+/* Scratch Buffers ======================================================== */
+/* ------------------------------------------------------------------------ */
+static toml_buf_type *toml_new_buffer( lua_State *L )
+{
+	toml_buf_type *b = (toml_buf_type*)lua_newuserdatauv(L, sizeof(toml_buf_type), 0);
+	memset((void*)b,0,sizeof(toml_buf_type));
+	luaL_setmetatable(L, LUA_EXT_TOML_BUF);
+	return b;
+}
+/* ------------------------------------------------------------------------ */
+static int toml_buffer_gc( lua_State *L )
+{
+	toml_buf_type *b = (toml_buf_type*)luaL_checkudata(L, 1, LUA_EXT_TOML_BUF);
+	free(b->data);
+	b->data = NULL;
+	b->len = b->cap = 0;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_reserve( lua_State *L, toml_buf_type *b, size_t n )
+{
+	if (b->len + n <= b->cap) return;
+	size_t cap = (b->cap < 256)?256:b->cap;
+	while (cap < b->len + n) cap *= 2;
+	char *p = (char*)realloc(b->data, cap);
+	if (p == NULL) luaL_error(L, "not enough memory");
+	b->data = p;
+	b->cap = cap;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_add( lua_State *L, toml_buf_type *b, const void *s, size_t n )
+{
+	toml_reserve(L, b, n);
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
+#define toml_addc(L,b,c)     do { char _c = (c); toml_add(L,b,&_c,1); } while(0)
+#define toml_adds(L,b,s)     toml_add(L,b,s,strlen(s))
+/* ------------------------------------------------------------------------ */
+/* read a whole file, NUL terminated so the parser can look ahead */
+static bool toml_read_file( lua_State *L, const char *path, toml_buf_type *b )
+{
+	FILE *fp = fopen(path, "rb");
+	size_t n;
+
+	if (fp == NULL) return false;
+	b->len = 0;
+	do {
+		toml_reserve(L, b, 4096);
+		n = fread(b->data + b->len, 1, b->cap - b->len, fp);
+		b->len += n;
+	} while (n > 0);
+	fclose(fp);
+	toml_reserve(L, b, 1);
+	b->data[b->len] = '\0';
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static uint64_t toml_hash( const char *s, size_t len )
+{
+	uint64_t h = 0xcbf29ce484222325ULL;   /* FNV-1a */
+	for (size_t indx = 0;indx<len;++indx) {
+		h ^= (uint8_t)s[indx];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* Parser ================================================================= */
+/* ------------------------------------------------------------------------ */
+static int toml_error( toml_parser_type *P, const char *fmt, ... )
+{
+	lua_State *L = P->L;
+	const char *end = (P->p < P->end)?P->p:P->end;
+	int line = 1;
+	va_list args;
+
+	for (const char *s = P->text;s<end;++s) if (*s == '\n') ++line;
+	va_start(args, fmt);
+	lua_pushvfstring(L, fmt, args);
+	va_end(args);
+	return luaL_error(L, "TOML: %s on line %d.", lua_tostring(L,-1), line);
+}
+/* ------------------------------------------------------------------------ */
+/* error naming the key at index k */
+static int toml_key_error( toml_parser_type *P, int k, const char *fmt )
+{
+	lua_pushvalue(P->L, k);
+	return toml_error(P, fmt, lua_tostring(P->L, -1));
+}
+/* ------------------------------------------------------------------------ */
+static void toml_enter( toml_parser_type *P )
+{
+	if (++P->depth > TOML_MAX_DEPTH) toml_error(P, "Nesting too deep");
+	luaL_checkstack(P->L, 8, "TOML nesting");
+}
+/* ------------------------------------------------------------------------ */
+static int toml_state( toml_parser_type *P, int idx )
+{
+	lua_State *L = P->L;
+	lua_pushvalue(L, idx);
+	lua_rawget(L, P->defs);
+	int state = (int)lua_tointeger(L, -1);
+	lua_pop(L,1);
+	return state;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_set_state( toml_parser_type *P, int idx, int state )
+{
+	lua_State *L = P->L;
+	idx = lua_absindex(L, idx);
+	lua_pushvalue(L, idx);
+	lua_pushinteger(L, state);
+	lua_rawset(L, P->defs);
+}
+/* ------------------------------------------------------------------------ */
+static inline bool toml_newline( const char *p )
+{
+	return (p[0] == '\n')||((p[0] == '\r')&&(p[1] == '\n'));
+}
+/* ------------------------------------------------------------------------ */
+static inline void toml_skip_newline( toml_parser_type *P )
+{
+	P->p += (*P->p == '\r')?2:1;
+}
+/* ------------------------------------------------------------------------ */
+static inline void toml_ws( toml_parser_type *P )
+{
+	while ((*P->p == ' ')||(*P->p == '\t')) P->p++;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_comment( toml_parser_type *P )
+{
+	if (*P->p != '#') return;
+	while ((P->p < P->end)&&(!toml_newline(P->p))) P->p++;
+}
+/* ------------------------------------------------------------------------ */
+/* whitespace, comments and line breaks, as allowed inside arrays */
+static void toml_space( toml_parser_type *P )
+{
+	for (;;) {
+		toml_ws(P);
+		toml_comment(P);
+		if ((P->p >= P->end)||(!toml_newline(P->p))) break;
+		toml_skip_newline(P);
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* nothing but a comment may follow a value or a header on its line */
+static void toml_eol( toml_parser_type *P )
+{
+	toml_ws(P);
+	toml_comment(P);
+	if (P->p >= P->end) return;
+	if (!toml_newline(P->p)) toml_error(P, "Invalid primitive");
+	toml_skip_newline(P);
+}
+/* ------------------------------------------------------------------------ */
+static void toml_utf8( toml_parser_type *P, uint32_t c )
+{
+	char s[4];
+	size_t n;
+
+	if (c < 0x80) { s[0] = (char)c; n = 1; }
+	else if (c < 0x800) {
+		s[0] = (char)(0xC0|(c>>6));
+		s[1] = (char)(0x80|(c&0x3F));
+		n = 2;
+	} else if (c < 0x10000) {
+		s[0] = (char)(0xE0|(c>>12));
+		s[1] = (char)(0x80|((c>>6)&0x3F));
+		s[2] = (char)(0x80|(c&0x3F));
+		n = 3;
+	} else {
+		s[0] = (char)(0xF0|(c>>18));
+		s[1] = (char)(0x80|((c>>12)&0x3F));
+		s[2] = (char)(0x80|((c>>6)&0x3F));
+		s[3] = (char)(0x80|(c&0x3F));
+		n = 4;
+	}
+	toml_add(P->L, P->bfr, s, n);
+}
+/* ------------------------------------------------------------------------ */
+static void toml_escape( toml_parser_type *P, bool multi )
+{
+	const char *p = P->p + 1;
+	uint32_t c = 0;
+	int digits;
+
+	switch (*p) {
+	case 'b': toml_addc(P->L, P->bfr, '\b'); P->p += 2; return;
+	case 't': toml_addc(P->L, P->bfr, '\t'); P->p += 2; return;
+	case 'n': toml_addc(P->L, P->bfr, '\n'); P->p += 2; return;
+	case 'f': toml_addc(P->L, P->bfr, '\f'); P->p += 2; return;
+	case 'r': toml_addc(P->L, P->bfr, '\r'); P->p += 2; return;
+	case '"': toml_addc(P->L, P->bfr, '"'); P->p += 2; return;
+	case '\\': toml_addc(P->L, P->bfr, '\\'); P->p += 2; return;
+	case 'u':
+	case 'U':
+		digits = (*p == 'u')?4:8;
+		for (int indx = 1;indx<=digits;++indx) {
+			char h = p[indx];
+			if ((h >= '0')&&(h <= '9')) c = (c<<4)|(uint32_t)(h - '0');
+			else if ((h >= 'a')&&(h <= 'f')) c = (c<<4)|(uint32_t)(h - 'a' + 10);
+			else if ((h >= 'A')&&(h <= 'F')) c = (c<<4)|(uint32_t)(h - 'A' + 10);
+			else toml_error(P, "Invalid escape");
+		}
+		if (((c >= 0xD800)&&(c <= 0xDFFF))||(c > 0x10FFFF)) toml_error(P, "Unicode escape is not a Unicode scalar");
+		toml_utf8(P, c);
+		P->p += digits + 2;
+		return;
+	default:
+		break;
+	}
+	if (multi) {
+		/* line ending backslash, trim up to the next non-whitespace */
+		while ((*p == ' ')||(*p == '\t')) p++;
+		if (toml_newline(p)) {
+			while ((*p == ' ')||(*p == '\t')||(*p == '\n')||toml_newline(p)) p++;
+			P->p = p;
+			return;
+		}
+	}
+	toml_error(P, "Invalid escape");
+}
+/* ------------------------------------------------------------------------ */
+static inline bool toml_plain( char c, char q )
+{
+	return (c != q)&&((c != '\\')||(q == '\''))&&(((uint8_t)c >= 0x20)||(c == '\t'))&&(c != 0x7F);
+}
+/* ------------------------------------------------------------------------ */
+/* basic, literal and multi-line strings, the value is pushed */
+static void toml_string( toml_parser_type *P )
+{
+	lua_State *L = P->L;
+	const char q = *P->p;
+	const bool multi = (P->p[1] == q)&&(P->p[2] == q);
+	bool first = true;
+
+	P->p += multi?3:1;
+	if (multi && toml_newline(P->p)) toml_skip_newline(P);
+	P->bfr->len = 0;
+	for (;;) {
+		const char *run = P->p;
+		while ((P->p < P->end)&&toml_plain(*P->p, q)) P->p++;
+		if (P->p >= P->end) toml_error(P, "Unterminated string");
+		char c = *P->p;
+		if (first && !multi && (c == q)) {
+			/* no escapes, straight from the document */
+			lua_pushlstring(L, run, P->p - run);
+			P->p++;
+			return;
+		}
+		first = false;
+		toml_add(L, P->bfr, run, P->p - run);
+		if (c == q) {
+			if (!multi) {
+				P->p++;
+				break;
+			}
+			if ((P->p[1] == q)&&(P->p[2] == q)) {
+				/* up to two quotes may sit right before the delimiter */
+				for (int indx = 0;(indx<2)&&(P->p[3] == q);++indx) {
+					toml_addc(L, P->bfr, q);
+					P->p++;
+				}
+				P->p += 3;
+				break;
+			}
+			toml_addc(L, P->bfr, q);
+			P->p++;
+		} else if (c == '\\') {
+			toml_escape(P, multi);
+		} else if (toml_newline(P->p)) {
+			if (!multi) toml_error(P, "Single-line string cannot contain line break");
+			toml_add(L, P->bfr, P->p, (c == '\r')?2:1);
+			toml_skip_newline(P);
+		} else {
+			if (P->strict) toml_error(P, "Control character in string");
+			toml_addc(L, P->bfr, c);
+			P->p++;
+		}
+	}
+	lua_pushlstring(L, P->bfr->data, P->bfr->len);
+}
+/* ------------------------------------------------------------------------ */
+static inline bool toml_digit( char c, int base )
+{
+	switch (base) {
+	case 2: return (c == '0')||(c == '1');
+	case 8: return (c >= '0')&&(c <= '7');
+	case 16: return ((c >= '0')&&(c <= '9'))||((c >= 'a')&&(c <= 'f'))||((c >= 'A')&&(c <= 'F'));
+	default: return (c >= '0')&&(c <= '9');
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* copy digits to num, underscores are only allowed between two digits */
+static const char *toml_digits( toml_parser_type *P, const char *s, char *num, size_t *len, int base )
+{
+	const char *start = s;
+	for (;;) {
+		if (toml_digit(*s, base)) {
+			if (*len >= TOML_MAX_NUMBER - 2) toml_error(P, "Invalid number");
+			num[(*len)++] = *s++;
+		} else if ((*s == '_')&&(s > start)&&toml_digit(s[-1], base)&&toml_digit(s[1], base)) {
+			s++;
+		} else {
+			break;
+		}
+	}
+	if (s == start) toml_error(P, "Invalid number");
+	return s;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_number( toml_parser_type *P )
+{
+	lua_State *L = P->L;
+	char num[TOML_MAX_NUMBER];
+	size_t len = 0;
+	const char *s = P->p;
+	bool is_float = false;
+
+	if ((*s == '+')||(*s == '-')) num[len++] = *s++;
+	if ((strncmp(s, "inf", 3) == 0)||(strncmp(s, "nan", 3) == 0)) {
+		lua_Number v = (*s == 'i')?(lua_Number)HUGE_VAL:(lua_Number)NAN;
+		lua_pushnumber(L, (num[0] == '-')?-v:v);
+		P->p = s + 3;
+		return;
+	}
+	if ((len == 0)&&(s[0] == '0')&&((s[1] == 'x')||(s[1] == 'o')||(s[1] == 'b'))) {
+		int base = (s[1] == 'x')?16:((s[1] == 'o')?8:2);
+		uint64_t v = 0;
+		s = toml_digits(P, s + 2, num, &len, base);
+		for (size_t indx = 0;indx<len;++indx) {
+			char c = num[indx];
+			uint64_t d = (c <= '9')?(uint64_t)(c - '0'):(uint64_t)((c|0x20) - 'a' + 10);
+			if (v > (UINT64_MAX - d)/(uint64_t)base) toml_error(P, "Integer out of range");
+			v = v*(uint64_t)base + d;
+		}
+		lua_pushinteger(L, (lua_Integer)v);
+		P->p = s;
+		return;
+	}
+	size_t int_start = len;
+	s = toml_digits(P, s, num, &len, 10);
+	if (P->strict && (num[int_start] == '0')&&(len - int_start > 1)) toml_error(P, "Leading zeros are not allowed");
+	if (*s == '.') {
+		is_float = true;
+		num[len++] = '.';
+		s = toml_digits(P, s + 1, num, &len, 10);
+	}
+	if ((*s == 'e')||(*s == 'E')) {
+		is_float = true;
+		num[len++] = 'e';
+		s++;
+		if ((*s == '+')||(*s == '-')) num[len++] = *s++;
+		s = toml_digits(P, s, num, &len, 10);
+	}
+	num[len] = '\0';
+	if (lua_stringtonumber(L, num) == 0) toml_error(P, "Invalid number");
+	if (!is_float && !lua_isinteger(L, -1)) toml_error(P, "Integer out of range");
+	P->p = s;
+}
+/* ------------------------------------------------------------------------ */
+static inline bool toml_isdigit( char c )
+{
+	return (c >= '0')&&(c <= '9');
+}
+/* ------------------------------------------------------------------------ */
+static bool toml_is_date( const char *s )
+{
+	return toml_isdigit(s[0])&&toml_isdigit(s[1])&&
+		((s[2] == ':')||(toml_isdigit(s[2])&&toml_isdigit(s[3])&&(s[4] == '-')));
+}
+/* ------------------------------------------------------------------------ */
+/* dates and times are returned as strings, Lua has no date type */
+static void toml_date( toml_parser_type *P )
+{
+	const char *s = P->p;
+	for (;;) {
+		while (toml_isdigit(*P->p)||((*P->p != '\0')&&(strchr("-:.+TtZz", *P->p) != NULL))) P->p++;
+		/* "1979-05-27 07:32:00", a space may separate the date and time */
+		if ((P->p - s == 10)&&(*P->p == ' ')&&toml_isdigit(P->p[1])&&toml_isdigit(P->p[2])&&(P->p[3] == ':')) {
+			P->p++;
+			continue;
+		}
+		break;
+	}
+	lua_pushlstring(P->L, s, P->p - s);
+}
+/* ------------------------------------------------------------------------ */
+static inline bool toml_bare( char c )
+{
+	return ((c >= 'A')&&(c <= 'Z'))||((c >= 'a')&&(c <= 'z'))||toml_isdigit(c)||(c == '_')||(c == '-');
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Push the parts of a (dotted) key and return how many there are.  Bare
+ * keys made of digits become integer keys when numeric is set, as the Lua
+ * parser did for key/value pairs.
+ */
+static int toml_key( toml_parser_type *P, bool numeric )
+{
+	lua_State *L = P->L;
+	int n = 0;
+
+	for (;;) {
+		toml_ws(P);
+		if (++n > TOML_MAX_DEPTH) toml_error(P, "Key has too many parts");
+		luaL_checkstack(L, 2, "TOML key");
+		if ((*P->p == '"')||(*P->p == '\'')) {
+			if ((P->p[1] == P->p[0])&&(P->p[2] == P->p[0])) toml_error(P, "Multi-line string used as key");
+			toml_string(P);
+		} else {
+			const char *s = P->p;
+			bool digits = true;
+			while ((P->p < P->end)&&toml_bare(*P->p)) {
+				digits = digits && toml_isdigit(*P->p);
+				P->p++;
+			}
+			if (P->p == s) toml_error(P, "Empty key name");
+			if (numeric && digits && (P->p - s < 19)) lua_pushinteger(L, (lua_Integer)strtoll(s, NULL, 10));
+			else lua_pushlstring(L, s, P->p - s);
+		}
+		toml_ws(P);
+		if (*P->p != '.') break;
+		P->p++;
+	}
+	return n;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Step from the table on top of the stack into its child named by the key
+ * at index k, creating it with the state ctx when it does not exist.  A
+ * header path steps into the last table of an array of tables.
+ */
+static void toml_child( toml_parser_type *P, int k, int ctx )
+{
+	lua_State *L = P->L;
+	int state;
+
+	lua_pushvalue(L, k);
+	switch (lua_rawget(L, -2)) {
+	case LUA_TNIL:
+		lua_pop(L,1);
+		lua_newtable(L);
+		toml_set_state(P, -1, ctx);
+		lua_pushvalue(L, k);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+		break;
+	case LUA_TTABLE:
+		state = toml_state(P, -1);
+		if ((state == TOML_TABLES)&&(ctx == TOML_IMPLICIT)) {
+			lua_rawgeti(L, -1, (lua_Integer)lua_rawlen(L, -1));
+			lua_remove(L, -2);
+		} else if ((state == TOML_INLINE)||(state == TOML_ARRAY)||(state == TOML_TABLES)) {
+			toml_key_error(P, k, "Cannot extend \"%s\"");
+		} else if ((ctx == TOML_DOTTED)&&(state != TOML_DOTTED)&&(P->strict)) {
+			toml_key_error(P, k, "Cannot redefine table \"%s\"");
+		}
+		break;
+	default:
+		toml_key_error(P, k, "Key \"%s\" is not a table");
+		break;
+	}
+	lua_remove(L, -2);
+}
+
+static void toml_value( toml_parser_type *P );
+/* ------------------------------------------------------------------------ */
+/* key = value, the n key parts are on top of the stack, t is the table */
+static void toml_assign( toml_parser_type *P, int t, int n )
+{
+	lua_State *L = P->L;
+	int k = lua_gettop(L) - n + 1;
+
+	lua_pushvalue(L, t);
+	for (int indx = 0;indx<n-1;++indx) toml_child(P, k + indx, TOML_DOTTED);
+	if (*P->p != '=') toml_error(P, "Expected '=' after key");
+	P->p++;
+	toml_ws(P);
+	if ((P->p >= P->end)||toml_newline(P->p)) toml_error(P, "Missing value");
+	lua_pushvalue(L, k + n - 1);
+	if ((lua_rawget(L, -2) != LUA_TNIL)&&(P->strict)) toml_key_error(P, k + n - 1, "Cannot redefine key \"%s\"");
+	lua_pop(L,1);
+	lua_pushvalue(L, k + n - 1);
+	toml_value(P);
+	lua_rawset(L, -3);
+	lua_settop(L, k - 1);
+}
+/* ------------------------------------------------------------------------ */
+static void toml_array( toml_parser_type *P )
+{
+	lua_State *L = P->L;
+	lua_Integer n = 0;
+
+	toml_enter(P);
+	P->p++;
+	lua_newtable(L);
+	toml_set_state(P, -1, TOML_ARRAY);
+	for (;;) {
+		toml_space(P);
+		if (*P->p == ']') break;
+		if (P->p >= P->end) toml_error(P, "Unterminated array");
+		toml_value(P);
+		lua_rawseti(L, -2, ++n);
+		toml_space(P);
+		if (*P->p == ',') {
+			P->p++;
+		} else if (*P->p != ']') {
+			toml_error(P, "Expected ',' or ']' in array");
+		}
+	}
+	P->p++;
+	P->depth--;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_inline( toml_parser_type *P )
+{
+	lua_State *L = P->L;
+	int t;
+
+	toml_enter(P);
+	P->p++;
+	lua_newtable(L);
+	t = lua_gettop(L);
+	toml_ws(P);
+	if (*P->p != '}') {
+		for (;;) {
+			toml_assign(P, t, toml_key(P, false));
+			toml_ws(P);
+			if (*P->p == '}') break;
+			if (toml_newline(P->p)) toml_error(P, "Newline in inline table");
+			if (*P->p != ',') toml_error(P, "Expected ',' or '}' in inline table");
+			P->p++;
+			toml_ws(P);
+			if ((*P->p == '}')&&(P->strict)) toml_error(P, "Trailing comma in inline table");
+			if (*P->p == '}') break;
+		}
+	}
+	P->p++;
+	toml_set_state(P, t, TOML_INLINE);
+	P->depth--;
+}
+/* ------------------------------------------------------------------------ */
+/* figure out the type and push the next value in the document */
+static void toml_value( toml_parser_type *P )
+{
+	const char *p = P->p;
+
+	switch (*p) {
+	case '"':
+	case '\'':
+		toml_string(P);
+		break;
+	case '[':
+		toml_array(P);
+		break;
+	case '{':
+		toml_inline(P);
+		break;
+	case 't':
+		if (strncmp(p, "true", 4) != 0) toml_error(P, "Invalid primitive");
+		lua_pushboolean(P->L, 1);
+		P->p += 4;
+		break;
+	case 'f':
+		if (strncmp(p, "false", 5) != 0) toml_error(P, "Invalid primitive");
+		lua_pushboolean(P->L, 0);
+		P->p += 5;
+		break;
+	default:
+		if (toml_is_date(p)) toml_date(P);
+		else if (toml_isdigit(*p)||(*p == '+')||(*p == '-')||(*p == 'i')||(*p == 'n')) toml_number(P);
+		else toml_error(P, "Invalid primitive");
+		break;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* [table] and [[array.of.tables]], the table becomes the current one */
+static void toml_header( toml_parser_type *P )
+{
+	lua_State *L = P->L;
+	bool tables = (P->p[1] == '[');
+	int n, k;
+
+	P->p += tables?2:1;
+	n = toml_key(P, false);
+	k = lua_gettop(L) - n + 1;
+	if ((*P->p != ']')||(tables && (P->p[1] != ']'))) toml_error(P, "Mismatching brackets");
+	P->p += tables?2:1;
+
+	lua_pushvalue(L, P->root);
+	for (int indx = 0;indx<n-1;++indx) toml_child(P, k + indx, TOML_IMPLICIT);
+	lua_pushvalue(L, k + n - 1);
+	int type = lua_rawget(L, -2);
+	int state = (type == LUA_TTABLE)?toml_state(P, -1):0;
+	if (tables) {
+		if (type == LUA_TNIL) {
+			lua_pop(L,1);
+			lua_newtable(L);
+			toml_set_state(P, -1, TOML_TABLES);
+			lua_pushvalue(L, k + n - 1);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, -4);
+		} else if (state != TOML_TABLES) {
+			toml_key_error(P, k + n - 1, "Cannot redefine \"%s\" as an array of tables");
+		}
+		lua_newtable(L);
+		toml_set_state(P, -1, TOML_HEADER);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, -3, (lua_Integer)lua_rawlen(L, -3) + 1);
+	} else if (type == LUA_TNIL) {
+		lua_pop(L,1);
+		lua_newtable(L);
+		toml_set_state(P, -1, TOML_HEADER);
+		lua_pushvalue(L, k + n - 1);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	} else if (state == TOML_IMPLICIT) {
+		toml_set_state(P, -1, TOML_HEADER);
+	} else if ((state == TOML_HEADER)||(state == TOML_DOTTED)) {
+		if (P->strict) toml_error(P, "Cannot redefine table");
+	} else {
+		toml_key_error(P, k + n - 1, "Cannot redefine \"%s\" as a table");
+	}
+	lua_replace(L, P->current);
+	lua_settop(L, k - 1);
+	toml_eol(P);
+}
+/* ------------------------------------------------------------------------ */
+/* parse text and push the resulting table */
+static void toml_decode( lua_State *L, const char *text, size_t len, bool strict )
+{
+	toml_parser_type P;
+
+	memset((void*)&P,0,sizeof(toml_parser_type));
+	P.L = L;
+	P.text = P.p = text;
+	P.end = text + len;
+	P.strict = strict;
+	lua_newtable(L);
+	P.root = lua_gettop(L);
+	lua_newtable(L);
+	P.defs = lua_gettop(L);
+	P.bfr = toml_new_buffer(L);
+	lua_pushvalue(L, P.root);
+	P.current = lua_gettop(L);
+
+	if ((len >= 3)&&(memcmp(text, "\xEF\xBB\xBF", 3) == 0)) P.p += 3;
+	for (;;) {
+		toml_ws(&P);
+		if (P.p >= P.end) break;
+		if (*P.p == '#') {
+			toml_comment(&P);
+		} else if (toml_newline(P.p)) {
+			toml_skip_newline(&P);
+		} else if (*P.p == '[') {
+			toml_header(&P);
+		} else {
+			toml_assign(&P, P.current, toml_key(&P, true));
+			toml_eol(&P);
+		}
+	}
+	lua_settop(L, P.root);
+}
+/* ------------------------------------------------------------------------ */
+/* strict option, defaults to on like TOML.strict */
+static bool toml_strict( lua_State *L, int n )
+{
+	bool strict = true;
+	if (lua_isnoneornil(L, n)) return strict;
+	luaL_checktype(L, n, LUA_TTABLE);
+	if (lua_getfield(L, n, "strict") != LUA_TNIL) strict = lua_toboolean(L, -1);
+	lua_pop(L,1);
+	return strict;
+}
+
+/* Encoder ================================================================ */
+/* ------------------------------------------------------------------------ */
+static void toml_encode_string( lua_State *L, toml_buf_type *b, const char *s, size_t len )
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const char *end = s + len;
+
+	toml_addc(L, b, '"');
+	while (s < end) {
+		const char *run = s;
+		while ((s < end)&&((uint8_t)*s >= 0x20)&&(*s != '"')&&(*s != '\\')&&(*s != 0x7F)) s++;
+		toml_add(L, b, run, s - run);
+		if (s >= end) break;
+		switch (*s) {
+		case '"': toml_adds(L, b, "\\\""); break;
+		case '\\': toml_adds(L, b, "\\\\"); break;
+		case '\b': toml_adds(L, b, "\\b"); break;
+		case '\t': toml_adds(L, b, "\\t"); break;
+		case '\n': toml_adds(L, b, "\\n"); break;
+		case '\f': toml_adds(L, b, "\\f"); break;
+		case '\r': toml_adds(L, b, "\\r"); break;
+		default: {
+			char u[6] = { '\\', 'u', '0', '0', hex[((uint8_t)*s)>>4], hex[*s&0xF] };
+			toml_add(L, b, u, 6);
+			break;
+		}
+		}
+		s++;
+	}
+	toml_addc(L, b, '"');
+}
+/* ------------------------------------------------------------------------ */
+static void toml_encode_key( lua_State *L, toml_buf_type *b, int idx )
+{
+	size_t len;
+	const char *s;
+	bool bare = true;
+
+	if (lua_type(L, idx) == LUA_TNUMBER) {
+		if (!lua_isinteger(L, idx)) luaL_error(L, "cannot encode a float key");
+		char num[32];
+		int n = snprintf(num, sizeof(num), LUA_INTEGER_FMT, (LUAI_UACINT)lua_tointeger(L, idx));
+		toml_add(L, b, num, (size_t)n);
+		return;
+	}
+	if (lua_type(L, idx) != LUA_TSTRING) luaL_error(L, "cannot encode a key of type %s", luaL_typename(L, idx));
+	s = lua_tolstring(L, idx, &len);
+	for (size_t indx = 0;indx<len;++indx) bare = bare && toml_bare(s[indx]);
+	if (bare && (len > 0)) toml_add(L, b, s, len);
+	else toml_encode_string(L, b, s, len);
+}
+/* ------------------------------------------------------------------------ */
+/* length of a table holding only the keys 1..n, 0 for anything else */
+static lua_Integer toml_sequence( lua_State *L, int idx )
+{
+	lua_Integer n = (lua_Integer)lua_rawlen(L, idx);
+	lua_Integer count = 0;
+
+	if (n == 0) return 0;
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		lua_pop(L,1);
+		if (!lua_isinteger(L, -1)||(lua_tointeger(L, -1) < 1)||(lua_tointeger(L, -1) > n)) {
+			lua_pop(L,1);
+			return 0;
+		}
+		++count;
+	}
+	return (count == n)?n:0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * A table value is written as a section when it is a map, or an array
+ * holding only maps ([[name]]).  Everything else is an inline value.
+ */
+static bool toml_is_section( lua_State *L, int idx, lua_Integer *n )
+{
+	idx = lua_absindex(L, idx);
+	*n = 0;
+	if (lua_type(L, idx) != LUA_TTABLE) return false;
+	*n = toml_sequence(L, idx);
+	for (lua_Integer indx = 1;indx<=*n;++indx) {
+		lua_rawgeti(L, idx, indx);
+		bool map = (lua_type(L, -1) == LUA_TTABLE)&&(toml_sequence(L, lua_gettop(L)) == 0);
+		lua_pop(L,1);
+		if (!map) return false;
+	}
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+static void toml_encode_value( lua_State *L, toml_buf_type *b, int idx, int depth )
+{
+	char num[64];
+	int n;
+
+	idx = lua_absindex(L, idx);
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		toml_adds(L, b, lua_toboolean(L, idx)?"true":"false");
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			n = snprintf(num, sizeof(num), LUA_INTEGER_FMT, (LUAI_UACINT)lua_tointeger(L, idx));
+		} else {
+			lua_Number v = lua_tonumber(L, idx);
+			if (v != v) n = snprintf(num, sizeof(num), "nan");
+			else if (v == (lua_Number)HUGE_VAL) n = snprintf(num, sizeof(num), "inf");
+			else if (v == -(lua_Number)HUGE_VAL) n = snprintf(num, sizeof(num), "-inf");
+			else {
+				n = snprintf(num, sizeof(num), LUA_NUMBER_FMT, (LUAI_UACNUMBER)v);
+				if (strspn(num, "-0123456789") == (size_t)n) n += snprintf(num + n, sizeof(num) - n, ".0");
+			}
+		}
+		toml_add(L, b, num, (size_t)n);
+		break;
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		toml_encode_string(L, b, s, len);
+		break;
+	}
+	case LUA_TTABLE: {
+		lua_Integer len = toml_sequence(L, idx);
+		bool first = true;
+		if (depth > TOML_MAX_DEPTH) luaL_error(L, "cannot encode, nesting too deep (cyclic table?)");
+		luaL_checkstack(L, 4, NULL);
+		bool empty = false;
+		if (len == 0) {
+			lua_pushnil(L);
+			empty = (lua_next(L, idx) == 0);
+			lua_settop(L, idx);
+		}
+		if ((len > 0)||empty) {
+			toml_addc(L, b, '[');
+			for (lua_Integer indx = 1;indx<=len;++indx) {
+				toml_adds(L, b, (indx == 1)?" ":", ");
+				lua_rawgeti(L, idx, indx);
+				toml_encode_value(L, b, -1, depth + 1);
+				lua_pop(L,1);
+			}
+			toml_adds(L, b, (len > 0)?" ]":"]");
+			break;
+		}
+		toml_addc(L, b, '{');
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			toml_adds(L, b, first?" ":", ");
+			first = false;
+			toml_encode_key(L, b, -2);
+			toml_adds(L, b, " = ");
+			toml_encode_value(L, b, -1, depth + 1);
+			lua_pop(L,1);
+		}
+		toml_adds(L, b, " }");
+		break;
+	}
+	default:
+		luaL_error(L, "cannot encode a value of type %s", luaL_typename(L, idx));
+		break;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static void toml_encode_header( lua_State *L, toml_buf_type *b, int path, bool tables )
+{
+	size_t len;
+	const char *s = lua_tolstring(L, path, &len);
+
+	if (b->len > 0) toml_addc(L, b, '\n');
+	toml_adds(L, b, tables?"[[":"[");
+	toml_add(L, b, s, len);
+	toml_adds(L, b, tables?"]]\n":"]\n");
+}
+/* ------------------------------------------------------------------------ */
+/* key/value pairs of t, then its sections; path is the header name or 0 */
+static void toml_encode_table( lua_State *L, toml_buf_type *b, int t, int path, int depth )
+{
+	lua_Integer n;
+
+	if (depth > TOML_MAX_DEPTH) luaL_error(L, "cannot encode, nesting too deep (cyclic table?)");
+	luaL_checkstack(L, 8, NULL);
+	t = lua_absindex(L, t);
+	lua_pushnil(L);
+	while (lua_next(L, t)) {
+		if (!toml_is_section(L, -1, &n)) {
+			toml_encode_key(L, b, -2);
+			toml_adds(L, b, " = ");
+			toml_encode_value(L, b, -1, depth + 1);
+			toml_addc(L, b, '\n');
+		}
+		lua_pop(L,1);
+	}
+	lua_pushnil(L);
+	while (lua_next(L, t)) {
+		if (toml_is_section(L, -1, &n)) {
+			size_t mark = b->len;
+			toml_encode_key(L, b, -2);
+			if (path != 0) {
+				lua_pushvalue(L, path);
+				lua_pushliteral(L, ".");
+				lua_pushlstring(L, b->data + mark, b->len - mark);
+				lua_concat(L, 3);
+			} else {
+				lua_pushlstring(L, b->data + mark, b->len - mark);
+			}
+			b->len = mark;
+			int sub = lua_gettop(L);
+			if (n > 0) {
+				for (lua_Integer indx = 1;indx<=n;++indx) {
+					toml_encode_header(L, b, sub, true);
+					lua_rawgeti(L, sub - 1, indx);
+					toml_encode_table(L, b, -1, sub, depth + 1);
+					lua_pop(L,1);
+				}
+			} else {
+				toml_encode_header(L, b, sub, false);
+				toml_encode_table(L, b, sub - 1, sub, depth + 1);
+			}
+			lua_pop(L,1);
+		}
+		lua_pop(L,1);
+	}
+}
+
+/* Snapshots ============================================================== */
+/* ------------------------------------------------------------------------ */
+static void toml_snap_size( lua_State *L, toml_buf_type *b, uint64_t v )
+{
+	do {
+		uint8_t c = (uint8_t)(v & 0x7F);
+		v >>= 7;
+		toml_addc(L, b, (char)(c | ((v != 0)?0x80:0)));
+	} while (v != 0);
+}
+/* ------------------------------------------------------------------------ */
+static void toml_snap_value( lua_State *L, toml_buf_type *b, int idx, int depth )
+{
+	idx = lua_absindex(L, idx);
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		toml_addc(L, b, lua_toboolean(L, idx)?TOML_SNAP_TRUE:TOML_SNAP_FALSE);
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			lua_Integer v = lua_tointeger(L, idx);
+			toml_addc(L, b, TOML_SNAP_INT);
+			toml_add(L, b, &v, sizeof(v));
+		} else {
+			lua_Number v = lua_tonumber(L, idx);
+			toml_addc(L, b, TOML_SNAP_NUM);
+			toml_add(L, b, &v, sizeof(v));
+		}
+		break;
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		toml_addc(L, b, TOML_SNAP_STR);
+		toml_snap_size(L, b, len);
+		toml_add(L, b, s, len);
+		break;
+	}
+	case LUA_TTABLE: {
+		/* the array part is written first so restore can presize the table */
+		lua_Integer narr = 0, total = 0;
+		if (depth > TOML_MAX_DEPTH) luaL_error(L, "cannot snapshot, nesting too deep (cyclic table?)");
+		luaL_checkstack(L, 4, NULL);
+		while (lua_rawgeti(L, idx, narr + 1) != LUA_TNIL) {
+			lua_pop(L,1);
+			++narr;
+		}
+		lua_pop(L,1);
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			lua_pop(L,1);
+			++total;
+		}
+		toml_addc(L, b, TOML_SNAP_TABLE);
+		toml_snap_size(L, b, (uint64_t)narr);
+		toml_snap_size(L, b, (uint64_t)(total - narr));
+		for (lua_Integer indx = 1;indx<=narr;++indx) {
+			lua_rawgeti(L, idx, indx);
+			toml_snap_value(L, b, -1, depth + 1);
+			lua_pop(L,1);
+		}
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			if (!lua_isinteger(L, -2)||(lua_tointeger(L, -2) < 1)||(lua_tointeger(L, -2) > narr)) {
+				toml_snap_value(L, b, -2, depth + 1);
+				toml_snap_value(L, b, -1, depth + 1);
+			}
+			lua_pop(L,1);
+		}
+		break;
+	}
+	default:
+		luaL_error(L, "cannot snapshot a value of type %s", luaL_typename(L, idx));
+		break;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static bool toml_restore_size( const uint8_t **p, const uint8_t *end, uint64_t *v )
+{
+	*v = 0;
+	for (int shift = 0;shift<64;shift += 7) {
+		if (*p >= end) return false;
+		uint8_t c = *(*p)++;
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) return true;
+	}
+	return false;
+}
+/* ------------------------------------------------------------------------ */
+/* push the value at *p, false when the snapshot is truncated or corrupt */
+static bool toml_restore_value( lua_State *L, const uint8_t **p, const uint8_t *end, int depth )
+{
+	uint64_t narr, nrec, len;
+
+	if ((*p >= end)||(depth > TOML_MAX_DEPTH)||!lua_checkstack(L, 4)) return false;
+	switch (*(*p)++) {
+	case TOML_SNAP_FALSE:
+		lua_pushboolean(L, 0);
+		return true;
+	case TOML_SNAP_TRUE:
+		lua_pushboolean(L, 1);
+		return true;
+	case TOML_SNAP_INT: {
+		lua_Integer v;
+		if ((size_t)(end - *p) < sizeof(v)) return false;
+		memcpy(&v, *p, sizeof(v));
+		*p += sizeof(v);
+		lua_pushinteger(L, v);
+		return true;
+	}
+	case TOML_SNAP_NUM: {
+		lua_Number v;
+		if ((size_t)(end - *p) < sizeof(v)) return false;
+		memcpy(&v, *p, sizeof(v));
+		*p += sizeof(v);
+		lua_pushnumber(L, v);
+		return true;
+	}
+	case TOML_SNAP_STR:
+		if (!toml_restore_size(p, end, &len)||((uint64_t)(end - *p) < len)) return false;
+		lua_pushlstring(L, (const char*)*p, (size_t)len);
+		*p += len;
+		return true;
+	case TOML_SNAP_TABLE:
+		if (!toml_restore_size(p, end, &narr)||!toml_restore_size(p, end, &nrec)) return false;
+		if ((narr > (uint64_t)(end - *p))||(nrec > (uint64_t)(end - *p))) return false;
+		lua_createtable(L, (int)narr, (int)nrec);
+		for (uint64_t indx = 1;indx<=narr;++indx) {
+			if (!toml_restore_value(L, p, end, depth + 1)) return false;
+			lua_rawseti(L, -2, (lua_Integer)indx);
+		}
+		for (uint64_t indx = 0;indx<nrec;++indx) {
+			if (!toml_restore_value(L, p, end, depth + 1)) return false;
+			if (lua_isnil(L, -1)||!toml_restore_value(L, p, end, depth + 1)) return false;
+			lua_rawset(L, -3);
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+/* ------------------------------------------------------------------------ */
+static void toml_snap_header( toml_snap_header_type *h, bool strict, uint64_t mtime, uint64_t size, uint64_t hash )
+{
+	memset((void*)h,0,sizeof(toml_snap_header_type));
+	memcpy(h->magic, TOML_SNAP_MAGIC, 4);
+	h->version = TOML_SNAP_VERSION;
+	h->strict = strict?1:0;
+	h->int_size = (uint8_t)sizeof(lua_Integer);
+	h->num_size = (uint8_t)sizeof(lua_Number);
+	h->mtime = mtime;
+	h->size = size;
+	h->hash = hash;
+}
+/* ------------------------------------------------------------------------ */
+/* push the table held in a snapshot whose header matches h */
+static bool toml_restore( lua_State *L, const char *data, size_t len, const toml_snap_header_type *h )
+{
+	const uint8_t *p = (const uint8_t*)data + sizeof(toml_snap_header_type);
+	const uint8_t *end = (const uint8_t*)data + len;
+	int top = lua_gettop(L);
+
+	if (len < sizeof(toml_snap_header_type)) return false;
+	if (memcmp(data, h, sizeof(toml_snap_header_type)) != 0) return false;
+	if (!toml_restore_value(L, &p, end, 0)||!lua_istable(L, -1)||(p != end)) {
+		lua_settop(L, top);
+		return false;
+	}
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Write the snapshot next to the config, through a temporary file of this
+ * process, so runs that write at the same time never rename a partial one.
+ */
+static void toml_snap_write( lua_State *L, const char *path, const toml_buf_type *b )
+{
+#ifdef WIN32
+	const char *tmp = lua_pushfstring(L, "%s.%d.tmp", path, (int)_getpid());
+#else
+	const char *tmp = lua_pushfstring(L, "%s.%d.tmp", path, (int)getpid());
+#endif
+	FILE *fp = fopen(tmp, "wb");
+	bool ok;
+
+	if (fp == NULL) {
+		lua_pop(L,1);
+		return;
+	}
+	ok = (fwrite(b->data, 1, b->len, fp) == b->len);
+	ok = (fclose(fp) == 0) && ok;
+#ifdef WIN32
+	if (ok) remove(path);
+#endif
+	if (!ok || (rename(tmp, path) != 0)) remove(tmp);
+	lua_pop(L,1);
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* tbl = ctoml.parse( text, opts ) */
+static int toml_parse( lua_State *L )
+{
+	size_t len;
+	const char *text = luaL_checklstring(L, 1, &len);
+	bool strict = toml_strict(L, 2);
+
+	lua_settop(L, 2);
+	toml_decode(L, text, len, strict);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* text = ctoml.encode( tbl ) */
+static int toml_encode( lua_State *L )
+{
+	toml_buf_type *b;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_settop(L, 1);
+	b = toml_new_buffer(L);
+	toml_encode_table(L, b, 1, 0, 0);
+	lua_pushlstring(L, b->data, (b->len > 0)?b->len - 1:0);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * tbl, cached = ctoml.load( filename, opts )
+ * With opts.cache (true, or the snapshot file name) the parsed table is
+ * kept in "<filename>.cache" and reused while the file's mtime, size and
+ * hash are unchanged.
+ */
+static int toml_load( lua_State *L )
+{
+	const char *path = luaL_checkstring(L, 1);
+	bool strict = toml_strict(L, 2);
+	const char *cache = NULL;
+	toml_snap_header_type h;
+	toml_buf_type *text, *snap = NULL;
+	struct stat st;
+
+	lua_settop(L, 2);
+	if (lua_istable(L, 2)) {
+		lua_getfield(L, 2, "cache");
+		if (lua_type(L, -1) == LUA_TSTRING) cache = lua_tostring(L, -1);
+		else if (lua_toboolean(L, -1)) {
+			cache = lua_pushfstring(L, "%s.cache", path);
+			lua_replace(L, 3);
+		}
+	}
+	lua_settop(L, 3);
+	text = toml_new_buffer(L);
+	if (!toml_read_file(L, path, text)||(stat(path, &st) != 0)) return luaL_fileresult(L, 0, path);
+	toml_snap_header(&h, strict, (uint64_t)st.st_mtime, (uint64_t)text->len, toml_hash(text->data, text->len));
+
+	if (cache != NULL) {
+		snap = toml_new_buffer(L);
+		if (toml_read_file(L, cache, snap)&&toml_restore(L, snap->data, snap->len, &h)) {
+			lua_pushboolean(L, 1);
+			return 2;
+		}
+	}
+	toml_decode(L, text->data, text->len, strict);
+	if (cache != NULL) {
+		snap->len = 0;
+		toml_add(L, snap, &h, sizeof(h));
+		toml_snap_value(L, snap, -1, 0);
+		toml_snap_write(L, cache, snap);
+	}
+	lua_pushboolean(L, 0);
+	return 2;
+}
+/* ------------------------------------------------------------------------ */
+/* bin = ctoml.snapshot( tbl ) */
+static int toml_snapshot( lua_State *L )
+{
+	toml_snap_header_type h;
+	toml_buf_type *b;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_settop(L, 1);
+	b = toml_new_buffer(L);
+	toml_snap_header(&h, false, 0, 0, 0);
+	toml_add(L, b, &h, sizeof(h));
+	toml_snap_value(L, b, 1, 0);
+	lua_pushlstring(L, b->data, b->len);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
+/* tbl = ctoml.restore( bin ), nil on a damaged snapshot */
+static int toml_restore_snapshot( lua_State *L )
+{
+	size_t len;
+	const char *data = luaL_checklstring(L, 1, &len);
+	toml_snap_header_type h;
+
+	toml_snap_header(&h, false, 0, 0, 0);
+	if (!toml_restore(L, data, len, &h)) {
+		luaL_pushfail(L);
+		lua_pushliteral(L, "invalid snapshot");
+		return 2;
+	}
+	return 1;
+}
+
+static const luaL_Reg toml_lib[] = {
+		{"parse", toml_parse},
+		{"encode", toml_encode},
+		{"load", toml_load},
+		{"snapshot", toml_snapshot},
+		{"restore", toml_restore_snapshot},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_ctoml( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_TOML_BUF);
+	lua_pushcfunction(L, toml_buffer_gc);
+	lua_setfield(L, -2, "__gc");
+	lua_pop(L,1);
+
+	luaL_newlib(L, toml_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
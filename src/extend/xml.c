@@ -0,0 +1,702 @@
+/*
+ * xml.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lprefix.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define LUA_EXT_XML_BUF       ("_XML_BUF_")
+
+#define XML_MAX_DEPTH         (1000)
+
+/* xmlparser.lua error strings */
+#define XML_ERR               "Error Parsing XML"
+#define XML_ERR_DECL          "Error Parsing XMLDecl"
+#define XML_ERR_DECL_START    "XMLDecl not at start of document"
+#define XML_ERR_DECL_ATTR     "Invalid XMLDecl attributes"
+#define XML_ERR_PI            "Error Parsing Processing Instruction"
+#define XML_ERR_COMMENT       "Error Parsing Comment"
+#define XML_ERR_CDATA         "Error Parsing CDATA"
+#define XML_ERR_DTD           "Error Parsing DTD"
+#define XML_ERR_END_TAG       "End Tag Attributes Invalid"
+#define XML_ERR_UNMATCHED     "Unbalanced Tag"
+#define XML_ERR_INCOMPLETE    "Incomplete XML Document"
+
+/* handler callbacks */
+enum {
+	XML_CB_STARTTAG = 0,
+	XML_CB_ENDTAG,
+	XML_CB_TEXT,
+	XML_CB_CDATA,
+	XML_CB_COMMENT,
+	XML_CB_DECL,
+	XML_CB_PI,
+	XML_CB_DTD,
+	XML_CB_COUNT
+};
+
+static const char *const xml_callbacks[XML_CB_COUNT] = {
+		"starttag", "endtag", "text", "cdata", "comment", "decl", "pi", "dtd"
+};
+
+/* ------------------------------------------------------------------------ */
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+} xml_buf_type;
+
+typedef struct {
+	lua_State *L;
+	const char *xml;
+	size_t len;
+	bool strip_ws;         /**< options.stripWS */
+	bool expand;           /**< options.expandEntities */
+	bool attributes;       /**< parseAttributes */
+	bool tree;             /**< build the xmlhandler_tree result in C */
+	int handler;           /**< stack index of the handler */
+	int on_error;          /**< stack index of options.errorHandler, 0 for none */
+	int cb;                /**< stack index of the first cached callback */
+	bool has[XML_CB_COUNT];
+	int names;             /**< open tag names */
+	lua_Integer depth;
+	int nodes;             /**< tree mode, stack of nodes */
+	lua_Integer levels;
+	int root;              /**< tree mode, handler.root */
+	int noreduce;          /**< tree mode, handler.options.noreduce or 0 */
+	xml_buf_type *bfr;
+} xml_parser_type;
+
+/* Scratch Buffer ========================================================= */
+/* ------------------------------------------------------------------------ */
+static int xml_buffer_gc( lua_State *L )
+{
+	xml_buf_type *b = (xml_buf_type*)luaL_checkudata(L, 1, LUA_EXT_XML_BUF);
+	free(b->data);
+	b->data = NULL;
+	b->len = b->cap = 0;
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+static void xml_add( lua_State *L, xml_buf_type *b, const char *s, size_t n )
+{
+	if (b->len + n > b->cap) {
+		size_t cap = (b->cap < 256)?256:b->cap;
+		while (cap < b->len + n) cap *= 2;
+		char *p = (char*)realloc(b->data, cap);
+		if (p == NULL) luaL_error(L, "not enough memory");
+		b->data = p;
+		b->cap = cap;
+	}
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
+
+/* Text =================================================================== */
+/* ------------------------------------------------------------------------ */
+/* find s in [p,end) */
+static const char *xml_find( const char *p, const char *end, const char *s )
+{
+	size_t n = strlen(s);
+	while ((size_t)(end - p) >= n) {
+		p = (const char*)memchr(p, s[0], (end - p) - n + 1);
+		if (p == NULL) return NULL;
+		if (memcmp(p, s, n) == 0) return p;
+		++p;
+	}
+	return NULL;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Push text with the stripWS and expandEntities options applied.  Numeric
+ * entities above 255 are left as they are, as xmlparser.lua does.
+ */
+static void xml_push_text( xml_parser_type *X, const char *s, const char *e, bool strip )
+{
+	lua_State *L = X->L;
+	const char *amp;
+
+	if (strip) {
+		while ((s < e)&&isspace((unsigned char)*s)) ++s;
+		while ((e > s)&&isspace((unsigned char)e[-1])) --e;
+	}
+	if (!X->expand || ((amp = (const char*)memchr(s, '&', e - s)) == NULL)) {
+		lua_pushlstring(L, s, e - s);
+		return;
+	}
+	X->bfr->len = 0;
+	while (amp != NULL) {
+		const char *semi;
+		char c = 0;
+		bool known = true;
+
+		xml_add(L, X->bfr, s, amp - s);
+		s = amp;
+		semi = (const char*)memchr(amp, ';', ((e - amp) < 12)?(size_t)(e - amp):12);
+		if (semi == NULL) known = false;
+		else if ((semi - amp == 3)&&(memcmp(amp, "&lt", 3) == 0)) c = '<';
+		else if ((semi - amp == 3)&&(memcmp(amp, "&gt", 3) == 0)) c = '>';
+		else if ((semi - amp == 4)&&(memcmp(amp, "&amp", 4) == 0)) c = '&';
+		else if ((semi - amp == 5)&&(memcmp(amp, "&quot", 5) == 0)) c = '"';
+		else if ((semi - amp == 5)&&(memcmp(amp, "&apos", 5) == 0)) c = '\'';
+		else if ((semi - amp > 2)&&(amp[1] == '#')) {
+			bool hex = (amp[2] == 'x');
+			const char *d = amp + (hex?3:2);
+			unsigned long v = 0;
+			if (d == semi) known = false;
+			for (;(d < semi)&&known;++d) {
+				if (hex ? !isxdigit((unsigned char)*d) : !isdigit((unsigned char)*d)) known = false;
+				else if (v < 0x1000000) v = v*(hex?16:10) + (unsigned long)(isdigit((unsigned char)*d)?(*d - '0'):((*d|0x20) - 'a' + 10));
+			}
+			if (v > 255) known = false;
+			c = (char)v;
+		} else known = false;
+
+		if (known) {
+			xml_add(L, X->bfr, &c, 1);
+			s = semi + 1;
+		} else {
+			xml_add(L, X->bfr, s, 1);
+			s += 1;
+		}
+		amp = (const char*)memchr(s, '&', e - s);
+	}
+	xml_add(L, X->bfr, s, e - s);
+	lua_pushlstring(L, X->bfr->data, X->bfr->len);
+}
+
+/* Events ================================================================= */
+/* ------------------------------------------------------------------------ */
+/* options.errorHandler( msg, pos ), returns so parsing may go on */
+static void xml_error( xml_parser_type *X, const char *msg, size_t pos )
+{
+	lua_State *L = X->L;
+	if (X->on_error == 0) return;
+	lua_pushvalue(L, X->on_error);
+	lua_pushstring(L, msg);
+	lua_pushinteger(L, (lua_Integer)pos);
+	lua_call(L, 2, 0);
+}
+/* ------------------------------------------------------------------------ */
+/* handler:<cb>( value, extra, match, endMatch ), value is on the stack */
+static void xml_event( xml_parser_type *X, int cb, bool extra, size_t m, size_t e )
+{
+	lua_State *L = X->L;
+	int value = lua_gettop(L);
+
+	lua_pushvalue(L, X->cb + cb);
+	lua_pushvalue(L, X->handler);
+	lua_pushvalue(L, value);
+	if (extra) lua_pushnil(L);
+	lua_pushinteger(L, (lua_Integer)m);
+	lua_pushinteger(L, (lua_Integer)e);
+	lua_call(L, extra?5:4, 0);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Attributes of a tag, pushed as a table or nil when there are none.
+ * Names are [%w-:_]+ and values are quoted with " or '.
+ */
+static void xml_attributes( xml_parser_type *X, const char *p, const char *end )
+{
+	lua_State *L = X->L;
+	bool any = false;
+
+	while (p < end) {
+		const char *name = p, *name_end, *value;
+		char q;
+
+		while ((p < end)&&(isalnum((unsigned char)*p)||(*p == '-')||(*p == ':')||(*p == '_'))) ++p;
+		if (p == name) {
+			++p;
+			continue;
+		}
+		name_end = p;
+		while ((p < end)&&isspace((unsigned char)*p)) ++p;
+		if ((p >= end)||(*p != '=')) continue;
+		++p;
+		while ((p < end)&&isspace((unsigned char)*p)) ++p;
+		if ((p >= end)||((*p != '"')&&(*p != '\''))) continue;
+		q = *p++;
+		value = p;
+		p = (const char*)memchr(p, q, end - p);
+		if (p == NULL) break;
+		if (!any) {
+			lua_newtable(L);
+			any = true;
+		}
+		lua_pushlstring(L, name, name_end - name);
+		xml_push_text(X, value, p, false);
+		lua_rawset(L, -3);
+		++p;
+	}
+	if (!any) lua_pushnil(L);
+}
+/* ------------------------------------------------------------------------ */
+/* push the name and the attributes (or nil) of a tag, returns the name length */
+static size_t xml_name( xml_parser_type *X, const char *s, const char *end, bool attrs )
+{
+	const char *name_end = s;
+
+	while ((name_end < end)&&!isspace((unsigned char)*name_end)) ++name_end;
+	lua_pushlstring(X->L, s, name_end - s);
+	if (attrs) xml_attributes(X, name_end, end);
+	else lua_pushnil(X->L);
+	return name_end - s;
+}
+/* ------------------------------------------------------------------------ */
+/* replace the name and attributes on top of the stack by {name = , attrs = } */
+static void xml_tag_table( lua_State *L )
+{
+	lua_createtable(L, 0, 2);
+	lua_insert(L, -3);
+	lua_setfield(L, -3, "attrs");
+	lua_setfield(L, -2, "name");
+}
+/* ------------------------------------------------------------------------ */
+/* push {name = , attrs = } for the text of a tag, returns the name length */
+static size_t xml_tag( xml_parser_type *X, const char *s, const char *end, bool attrs )
+{
+	size_t n = xml_name(X, s, end, attrs);
+	xml_tag_table(X->L);
+	return n;
+}
+
+/* Tree Handler =========================================================== */
+/* ------------------------------------------------------------------------ */
+/* xmlhandler_tree's reduce(), drop single entry vectors */
+static void xml_reduce( xml_parser_type *X, int node, int key, int parent )
+{
+	lua_State *L = X->L;
+	bool keep = false;
+
+	luaL_checkstack(L, 6, "XML nesting");
+	lua_pushnil(L);
+	while (lua_next(L, node)) {
+		if (lua_istable(L, -1)) xml_reduce(X, lua_gettop(L), lua_gettop(L) - 1, node);
+		lua_pop(L,1);
+	}
+	if ((parent == 0)||(lua_rawlen(L, node) != 1)) return;
+	if (X->noreduce != 0) {
+		lua_pushvalue(L, key);
+		keep = (lua_rawget(L, X->noreduce) != LUA_TNIL)&&lua_toboolean(L, -1);
+		lua_pop(L,1);
+	}
+	if (keep || (lua_getfield(L, node, "_attr") != LUA_TNIL)) {
+		if (!keep) lua_pop(L,1);
+		return;
+	}
+	lua_pop(L,1);
+	lua_pushvalue(L, key);
+	lua_rawgeti(L, node, 1);
+	lua_rawset(L, parent);
+}
+/* ------------------------------------------------------------------------ */
+/* name and attrs are the stack indices of the tag's name and attributes */
+static void xml_tree_start( xml_parser_type *X, int name, int attrs )
+{
+	lua_State *L = X->L;
+	int top = lua_gettop(L);
+
+	lua_rawgeti(L, X->nodes, X->levels);   /* current */
+	lua_newtable(L);                       /* node */
+	if (X->attributes && !lua_isnil(L, attrs)) {
+		lua_pushvalue(L, attrs);
+		lua_setfield(L, -2, "_attr");
+	}
+	lua_pushvalue(L, name);
+	switch (lua_rawget(L, top + 1)) {
+	case LUA_TNIL:
+		lua_pop(L,1);
+		lua_createtable(L, 1, 0);
+		lua_pushvalue(L, top + 2);
+		lua_rawseti(L, -2, 1);
+		break;
+	case LUA_TTABLE:
+		if (lua_rawlen(L, -1) > 0) {
+			lua_pushvalue(L, top + 2);
+			lua_rawseti(L, -2, (lua_Integer)lua_rawlen(L, -2) + 1);
+			break;
+		}
+		/* a single node becomes a vector */
+		/* fall through */
+	default:
+		lua_createtable(L, 2, 0);
+		lua_insert(L, -2);
+		lua_rawseti(L, -2, 1);
+		lua_pushvalue(L, top + 2);
+		lua_rawseti(L, -2, 2);
+		break;
+	}
+	lua_pushvalue(L, name);
+	lua_insert(L, -2);
+	lua_rawset(L, top + 1);
+	lua_rawseti(L, X->nodes, ++X->levels);
+	lua_settop(L, top);
+}
+/* ------------------------------------------------------------------------ */
+static void xml_tree_end( xml_parser_type *X, int name, size_t m )
+{
+	lua_State *L = X->L;
+	int top = lua_gettop(L);
+
+	if (X->levels < 2) luaL_error(L, "XML Error - Unmatched Tag [%d:%s]\n", (int)m, lua_tostring(L, name));
+	lua_rawgeti(L, X->nodes, X->levels - 1);   /* prev */
+	lua_pushvalue(L, name);
+	if (lua_rawget(L, -2) == LUA_TNIL) luaL_error(L, "XML Error - Unmatched Tag [%d:%s]\n", (int)m, lua_tostring(L, name));
+	lua_pop(L,1);
+	if (lua_rawequal(L, -1, X->root)) xml_reduce(X, X->root, 0, 0);
+	lua_pushnil(L);
+	lua_rawseti(L, X->nodes, X->levels--);
+	lua_settop(L, top);
+}
+/* ------------------------------------------------------------------------ */
+static void xml_tree_text( xml_parser_type *X )
+{
+	lua_State *L = X->L;
+	lua_rawgeti(L, X->nodes, X->levels);
+	lua_pushvalue(L, -2);
+	lua_rawseti(L, -2, (lua_Integer)lua_rawlen(L, -2) + 1);
+	lua_pop(L,1);
+}
+
+/* Tokenizer ============================================================== */
+/* ------------------------------------------------------------------------ */
+/* the tag's name, attributes and (events only) tag table start at index t */
+static void xml_start( xml_parser_type *X, int t, size_t m, size_t e )
+{
+	if (X->tree) xml_tree_start(X, t, t + 1);
+	else if (X->has[XML_CB_STARTTAG]) xml_event(X, XML_CB_STARTTAG, false, m, e);
+}
+/* ------------------------------------------------------------------------ */
+static void xml_end( xml_parser_type *X, int t, size_t m, size_t e )
+{
+	if (X->tree) xml_tree_end(X, t, m);
+	else xml_event(X, XML_CB_ENDTAG, false, m, e);
+}
+/* ------------------------------------------------------------------------ */
+static void xml_text( xml_parser_type *X, int cb, size_t m, size_t e )
+{
+	if (X->tree && (cb != XML_CB_COMMENT)) xml_tree_text(X);
+	else if (X->has[cb]) xml_event(X, cb, true, m, e);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * <name attr="value">, </name> and <name/>, lt and gt are the brackets.
+ * The tree handler only needs the name and attributes, the tag table
+ * is built for handler callbacks.
+ */
+static void xml_normal_tag( xml_parser_type *X, const char *lt, const char *gt, size_t pos )
+{
+	lua_State *L = X->L;
+	const char *s = lt + 1, *e = gt;
+	bool closing = (*s == '/');
+	bool empty = !closing && (e > s) && (e[-1] == '/');
+	size_t m = (size_t)(lt - X->xml) + 1;
+	size_t end = (size_t)(gt - X->xml) + 1;
+	int t = lua_gettop(L) + 1;
+
+	if (closing) ++s;
+	if (empty) --e;
+	if (closing && !X->has[XML_CB_ENDTAG]) return;
+	xml_name(X, s, e, closing || !X->tree || X->attributes);
+	if (!X->tree) {
+		lua_pushvalue(L, t);
+		lua_pushvalue(L, t + 1);
+		xml_tag_table(L);
+	}
+	if (closing) {
+		if (!lua_isnil(L, t + 1)) {
+			lua_pushfstring(L, "%s (/%s)", XML_ERR_END_TAG, lua_tostring(L, t));
+			xml_error(X, lua_tostring(L, -1), pos);
+			lua_pop(L,1);
+		}
+		if (X->depth > 0) {
+			lua_rawgeti(L, X->names, X->depth);
+			lua_pushnil(L);
+			lua_rawseti(L, X->names, X->depth--);
+		} else {
+			lua_pushnil(L);
+		}
+		if (!lua_rawequal(L, -1, t)) {
+			lua_pushfstring(L, "%s (/%s)", XML_ERR_UNMATCHED, lua_tostring(L, t));
+			xml_error(X, lua_tostring(L, -1), pos);
+			lua_pop(L,1);
+		}
+		lua_pop(L,1);
+		xml_end(X, t, m, end);
+	} else {
+		if (X->depth >= XML_MAX_DEPTH) luaL_error(L, "XML nesting too deep");
+		lua_pushvalue(L, t);
+		lua_rawseti(L, X->names, ++X->depth);
+		xml_start(X, t, m, end);
+		if (empty) {
+			lua_pushnil(L);
+			lua_rawseti(L, X->names, X->depth--);
+			if (X->has[XML_CB_ENDTAG]) xml_end(X, t, m, end);
+		}
+	}
+	lua_settop(L, t - 1);
+}
+/* ------------------------------------------------------------------------ */
+/* <?target ...?>, the XML declaration when first is set */
+static bool xml_pi( xml_parser_type *X, const char *lt, const char **gt, size_t pos, bool decl )
+{
+	lua_State *L = X->L;
+	const char *end = X->xml + X->len;
+	const char *close = xml_find(lt + 2, end, "?>");
+	size_t m = (size_t)(lt - X->xml) + 1;
+
+	if (close == NULL) {
+		xml_error(X, decl?XML_ERR_DECL:XML_ERR_PI, pos);
+		return false;
+	}
+	*gt = close + 1;
+	if (decl) {
+		if (m != 1) xml_error(X, XML_ERR_DECL_START, pos);
+		xml_tag(X, lt + 2, close, true);
+		if (lua_getfield(L, -1, "attrs") == LUA_TTABLE) {
+			if (lua_getfield(L, -1, "version") == LUA_TNIL) xml_error(X, XML_ERR_DECL_ATTR, pos);
+			lua_pop(L,1);
+		}
+		lua_pop(L,1);
+		if (X->has[XML_CB_DECL]) xml_event(X, XML_CB_DECL, false, m, (size_t)(close - X->xml) + 2);
+		lua_pop(L,1);
+	} else if (X->has[XML_CB_PI]) {
+		size_t n = xml_tag(X, lt + 2, close, true);
+		if (close > lt + 2 + n) {
+			if (lua_getfield(L, -1, "attrs") == LUA_TNIL) {
+				lua_pop(L,1);
+				lua_newtable(L);
+				lua_pushvalue(L, -1);
+				lua_setfield(L, -3, "attrs");
+			}
+			lua_pushlstring(L, lt + 2 + n, close - (lt + 2 + n));
+			lua_setfield(L, -2, "_text");
+			lua_pop(L,1);
+		}
+		xml_event(X, XML_CB_PI, false, m, (size_t)(close - X->xml) + 2);
+		lua_pop(L,1);
+	}
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* <!DOCTYPE ...>, the internal subset may hold '>' */
+static bool xml_dtd( xml_parser_type *X, const char *lt, const char **gt, size_t pos )
+{
+	lua_State *L = X->L;
+	const char *end = X->xml + X->len;
+	const char *p = lt + 9;
+	int nest = 0;
+	char q = 0;
+
+	for (;p<end;++p) {
+		if (q != 0) {
+			if (*p == q) q = 0;
+		} else if ((*p == '"')||(*p == '\'')) q = *p;
+		else if (*p == '[') ++nest;
+		else if (*p == ']') --nest;
+		else if ((*p == '>')&&(nest <= 0)) break;
+	}
+	if (p >= end) {
+		xml_error(X, XML_ERR_DTD, pos);
+		return false;
+	}
+	*gt = p;
+	if (X->has[XML_CB_DTD]) {
+		lua_createtable(L, 0, 2);
+		lua_pushliteral(L, "DOCTYPE");
+		lua_setfield(L, -2, "name");
+		lua_pushlstring(L, (lt + 10 < p)?lt + 10:p, (lt + 10 < p)?(size_t)(p - (lt + 10)):0);
+		lua_setfield(L, -2, "value");
+		xml_event(X, XML_CB_DTD, false, (size_t)(lt - X->xml) + 1, (size_t)(p - X->xml) + 1);
+		lua_pop(L,1);
+	}
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* comments and CDATA sections, text between open and close */
+static bool xml_section( xml_parser_type *X, const char *lt, const char **gt, size_t pos, size_t open, const char *close, int cb )
+{
+	const char *end = X->xml + X->len;
+	const char *c = xml_find(lt + open, end, close);
+
+	if (c == NULL) {
+		xml_error(X, (cb == XML_CB_COMMENT)?XML_ERR_COMMENT:XML_ERR_CDATA, pos);
+		return false;
+	}
+	*gt = c + strlen(close) - 1;
+	if (X->has[cb] || ((cb == XML_CB_CDATA) && X->tree)) {
+		if (cb == XML_CB_COMMENT) xml_push_text(X, lt + open, c, X->strip_ws);
+		else lua_pushlstring(X->L, lt + open, c - (lt + open));
+		xml_text(X, cb, (size_t)(lt - X->xml) + 1, (size_t)(*gt - X->xml) + 1);
+		lua_pop(X->L,1);
+	}
+	return true;
+}
+/* ------------------------------------------------------------------------ */
+/* closing '>' of a normal tag, quoted attribute values may hold '>' */
+static const char *xml_tag_end( const char *p, const char *end )
+{
+	char q = 0;
+	for (;p<end;++p) {
+		if (q != 0) {
+			if (*p == q) q = 0;
+		} else if ((*p == '"')||(*p == '\'')) q = *p;
+		else if (*p == '>') return p;
+	}
+	return NULL;
+}
+/* ------------------------------------------------------------------------ */
+static void xml_run( xml_parser_type *X )
+{
+	lua_State *L = X->L;
+	const char *xml = X->xml;
+	const char *end = xml + X->len;
+	const char *p = xml;
+
+	while (p < end) {
+		const char *lt = (const char*)memchr(p, '<', end - p);
+		const char *gt;
+		size_t pos = (size_t)(p - xml) + 1;
+		bool ok = true;
+
+		if ((lt == NULL)||(memchr(lt, '>', end - lt) == NULL)) {
+			const char *s = p;
+			while ((s < end)&&isspace((unsigned char)*s)) ++s;
+			if (s < end) xml_error(X, XML_ERR, pos);
+			else if (X->depth != 0) xml_error(X, XML_ERR_INCOMPLETE, pos);
+			return;
+		}
+
+		/* leading text */
+		if (X->tree || X->has[XML_CB_TEXT]) {
+			xml_push_text(X, p, lt, X->strip_ws);
+			if (lua_rawlen(L, -1) > 0) xml_text(X, XML_CB_TEXT, (size_t)(lt - xml) + 1, (size_t)(lt - xml));
+			lua_pop(L,1);
+		}
+
+		if ((strncmp(lt, "<?xml", 5) == 0)&&isspace((unsigned char)lt[5])) {
+			ok = xml_pi(X, lt, &gt, pos, true);
+		} else if (lt[1] == '?') {
+			ok = xml_pi(X, lt, &gt, pos, false);
+		} else if (strncmp(lt, "<!--", 4) == 0) {
+			ok = xml_section(X, lt, &gt, pos, 4, "-->", XML_CB_COMMENT);
+		} else if (strncmp(lt, "<!DOCTYPE", 9) == 0) {
+			ok = xml_dtd(X, lt, &gt, pos);
+		} else if (strncmp(lt, "<![CDATA[", 9) == 0) {
+			ok = xml_section(X, lt, &gt, pos, 9, "]]>", XML_CB_CDATA);
+		} else {
+			gt = xml_tag_end(lt + 1, end);
+			if (gt == NULL) {
+				xml_error(X, XML_ERR, pos);
+				return;
+			}
+			xml_normal_tag(X, lt, gt, pos);
+		}
+		if (!ok) return;
+		p = gt + 1;
+	}
+	if (X->depth != 0) xml_error(X, XML_ERR_INCOMPLETE, (size_t)(p - xml) + 1);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Common setup for parse() and tree(), arguments are
+ * ( xml, handler, options, parseAttributes ).
+ */
+static void xml_setup( lua_State *L, xml_parser_type *X, bool tree )
+{
+	memset((void*)X,0,sizeof(xml_parser_type));
+	X->L = L;
+	X->xml = luaL_checklstring(L, 1, &X->len);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	if (!lua_isnoneornil(L, 3)) luaL_checktype(L, 3, LUA_TTABLE);
+	X->attributes = lua_isnoneornil(L, 4) || lua_toboolean(L, 4);
+	X->tree = tree;
+	X->handler = 2;
+	lua_settop(L, 4);
+	if (lua_istable(L, 3)) {
+		lua_getfield(L, 3, "stripWS");
+		X->strip_ws = lua_toboolean(L, -1);
+		lua_getfield(L, 3, "expandEntities");
+		X->expand = lua_toboolean(L, -1);
+		lua_pop(L,2);
+		if (lua_getfield(L, 3, "errorHandler") != LUA_TNIL) X->on_error = lua_gettop(L);
+		else lua_pop(L,1);
+	}
+	X->cb = lua_gettop(L) + 1;
+	for (int indx = 0;indx<XML_CB_COUNT;++indx) {
+		X->has[indx] = (lua_getfield(L, X->handler, xml_callbacks[indx]) != LUA_TNIL);
+	}
+	lua_newtable(L);
+	X->names = lua_gettop(L);
+	X->bfr = (xml_buf_type*)lua_newuserdatauv(L, sizeof(xml_buf_type), 0);
+	memset((void*)X->bfr,0,sizeof(xml_buf_type));
+	luaL_setmetatable(L, LUA_EXT_XML_BUF);
+	if (tree) {
+		if (lua_getfield(L, X->handler, "root") != LUA_TTABLE) luaL_error(L, "handler has no root table");
+		X->root = lua_gettop(L);
+		lua_newtable(L);
+		X->nodes = lua_gettop(L);
+		lua_pushvalue(L, X->root);
+		lua_rawseti(L, X->nodes, ++X->levels);
+		lua_getfield(L, X->handler, "options");
+		if (lua_istable(L, -1)&&(lua_getfield(L, -1, "noreduce") == LUA_TTABLE)) X->noreduce = lua_gettop(L);
+		else lua_pushnil(L);
+		X->has[XML_CB_ENDTAG] = true;
+	}
+}
+
+/* Library ================================================================ */
+/* ------------------------------------------------------------------------ */
+/* cxml.parse( xml, handler, options, parseAttributes ) */
+static int xml_parse( lua_State *L )
+{
+	xml_parser_type X;
+	xml_setup(L, &X, false);
+	xml_run(&X);
+	return 0;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * cxml.tree( xml, handler, options, parseAttributes )
+ * Builds handler.root the way xmlhandler_tree does, without calling the
+ * tag and text callbacks.  Other callbacks of the handler still run.
+ */
+static int xml_tree( lua_State *L )
+{
+	xml_parser_type X;
+	xml_setup(L, &X, true);
+	xml_run(&X);
+	lua_pushvalue(L, X.root);
+	return 1;
+}
+
+static const luaL_Reg xml_lib[] = {
+		{"parse", xml_parse},
+		{"tree", xml_tree},
+		{NULL, NULL}
+};
+/* ------------------------------------------------------------------------ */
+LUALIB_API int luaopen_cxml( lua_State *L )
+{
+	luaL_newmetatable(L, LUA_EXT_XML_BUF);
+	lua_pushcfunction(L, xml_buffer_gc);
+	lua_setfield(L, -2, "__gc");
+	lua_pop(L,1);
+
+	luaL_newlib(L, xml_lib);
+	return 1;
+}
+/* ------------------------------------------------------------------------ */
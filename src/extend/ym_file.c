@@ -0,0 +1,161 @@
+/*
+ * ym_file.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+/* ------------------------------------------------------------------------ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ym_file.h"
+#include "zmodem.h"
+
+/* Private Data =========================================================== */
+static ym_file_type *_ym_file = NULL;
+
+/* Private APIs =========================================================== */
+/* ------------------------------------------------------------------------ */
+static const char *ym_file_basename( const char *path )
+{
+    const char *base = path;
+
+    for (const char *p = path; *p != 0; ++p) {
+        if ((*p == '/') || (*p == '\\') || (*p == ':')) base = p + 1;
+    }
+    return base;
+}
+/* ------------------------------------------------------------------------ */
+/* count a block that was read or written, progress() every f->every blocks */
+static uint32_t ym_file_block( ym_file_type *f )
+{
+    ++f->blocks;
+    if ((f->progress == NULL) || (f->every == 0) || ((f->blocks % f->every) != 0)) return YM_RES_OK;
+    return f->progress(f);
+}
+/* ------------------------------------------------------------------------ */
+void ym_file_attach( ym_file_type *f )
+{
+    if ((_ym_file != NULL) && (_ym_file->fp != NULL)) {
+        fclose(_ym_file->fp);
+        _ym_file->fp = NULL;
+    }
+    _ym_file = f;
+}
+
+/* Callback API =========================================================== */
+/* ------------------------------------------------------------------------ */
+uint32_t ym_stream_next(char *name, uint32_t len, uint32_t *size)
+{
+    ym_file_type *f = _ym_file;
+    const char *path;
+    long end;
+
+    if (f == NULL) return YM_RES_ERROR;
+    if (f->next >= f->count) return YM_RES_END_OF_TRANSFER;
+    path = f->paths[f->next++];
+    f->fp = fopen(path, "rb");
+    if (f->fp == NULL) return YM_RES_ERROR;
+    if ((fseek(f->fp, 0, SEEK_END) != 0) || ((end = ftell(f->fp)) < 0)) return YM_RES_ERROR;
+    rewind(f->fp);
+    f->start = 0;
+    *size = (uint32_t)end;
+    snprintf(f->name, sizeof(f->name), "%s", ym_file_basename(path));
+    snprintf(name, len, "%s", f->name);
+    return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ym_stream_read(uint8_t *block, uint32_t size, bool first, uint32_t *br)
+{
+    ym_file_type *f = _ym_file;
+
+    *br = 0;
+    if (f == NULL) return YM_RES_ERROR;
+    if (f->fp != NULL) {
+        /* a packet built again starts where the caller's file was, not at 0 */
+        if (first && (f->start >= 0) && (fseek(f->fp, f->start, SEEK_SET) != 0)) return YM_RES_ERROR;
+        *br = (uint32_t)fread(block, 1, size, f->fp);
+        if ((*br < size) && ferror(f->fp)) return YM_RES_ERROR;
+    }
+    else if (f->read != NULL) {
+        /* a reader cannot rewind, the engines only ask for the start once */
+        uint32_t res = f->read(f, block, size, br);
+        if (res != YM_RES_OK) return res;
+    }
+    else return YM_RES_ERROR;
+    f->bytes += *br;
+    return (*br > 0) ? ym_file_block(f) : YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Only the base name of what the sender announced is used, so a transfer
+ * cannot write outside of the receive directory.
+ */
+uint32_t ym_stream_open(const char *name, uint32_t size)
+{
+    ym_file_type *f = _ym_file;
+    char path[ YM_MAX_FILENAME + 512 ];
+    const char *base = ym_file_basename(name);
+
+    (void) size;
+    if (f == NULL) return YM_RES_ERROR;
+    if ((base[0] == 0) || (strcmp(base, ".") == 0) || (strcmp(base, "..") == 0)) return YM_RES_ERROR;
+    snprintf(f->name, sizeof(f->name), "%s", base);
+    if ((f->dir != NULL) && (f->dir[0] != 0)) snprintf(path, sizeof(path), "%s/%s", f->dir, base);
+    else snprintf(path, sizeof(path), "%s", base);
+
+    f->fp = NULL;
+    if (f->resume) f->fp = fopen(path, "r+b");
+    if (f->fp == NULL) f->fp = fopen(path, "w+b");
+    return (f->fp != NULL) ? YM_RES_OK : YM_RES_ERROR;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ym_stream_write(uint32_t block_id, uint8_t *block, uint32_t size)
+{
+    ym_file_type *f = _ym_file;
+
+    (void) block_id;
+    if (f == NULL) return YM_RES_ERROR;
+    if (f->fp != NULL) {
+        if (fwrite(block, 1, size, f->fp) != size) return YM_RES_ERROR;
+    }
+    else if (f->write != NULL) {
+        uint32_t res = f->write(f, block, size);
+        if (res != YM_RES_OK) return res;
+    }
+    else return YM_RES_ERROR;
+    f->bytes += size;
+    return ym_file_block(f);
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ym_stream_seek(uint32_t offset)
+{
+    ym_file_type *f = _ym_file;
+
+    if ((f == NULL) || (f->fp == NULL)) return YM_RES_ERROR;
+    return (fseek(f->fp, (long)offset, SEEK_SET) == 0) ? YM_RES_OK : YM_RES_ERROR;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ym_stream_size(void)
+{
+    ym_file_type *f = _ym_file;
+    long end;
+
+    if ((f == NULL) || (f->fp == NULL)) return 0;
+    if ((fseek(f->fp, 0, SEEK_END) != 0) || ((end = ftell(f->fp)) < 0)) return 0;
+    return (uint32_t)end;
+}
+/* ------------------------------------------------------------------------ */
+void ym_stream_close(bool ok)
+{
+    ym_file_type *f = _ym_file;
+
+    if ((f == NULL) || (f->fp == NULL)) return;
+    if ((fclose(f->fp) == 0) && ok) ++f->files;
+    f->fp = NULL;
+}
+/* ------------------------------------------------------------------------ */
+
+/* EnD OF FILE ============================================================ */
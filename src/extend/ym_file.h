@@ -0,0 +1,60 @@
+/*
+ * ym_file.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef DRIVERS_YM_FILE_H_
+#define DRIVERS_YM_FILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "ymodem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Types ------------------------------------------------------------------ */
+/*
+ * ym_stream_* callbacks backed by files.  The sender walks the list of
+ * paths and announces each file by its base name; the receiver stores the
+ * files it is sent in dir.  XMODEM has no names, fp is opened by the
+ * caller or the data comes from read() and goes to write() instead.
+ */
+typedef struct ym_file_s ym_file_type;
+
+struct ym_file_s {
+    FILE *fp;
+    long start;                  /* offset of fp the data is sent from, -1 = not seekable */
+    /* source and sink used while fp is NULL, YM_RES_OK when it worked */
+    uint32_t (*read)( ym_file_type *f, uint8_t *data, uint32_t size, uint32_t *br );
+    uint32_t (*write)( ym_file_type *f, const uint8_t *data, uint32_t size );
+    /* called after every `every` blocks, anything but YM_RES_OK stops the transfer */
+    uint32_t (*progress)( ym_file_type *f );
+    void *ctx;                   /* for read, write and progress */
+    uint32_t every;
+    uint32_t blocks;             /* blocks read or written */
+    const char *const *paths;    /* files to send */
+    uint32_t count;              /* number of paths */
+    uint32_t next;               /* next path for ym_stream_next() */
+    const char *dir;             /* directory for received files, NULL = current */
+    bool resume;                 /* keep the data of files that already exist */
+    char name[ YM_MAX_FILENAME ];/* file in transfer */
+    uint32_t files;              /* files completed */
+    uint64_t bytes;              /* payload bytes read or written */
+};
+
+/* Public API ------------------------------------------------------------- */
+
+/* make f the target of the stream callbacks, NULL closes and detaches it */
+void ym_file_attach( ym_file_type *f );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRIVERS_YM_FILE_H_ */
@@ -14,16 +14,40 @@
  * work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
  */
 /* ------------------------------------------------------------------------ */
-#include "ymodem.h"
-
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ymodem.h"
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
 /* ------------------------------------------------------------------------ */
 #define XOPT_YMODEM_MAX_PACKET_SIZE   2048
-#define XOPT_YMODEM_TIMEOUT_CHAR      1000
+#ifndef XOPT_YMODEM_TIMEOUT_CHAR
+#define XOPT_YMODEM_TIMEOUT_CHAR      1000   /* ms to wait for packet data */
+#endif
+#ifndef XOPT_YMODEM_MAX_TRIES
 #define XOPT_YMODEM_MAX_TRIES         10
+#endif
+#ifndef XOPT_YMODEM_START_DELAY
+#define XOPT_YMODEM_START_DELAY       20000  /* ms before the receiver starts */
+#endif
+#ifndef XOPT_YMODEM_PACKET_DELAY
+#define XOPT_YMODEM_PACKET_DELAY      0      /* ms before each packet is received */
+#endif
+#ifndef XOPT_YMODEM_HANDSHAKE_TIMEOUT
+#define XOPT_YMODEM_HANDSHAKE_TIMEOUT (XOPT_YMODEM_TIMEOUT_CHAR*5)
+#endif
 
 /* ------------------------------------------------------------------------ */
 #define _ym_max(a,b)   ( (a>b)?a:b)
@@ -37,6 +61,7 @@
 #define YM_NAK                     (0x15)  /* Negative ACKnowledge, receiver ERROR, retry */
 #define YM_CAN                     (0x18)  /* two CAN in succession will abort transfer */
 #define YM_CRC                     (0x43)  /* 'C' == 0x43, request 16-bit CRC, use in place of first NAK for CRC mode */
+#define YM_STREAM                  (0x47)  /* 'G' == 0x47, request YMODEM-g streaming (CRC, no per-block ACK) */
 #define YM_ABT1                    (0x41)  /* 'A' == 0x41, assume try abort by user typing */
 #define YM_ABT2                    (0x61)  /* 'a' == 0x61, assume try abort by user typing */
 #define YM_EOF                     (0x1A)  /* CTRL-Z terminator */
@@ -51,11 +76,62 @@
  * These are defined configuration macros for binding the YMODEM driver
  * implementation to the underlying tick API for delays and timing.
  */
-#define _YM_DELAY                  Sleep
+#ifdef WIN32
+#define _YM_DELAY(ms)              Sleep(ms)
+#else
+#define _YM_DELAY(ms)              _ym_delay(ms)
+#endif
 
 /* Private Data =========================================================== */
 static uint32_t _ym_fs_state = YM_RES_OK;
+static uint32_t _ym_retries = 0;   /* packets sent or asked for again */
 static uint8_t _ym_packet_ws[ XOPT_YMODEM_MAX_PACKET_SIZE ];
+/* the transmitter fills one buffer while the other one is on the line */
+static uint8_t _ym_packet_tx[2][ XOPT_YMODEM_MAX_PACKET_SIZE ];
+
+static ym_timing_type _ym_timing = {
+    .start_delay = XOPT_YMODEM_START_DELAY,
+    .packet_delay = XOPT_YMODEM_PACKET_DELAY,
+    .char_timeout = XOPT_YMODEM_TIMEOUT_CHAR,
+    .handshake_timeout = XOPT_YMODEM_HANDSHAKE_TIMEOUT,
+    .max_tries = XOPT_YMODEM_MAX_TRIES
+};
+
+/* CRC-16/XMODEM (polynomial 0x1021) for each value of the high byte */
+static const uint16_t _ym_crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
 
 /* Interface APIs --------------------------------------------------------- */
 
@@ -63,21 +139,27 @@ static uint8_t _ym_packet_ws[ XOPT_YMODEM_MAX_PACKET_SIZE ];
 /* ------------------------------------------------------------------------ */
 static uint32_t ym_calc_crc16(uint8_t *packet, uint32_t len, uint32_t crc)
 {
-    int i;
-    uint32_t comp_crc = crc;
-
-    for (; len > 0; len--) { /* Step through bytes in memory */
-
-        comp_crc = comp_crc ^ (*packet++ << 8); /* Fetch byte from memory, XOR into CRC top byte*/
-        for (i = 0; i < 8; i++) { /* Prepare to rotate 8 bits */
-            comp_crc = comp_crc << 1; /* rotate */
-            if (comp_crc & 0x10000) /* bit 15 was set (now bit 16)... */
-            comp_crc = (comp_crc ^ 0x1021) & 0xFFFF; /* XOR with XMODEM polynomic */
-            /* and ensure CRC remains 16-bit value */
-        } /* Loop for 8 bits */
-    } /* Loop until num=0 */
+    uint16_t comp_crc = (uint16_t)crc;
+
+    while (len--) {
+        comp_crc = (uint16_t)((comp_crc << 8) ^ _ym_crc16_table[((comp_crc >> 8) ^ *packet++) & 0xFF]);
+    }
     return comp_crc;
 }
+/* ------------------------------------------------------------------------ */
+/* CRC-16/XMODEM of len bytes continuing from crc (0 to start) */
+uint32_t ymodem_crc16(const uint8_t *data, uint32_t len, uint32_t crc)
+{
+    return ym_calc_crc16((uint8_t*)data, len, crc);
+}
+/* ------------------------------------------------------------------------ */
+#ifndef WIN32
+static void _ym_delay( uint32_t ms )
+{
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR));
+}
+#endif
 
 /* ------------------------------------------------ */
 /**
@@ -96,7 +178,7 @@ static uint32_t ymodem_receive_xmodem_packet( bool crc )
 {
     uint32_t bytes = 0;
     /* receive the first packet character */
-    uint32_t sop = ym_getc( XOPT_YMODEM_TIMEOUT_CHAR );
+    uint32_t sop = ym_getc( _ym_timing.char_timeout );
     if (sop == 0xFFFFFFFF) return YM_RES_TIMEOUT;
     _ym_packet_ws[0] = (uint8_t)sop;
 
@@ -109,15 +191,15 @@ static uint32_t ymodem_receive_xmodem_packet( bool crc )
     else return YM_RES_ERROR;
 
     /* read the block ID */
-    bytes = ym_receive(&_ym_packet_ws[1], 2, XOPT_YMODEM_TIMEOUT_CHAR);
+    bytes = ym_receive(&_ym_packet_ws[1], 2, _ym_timing.char_timeout);
     if (bytes <2) return YM_RES_TIMEOUT;
     /* receive data payload */
-    bytes = ym_receive(&_ym_packet_ws[3], plen, XOPT_YMODEM_TIMEOUT_CHAR);
+    bytes = ym_receive(&_ym_packet_ws[3], plen, _ym_timing.char_timeout);
     if (bytes < plen) return YM_RES_TIMEOUT;
 
     /* receive CRC and/or checksum */
-    if (crc) bytes = ym_receive(&_ym_packet_ws[3 + plen], 2, XOPT_YMODEM_TIMEOUT_CHAR);
-    else bytes = ym_receive(&_ym_packet_ws[3 + plen], 1, XOPT_YMODEM_TIMEOUT_CHAR);
+    if (crc) bytes = ym_receive(&_ym_packet_ws[3 + plen], 2, _ym_timing.char_timeout);
+    else bytes = ym_receive(&_ym_packet_ws[3 + plen], 1, _ym_timing.char_timeout);
 
     return (bytes<((crc)?2:1))?YM_RES_TIMEOUT:YM_RES_OK;
 }
@@ -131,16 +213,15 @@ static uint32_t ymodem_verify_xmodem_packet(uint8_t *packet, bool crc)
 	} check;
 
     if (crc) {
-        uint16_t *verify = (uint16_t*) (packet + _YM_DATASIZE(packet) + 3);
+        uint8_t *verify = packet + _YM_DATASIZE(packet) + 3;
         check.u32 = ym_calc_crc16(&packet[3], _YM_DATASIZE(packet), 0);
-        check.u16[0] = ((check.u16[0] >> 8) & 0xFF) | (check.u16[0] << 8);
-        return (check.u16[0] == *verify) ? YM_RES_OK : YM_RES_ERR_CRC;
+        return (check.u32 == (((uint32_t)verify[0] << 8) | verify[1])) ? YM_RES_OK : YM_RES_ERR_CRC;
     }
     else {
         check.u32 = 0;
         uint32_t size = _YM_DATASIZE(packet);
         packet += 3;
-        for (int i = 0; i < size; ++i) {
+        for (uint32_t i = 0; i < size; ++i) {
             check.u32 += *packet;
             ++packet;
         }
@@ -149,237 +230,509 @@ static uint32_t ymodem_verify_xmodem_packet(uint8_t *packet, bool crc)
     return YM_RES_OK;
 }
 /* ------------------------------------------------------------------------ */
+/* store the CRC or checksum of the data_size payload bytes after them */
+static void ymodem_sign_xmodem_packet(uint8_t *buf, uint32_t data_size, bool crc)
+{
+    uint32_t checksum;
+
+    if (crc) {
+        checksum = ym_calc_crc16(&buf[3], data_size, 0);
+        buf[3 + data_size] = (checksum >> 8) & 0xFF;
+        buf[4 + data_size] = (checksum & 0xFF);
+    }
+    else if (data_size > 0) {
+        checksum = 0;
+        for (uint32_t idx = 0; idx < data_size; ++idx) {
+            checksum += buf[3 + idx];
+        }
+        buf[3 + data_size] = checksum&0xFF;
+    }
+}
+/* ------------------------------------------------------------------------ */
+/* cancel the transfer, the sender stops after two CAN in a row */
+static void ymodem_cancel( void )
+{
+    for (int i = 0; i < 8; ++i) ym_putc(YM_CAN);
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * The length of the data in an ASCII block without the CTRL-Z padding.
+ * A lone CTRL-Z is kept, only a run that reaches the end of the block is
+ * padding.
+ */
+static uint32_t ymodem_trim_ascii(const uint8_t *data, uint32_t size)
+{
+    uint32_t len = size;
+
+    while ((len > 0) && (data[len - 1] == YM_EOF)) --len;
+    return len;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Receive a file with XMODEM (CRC, checksum or 1K blocks) into the stream.
+ * The receiver asks with 'C' and falls back to NAK and checksums when the
+ * sender does not answer.  Bad packets are NAKed after the line went
+ * quiet, a repeated block (our ACK was lost) is ACKed again and not
+ * written.  Returns YM_RES_END_OF_TRANSFER once the EOT was ACKed.
+ */
 uint32_t ymodem_receive_xmodem_unsafe(bool ascii_mode )
 {
     bool crc = true;
-    uint32_t packet = 0;
-    uint32_t res = YM_RES_TIMEOUT;
-    uint8_t codes[3] = { YM_CRC, YM_ACK, YM_NAK };
-    uint32_t ntries = XOPT_YMODEM_MAX_TRIES;
-    uint32_t bytes_written = 0;
-    uint8_t block = 0;
-
-    _YM_DELAY(20000); // wait for about 20 seconds before starting
-    while (res != YM_RES_CANCEL) {
-        /*
-         * sending response
-         */
-    	/* When block0 is active and there was a timeout, transmit
-    	 * the "start" character of either "C" for crc-16 mode, or
-    	 * NAK to initiate a transmission.
-    	 */
-        if ((res == YM_RES_TIMEOUT) && (block == 0))
-            ym_putc((char)( (crc) ? codes[0] : codes[2]));
-        /* send ACK when the last packet was recieved and processed ok */
-        else if (res == YM_RES_OK) ym_putc(codes[1]);
-        /* When the end of transfer is detected, send an acknowledge and
-         * exit the loop.  The file is now complete.
-         */
-        else if (res == YM_RES_END_OF_TRANSFER) {
-            /*
-             * EOT was detected, acknowledge and then return
-             */
-            ym_putc((char)codes[1]);
-            break;
-        }
-        /* When there was a timeout, just send a NAK to tell the host
-         * to re-transmit.
-         */
-        else if (res == YM_RES_TIMEOUT) ym_putc((char)codes[2]);
+    bool started = false;
+    uint8_t expected = 1;
+    uint32_t ntries = _ym_timing.max_tries;
+    uint32_t res;
 
-        _YM_DELAY(10); // wait for 10ms (let USB catch up)
+    _ym_retries = 0;
+    // give the user time to start the sender
+    if (_ym_timing.start_delay) _YM_DELAY(_ym_timing.start_delay);
+    ym_putc((char)((crc) ? YM_CRC : YM_NAK));
+    for (;;) {
+        if (_ym_timing.packet_delay) _YM_DELAY(_ym_timing.packet_delay);
         res = ymodem_receive_xmodem_packet(crc);
-        ++packet;
+        if (res == YM_RES_OK) res = ymodem_verify_xmodem_packet(_ym_packet_ws, crc);
+        if ((res == YM_RES_OK) && ((uint8_t)(_ym_packet_ws[1] + _ym_packet_ws[2]) != 0xFF)) res = YM_RES_ERR_CRC;
 
-        if (res == YM_RES_OK) {
-//            last_block = block;
-            block = _ym_packet_ws[1];
+        if (res == YM_RES_END_OF_TRANSFER) {
+            ym_putc(YM_ACK);
+            return YM_RES_END_OF_TRANSFER;
         }
-        else if (res == YM_RES_TIMEOUT) {
-            --packet;
-            if (ntries) --ntries;
-            /*
-             * When we are out of tries, but still waiting
-             * for block 0, fallback to NAK handshake with
-             * sender.
-             */
-            else if ((ntries == 0) && (block == 0)) {
+        if (res == YM_RES_CANCEL) return YM_RES_CANCEL;
+        if (res != YM_RES_OK) {
+            if (ntries-- == 0) {
+                if (started || !crc) {
+                    ymodem_cancel();
+                    return (res == YM_RES_TIMEOUT) ? YM_RES_TIMEOUT : YM_RES_ERROR;
+                }
+                /* no answer to 'C', the sender may only know checksums */
                 crc = false;
-                ntries = 10;
+                ntries = _ym_timing.max_tries;
+            }
+            /* let a corrupted or repeated packet finish before asking again */
+            while (ym_getc(50) != 0xFFFFFFFF);
+            if (started) {
+                ym_putc(YM_NAK);
+                ++_ym_retries;
             }
-            /*
-             * when we have exceeded our max timeouts
-             * the sender must have quit. so, leave
-             * letting the caller know that there was
-             * a timeout.
-             */
-            else return YM_RES_TIMEOUT;
+            else ym_putc((char)((crc) ? YM_CRC : YM_NAK));
+            continue;
         }
 
-        // add packet validation
-        if (res == YM_RES_OK) {
-            res = ymodem_verify_xmodem_packet(_ym_packet_ws, crc);
+        started = true;
+        ntries = _ym_timing.max_tries;
+        if (_ym_packet_ws[1] == (uint8_t)(expected - 1)) {
+            /* our ACK was lost, the sender repeated the last packet */
+            ym_putc(YM_ACK);
+            continue;
+        }
+        if (_ym_packet_ws[1] != expected) {
+            ymodem_cancel();
+            return YM_RES_ERROR;
         }
 
-        if (res == YM_RES_OK) {
-            ntries = 10; // reset the timeout count-down
-            /*
-             * The packet has been received correctly, and
-             * the packet was validated, so we are going to
-             * write the data into the target file
-             */
-            uint32_t bw = 0;
-            uint32_t btw = _YM_DATASIZE(_ym_packet_ws);
-            if (ascii_mode) {
-                /*
-                 * in ASCII mode, we look for the CTRL-Z EOF
-                 * marker and truncate the block to remove the
-                 * CTRL-Z padding.
-                 */
-                uint32_t trim_point = btw;
-                for (uint32_t idx = 0; idx < btw; ++idx) {
-                    if (_ym_packet_ws[3 + idx] == YM_EOF) {
-                        /*
-                         * There was a ctrl-z in the data payload,
-                         * but we'll keep it there unless it was
-                         * padding.  the way I determine padding
-                         * is to scan from the location of the
-                         * ctrl-z to the end of the data size.
-                         * when there are all ctrl-Z there, it was
-                         * padding.  i.e. highly unlikely that
-                         * a file will have a packet of ctrl-Z
-                         * but it could have a lone one in the
-                         * data.
-                         */
-                        uint32_t lookahead = idx + 1;
-                        while ((lookahead < btw)
-                                && (_ym_packet_ws[3 + lookahead] == YM_EOF)) {
-                            ++lookahead;
-                        }
-                        if (lookahead >= btw) {
-                            trim_point = idx;
-                            idx = lookahead;
-                        }
-                    }
-                }
-                /* adjust the btw to remove the padding */
-                btw = (btw > trim_point) ? trim_point : btw;
-            } /* end of ascii mode handling */
-            if (btw > 0) {
-            	uint32_t fr = ym_stream_write(block, &_ym_packet_ws[3], btw);
-            	bytes_written += bw;
-            	if (fr != YM_RES_OK) {
-            		/* an error has occurred, log it? */
-            		_ym_fs_state = fr;
-            		/* Send CANCEL to transmitter */
-            		for (int i = 0; i < 8; ++i) ym_putc(YM_CAN);
-            		return YM_RES_ERROR;
-            	}
+        uint32_t btw = _YM_DATASIZE(_ym_packet_ws);
+        /* in ASCII mode the CTRL-Z padding of the block is dropped */
+        if (ascii_mode) btw = ymodem_trim_ascii(&_ym_packet_ws[3], btw);
+        if (btw > 0) {
+            uint32_t fr = ym_stream_write(expected, &_ym_packet_ws[3], btw);
+            if (fr != YM_RES_OK) {
+                _ym_fs_state = fr;
+                ymodem_cancel();
+                return (fr == YM_RES_CANCEL) ? YM_RES_CANCEL : YM_RES_ERROR;
             }
-        } /* end of packet good handling */
-    } /* end of packet receive loop */
-
-    return res;
+        }
+        ym_putc(YM_ACK);
+        ++expected;
+    }
 }
 /* ------------------------------------------------------------------------ */
 /* YMODEM Handlers */
 
+/* ------------------------------------------------------------------------ */
+/*
+ * Receive a valid packet.  Bad packets are NAKed and retried until the
+ * tries run out; in streaming mode any error ends the transfer since the
+ * sender does not listen for NAK.
+ */
+static uint32_t ymodem_receive_valid_packet(bool streaming, char request)
+{
+    uint32_t ntries = _ym_timing.max_tries;
+    uint32_t res;
+
+    for (;;) {
+        if (_ym_timing.packet_delay) _YM_DELAY(_ym_timing.packet_delay);
+        res = ymodem_receive_xmodem_packet(true);
+        if (res == YM_RES_OK) res = ymodem_verify_xmodem_packet(_ym_packet_ws, true);
+        if ((res == YM_RES_OK) || (res == YM_RES_END_OF_TRANSFER) || (res == YM_RES_CANCEL)) return res;
+        if (streaming || (ntries-- == 0)) return (res == YM_RES_TIMEOUT) ? YM_RES_TIMEOUT : YM_RES_ERROR;
+        /* let a corrupted packet finish before asking again */
+        while (ym_getc(50) != 0xFFFFFFFF);
+        ym_putc(request);
+        ++_ym_retries;
+    }
+}
+/* ------------------------------------------------------------------------ */
+/* Receive the data blocks of one file, ending with the (double) EOT */
+static uint32_t ymodem_receive_file(uint32_t size, bool streaming)
+{
+    uint32_t remaining = size;
+    uint8_t expected = 1;
+    bool eot = false;
+    uint32_t res;
+
+    for (;;) {
+        res = ymodem_receive_valid_packet(streaming, YM_NAK);
+        if (res == YM_RES_END_OF_TRANSFER) {
+            /* NAK the first EOT so a stray byte cannot end the file early */
+            if (!streaming && !eot) {
+                eot = true;
+                ym_putc(YM_NAK);
+                continue;
+            }
+            ym_putc(YM_ACK);
+            return YM_RES_OK;
+        }
+        if (res != YM_RES_OK) return res;
+        eot = false;
+
+        uint8_t block = _ym_packet_ws[1];
+        if (block == (uint8_t)(expected - 1)) {
+            /* our ACK was lost, the sender repeated the last packet */
+            if (block == 0) ym_putc(streaming ? YM_STREAM : YM_ACK);
+            else ym_putc(YM_ACK);
+            continue;
+        }
+        if ((block != expected) || ((uint8_t)(_ym_packet_ws[1] + _ym_packet_ws[2]) != 0xFF)) return YM_RES_ERROR;
+
+        /* the header gave the exact size, everything past it is padding */
+        uint32_t btw = _YM_DATASIZE(_ym_packet_ws);
+        if (size != YM_SIZE_UNKNOWN) {
+            btw = _ym_min(btw, remaining);
+            remaining -= btw;
+        }
+        if (btw > 0) {
+            uint32_t fr = ym_stream_write(expected, &_ym_packet_ws[3], btw);
+            if (fr != YM_RES_OK) {
+                _ym_fs_state = fr;
+                return YM_RES_ERROR;
+            }
+        }
+        if (!streaming) ym_putc(YM_ACK);
+        ++expected;
+    }
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ymodem_receive( bool streaming )
+{
+    char request = (streaming) ? YM_STREAM : YM_CRC;
+    uint32_t ntries = _ym_timing.max_tries;
+    uint32_t res;
+
+    _ym_retries = 0;
+    if (_ym_timing.start_delay) _YM_DELAY(_ym_timing.start_delay);
+    for (;;) {
+        /*
+         * Block 0: ask for the header until the sender answers
+         */
+        do {
+            ym_putc(request);
+            res = ymodem_receive_xmodem_packet(true);
+        } while ((res == YM_RES_TIMEOUT) && (ntries-- > 0));
+        if (res == YM_RES_END_OF_TRANSFER) {
+            /* the sender repeated the EOT of the last file, it missed our ACK */
+            ym_putc(YM_ACK);
+            if (ntries-- > 0) continue;
+        }
+        if (res == YM_RES_OK) res = ymodem_verify_xmodem_packet(_ym_packet_ws, true);
+        if (res == YM_RES_CANCEL) return YM_RES_CANCEL;
+        if ((res == YM_RES_OK) && (_ym_packet_ws[1] != 0)) res = YM_RES_ERROR;
+        if (res != YM_RES_OK) {
+            if ((res != YM_RES_TIMEOUT) && (ntries-- > 0)) {
+                while (ym_getc(50) != 0xFFFFFFFF);
+                continue;
+            }
+            ymodem_cancel();
+            return res;
+        }
+        ntries = _ym_timing.max_tries;
+
+        /*
+         * "name\0size [mtime mode]\0", an empty name ends the batch
+         */
+        uint32_t plen = _YM_DATASIZE(_ym_packet_ws);
+        char *name = (char*)&_ym_packet_ws[3];
+        if (name[0] == 0) {
+            ym_putc(YM_ACK);
+            return YM_RES_OK;
+        }
+
+        uint32_t size = YM_SIZE_UNKNOWN;
+        size_t nlen = strnlen(name, plen);
+        if (nlen >= plen) {
+            ymodem_cancel();
+            return YM_RES_ERROR;
+        }
+        if ((nlen + 1 < plen) && isdigit((unsigned char)name[nlen + 1])) {
+            _ym_packet_ws[3 + plen] = 0; /* the CRC is checked, terminate the fields */
+            size = (uint32_t)strtoul(&name[nlen + 1], NULL, 10);
+        }
+
+        res = ym_stream_open(name, size);
+        if (res != YM_RES_OK) {
+            _ym_fs_state = res;
+            ymodem_cancel();
+            return YM_RES_ERROR;
+        }
+        /* YMODEM-g skips the ACK, the 'G' both accepts block 0 and starts the data */
+        if (!streaming) ym_putc(YM_ACK);
+        ym_putc(request);
+        res = ymodem_receive_file(size, streaming);
+        ym_stream_close(res == YM_RES_OK);
+        if (res != YM_RES_OK) {
+            if (res != YM_RES_CANCEL) ymodem_cancel();
+            return res;
+        }
+    }
+}
+
 /* ======================================================================== */
 /* XMODEM Transmitter ----------------------------------------------------- */
 
-static uint32_t ymodem_send_xmodem_packet(uint8_t block, bool crc, uint8_t *status)
+/*
+ * Build packet number "block" into buf from the next chunk of the stream,
+ * chunks are block_size (128 or 1024) bytes.  The length of the packet on
+ * the wire is returned in *length, an EOT is built once the stream is
+ * exhausted.
+ */
+static uint32_t ymodem_build_xmodem_packet(uint8_t *buf, uint8_t block, uint32_t block_size, bool crc, bool first, uint32_t *length)
 {
-    uint32_t checksum;
     uint32_t bytes_read;
-    uint32_t response;
-    uint32_t packet_length = 1024;  //+5 for header and CRC
+    uint32_t packet_length = block_size;  //+5 for header and CRC
     uint32_t data_size = 0;
 
-    _ym_packet_ws[1] = block;
-    _ym_packet_ws[2] = 255 - block;
-    uint32_t res = ym_stream_read(&_ym_packet_ws[3], packet_length, (block < 2), &bytes_read);
+    buf[1] = block;
+    buf[2] = 255 - block;
+    uint32_t res = ym_stream_read(&buf[3], packet_length, first, &bytes_read);
 
-    if (res != YM_RES_OK) return YM_RES_ERROR;
+    if (res != YM_RES_OK) return (res == YM_RES_CANCEL) ? YM_RES_CANCEL : YM_RES_ERROR;
     if (bytes_read == 0) {
-        _ym_packet_ws[0] = YM_EOT;
+        buf[0] = YM_EOT;
         packet_length = 1;
     }
     else if (bytes_read <= 128) {
         /* send short end packet */
-        _ym_packet_ws[0] = YM_SOH;
+        buf[0] = YM_SOH;
         packet_length = 128 + 3 + ((crc) ? 2 : 1);
         data_size = 128;
     }
-    else if (bytes_read <= 1024) {
-        _ym_packet_ws[0] = YM_STX;
+    else {
+        buf[0] = YM_STX;
         packet_length = 1024 + 3 + ((crc) ? 2 : 1);
         data_size = 1024;
     }
 
     /* add padding when required */
-    for (int idx = bytes_read; idx < data_size; ++idx) {
-        _ym_packet_ws[3 + idx] = 0x1A;
-    }
-    /* compute verification signature */
-    if (crc) {
-        checksum = ym_calc_crc16(&_ym_packet_ws[3], data_size, 0);
-        _ym_packet_ws[3 + data_size] = (checksum >> 8) & 0xFF;
-        _ym_packet_ws[4 + data_size] = (checksum & 0xFF);
+    for (uint32_t idx = bytes_read; idx < data_size; ++idx) {
+        buf[3 + idx] = 0x1A;
     }
-    else {
-        checksum = 0;
-        for (int idx = 0; idx < data_size; ++idx) {
-            checksum += _ym_packet_ws[3 + idx];
+    ymodem_sign_xmodem_packet(buf, data_size, crc);
+    *length = packet_length;
+    return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Send the stream as data packets 1, 2, ... followed by EOT.
+ *
+ * Packet N+1 is read from the stream and signed while the receiver is
+ * still checking packet N, so the link never waits on the file system.
+ * A NAK or timeout resends the current buffer without reading again.
+ * In streaming mode (YMODEM-g) the packets go out back to back and only
+ * the EOT is acknowledged; the receiver cancels on any error.
+ */
+static uint32_t ymodem_send_stream(bool crc, bool streaming, uint32_t block_size)
+{
+    uint32_t ntries;
+    uint32_t response;
+    uint32_t res;
+    uint32_t length[2];
+    uint32_t count = 1;
+    int cur = 0;
+
+    res = ymodem_build_xmodem_packet(_ym_packet_tx[cur], 1, block_size, crc, true, &length[cur]);
+    while (res == YM_RES_OK) {
+        uint8_t *packet = _ym_packet_tx[cur];
+        bool prepared = false;
+
+        if (streaming && (packet[0] != YM_EOT)) {
+            ym_send(packet, length[cur]);
+            res = ymodem_build_xmodem_packet(_ym_packet_tx[cur ^ 1], (uint8_t)(count + 1), block_size, crc, false, &length[cur ^ 1]);
+            if (ym_getc(0) == YM_CAN) return YM_RES_CANCEL;
+            ++count;
+            cur ^= 1;
+            continue;
         }
-        _ym_packet_ws[3 + data_size] = checksum&0xFF;
-    }
-    /* send the packet (try 10 times before abort) */
-    uint32_t ntries = 11;
-    do {
-        --ntries;
-        ym_flush();
-        ym_send(_ym_packet_ws, packet_length);
-        response = ym_getc(XOPT_YMODEM_TIMEOUT_CHAR);
-    } while ((response != YM_ACK) && (ntries > 0));
 
-    if (status != NULL)  *status = _ym_packet_ws[0];
-
-
-    if (ntries == 0) return YM_RES_TIMEOUT;
-    else return YM_RES_ACK;
+        ntries = _ym_timing.max_tries;
+        do {
+            /* the YMODEM receiver NAKs the first EOT on purpose */
+            if ((ntries-- < _ym_timing.max_tries) && ((packet[0] != YM_EOT) || (response != YM_NAK))) ++_ym_retries;
+            ym_flush();
+            ym_send(packet, length[cur]);
+            if (!prepared && (packet[0] != YM_EOT)) {
+                res = ymodem_build_xmodem_packet(_ym_packet_tx[cur ^ 1], (uint8_t)(count + 1), block_size, crc, false, &length[cur ^ 1]);
+                if (res != YM_RES_OK) return res;
+                prepared = true;
+            }
+            response = ym_getc(_ym_timing.char_timeout);
+            if (response == YM_CAN) return YM_RES_CANCEL;
+        } while ((response != YM_ACK) && (ntries > 0));
+
+        if (response != YM_ACK) return YM_RES_TIMEOUT;
+        if (packet[0] == YM_EOT) return YM_RES_OK;
+        ++count;
+        cur ^= 1;
+    }
+    return res;
 }
 /* ------------------------------------------------------------------------ */
-uint32_t ymodem_send_xmodem_unsafe( void )
+/*
+ * Send the stream with XMODEM in 1K (STX) packets, or in the classic 128
+ * byte (SOH) packets that every receiver understands when use_1k is false.
+ */
+uint32_t ymodem_send_xmodem_unsafe( bool use_1k )
 {
     bool crc = true;
-    uint32_t ntries = XOPT_YMODEM_MAX_TRIES;
+    uint32_t ntries = _ym_timing.max_tries;
     uint32_t response;
-    uint32_t res;
-    uint32_t block;
-    uint8_t stat;
 
+    _ym_retries = 0;
     /*
      * Part 1: wait for receiver's "C" or NAK
      */
     ym_flush();
     do {
-        response = ym_getc(XOPT_YMODEM_TIMEOUT_CHAR*5);
+        response = ym_getc(_ym_timing.handshake_timeout);
         --ntries;
     } while ((response != 'C') && (response != YM_NAK) && (ntries > 0));
 
-    if (ntries == 0) return YM_RES_TIMEOUT;
+    if ((response != 'C') && (response != YM_NAK)) return YM_RES_TIMEOUT;
     crc = (response == 'C');
 
     /*
      * Part 2: send the file data
      */
-    block = 1;
+    uint32_t res = ymodem_send_stream(crc, false, (use_1k) ? 1024 : 128);
+    if ((res == YM_RES_ERROR) || (res == YM_RES_CANCEL)) ymodem_cancel();
+    return res;
+}
+/* ------------------------------------------------------------------------ */
+/* wait for the receiver to ask for the next header or data stream */
+static uint32_t ymodem_wait_start(bool *crc, bool *streaming)
+{
+    uint32_t ntries = _ym_timing.max_tries;
+    uint32_t response;
+
     do {
-        res = ymodem_send_xmodem_packet(block, crc, &stat);
-        ++block;
-    } while ((stat != YM_EOT) && (res != YM_RES_TIMEOUT));
+        response = ym_getc(_ym_timing.handshake_timeout);
+        if (response == YM_CAN) return YM_RES_CANCEL;
+        --ntries;
+    } while ((response != YM_CRC) && (response != YM_STREAM) && (response != YM_NAK) && (ntries > 0));
 
-    return (res == YM_RES_ACK) ? YM_RES_OK : res;
+    if (response == YM_CRC) { *crc = true; *streaming = false; }
+    else if (response == YM_STREAM) { *crc = true; *streaming = true; }
+    else if (response == YM_NAK) { *crc = false; *streaming = false; }
+    else return YM_RES_TIMEOUT;
+    return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Send block 0: "name\0size\0" padded with NUL.  An empty name ends the
+ * batch.  The receiver answers with ACK, or with 'G' in YMODEM-g where the
+ * header is not acknowledged; the answer is returned in *response.
+ */
+static uint32_t ymodem_send_header(const char *name, uint32_t size, bool crc, bool streaming, uint32_t *response)
+{
+    uint8_t *packet = _ym_packet_tx[0];
+    uint32_t data_size = 128;
+    uint32_t len = 0;
+    uint32_t ntries = _ym_timing.max_tries;
+
+    memset(packet, 0, 3 + 1024 + 2);
+    if (name[0] != 0) {
+        len = (uint32_t)strlen(name);
+        if (len > 1024 - 16) len = 1024 - 16;
+        memcpy(&packet[3], name, len);
+        len += 1;
+        if (size != YM_SIZE_UNKNOWN) {
+            len += (uint32_t)snprintf((char*)&packet[3 + len], 16, "%lu", (unsigned long)size);
+        }
+        if (len >= 128) data_size = 1024;
+    }
+    packet[0] = (data_size == 1024) ? YM_STX : YM_SOH;
+    packet[1] = 0;
+    packet[2] = 0xFF;
+    ymodem_sign_xmodem_packet(packet, data_size, crc);
+
+    do {
+        if (ntries-- < _ym_timing.max_tries) ++_ym_retries;
+        ym_flush();
+        ym_send(packet, data_size + 3 + ((crc) ? 2 : 1));
+        /* nothing follows the closing header of a YMODEM-g batch */
+        if (streaming && (name[0] == 0)) return YM_RES_OK;
+        *response = ym_getc(_ym_timing.char_timeout);
+        if (*response == YM_CAN) return YM_RES_CANCEL;
+        if ((*response == YM_ACK) || (streaming && (*response == YM_STREAM))) return YM_RES_OK;
+    } while (ntries > 0);
+
+    return YM_RES_TIMEOUT;
+}
+/* ------------------------------------------------------------------------ */
+uint32_t ymodem_send( void )
+{
+    char name[ YM_MAX_FILENAME ];
+    uint32_t size;
+    uint32_t res;
+    uint32_t response = 0;
+    bool crc = true;
+    bool streaming = false;
+
+    _ym_retries = 0;
+    ym_flush();
+    for (;;) {
+        res = ymodem_wait_start(&crc, &streaming);
+        if (res != YM_RES_OK) return res;
+
+        name[0] = 0;
+        size = YM_SIZE_UNKNOWN;
+        res = ym_stream_next(name, sizeof(name), &size);
+        if (res == YM_RES_END_OF_TRANSFER) {
+            /* the empty header closes the batch */
+            return ymodem_send_header("", 0, crc, streaming, &response);
+        }
+        if (res != YM_RES_OK) {
+            _ym_fs_state = res;
+            for (int i = 0; i < 8; ++i) ym_putc(YM_CAN);
+            return YM_RES_ERROR;
+        }
+        name[sizeof(name) - 1] = 0;
+
+        res = ymodem_send_header(name, size, crc, streaming, &response);
+        if ((res == YM_RES_OK) && (response == YM_ACK)) res = ymodem_wait_start(&crc, &streaming);
+        if (res == YM_RES_OK) res = ymodem_send_stream(crc, streaming, 1024);
+        ym_stream_close(res == YM_RES_OK);
+        if (res != YM_RES_OK) return res;
+    }
+}
+/* ------------------------------------------------------------------------ */
+void ymodem_set_timing( const ym_timing_type *timing )
+{
+    if (timing != NULL) _ym_timing = *timing;
+    if (_ym_timing.max_tries == 0) _ym_timing.max_tries = 1;
+}
+/* ------------------------------------------------------------------------ */
+void ymodem_get_timing( ym_timing_type *timing )
+{
+    if (timing != NULL) *timing = _ym_timing;
 }
 /* ------------------------------------------------------------------------ */
 uint32_t ymodem_get_error(void)
@@ -387,6 +740,12 @@ uint32_t ymodem_get_error(void)
     return _ym_fs_state;
 }
 /* ------------------------------------------------------------------------ */
+/* packets resent (transmitter) or asked for again (receiver) in the last transfer */
+uint32_t ymodem_get_retries(void)
+{
+    return _ym_retries;
+}
+/* ------------------------------------------------------------------------ */
 
 /* Callback API =========================================================== */
 /* these functions are typically overridden by the application to defer
@@ -8,11 +8,22 @@
 #ifndef DRIVERS_YMODEM_H_
 #define DRIVERS_YMODEM_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Types ------------------------------------------------------------------ */
+/* protocol timing, all times in ms */
+typedef struct {
+    uint32_t start_delay;        /* receiver wait before the first 'C' */
+    uint32_t packet_delay;       /* receiver wait before each packet */
+    uint32_t char_timeout;       /* wait for packet data and for ACK/NAK */
+    uint32_t handshake_timeout;  /* transmitter wait for each 'C'/NAK */
+    uint32_t max_tries;          /* retries for each handshake and packet */
+} ym_timing_type;
 
 /* Definitions and constants ============================================== */
 #define YM_RES_OK               (0)
@@ -24,11 +35,22 @@ extern "C" {
 #define YM_RES_BUSY             (6)
 #define YM_RES_ACK              (7)
 
+/* file size passed to ym_stream_open()/from ym_stream_next() when it is not known */
+#define YM_SIZE_UNKNOWN         (0xFFFFFFFF)
+/* longest file name (with the terminating NUL) handed to ym_stream_next() */
+#define YM_MAX_FILENAME         (256)
+
 /* Public API ------------------------------------------------------------- */
 
 uint32_t ymodem_receive_xmodem_unsafe(bool ascii_mode);
-uint32_t ymodem_send_xmodem_unsafe( void );
+uint32_t ymodem_send_xmodem_unsafe( bool use_1k );
+uint32_t ymodem_receive( bool streaming );
+uint32_t ymodem_send( void );
 uint32_t ymodem_get_error(void);
+uint32_t ymodem_get_retries(void);
+uint32_t ymodem_crc16(const uint8_t *data, uint32_t len, uint32_t crc);
+void ymodem_set_timing( const ym_timing_type *timing );
+void ymodem_get_timing( ym_timing_type *timing );
 
 /* Callback API =========================================================== */
 /* these functions are typically overridden by the application to defer
@@ -39,6 +61,14 @@ uint32_t ymodem_get_error(void);
 
 uint32_t ym_stream_write(uint32_t block_id, uint8_t *block, uint32_t size);
 uint32_t ym_stream_read(uint8_t *block, uint32_t size, bool first, uint32_t *br);
+/* YMODEM batch: the receiver opens each announced file and closes it when it
+ * is complete (ok) or the transfer failed.  The sender asks for the next file
+ * with ym_stream_next(), which returns YM_RES_END_OF_TRANSFER after the last
+ * one, and closes it the same way.
+ */
+uint32_t ym_stream_open(const char *name, uint32_t size);
+uint32_t ym_stream_next(char *name, uint32_t len, uint32_t *size);
+void ym_stream_close(bool ok);
 void ym_flush( void );
 void ym_putc(char c);
 uint32_t ym_getc( uint32_t timeout);
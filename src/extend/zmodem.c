@@ -0,0 +1,936 @@
+/*
+ * zmodem.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+/* ------------------------------------------------------------------------ */
+#include <ctype.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zmodem.h"
+
+/* ------------------------------------------------------------------------ */
+#ifndef XOPT_ZMODEM_MAX_TRIES
+#define XOPT_ZMODEM_MAX_TRIES         10
+#endif
+#ifndef XOPT_ZMODEM_MAX_GARBAGE
+#define XOPT_ZMODEM_MAX_GARBAGE       65536  /* bytes skipped while hunting for a header */
+#endif
+#ifndef XOPT_ZMODEM_RX_BUFFER
+#define XOPT_ZMODEM_RX_BUFFER         2048   /* bytes taken from the line with one read */
+#endif
+#define ZM_MAX_BLOCK                  1024
+
+/* constants defined by ZModem protocol */
+#define ZPAD                       ('*')   /* pad character, begins frames */
+#define ZDLE                       (0x18)  /* ZMODEM escape (same as CAN) */
+#define ZDLEE                      (ZDLE ^ 0x40)  /* escaped ZDLE */
+#define ZBIN                       ('A')   /* binary frame, CRC-16 */
+#define ZHEX                       ('B')   /* hex frame, CRC-16 */
+#define ZBIN32                     ('C')   /* binary frame, CRC-32 */
+#define ZM_XON                     (0x11)
+#define ZM_XOFF                    (0x13)
+
+/* frame types */
+#define ZRQINIT                    (0)     /* request receive init */
+#define ZRINIT                     (1)     /* receive init */
+#define ZSINIT                     (2)     /* send init sequence */
+#define ZACK                       (3)     /* acknowledge */
+#define ZFILE                      (4)     /* file name from sender */
+#define ZSKIP                      (5)     /* receiver skips the file */
+#define ZNAK                       (6)     /* last header was garbled */
+#define ZABORT                     (7)     /* abort batch transfers */
+#define ZFIN                       (8)     /* finish session */
+#define ZRPOS                      (9)     /* resume data transmission here */
+#define ZDATA                      (10)    /* data packets to follow */
+#define ZEOF                       (11)    /* end of file */
+#define ZFERR                      (12)    /* fatal read or write error */
+#define ZCRC                       (13)    /* request for file CRC */
+#define ZCHALLENGE                 (14)    /* receiver's challenge */
+#define ZCOMPL                     (15)    /* request is complete */
+#define ZCAN                       (16)    /* other end cancelled with CAN*5 */
+
+/* ZDLE sequences ending a data subpacket */
+#define ZCRCE                      ('h')   /* end of frame, header follows */
+#define ZCRCG                      ('i')   /* frame continues nonstop */
+#define ZCRCQ                      ('j')   /* frame continues, ZACK expected */
+#define ZCRCW                      ('k')   /* end of frame, ZACK expected */
+#define ZRUB0                      ('l')   /* translate to 0x7F */
+#define ZRUB1                      ('m')   /* translate to 0xFF */
+
+/* ZRINIT capabilities in ZF0 */
+#define CANFDX                     (0x01)  /* full duplex */
+#define CANOVIO                    (0x02)  /* receive while writing to disk */
+#define CANFC32                    (0x20)  /* CRC-32 frames */
+
+/* header bytes, positions are little endian, flags are reversed */
+#define ZP0                        (0)
+#define ZP1                        (1)
+#define ZF0                        (3)
+
+/* results of the receive helpers besides the data byte or frame type */
+#define ZM_TIMEOUT                 (-1)
+#define ZM_ERROR                   (-2)
+#define ZM_CANCEL                  (-3)
+#define ZM_GOTFRAME                (0x100) /* or'd with the subpacket end */
+
+/* Private Data =========================================================== */
+static uint8_t _zm_data[ ZM_MAX_BLOCK + 16 ];
+static uint8_t _zm_tx[ 2 * (ZM_MAX_BLOCK + 16) + 64 ];
+static uint32_t _zm_tx_len;
+static int32_t _zm_pushback = -1;
+static uint8_t _zm_rx[ XOPT_ZMODEM_RX_BUFFER ];
+static uint32_t _zm_rx_pos;
+static uint32_t _zm_rx_len;
+static bool _zm_rx_crc32;       /* last header was ZBIN32, its data uses CRC-32 */
+static bool _zm_tx_crc32;       /* the receiver accepts CRC-32 frames */
+static char _zm_name[ YM_MAX_FILENAME ];
+static uint32_t _zm_retries;    /* rewinds (sender) or ZRPOS requests (receiver) */
+
+/* CRC-32 (IEEE 802.3, reflected) */
+static const uint32_t _zm_crc32_table[256] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
+    0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+    0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
+    0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
+    0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+    0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
+    0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
+    0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+    0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
+    0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
+    0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+    0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
+    0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
+    0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+    0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
+    0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
+    0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+    0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
+    0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
+    0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+    0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
+    0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
+    0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+    0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
+    0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
+    0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+    0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
+    0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
+    0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+    0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
+    0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
+    0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+    0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D,
+};
+
+/* Private APIs =========================================================== */
+/* ------------------------------------------------------------------------ */
+static uint32_t zm_crc32(const uint8_t *data, uint32_t len, uint32_t crc)
+{
+    while (len--) {
+        crc = _zm_crc32_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+/* ------------------------------------------------------------------------ */
+static void zm_set_pos(uint8_t *hdr, uint32_t pos)
+{
+    hdr[0] = pos & 0xFF;
+    hdr[1] = (pos >> 8) & 0xFF;
+    hdr[2] = (pos >> 16) & 0xFF;
+    hdr[3] = (pos >> 24) & 0xFF;
+}
+/* ------------------------------------------------------------------------ */
+static uint32_t zm_get_pos(const uint8_t *hdr)
+{
+    return (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+}
+
+/* Receive ================================================================ */
+/* ------------------------------------------------------------------------ */
+/*
+ * Next byte from the line.  The bytes come from _zm_rx, which is refilled
+ * with what has arrived in one ym_receive(); only an empty line waits for
+ * the first byte.
+ */
+static int32_t zm_rawc(uint32_t timeout)
+{
+    uint32_t c;
+
+    if (_zm_pushback >= 0) {
+        c = (uint32_t)_zm_pushback;
+        _zm_pushback = -1;
+        return (int32_t)c;
+    }
+    if (_zm_rx_pos >= _zm_rx_len) {
+        _zm_rx_pos = 0;
+        _zm_rx_len = ym_receive(_zm_rx, sizeof(_zm_rx), 0);
+        if (_zm_rx_len == 0) {
+            if ((timeout == 0) || (ym_receive(_zm_rx, 1, timeout) == 0)) return ZM_TIMEOUT;
+            _zm_rx_len = 1 + ym_receive(&_zm_rx[1], sizeof(_zm_rx) - 1, 0);
+        }
+    }
+    return (int32_t)_zm_rx[_zm_rx_pos++];
+}
+/* ------------------------------------------------------------------------ */
+/* next byte from the line, XON/XOFF inserted by the link are dropped */
+static int32_t zm_getc(uint32_t timeout)
+{
+    int32_t c;
+
+    do {
+        c = zm_rawc(timeout);
+    } while ((c >= 0) && ((c & 0x7F) == ZM_XON || (c & 0x7F) == ZM_XOFF));
+    return c;
+}
+/* ------------------------------------------------------------------------ */
+/* discard everything received so far, used before asking for a resend */
+static void zm_purge( void )
+{
+    _zm_pushback = -1;
+    _zm_rx_pos = _zm_rx_len = 0;
+    ym_flush();
+}
+/* ------------------------------------------------------------------------ */
+/* ZDLE decoded byte, the end of a data subpacket is ZM_GOTFRAME|end */
+static int32_t zm_zdl_getc(uint32_t timeout)
+{
+    int32_t c = zm_getc(timeout);
+    int cans = 1;
+
+    if (c != ZDLE) return c;
+    while ((c = zm_getc(timeout)) == ZDLE) {
+        /* five CAN in a row cancel the session */
+        if (++cans >= 5) return ZM_CANCEL;
+    }
+    if (c < 0) return c;
+    switch (c) {
+    case ZCRCE:
+    case ZCRCG:
+    case ZCRCQ:
+    case ZCRCW:
+        return ZM_GOTFRAME | c;
+    case ZRUB0:
+        return 0x7F;
+    case ZRUB1:
+        return 0xFF;
+    default:
+        break;
+    }
+    return ((c & 0x60) == 0x40) ? (c ^ 0x40) : ZM_ERROR;
+}
+/* ------------------------------------------------------------------------ */
+static int32_t zm_hex_nibble(int32_t c)
+{
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return ZM_ERROR;
+}
+/* ------------------------------------------------------------------------ */
+static int32_t zm_recv_hex_header(uint8_t *raw, uint32_t timeout)
+{
+    int32_t hi, lo, c;
+
+    for (int i = 0; i < 7; ++i) {
+        if ((hi = zm_getc(timeout)) < 0) return hi;
+        if ((lo = zm_getc(timeout)) < 0) return lo;
+        hi = zm_hex_nibble(hi);
+        lo = zm_hex_nibble(lo);
+        if ((hi < 0) || (lo < 0)) return ZM_ERROR;
+        raw[i] = (uint8_t)((hi << 4) | lo);
+    }
+    if (ymodem_crc16(raw, 7, 0) != 0) return ZM_ERROR;
+    /* CR LF trailer, the XON after it is dropped by zm_getc() */
+    c = zm_getc(timeout);
+    if ((c & 0x7F) == '\r') c = zm_getc(timeout);
+    if ((c >= 0) && ((c & 0x7F) != '\n')) _zm_pushback = c;
+    return raw[0];
+}
+/* ------------------------------------------------------------------------ */
+static int32_t zm_recv_bin_header(uint8_t *raw, bool crc32, uint32_t timeout)
+{
+    uint32_t n = crc32 ? 9 : 7;
+    int32_t c;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        c = zm_zdl_getc(timeout);
+        if (c < 0) return c;
+        if (c & ZM_GOTFRAME) return ZM_ERROR;
+        raw[i] = (uint8_t)c;
+    }
+    if (crc32) {
+        if (zm_crc32(raw, 9, 0xFFFFFFFF) != 0xDEBB20E3) return ZM_ERROR;
+    }
+    else if (ymodem_crc16(raw, 7, 0) != 0) return ZM_ERROR;
+    return raw[0];
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Hunt for the next header and return its type, the position/flag bytes
+ * are stored in hdr.
+ */
+static int32_t zm_recv_header(uint8_t *hdr, uint32_t timeout)
+{
+    uint32_t garbage = 0;
+    uint8_t raw[9];
+    int cans = 0;
+    int32_t c, type;
+
+    for (;;) {
+        c = zm_getc(timeout);
+        if (c < 0) return c;
+        if (c == ZDLE) {
+            if (++cans >= 5) return ZM_CANCEL;
+            continue;
+        }
+        cans = 0;
+        if (c != ZPAD) {
+            if (++garbage > XOPT_ZMODEM_MAX_GARBAGE) return ZM_ERROR;
+            continue;
+        }
+        while ((c = zm_getc(timeout)) == ZPAD);
+        if (c < 0) return c;
+        if (c != ZDLE) {
+            _zm_pushback = c;
+            continue;
+        }
+        c = zm_getc(timeout);
+        if (c == ZHEX) type = zm_recv_hex_header(raw, timeout);
+        else if ((c == ZBIN) || (c == ZBIN32)) type = zm_recv_bin_header(raw, (c == ZBIN32), timeout);
+        else if (c < 0) return c;
+        else continue;
+
+        if (type >= 0) {
+            _zm_rx_crc32 = (c == ZBIN32);
+            memcpy(hdr, &raw[1], 4);
+        }
+        return type;
+    }
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Receive a data subpacket into buf and return how it ended (ZCRCE..ZCRCW)
+ * or an error.  The CRC of the preceding header's kind is checked.
+ */
+static int32_t zm_recv_data(uint8_t *buf, uint32_t max, uint32_t *len, uint32_t timeout)
+{
+    uint8_t check[4];
+    uint32_t n = 0;
+    uint32_t crc_len = _zm_rx_crc32 ? 4 : 2;
+    int32_t c, end;
+
+    for (;;) {
+        c = zm_zdl_getc(timeout);
+        if (c < 0) return c;
+        if (c & ZM_GOTFRAME) break;
+        if (n >= max) return ZM_ERROR;
+        buf[n++] = (uint8_t)c;
+    }
+    end = c & 0xFF;
+    for (uint32_t i = 0; i < crc_len; ++i) {
+        c = zm_zdl_getc(timeout);
+        if (c < 0) return c;
+        if (c & ZM_GOTFRAME) return ZM_ERROR;
+        check[i] = (uint8_t)c;
+    }
+    *len = n;
+    if (_zm_rx_crc32) {
+        uint8_t e = (uint8_t)end;
+        uint32_t crc = zm_crc32(buf, n, 0xFFFFFFFF);
+        crc = ~zm_crc32(&e, 1, crc);
+        if (crc != zm_get_pos(check)) return ZM_ERROR;
+    }
+    else {
+        uint8_t e = (uint8_t)end;
+        uint32_t crc = ymodem_crc16(buf, n, 0);
+        crc = ymodem_crc16(&e, 1, crc);
+        if (crc != (((uint32_t)check[0] << 8) | check[1])) return ZM_ERROR;
+    }
+    return end;
+}
+
+/* Transmit =============================================================== */
+/* ------------------------------------------------------------------------ */
+static void zm_put(uint8_t c)
+{
+    _zm_tx[_zm_tx_len++] = c;
+}
+/* ------------------------------------------------------------------------ */
+static void zm_put_esc(uint8_t c)
+{
+    switch (c) {
+    case ZDLE:
+    case 0x10:
+    case 0x90:
+    case ZM_XON:
+    case ZM_XON | 0x80:
+    case ZM_XOFF:
+    case ZM_XOFF | 0x80:
+        zm_put(ZDLE);
+        zm_put(c ^ 0x40);
+        break;
+    default:
+        zm_put(c);
+        break;
+    }
+}
+/* ------------------------------------------------------------------------ */
+static void zm_flush_tx( void )
+{
+    if (_zm_tx_len > 0) ym_send(_zm_tx, _zm_tx_len);
+    _zm_tx_len = 0;
+}
+/* ------------------------------------------------------------------------ */
+static void zm_send_hex_header(uint8_t type, const uint8_t *hdr)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint8_t raw[7];
+    uint32_t crc;
+
+    raw[0] = type;
+    memcpy(&raw[1], hdr, 4);
+    crc = ymodem_crc16(raw, 5, 0);
+    raw[5] = (crc >> 8) & 0xFF;
+    raw[6] = crc & 0xFF;
+
+    zm_put(ZPAD);
+    zm_put(ZPAD);
+    zm_put(ZDLE);
+    zm_put(ZHEX);
+    for (int i = 0; i < 7; ++i) {
+        zm_put(hex[raw[i] >> 4]);
+        zm_put(hex[raw[i] & 0x0F]);
+    }
+    zm_put('\r');
+    zm_put('\n' | 0x80);
+    if ((type != ZFIN) && (type != ZACK)) zm_put(ZM_XON);
+    zm_flush_tx();
+}
+/* ------------------------------------------------------------------------ */
+static void zm_send_pos_header(uint8_t type, uint32_t pos)
+{
+    uint8_t hdr[4];
+    zm_set_pos(hdr, pos);
+    zm_send_hex_header(type, hdr);
+}
+/* ------------------------------------------------------------------------ */
+/* binary header, CRC-32 when the receiver supports it */
+static void zm_send_bin_header(uint8_t type, const uint8_t *hdr)
+{
+    uint8_t raw[5];
+
+    raw[0] = type;
+    memcpy(&raw[1], hdr, 4);
+    zm_put(ZPAD);
+    zm_put(ZDLE);
+    zm_put(_zm_tx_crc32 ? ZBIN32 : ZBIN);
+    for (int i = 0; i < 5; ++i) zm_put_esc(raw[i]);
+    if (_zm_tx_crc32) {
+        uint32_t crc = ~zm_crc32(raw, 5, 0xFFFFFFFF);
+        for (int i = 0; i < 4; ++i, crc >>= 8) zm_put_esc(crc & 0xFF);
+    }
+    else {
+        uint32_t crc = ymodem_crc16(raw, 5, 0);
+        zm_put_esc((crc >> 8) & 0xFF);
+        zm_put_esc(crc & 0xFF);
+    }
+    zm_flush_tx();
+}
+/* ------------------------------------------------------------------------ */
+static void zm_send_data(const uint8_t *buf, uint32_t len, uint8_t end)
+{
+    for (uint32_t i = 0; i < len; ++i) zm_put_esc(buf[i]);
+    zm_put(ZDLE);
+    zm_put(end);
+    if (_zm_tx_crc32) {
+        uint32_t crc = zm_crc32(buf, len, 0xFFFFFFFF);
+        crc = ~zm_crc32(&end, 1, crc);
+        for (int i = 0; i < 4; ++i, crc >>= 8) zm_put_esc(crc & 0xFF);
+    }
+    else {
+        uint32_t crc = ymodem_crc16(buf, len, 0);
+        crc = ymodem_crc16(&end, 1, crc);
+        zm_put_esc((crc >> 8) & 0xFF);
+        zm_put_esc(crc & 0xFF);
+    }
+    if (end == ZCRCW) zm_put(ZM_XON);
+    zm_flush_tx();
+}
+/* ------------------------------------------------------------------------ */
+/* CAN*8 followed by backspaces to clean up the remote command line */
+static void zm_cancel( void )
+{
+    static const uint8_t seq[] = {
+        ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE,
+        0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08
+    };
+    ym_send((uint8_t*)seq, sizeof(seq));
+}
+/* ------------------------------------------------------------------------ */
+static bool zm_progress(const zm_options_type *opt, uint32_t offset, uint32_t size)
+{
+    if (opt->progress == NULL) return true;
+    return opt->progress(opt->ctx, _zm_name, offset, size);
+}
+/* ------------------------------------------------------------------------ */
+static void zm_options(const zm_options_type *in, zm_options_type *opt)
+{
+    if (in != NULL) *opt = *in;
+    else zmodem_default_options(opt);
+    if (opt->block < 32) opt->block = 32;
+    if (opt->block > ZM_MAX_BLOCK) opt->block = ZM_MAX_BLOCK;
+    if (opt->timeout == 0) opt->timeout = ZM_DEFAULT_TIMEOUT;
+    _zm_pushback = -1;
+    _zm_rx_pos = _zm_rx_len = 0;
+    _zm_tx_len = 0;
+    _zm_retries = 0;
+}
+
+/* Sender ================================================================= */
+/* ------------------------------------------------------------------------ */
+static uint32_t zm_wait_rinit(const zm_options_type *opt, uint32_t *rxbuf)
+{
+    uint8_t hdr[4] = { 0, 0, 0, 0 };
+
+    for (uint32_t tries = 0; tries < XOPT_ZMODEM_MAX_TRIES; ++tries) {
+        int32_t type = zm_recv_header(hdr, opt->timeout);
+
+        switch (type) {
+        case ZRINIT:
+            _zm_tx_crc32 = (hdr[ZF0] & CANFC32) != 0;
+            *rxbuf = (uint32_t)hdr[ZP0] | ((uint32_t)hdr[ZP1] << 8);
+            return YM_RES_OK;
+        case ZCHALLENGE:
+            zm_send_hex_header(ZACK, hdr);
+            break;
+        case ZCAN:
+        case ZABORT:
+        case ZM_CANCEL:
+            return YM_RES_CANCEL;
+        default:
+            zm_set_pos(hdr, 0);
+            zm_send_hex_header(ZRQINIT, hdr);
+            break;
+        }
+    }
+    return YM_RES_TIMEOUT;
+}
+/* ------------------------------------------------------------------------ */
+/* ZFILE with "name\0size mtime mode\0", the receiver answers with ZRPOS */
+static uint32_t zm_send_zfile(const zm_options_type *opt, uint32_t size, uint32_t *pos)
+{
+    uint8_t hdr[4] = { 0, 0, 0, 0 };
+    uint8_t rh[4];
+    uint32_t len = (uint32_t)strlen(_zm_name) + 1;
+
+    memcpy(_zm_data, _zm_name, len);
+    if (size != YM_SIZE_UNKNOWN) {
+        len += (uint32_t)snprintf((char*)&_zm_data[len], 32, "%lu 0 0", (unsigned long)size) + 1;
+    }
+    else _zm_data[len++] = 0;
+
+    for (uint32_t tries = 0; tries < XOPT_ZMODEM_MAX_TRIES; ++tries) {
+        int32_t type;
+
+        if (tries > 0) ++_zm_retries;
+        zm_send_bin_header(ZFILE, hdr);
+        zm_send_data(_zm_data, len, ZCRCW);
+        /* a ZRINIT still queued from the handshake is not an answer */
+        do {
+            type = zm_recv_header(rh, opt->timeout);
+        } while ((type == ZRINIT) || (type == ZACK));
+        switch (type) {
+        case ZRPOS:
+            *pos = zm_get_pos(rh);
+            return YM_RES_OK;
+        case ZSKIP:
+            return YM_RES_END_OF_TRANSFER;
+        case ZCAN:
+        case ZABORT:
+        case ZFERR:
+        case ZM_CANCEL:
+            return YM_RES_CANCEL;
+        default:
+            break;
+        }
+    }
+    return YM_RES_TIMEOUT;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * Stream the file from the receiver's position.  The frame stays open
+ * with ZCRCG subpackets; with a window every quarter of it ends in ZCRCQ
+ * so the receiver reports its position, and the sender stops once a full
+ * window is unacknowledged.  ZRPOS from the receiver rewinds the stream.
+ */
+static uint32_t zm_send_file(const zm_options_type *opt, uint32_t size, uint32_t window)
+{
+    uint8_t hdr[4];
+    uint8_t rh[4];
+    uint32_t pos = 0;
+    uint32_t acked;
+    uint32_t last_rpos;
+    uint32_t since_q = 0;
+    uint32_t tries = 0;
+    uint32_t res;
+    bool restart = true;
+    int32_t type;
+
+    res = zm_send_zfile(opt, size, &pos);
+    if (res == YM_RES_END_OF_TRANSFER) return YM_RES_OK;
+    if (res != YM_RES_OK) return res;
+    acked = last_rpos = pos;
+
+    for (;;) {
+        /*
+         * Data frame(s)
+         */
+        for (;;) {
+            uint32_t br = 0;
+            uint8_t end;
+            bool last;
+
+            if (restart) {
+                if (ym_stream_seek(pos) != YM_RES_OK) return YM_RES_ERROR;
+                zm_set_pos(hdr, pos);
+                zm_send_bin_header(ZDATA, hdr);
+                restart = false;
+                since_q = 0;
+            }
+            if (ym_stream_read(_zm_data, opt->block, false, &br) != YM_RES_OK) return YM_RES_ERROR;
+            last = (br < opt->block);
+            since_q += br;
+            if (last) end = ZCRCE;
+            else if ((window > 0) && (since_q >= (((window / 4) > opt->block) ? (window / 4) : opt->block))) {
+                end = ZCRCQ;
+                since_q = 0;
+            }
+            else end = ZCRCG;
+            zm_send_data(_zm_data, br, end);
+            pos += br;
+            if (!zm_progress(opt, pos, size)) {
+                zm_cancel();
+                return YM_RES_CANCEL;
+            }
+            if (last) break;
+
+            /* reverse channel: ZACK moves the window, ZRPOS rewinds */
+            for (;;) {
+                bool full = (window > 0) && (pos - acked >= window);
+
+                if (!full) {
+                    /* only look when something other than XON is waiting */
+                    int32_t c = zm_getc(0);
+                    if (c < 0) break;
+                    _zm_pushback = c;
+                }
+                type = zm_recv_header(rh, opt->timeout);
+                if (type == ZACK) {
+                    uint32_t p = zm_get_pos(rh);
+                    if ((p > acked) && (p <= pos)) acked = p;
+                }
+                else if (type == ZRPOS) {
+                    pos = acked = zm_get_pos(rh);
+                    restart = true;
+                    /* errors are only fatal while the receiver makes no progress */
+                    if (pos > last_rpos) tries = 0;
+                    last_rpos = pos;
+                }
+                else if (type == ZSKIP) return YM_RES_OK;
+                else if ((type == ZCAN) || (type == ZABORT) || (type == ZFERR) || (type == ZM_CANCEL)) return YM_RES_CANCEL;
+                else if (full && (type == ZM_TIMEOUT)) {
+                    /* the acknowledgements were lost, start over from the last one */
+                    pos = acked;
+                    restart = true;
+                }
+                if (restart) {
+                    ++_zm_retries;
+                    if (++tries > XOPT_ZMODEM_MAX_TRIES) return YM_RES_TIMEOUT;
+                    break;
+                }
+            }
+        }
+
+        /*
+         * End of file, the receiver answers with ZRINIT or asks for a resend
+         */
+        for (;;) {
+            zm_set_pos(hdr, pos);
+            zm_send_bin_header(ZEOF, hdr);
+            do {
+                type = zm_recv_header(rh, opt->timeout);
+            } while (type == ZACK);
+            if ((type == ZRINIT) || (type == ZSKIP)) return YM_RES_OK;
+            if ((type == ZCAN) || (type == ZABORT) || (type == ZFERR) || (type == ZM_CANCEL)) return YM_RES_CANCEL;
+            if (++tries > XOPT_ZMODEM_MAX_TRIES) return YM_RES_TIMEOUT;
+            ++_zm_retries;
+            if (type == ZRPOS) {
+                pos = acked = zm_get_pos(rh);
+                restart = true;
+                if (pos > last_rpos) tries = 0;
+                last_rpos = pos;
+                break;
+            }
+        }
+    }
+}
+/* ------------------------------------------------------------------------ */
+uint32_t zmodem_send( const zm_options_type *options )
+{
+    zm_options_type opt;
+    uint8_t hdr[4] = { 0, 0, 0, 0 };
+    uint32_t rxbuf = 0;
+    uint32_t window;
+    uint32_t size;
+    uint32_t res;
+
+    zm_options(options, &opt);
+    ym_send((uint8_t*)"rz\r", 3);
+    zm_send_hex_header(ZRQINIT, hdr);
+    res = zm_wait_rinit(&opt, &rxbuf);
+    if (res != YM_RES_OK) return res;
+
+    /* a receiver with a buffer limit gets at most that much in flight */
+    window = opt.window;
+    if ((rxbuf > 0) && ((window == 0) || (window > rxbuf))) window = rxbuf;
+
+    for (;;) {
+        _zm_name[0] = 0;
+        size = YM_SIZE_UNKNOWN;
+        res = ym_stream_next(_zm_name, sizeof(_zm_name), &size);
+        if (res == YM_RES_END_OF_TRANSFER) break;
+        if (res != YM_RES_OK) {
+            zm_cancel();
+            return YM_RES_ERROR;
+        }
+        _zm_name[sizeof(_zm_name) - 1] = 0;
+        res = zm_send_file(&opt, size, window);
+        ym_stream_close(res == YM_RES_OK);
+        if (res != YM_RES_OK) {
+            if (res != YM_RES_CANCEL) zm_cancel();
+            return res;
+        }
+    }
+
+    /* session end: ZFIN both ways, then "over and out" */
+    for (uint32_t tries = 0; tries < XOPT_ZMODEM_MAX_TRIES; ++tries) {
+        int32_t type;
+        zm_send_hex_header(ZFIN, hdr);
+        type = zm_recv_header(hdr, opt.timeout);
+        if (type == ZFIN) {
+            ym_send((uint8_t*)"OO", 2);
+            return YM_RES_OK;
+        }
+        if ((type == ZCAN) || (type == ZM_CANCEL)) return YM_RES_CANCEL;
+        memset(hdr, 0, sizeof(hdr));
+    }
+    return YM_RES_TIMEOUT;
+}
+
+/* Receiver =============================================================== */
+/* ------------------------------------------------------------------------ */
+static void zm_send_rinit(const zm_options_type *opt)
+{
+    uint8_t hdr[4] = { 0, 0, 0, CANFDX | CANOVIO | CANFC32 };
+    (void) opt;
+    zm_send_hex_header(ZRINIT, hdr);
+}
+/* ------------------------------------------------------------------------ */
+/* ZFILE data: open the file and return the position to start from */
+static uint32_t zm_open_file(const zm_options_type *opt, uint32_t len, uint32_t *size, uint32_t *pos)
+{
+    char *info = (char*)_zm_data;
+    size_t nlen = strnlen(info, len);
+
+    if ((nlen == 0) || (nlen >= len) || (nlen >= sizeof(_zm_name))) return YM_RES_ERROR;
+    memcpy(_zm_name, info, nlen + 1);
+    *size = YM_SIZE_UNKNOWN;
+    _zm_data[len] = 0;
+    if ((nlen + 1 < len) && isdigit((unsigned char)info[nlen + 1])) {
+        *size = (uint32_t)strtoul(&info[nlen + 1], NULL, 10);
+    }
+    if (ym_stream_open(_zm_name, *size) != YM_RES_OK) return YM_RES_ERROR;
+    *pos = (opt->resume) ? ym_stream_size() : 0;
+    if (opt->resume && (*size != YM_SIZE_UNKNOWN) && (*pos >= *size)) return YM_RES_END_OF_TRANSFER;
+    if (ym_stream_seek(*pos) != YM_RES_OK) return YM_RES_ERROR;
+    return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+/* data subpackets of one ZDATA frame */
+static uint32_t zm_recv_frame(const zm_options_type *opt, uint32_t *pos, uint32_t size)
+{
+    uint32_t len;
+    int32_t end;
+
+    for (;;) {
+        end = zm_recv_data(_zm_data, ZM_MAX_BLOCK, &len, opt->timeout);
+        if (end == ZM_CANCEL) return YM_RES_CANCEL;
+        if (end < 0) return (end == ZM_TIMEOUT) ? YM_RES_TIMEOUT : YM_RES_ERR_CRC;
+        if (len > 0) {
+            if (ym_stream_write(*pos, _zm_data, len) != YM_RES_OK) return YM_RES_ERROR;
+            *pos += len;
+        }
+        if (!zm_progress(opt, *pos, size)) {
+            zm_cancel();
+            return YM_RES_CANCEL;
+        }
+        switch (end) {
+        case ZCRCW:
+            zm_send_pos_header(ZACK, *pos);
+            return YM_RES_OK;
+        case ZCRCQ:
+            zm_send_pos_header(ZACK, *pos);
+            break;
+        case ZCRCE:
+            return YM_RES_OK;
+        default:
+            break;
+        }
+    }
+}
+/* ------------------------------------------------------------------------ */
+uint32_t zmodem_receive( const zm_options_type *options )
+{
+    zm_options_type opt;
+    uint8_t hdr[4];
+    uint32_t tries = 0;
+    uint32_t pos = 0;
+    uint32_t size = 0;
+    uint32_t len;
+    uint32_t res;
+    bool open = false;
+    int32_t type;
+
+    zm_options(options, &opt);
+    zm_send_rinit(&opt);
+    for (;;) {
+        type = zm_recv_header(hdr, opt.timeout);
+        switch (type) {
+        case ZRQINIT:
+            if (!open) zm_send_rinit(&opt);
+            break;
+        case ZSINIT:
+            if (zm_recv_data(_zm_data, ZM_MAX_BLOCK, &len, opt.timeout) >= 0) zm_send_pos_header(ZACK, 0);
+            else zm_send_pos_header(ZNAK, 0);
+            break;
+        case ZFILE:
+            if (zm_recv_data(_zm_data, ZM_MAX_BLOCK, &len, opt.timeout) < 0) {
+                zm_send_pos_header(ZNAK, 0);
+                break;
+            }
+            if (open) {
+                /* our ZRPOS was lost */
+                zm_send_pos_header(ZRPOS, pos);
+                break;
+            }
+            res = zm_open_file(&opt, len, &size, &pos);
+            if (res == YM_RES_OK) {
+                open = true;
+                tries = 0;
+                zm_send_pos_header(ZRPOS, pos);
+            }
+            else {
+                /* the file could not be written (or is complete), skip it */
+                ym_stream_close(res == YM_RES_END_OF_TRANSFER);
+                zm_send_pos_header(ZSKIP, 0);
+            }
+            break;
+        case ZDATA:
+            if (!open) {
+                zm_send_rinit(&opt);
+                break;
+            }
+            if (zm_get_pos(hdr) == pos) {
+                uint32_t start = pos;
+
+                res = zm_recv_frame(&opt, &pos, size);
+                /* the tries count errors without progress in between */
+                if (pos != start) tries = 0;
+                if (res == YM_RES_OK) break;
+                if (res == YM_RES_CANCEL) {
+                    ym_stream_close(false);
+                    return res;
+                }
+                if (res == YM_RES_ERROR) {
+                    zm_cancel();
+                    ym_stream_close(false);
+                    return res;
+                }
+            }
+            if (++tries > XOPT_ZMODEM_MAX_TRIES) {
+                zm_cancel();
+                ym_stream_close(false);
+                return YM_RES_TIMEOUT;
+            }
+            zm_purge();
+            zm_send_pos_header(ZRPOS, pos);
+            ++_zm_retries;
+            break;
+        case ZEOF:
+            if (!open) zm_send_rinit(&opt);
+            else if (zm_get_pos(hdr) == pos) {
+                ym_stream_close(true);
+                open = false;
+                zm_send_rinit(&opt);
+            }
+            /* a ZEOF for another position is stale, the ZRPOS is on its way */
+            break;
+        case ZFIN:
+            if (open) ym_stream_close(false);
+            zm_send_pos_header(ZFIN, 0);
+            /* "OO", not every sender bothers */
+            zm_getc(500);
+            zm_getc(100);
+            return YM_RES_OK;
+        case ZCAN:
+        case ZABORT:
+        case ZM_CANCEL:
+            if (open) ym_stream_close(false);
+            return YM_RES_CANCEL;
+        default:
+            if (++tries > XOPT_ZMODEM_MAX_TRIES) {
+                if (open) ym_stream_close(false);
+                zm_cancel();
+                return YM_RES_TIMEOUT;
+            }
+            if (open) zm_send_pos_header(ZRPOS, pos);
+            else zm_send_rinit(&opt);
+            ++_zm_retries;
+            break;
+        }
+    }
+}
+/* ------------------------------------------------------------------------ */
+uint32_t zmodem_get_retries( void )
+{
+    return _zm_retries;
+}
+/* ------------------------------------------------------------------------ */
+void zmodem_default_options( zm_options_type *opt )
+{
+    memset(opt, 0, sizeof(*opt));
+    opt->window = ZM_DEFAULT_WINDOW;
+    opt->block = ZM_DEFAULT_BLOCK;
+    opt->timeout = ZM_DEFAULT_TIMEOUT;
+}
+/* ------------------------------------------------------------------------ */
+
+/* EnD OF FILE ============================================================ */
@@ -0,0 +1,65 @@
+/*
+ * zmodem.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ */
+
+#ifndef DRIVERS_ZMODEM_H_
+#define DRIVERS_ZMODEM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ymodem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Types ------------------------------------------------------------------ */
+/*
+ * Transfer options.  The progress callback is called after each data
+ * subpacket with the current file offset, returning false cancels the
+ * transfer.
+ */
+typedef struct {
+    uint32_t window;     /* bytes the sender has in flight before it waits for ZACK, 0 streams */
+    uint32_t block;      /* data subpacket size, 32..1024 */
+    uint32_t timeout;    /* ms to wait for a header before it is requested again */
+    bool     resume;     /* receiver continues files from ym_stream_size() */
+    bool   (*progress)(void *ctx, const char *name, uint32_t offset, uint32_t size);
+    void    *ctx;
+} zm_options_type;
+
+/* Definitions and constants ============================================== */
+#define ZM_DEFAULT_WINDOW       (16384)
+#define ZM_DEFAULT_BLOCK        (1024)
+#define ZM_DEFAULT_TIMEOUT      (10000)
+
+/* Public API ------------------------------------------------------------- */
+
+/* the results are the YM_RES_* codes of the YMODEM driver */
+uint32_t zmodem_send( const zm_options_type *opt );
+uint32_t zmodem_receive( const zm_options_type *opt );
+void zmodem_default_options( zm_options_type *opt );
+/* rewinds of the sender or resend requests of the receiver in the last transfer */
+uint32_t zmodem_get_retries( void );
+
+/* Callback API =========================================================== */
+/* ZMODEM uses the ym_* serial and ym_stream_* callbacks of the YMODEM
+ * driver; ym_stream_next()/ym_stream_open() announce the files.  Data is
+ * read and written sequentially from the offset set with ym_stream_seek(),
+ * ym_stream_size() reports how much of a received file already exists so
+ * an interrupted transfer can be resumed.
+ */
+uint32_t ym_stream_seek(uint32_t offset);
+uint32_t ym_stream_size(void);
+/* ------------------------------------------------------------------------ */
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* DRIVERS_ZMODEM_H_ */
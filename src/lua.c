@@ -21,9 +21,11 @@
 #include "lualib.h"
 
 int luaopen_ext(lua_State *L);     /* Add general extensions */
-#ifdef WIN32
 int luaopen_brooks_serial(lua_State *L);
-#endif
+void startup_begin(lua_State *L, const char *phase);  /* LUA_STARTUP_TRACE */
+void startup_end(lua_State *L);
+void bytecache_install(lua_State *L);  /* LUA_BYTECACHE */
+int bytecache_loadfile(lua_State *L, const char *fname);
 
 #if !defined(LUA_PROGNAME)
 #define LUA_PROGNAME		"lua"
@@ -246,10 +248,14 @@ static int handle_script (lua_State *L, char **argv) {
   const char *fname = argv[0];
   if (strcmp(fname, "-") == 0 && strcmp(argv[-1], "--") != 0)
     fname = NULL;  /* stdin */
-  status = luaL_loadfile(L, fname);
+  startup_begin(L, "main chunk load");
+  status = bytecache_loadfile(L, fname);
+  startup_end(L);
   if (status == LUA_OK) {
     int n = pushargs(L);  /* push arguments to script */
+    startup_begin(L, "main chunk run");
     status = docall(L, n, LUA_MULTRET);
+    startup_end(L);
   }
   return report(L, status);
 }
@@ -618,17 +624,24 @@ static int pmain (lua_State *L) {
     lua_pushboolean(L, 1);  /* signal for libraries to ignore env. vars. */
     lua_setfield(L, LUA_REGISTRYINDEX, "LUA_NOENV");
   }
+  startup_begin(L, "luaL_openlibs");
   luaL_openlibs(L);  /* open standard libraries */
+  startup_end(L);
   /* Extenstions ---------------------------------------------------------- */
-#ifdef WIN32
+  startup_begin(L, "luaopen_ext");
   luaopen_brooks_serial(L);  /* Extend with serial() */
-#endif
   luaopen_ext(L);     /* Add general extensions */
+  bytecache_install(L);  /* compiled modules are kept in LUA_BYTECACHE */
+  startup_end(L);
   /* ---------------------------------------------------------------------- */
   createargtable(L, argv, argc, script);  /* create table 'arg' */
   lua_gc(L, LUA_GCGEN, 0, 0);  /* GC in generational mode */
   if (!(args & has_E)) {  /* no option '-E'? */
-    if (handle_luainit(L) != LUA_OK)  /* run LUA_INIT */
+    int status;
+    startup_begin(L, "LUA_INIT");
+    status = handle_luainit(L);  /* run LUA_INIT */
+    startup_end(L);
+    if (status != LUA_OK)
       return 0;  /* error running LUA_INIT */
   }
   if (!runargs(L, argv, script))  /* execute arguments -e and -l */
@@ -652,7 +665,10 @@ static int pmain (lua_State *L) {
 
 int main (int argc, char **argv) {
   int status, result;
-  lua_State *L = luaL_newstate();  /* create state */
+  lua_State *L;
+  startup_begin(NULL, "luaL_newstate");
+  L = luaL_newstate();  /* create state */
+  startup_end(L);
   if (L == NULL) {
     l_message(argv[0], "cannot create state: not enough memory");
     return EXIT_FAILURE;
@@ -0,0 +1,601 @@
+#ifdef XFERBENCH
+/*
+ * xferbench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: CErhardt
+ *
+ * Loopback benchmark of the serial file transfers.  Two pseudo terminals are
+ * joined by a relay process that paces the bytes at the line rate and
+ * injects delay, jitter, bit errors and dropped bytes, the receiver runs in
+ * a child process on one pty and the sender in this process on the other.
+ * Each run reports the effective throughput, the retransmissions and the
+ * CPU time per MB of both sides; the exit code is non-zero when a transfer
+ * fails or the received file differs, so the tool can guard a CI run.
+ */
+#ifndef WIN32
+#define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "extend/serialport.h"
+#include "extend/ymodem.h"
+#include "extend/zmodem.h"
+#include "extend/ym_file.h"
+
+/* Definitions and constants ============================================== */
+#define XB_FILE_NAME         ("bench.bin")
+#define XB_CHUNK             (64)        /**< bytes the relay moves at once */
+#define XB_QUEUE             (8192)      /**< chunks in flight per direction */
+#define XB_TX_BUFFER         (4096)      /**< bytes a UART driver takes ahead of the line */
+
+enum { XB_XMODEM, XB_YMODEM, XB_YMODEM_G, XB_ZMODEM, XB_ALL };
+static const char *const xb_mode_names[] = { "xmodem", "ymodem", "ymodem-g", "zmodem", "all" };
+
+/* Types ------------------------------------------------------------------ */
+typedef struct {
+	int mode;
+	uint32_t size;        /**< bytes in the test file */
+	uint32_t baud;        /**< line rate the relay paces at, 0 = as fast as the ptys go */
+	double delay;         /**< one way delay in ms */
+	double jitter;        /**< extra random delay in ms, 0..jitter */
+	double ber;           /**< probability that a bit is flipped */
+	double drop;          /**< probability that a byte is lost */
+	uint32_t window;      /**< ZMODEM window */
+	double storage;       /**< ms the sender's storage takes for each block it reads */
+	uint32_t repeat;
+	uint64_t seed;
+} xb_options_type;
+
+/* one direction of the relay */
+typedef struct {
+	int from, to;         /**< pty masters */
+	struct { uint8_t d[ XB_CHUNK ]; uint32_t n; double due; } q[ XB_QUEUE ];
+	uint32_t head, tail;  /**< chunks are written at head, taken at tail */
+	uint32_t off;         /**< bytes of the tail chunk already delivered */
+	double wire;          /**< time the line is busy until */
+	double last;          /**< due time of the newest chunk, keeps the order */
+	double next_flip;     /**< bits until the next bit error */
+	double next_drop;     /**< bytes until the next lost byte */
+} xb_link_type;
+
+/* fault counters, shared with the relay process */
+typedef struct {
+	uint64_t flips;
+	uint64_t drops;
+} xb_faults_type;
+
+/* what the receiver process reports */
+typedef struct {
+	uint32_t res;
+	uint32_t retries;
+} xb_result_type;
+
+typedef struct {
+	double wall;          /**< s */
+	double cpu_tx, cpu_rx;/**< s */
+	uint32_t retries_tx, retries_rx;
+	uint64_t flips, drops;
+	bool ok;
+	bool aborted;         /**< YMODEM-g gave up on a fault, which is all it can do */
+} xb_run_type;
+
+extern HANDLE ym_serial;
+
+/* Private Data =========================================================== */
+static xb_options_type _xb;
+static uint64_t _xb_rng;
+static volatile sig_atomic_t _xb_stop = 0;
+
+/* Private APIs =========================================================== */
+/* ------------------------------------------------------------------------ */
+static double xb_now( void )
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+/* ------------------------------------------------------------------------ */
+/* xorshift64*, uniform in (0,1] */
+static double xb_random( void )
+{
+	_xb_rng ^= _xb_rng >> 12;
+	_xb_rng ^= _xb_rng << 25;
+	_xb_rng ^= _xb_rng >> 27;
+	return (double)((_xb_rng * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0 + 1.0 / 9007199254740992.0;
+}
+/* ------------------------------------------------------------------------ */
+/* events of probability p happen every xb_gap(p) trials */
+static double xb_gap( double p )
+{
+	if (p <= 0.0) return INFINITY;
+	if (p >= 1.0) return 0.0;
+	return floor(log(xb_random()) / log1p(-p));
+}
+/* ------------------------------------------------------------------------ */
+static double xb_cpu( const struct rusage *ru )
+{
+	return (double)ru->ru_utime.tv_sec + (double)ru->ru_utime.tv_usec / 1e6
+	     + (double)ru->ru_stime.tv_sec + (double)ru->ru_stime.tv_usec / 1e6;
+}
+/* ------------------------------------------------------------------------ */
+/* open a pty master, the name of its slave is stored in slave */
+static int xb_pty( char *slave, size_t len )
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (fd < 0) return -1;
+	if ((grantpt(fd) != 0) || (unlockpt(fd) != 0) || (ptsname_r(fd, slave, len) != 0)) {
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+/* Relay ================================================================== */
+/* ------------------------------------------------------------------------ */
+static void xb_relay_stop( int sig )
+{
+	(void) sig;
+	_xb_stop = 1;
+}
+/* ------------------------------------------------------------------------ */
+/*
+ * The link takes more data while the queue has room and, when it is paced,
+ * no more than a driver buffer is waiting for the line; the sender blocks
+ * like it would on a real port.
+ */
+static bool xb_relay_ready( const xb_link_type *l )
+{
+	if ((l->head - l->tail) >= XB_QUEUE) return false;
+	if (_xb.baud == 0) return true;
+	return (l->wire - xb_now()) * (double)_xb.baud / 10.0 < (double)XB_TX_BUFFER;
+}
+/* ------------------------------------------------------------------------ */
+/* read what is waiting on the link, damage it and queue it for delivery */
+static void xb_relay_read( xb_link_type *l, xb_faults_type *faults )
+{
+	uint8_t buf[ XB_CHUNK ];
+	ssize_t rd;
+
+	while (xb_relay_ready(l) && ((rd = read(l->from, buf, sizeof(buf))) > 0)) {
+		double t = xb_now();
+		uint32_t n = 0;
+
+		for (ssize_t i = 0; i < rd; ++i) {
+			if (l->next_drop < 1.0) {
+				l->next_drop = xb_gap(_xb.drop);
+				++faults->drops;
+				continue;
+			}
+			l->next_drop -= 1.0;
+			while (l->next_flip < 8.0) {
+				buf[i] ^= (uint8_t)(1u << (uint32_t)l->next_flip);
+				l->next_flip += xb_gap(_xb.ber) + 1.0;
+				++faults->flips;
+			}
+			l->next_flip -= 8.0;
+			buf[n++] = buf[i];
+		}
+		if (n == 0) continue;
+
+		/* the line is busy for 10 bits a byte, then the chunk travels */
+		if (_xb.baud != 0) {
+			l->wire = ((l->wire > t) ? l->wire : t) + (double)n * 10.0 / (double)_xb.baud;
+			t = l->wire;
+		}
+		t += (_xb.delay + _xb.jitter * xb_random()) / 1000.0;
+		if (t < l->last) t = l->last;
+		l->last = t;
+
+		uint32_t h = l->head++ % XB_QUEUE;
+		memcpy(l->q[h].d, buf, n);
+		l->q[h].n = n;
+		l->q[h].due = t;
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* deliver the chunks that are due, returns the ms until the next one or -1 */
+static int xb_relay_write( xb_link_type *l )
+{
+	while (l->tail != l->head) {
+		uint32_t i = l->tail % XB_QUEUE;
+		double wait = l->q[i].due - xb_now();
+		ssize_t wr;
+
+		if (wait > 0.0) return (int)ceil(wait * 1000.0);
+		wr = write(l->to, &l->q[i].d[l->off], l->q[i].n - l->off);
+		if (wr < 0) return ((errno == EAGAIN) || (errno == EINTR)) ? 1 : -1;
+		l->off += (uint32_t)wr;
+		if (l->off < l->q[i].n) return 1;
+		l->off = 0;
+		++l->tail;
+	}
+	return -1;
+}
+/* ------------------------------------------------------------------------ */
+static void xb_relay( int a, int b, xb_faults_type *faults )
+{
+	static xb_link_type link[2];
+
+	signal(SIGTERM, xb_relay_stop);
+	memset(link, 0, sizeof(link));
+	link[0].from = a; link[0].to = b;
+	link[1].from = b; link[1].to = a;
+	for (int i = 0; i < 2; ++i) {
+		link[i].next_flip = xb_gap(_xb.ber);
+		link[i].next_drop = xb_gap(_xb.drop);
+	}
+
+	while (!_xb_stop) {
+		struct pollfd pfd[2];
+		int timeout = -1;
+
+		for (int i = 0; i < 2; ++i) {
+			int t = xb_relay_write(&link[i]);
+			if (!xb_relay_ready(&link[i])) t = 1;
+			if ((t >= 0) && ((timeout < 0) || (t < timeout))) timeout = t;
+			pfd[i].fd = link[i].from;
+			pfd[i].events = (xb_relay_ready(&link[i])) ? POLLIN : 0;
+		}
+		if (poll(pfd, 2, timeout) < 0) continue;
+		for (int i = 0; i < 2; ++i) {
+			if (pfd[i].revents & POLLIN) xb_relay_read(&link[i], faults);
+		}
+	}
+}
+
+/* Transfers ============================================================== */
+/* ------------------------------------------------------------------------ */
+static uint32_t xb_transfer( int mode, bool send, ym_file_type *f )
+{
+	zm_options_type opt;
+	uint32_t res;
+
+	ym_file_attach(f);
+	switch (mode) {
+	case XB_XMODEM:
+		if (send) return ymodem_send_xmodem_unsafe(true);
+		/* the XMODEM receiver ends with the EOT it acknowledged */
+		res = ymodem_receive_xmodem_unsafe(false);
+		return (res == YM_RES_END_OF_TRANSFER) ? YM_RES_OK : res;
+	case XB_YMODEM:
+		return (send) ? ymodem_send() : ymodem_receive(false);
+	case XB_YMODEM_G:
+		return (send) ? ymodem_send() : ymodem_receive(true);
+	default:
+		zmodem_default_options(&opt);
+		opt.window = _xb.window;
+		return (send) ? zmodem_send(&opt) : zmodem_receive(&opt);
+	}
+}
+/* ------------------------------------------------------------------------ */
+/* the sender's progress hook after every block read, models slow storage */
+static uint32_t xb_storage( ym_file_type *f )
+{
+	struct timespec ts;
+
+	(void)f;
+	ts.tv_sec = (time_t)(_xb.storage / 1000.0);
+	ts.tv_nsec = (long)((_xb.storage - ts.tv_sec * 1000.0) * 1e6);
+	while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR));
+	return YM_RES_OK;
+}
+/* ------------------------------------------------------------------------ */
+static uint32_t xb_retries( int mode )
+{
+	return (mode == XB_ZMODEM) ? zmodem_get_retries() : ymodem_get_retries();
+}
+/* ------------------------------------------------------------------------ */
+/* the received file matches the source, XMODEM pads the last block with ^Z */
+static bool xb_compare( const char *src, const char *dst, bool padded )
+{
+	FILE *a = fopen(src, "rb");
+	FILE *b = fopen(dst, "rb");
+	bool same = (a != NULL) && (b != NULL);
+	int ca, cb;
+
+	while (same) {
+		ca = fgetc(a);
+		cb = fgetc(b);
+		if (ca == EOF) {
+			while (padded && (cb == 0x1A)) cb = fgetc(b);
+			same = (cb == EOF);
+			break;
+		}
+		same = (ca == cb);
+	}
+	if (a != NULL) fclose(a);
+	if (b != NULL) fclose(b);
+	return same;
+}
+/* ------------------------------------------------------------------------ */
+static void xb_run( int mode, const char *dir, xb_run_type *run )
+{
+	char slave[2][64], src[512], rxdir[512], dst[ 512 + YM_MAX_FILENAME ];
+	const char *paths[1] = { src };
+	int master[2], rpipe[2];
+	pid_t relay, receiver;
+	xb_faults_type *faults;
+	xb_result_type rx = { YM_RES_ERROR, 0 };
+	struct rusage ru0, ru1, ru_rx;
+	ym_file_type f;
+	uint32_t res;
+	int status;
+	double t0;
+
+	memset(run, 0, sizeof(xb_run_type));
+	snprintf(src, sizeof(src), "%s/%s", dir, XB_FILE_NAME);
+	snprintf(rxdir, sizeof(rxdir), "%s/rx", dir);
+	snprintf(dst, sizeof(dst), "%s/%s", rxdir, XB_FILE_NAME);
+	remove(dst);
+
+	faults = mmap(NULL, sizeof(xb_faults_type), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (faults == MAP_FAILED) return;
+	memset(faults, 0, sizeof(xb_faults_type));
+
+	master[0] = xb_pty(slave[0], sizeof(slave[0]));
+	master[1] = xb_pty(slave[1], sizeof(slave[1]));
+	if ((master[0] < 0) || (master[1] < 0) || (pipe(rpipe) != 0)) {
+		perror("xferbench: pty");
+		return;
+	}
+
+	fflush(stdout);
+	/* every run gets its own faults, the relay starts from the next random state */
+	xb_random();
+	relay = fork();
+	if (relay == 0) {
+		close(rpipe[0]);
+		close(rpipe[1]);
+		xb_relay(master[0], master[1], faults);
+		_exit(0);
+	}
+
+	t0 = xb_now();
+	receiver = fork();
+	if (receiver == 0) {
+		close(rpipe[0]);
+		close(master[0]);
+		close(master[1]);
+		ym_serial = openSerialPort(slave[1], 115200, one, off);
+		memset(&f, 0, sizeof(f));
+		if (mode == XB_XMODEM) f.fp = fopen(dst, "w+b");
+		else f.dir = rxdir;
+		rx.res = xb_transfer(mode, false, &f);
+		rx.retries = xb_retries(mode);
+		ym_file_attach(NULL);
+		if (write(rpipe[1], &rx, sizeof(rx)) != sizeof(rx)) _exit(1);
+		_exit(0);
+	}
+	close(rpipe[1]);
+
+	/* the sender runs here, so its CPU time is what this process used */
+	getrusage(RUSAGE_SELF, &ru0);
+	ym_serial = openSerialPort(slave[0], 115200, one, off);
+	memset(&f, 0, sizeof(f));
+	if (mode == XB_XMODEM) f.fp = fopen(src, "rb");
+	else {
+		f.paths = paths;
+		f.count = 1;
+	}
+	if (_xb.storage > 0) {
+		f.progress = xb_storage;
+		f.every = 1;
+	}
+	res = xb_transfer(mode, true, &f);
+	run->retries_tx = xb_retries(mode);
+	ym_file_attach(NULL);
+
+	if (read(rpipe[0], &rx, sizeof(rx)) != sizeof(rx)) rx.res = YM_RES_ERROR;
+	close(rpipe[0]);
+	wait4(receiver, &status, 0, &ru_rx);
+	run->wall = xb_now() - t0;
+	getrusage(RUSAGE_SELF, &ru1);
+	closeSerialPort(ym_serial);
+	ym_serial = SP_INVALID_HANDLE;
+
+	kill(relay, SIGTERM);
+	waitpid(relay, &status, 0);
+	close(master[0]);
+	close(master[1]);
+
+	run->cpu_tx = xb_cpu(&ru1) - xb_cpu(&ru0);
+	run->cpu_rx = xb_cpu(&ru_rx);
+	run->retries_rx = rx.retries;
+	run->flips = faults->flips;
+	run->drops = faults->drops;
+	munmap(faults, sizeof(xb_faults_type));
+
+	run->ok = (res == YM_RES_OK) && (rx.res == YM_RES_OK) && xb_compare(src, dst, mode == XB_XMODEM);
+	run->aborted = !run->ok && (mode == XB_YMODEM_G) && ((run->flips + run->drops) > 0)
+		&& ((res != YM_RES_OK) || (rx.res != YM_RES_OK));
+}
+/* ------------------------------------------------------------------------ */
+static void xb_report( const char *label, const char *result, const xb_run_type *run, uint32_t n )
+{
+	double mb = (double)_xb.size * n / 1048576.0;
+	double rate = (double)_xb.size * n / run->wall;
+
+	printf("%-9s %-6s", label, result);
+	if (n == 0) printf(" %10s %10s %6s", "-", "-", "-");
+	else {
+		printf(" %10.3f %10.0f", run->wall / n, rate);
+		if (_xb.baud != 0) printf(" %5.1f%%", rate * 1000.0 / _xb.baud);
+		else printf(" %6s", "-");
+	}
+	printf(" %7u %7u", run->retries_tx, run->retries_rx);
+	if (n == 0) printf(" %8s %8s", "-", "-");
+	else printf(" %8.1f %8.1f", run->cpu_tx * 1000.0 / mb, run->cpu_rx * 1000.0 / mb);
+	printf(" %7llu %7llu\n", (unsigned long long)run->flips, (unsigned long long)run->drops);
+}
+/* ------------------------------------------------------------------------ */
+/* run the mode repeat times, the summary averages the transfers that passed */
+static bool xb_mode( int mode, const char *dir )
+{
+	xb_run_type run, total;
+	uint32_t passed = 0, aborted = 0;
+
+	memset(&total, 0, sizeof(total));
+	for (uint32_t i = 0; i < _xb.repeat; ++i) {
+		xb_run(mode, dir, &run);
+		if (_xb.repeat > 1) xb_report("", (run.ok) ? "ok" : (run.aborted) ? "abort" : "FAIL", &run, (run.ok) ? 1 : 0);
+		if (run.ok) {
+			total.wall += run.wall;
+			total.cpu_tx += run.cpu_tx;
+			total.cpu_rx += run.cpu_rx;
+			++passed;
+		}
+		else if (run.aborted) ++aborted;
+		total.retries_tx += run.retries_tx;
+		total.retries_rx += run.retries_rx;
+		total.flips += run.flips;
+		total.drops += run.drops;
+	}
+	xb_report(xb_mode_names[mode], (passed == _xb.repeat) ? "ok" : (passed + aborted == _xb.repeat) ? "abort" : "FAIL",
+		&total, passed);
+	return (passed + aborted) == _xb.repeat;
+}
+/* ------------------------------------------------------------------------ */
+/* random test data, so that no protocol gets an easy ride on escaping */
+static bool xb_make_file( const char *path )
+{
+	FILE *fp = fopen(path, "wb");
+	uint8_t buf[4096];
+
+	if (fp == NULL) return false;
+	for (uint32_t left = _xb.size; left > 0; ) {
+		uint32_t n = (left < sizeof(buf)) ? left : (uint32_t)sizeof(buf);
+		for (uint32_t i = 0; i < n; ++i) buf[i] = (uint8_t)(xb_random() * 256.0);
+		fwrite(buf, 1, n, fp);
+		left -= n;
+	}
+	return fclose(fp) == 0;
+}
+/* ------------------------------------------------------------------------ */
+static void xb_usage( const char *prog )
+{
+	printf("usage: %s [options]\n"
+		"  -m mode    xmodem, ymodem, ymodem-g, zmodem or all (all)\n"
+		"  -s bytes   size of the test file (262144)\n"
+		"  -b baud    line rate of the link, 0 = unpaced (115200)\n"
+		"  -d ms      one way delay (0)\n"
+		"  -j ms      random extra delay up to ms (0)\n"
+		"  -e ber     bit error rate, e.g. 1e-5 (0)\n"
+		"  -x rate    probability that a byte is dropped (0)\n"
+		"  -w bytes   ZMODEM window, 0 streams (%u)\n"
+		"  -R ms      time the sender's storage takes per block read (0)\n"
+		"  -r n       repeat each transfer n times (1)\n"
+		"  -S seed    seed of the data and the faults (1)\n", prog, ZM_DEFAULT_WINDOW);
+}
+
+/* Public API ============================================================= */
+/* ------------------------------------------------------------------------ */
+int main( int argc, char **argv )
+{
+	char dir[] = "/tmp/xferbench.XXXXXX";
+	char path[512];
+	ym_timing_type timing;
+	bool ok = true;
+	int c;
+
+	_xb.mode = XB_ALL;
+	_xb.size = 262144;
+	_xb.baud = 115200;
+	_xb.window = ZM_DEFAULT_WINDOW;
+	_xb.repeat = 1;
+	_xb.seed = 1;
+	while ((c = getopt(argc, argv, "m:s:b:d:j:e:x:w:R:r:S:h")) != -1) {
+		switch (c) {
+		case 'm':
+			for (_xb.mode = 0; _xb.mode <= XB_ALL; ++_xb.mode) {
+				if (strcmp(optarg, xb_mode_names[_xb.mode]) == 0) break;
+			}
+			if (_xb.mode > XB_ALL) {
+				fprintf(stderr, "xferbench: unknown mode '%s'\n", optarg);
+				return 2;
+			}
+			break;
+		case 's': _xb.size = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'b': _xb.baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'd': _xb.delay = strtod(optarg, NULL); break;
+		case 'j': _xb.jitter = strtod(optarg, NULL); break;
+		case 'e': _xb.ber = strtod(optarg, NULL); break;
+		case 'x': _xb.drop = strtod(optarg, NULL); break;
+		case 'w': _xb.window = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'R': _xb.storage = strtod(optarg, NULL); break;
+		case 'r': _xb.repeat = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'S': _xb.seed = strtoull(optarg, NULL, 0); break;
+		default:
+			xb_usage(argv[0]);
+			return (c == 'h') ? 0 : 2;
+		}
+	}
+	if ((_xb.size == 0) || (_xb.repeat == 0)) {
+		xb_usage(argv[0]);
+		return 2;
+	}
+	_xb_rng = (_xb.seed != 0) ? _xb.seed : 1;
+
+	/* no start up pause, the receiver is known to be ready */
+	ymodem_get_timing(&timing);
+	timing.start_delay = 0;
+	ymodem_set_timing(&timing);
+
+	if (mkdtemp(dir) == NULL) {
+		perror("xferbench: mkdtemp");
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/rx", dir);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/%s", dir, XB_FILE_NAME);
+	if (!xb_make_file(path)) {
+		perror("xferbench: test file");
+		return 1;
+	}
+
+	printf("%u bytes, %u baud, delay %.1f ms, jitter %.1f ms, ber %g, drop %g, storage %.1f ms\n",
+		_xb.size, _xb.baud, _xb.delay, _xb.jitter, _xb.ber, _xb.drop, _xb.storage);
+	printf("%-9s %-6s %10s %10s %6s %7s %7s %8s %8s %7s %7s\n", "mode", "result", "s", "B/s", "line",
+		"tx-rtr", "rx-rtr", "tx-ms/MB", "rx-ms/MB", "flips", "drops");
+	for (int mode = XB_XMODEM; mode < XB_ALL; ++mode) {
+		if ((_xb.mode == XB_ALL) || (_xb.mode == mode)) ok = xb_mode(mode, dir) && ok;
+	}
+
+	remove(path);
+	snprintf(path, sizeof(path), "%s/rx/%s", dir, XB_FILE_NAME);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/rx", dir);
+	rmdir(path);
+	rmdir(dir);
+	return (ok) ? 0 : 1;
+}
+/* ------------------------------------------------------------------------ */
+#else
+#include <stdio.h>
+
+int main( void )
+{
+	fprintf(stderr, "xferbench: needs POSIX ptys\n");
+	return 1;
+}
+#endif
+#endif
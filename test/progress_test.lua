@@ -0,0 +1,55 @@
+-- progress_test.lua : the native progress bar against progress2.lua
+--
+--   xLua progress_test.lua
+--
+-- Both renderers draw the same bars for a set of sizes and ranges, size 0
+-- included (the legacy path of compiler.lua draws an empty bar).  Exits
+-- with 1 when a rendered string differs.
+------------------------------------------------------------------------------
+local sep  = package.config:sub(1,1) -- extract the separator
+package.path = ("..{SEP}scripts{SEP}modules{SEP}?.lua;.{SEP}scripts{SEP}modules{SEP}?.lua;"):gsub("{SEP}",sep) .. package.path
+------------------------------------------------------------------------------
+if cprogress == nil then
+    print("cprogress is not available, run this test with xLua")
+    os.exit(1)
+end
+local native = cprogress
+cprogress = nil
+local lua = require "progress2"
+package.loaded.progress2 = nil
+cprogress = native
+local progress = require "progress2"
+------------------------------------------------------------------------------
+local failed = 0
+local function check( name, size, max, min, bar )
+    local a, b = lua.new(size, max, min), progress.new(size, max, min)
+    if bar then a.bar, b.bar = bar, bar end
+    for pos = (min or 0), (max or 100) do
+        a:pos(pos)
+        b:pos(pos)
+        local sa, na = a:render()
+        local sb, nb = b:render()
+        if (sa ~= sb) or (na ~= nb) then
+            print(string.format("FAIL %s at %d:\n  lua    %q %s\n  native %q %s", name, pos, sa, na, sb, nb))
+            failed = failed + 1
+            return
+        end
+    end
+    print("ok   " .. name)
+end
+
+check("size 50", 50, 100, 0)
+check("size 7, range 3..40", 7, 40, 3)
+check("size 0", 0, 100, 0)
+check("size 0, ${PCT}", 0, 20, 0, "[${BAR}] ${PCT}% |")
+check("size 0, min == max", 0, 5, 5, "[${BAR}] ${PCT}%")
+check("size 1, ${BAR} twice", 1, 10, 0, "${BAR}-${BAR}")
+
+local ok = pcall(progress.new, -1)
+if ok then
+    print("FAIL size -1 was accepted")
+    failed = failed + 1
+else
+    print("ok   size -1 is refused")
+end
+os.exit((failed == 0) and 0 or 1)